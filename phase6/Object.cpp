@@ -0,0 +1,90 @@
+/*
+ * File:	Object.cpp
+ *
+ * Description:	This file contains the member function definitions for
+ *		object code in Simple C.
+ */
+
+# include "Object.h"
+
+using namespace std;
+
+
+/*
+ * Function:	Object::Object (constructor)
+ *
+ * Description:	Initialize an empty object for a machine with the given
+ *		number of bits.
+ */
+
+Object::Object(unsigned bits)
+    : bits(bits)
+{
+}
+
+
+/*
+ * Function:	Object::section
+ *
+ * Description:	Return the index of the section with the given name,
+ *		creating it if necessary.  The attributes of a new section
+ *		follow from its name, as with the usual assemblers.
+ */
+
+unsigned Object::section(const string &name)
+{
+    Section s;
+
+
+    for (unsigned i = 0; i < sections.size(); i ++)
+	if (sections[i].name == name)
+	    return i;
+
+    s.name = name;
+    s.nobits = (name == ".bss");
+    s.writable = (name == ".data" || name == ".bss");
+    s.executable = (name == ".text");
+    s.alignment = 1;
+    sections.push_back(s);
+    return sections.size() - 1;
+}
+
+
+/*
+ * Function:	Object::symbol
+ *
+ * Description:	Return the index of the symbol with the given name,
+ *		creating an undefined symbol if necessary.
+ */
+
+unsigned Object::symbol(const string &name)
+{
+    Symbol s;
+    map<string, unsigned>::iterator it = _symbols.find(name);
+
+
+    if (it != _symbols.end())
+	return it->second;
+
+    s.name = name;
+    s.section = UNDEFINED;
+    s.value = 0;
+    s.size = 0;
+    s.global = false;
+    symbols.push_back(s);
+    return _symbols[name] = symbols.size() - 1;
+}
+
+
+/*
+ * Function:	Object::find
+ *
+ * Description:	Return the index of the symbol with the given name, or -1
+ *		if there is no such symbol.
+ */
+
+int Object::find(const string &name) const
+{
+    map<string, unsigned>::const_iterator it = _symbols.find(name);
+    return it != _symbols.end() ? (int) it->second : -1;
+}
@@ -0,0 +1,65 @@
+/*
+ * File:	Object.h
+ *
+ * Description:	This file contains the class definition for object code
+ *		in Simple C, as produced by our assembler.  An object
+ *		consists of sections of bytes, a symbol table, and the
+ *		relocations that must be applied to the sections once the
+ *		addresses of the symbols are known.
+ *
+ *		The object is independent of any file format.  It can be
+ *		written out as an ELF relocatable file or loaded directly
+ *		into memory.  It holds code for either i386 or x86-64, as
+ *		given by its number of bits.
+ */
+
+# ifndef OBJECT_H
+# define OBJECT_H
+# include <map>
+# include <string>
+# include <vector>
+# include <cstdint>
+
+class Object {
+    typedef std::string string;
+    std::map<string, unsigned> _symbols;
+
+public:
+    enum { UNDEFINED = -1, COMMON = -2, ABSOLUTE = -3 };
+    enum RelocationType { ABSOLUTE32, RELATIVE32 };
+
+    struct Section {
+	string name;
+	bool nobits, writable, executable;
+	unsigned alignment;
+	std::vector<uint8_t> bytes;
+    };
+
+    struct Symbol {
+	string name;
+	int section;
+	uint64_t value, size;
+	bool global;
+    };
+
+    struct Relocation {
+	unsigned section;
+	uint64_t offset;
+	unsigned symbol;
+	RelocationType type;
+	int64_t addend;
+    };
+
+    unsigned bits;
+    std::vector<Section> sections;
+    std::vector<Symbol> symbols;
+    std::vector<Relocation> relocations;
+
+    Object(unsigned bits = 32);
+
+    unsigned section(const string &name);
+    unsigned symbol(const string &name);
+    int find(const string &name) const;
+};
+
+# endif /* OBJECT_H */
@@ -0,0 +1,200 @@
+/*
+ * File:	Scheduler.cpp
+ *
+ * Description:	This file contains the member function definitions for the
+ *		work-stealing scheduler.
+ *
+ *		The scheduler-wide lock only guards the counts of queued
+ *		and running tasks, which is how idle workers know whether
+ *		to sleep.  A worker that wakes up reserves one queued task
+ *		by decrementing the count, and then goes looking for it in
+ *		the queues, its own first.  Since every task in a queue is
+ *		covered by a reservation or by the count, the search must
+ *		eventually succeed.
+ */
+
+# include "Scheduler.h"
+
+using namespace std;
+
+
+/*
+ * Function:	Scheduler::Scheduler (constructor)
+ *
+ * Description:	Initialize the scheduler and start its worker threads.  If
+ *		no number of workers is given, we use one per hardware
+ *		thread.
+ */
+
+Scheduler::Scheduler(unsigned workers)
+    : _next(0), _queued(0), _running(0), _stopping(false)
+{
+    if (workers == 0)
+	workers = thread::hardware_concurrency();
+
+    if (workers == 0)
+	workers = 1;
+
+    for (unsigned i = 0; i < workers; i ++)
+	_workers.push_back(new Worker());
+
+    for (unsigned i = 0; i < workers; i ++)
+	_threads.push_back(thread(&Scheduler::run, this, i));
+}
+
+
+/*
+ * Function:	Scheduler::~Scheduler (destructor)
+ *
+ * Description:	Finish any outstanding tasks and stop the workers.
+ */
+
+Scheduler::~Scheduler()
+{
+    wait();
+
+    {
+	lock_guard<mutex> guard(_lock);
+	_stopping = true;
+    }
+
+    _ready.notify_all();
+
+    for (unsigned i = 0; i < _threads.size(); i ++)
+	_threads[i].join();
+
+    for (unsigned i = 0; i < _workers.size(); i ++)
+	delete _workers[i];
+}
+
+
+/*
+ * Function:	Scheduler::workers (accessor)
+ *
+ * Description:	Return the number of worker threads.
+ */
+
+unsigned Scheduler::workers() const
+{
+    return _workers.size();
+}
+
+
+/*
+ * Function:	Scheduler::submit
+ *
+ * Description:	Queue a task on the next worker in turn.
+ */
+
+void Scheduler::submit(const Task &task)
+{
+    Worker *worker;
+
+
+    {
+	lock_guard<mutex> guard(_lock);
+	worker = _workers[_next ++ % _workers.size()];
+
+	lock_guard<mutex> inner(worker->lock);
+	worker->tasks.push_back(task);
+	_queued ++;
+    }
+
+    _ready.notify_one();
+}
+
+
+/*
+ * Function:	Scheduler::wait
+ *
+ * Description:	Block until every submitted task has finished.
+ */
+
+void Scheduler::wait()
+{
+    unique_lock<mutex> guard(_lock);
+
+    while (_queued > 0 || _running > 0)
+	_idle.wait(guard);
+}
+
+
+/*
+ * Function:	Scheduler::take
+ *
+ * Description:	Take a task for the worker numbered SELF, trying the back
+ *		of its own queue before stealing from the front of the
+ *		others, starting with its neighbor.
+ */
+
+bool Scheduler::take(unsigned self, Task &task)
+{
+    unsigned n = _workers.size();
+
+
+    for (unsigned i = 0; i < n; i ++) {
+	Worker *worker = _workers[(self + i) % n];
+	lock_guard<mutex> guard(worker->lock);
+
+	if (!worker->tasks.empty()) {
+	    if (i == 0) {
+		task = worker->tasks.back();
+		worker->tasks.pop_back();
+	    } else {
+		task = worker->tasks.front();
+		worker->tasks.pop_front();
+	    }
+
+	    return true;
+	}
+    }
+
+    return false;
+}
+
+
+/*
+ * Function:	Scheduler::run
+ *
+ * Description:	The body of the worker numbered SELF, which runs tasks
+ *		until the scheduler is stopped.
+ */
+
+void Scheduler::run(unsigned self)
+{
+    Task task;
+
+
+    while (1) {
+	{
+	    unique_lock<mutex> guard(_lock);
+
+	    while (_queued == 0 && !_stopping)
+		_ready.wait(guard);
+
+	    if (_queued == 0)
+		return;
+
+	    _queued --;
+	    _running ++;
+	}
+
+	while (!take(self, task))
+	    this_thread::yield();
+
+	try {
+	    task();
+	} catch (...) {
+	}
+
+	task = Task();
+
+	{
+	    lock_guard<mutex> guard(_lock);
+	    _running --;
+
+	    if (_queued == 0 && _running == 0)
+		_idle.notify_all();
+	}
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ * File:	Scheduler.h
+ *
+ * Description:	This file contains the class definition for a
+ *		work-stealing scheduler, which runs tasks on a fixed set of
+ *		worker threads.
+ *
+ *		Each worker has its own double-ended queue of tasks.  A
+ *		worker takes tasks from the back of its own queue, and when
+ *		it runs dry, steals from the front of another worker's
+ *		queue.  Submitted tasks are dealt out to the workers in
+ *		turn, so a worker that drew a few large tasks sheds the
+ *		rest of its queue to workers that drew small ones.
+ *
+ *		Tasks are expected to handle their own errors.  A task
+ *		that throws has its exception swallowed, since there is no
+ *		one to rethrow it to.
+ */
+
+# ifndef SCHEDULER_H
+# define SCHEDULER_H
+# include <deque>
+# include <vector>
+# include <thread>
+# include <functional>
+# include <mutex>
+# include <condition_variable>
+
+class Scheduler {
+public:
+    typedef std::function<void()> Task;
+
+private:
+    struct Worker {
+	std::mutex lock;
+	std::deque<Task> tasks;
+    };
+
+    std::vector<Worker *> _workers;
+    std::vector<std::thread> _threads;
+    std::mutex _lock;
+    std::condition_variable _ready, _idle;
+    unsigned _next, _queued, _running;
+    bool _stopping;
+
+    bool take(unsigned self, Task &task);
+    void run(unsigned self);
+
+public:
+    Scheduler(unsigned workers = 0);
+    ~Scheduler();
+
+    unsigned workers() const;
+    void submit(const Task &task);
+    void wait();
+};
+
+# endif /* SCHEDULER_H */
@@ -156,15 +156,65 @@ const string &Number::value() const
 /*
  * Function:	Call::Call (constructor)
  *
- * Description:	Initialize a function call expression.
+ * Description:	Initialize a function call expression, which is not
+ *		known to be in tail position until the function is
+ *		complete.
  */
 
 Call::Call(const Symbol *id, const Expressions &args, const Type &type)
-    : Expression(type), _id(id), _args(args)
+    : Expression(type), _id(id), _args(args), _tail(false)
 {
 }
 
 
+/*
+ * Function:	Call::id (accessor)
+ *
+ * Description:	Return the symbol of the function called.
+ */
+
+const Symbol *Call::id() const
+{
+    return _id;
+}
+
+
+/*
+ * Function:	Inline::Inline (constructor)
+ *
+ * Description:	Initialize an inlined call expression.
+ */
+
+Inline::Inline(const Symbol *id, const Expressions &args, Block *body, const Type &type)
+    : Expression(type), _id(id), _args(args), _body(body)
+{
+}
+
+
+/*
+ * Function:	Inline::id (accessor)
+ *
+ * Description:	Return the symbol of the function inlined.
+ */
+
+const Symbol *Inline::id() const
+{
+    return _id;
+}
+
+
+/*
+ * Function:	Inline::body (accessor)
+ *
+ * Description:	Return the copy of the body of the function inlined.
+ */
+
+Block *Inline::body() const
+{
+    return _body;
+}
+
+
 /*
  * Function:	Not::Not (constructor)
  *
@@ -225,6 +275,11 @@ Promote::Promote(Expression *expr)
 {
 }
 
+Promote::Promote(Expression *expr, const Type &type)
+    : Expression(type), _expr(expr)
+{
+}
+
 
 /*
  * Function:	Multiply::Multiply (constructor)
@@ -430,6 +485,18 @@ Scope *Block::declarations() const
 }
 
 
+/*
+ * Function:	Block::statements (accessor)
+ *
+ * Description:	Return the statements of this block.
+ */
+
+const Statements &Block::statements() const
+{
+    return _stmts;
+}
+
+
 /*
  * Function:	While::While (constructor)
  *
@@ -466,6 +533,73 @@ If::If(Expression *expr, Statement *thenStmt, Statement *elseStmt)
 }
 
 
+/*
+ * Function:	Vector::Vector (constructor)
+ *
+ * Description:	Initialize a vector assignment.  Each operation has an
+ *		argument, which is null for those that take none.
+ */
+
+Vector::Vector(Expression *dst, const vector<Operation> &ops, const Expressions &args)
+    : _dst(dst), _ops(ops), _args(args)
+{
+}
+
+
+/*
+ * Function:	Vector::lanes
+ *
+ * Description:	Return the equivalent scalar statements, which assign
+ *		each lane in turn, for the backends that have no vectors.
+ *		The arguments are shared by the lanes, so the statements
+ *		are only to be generated, never rewritten.
+ */
+
+Statement *Vector::lanes() const
+{
+    vector<Expression *> stack;
+    Expression *expr, *left;
+    Statements stmts;
+    Type type(INT);
+
+
+    for (unsigned lane = 0; lane < 4; lane ++) {
+	Number *offset = new Number(lane * type.size());
+
+	for (unsigned i = 0; i < _ops.size(); i ++) {
+	    if (_ops[i] == LOAD)
+		expr = new Dereference(new Add(_args[i], offset, _args[i]->type()), type);
+	    else if (_ops[i] == SPLAT)
+		expr = _args[i];
+	    else if (_ops[i] == STEP)
+		expr = new Add(_args[i], new Number(lane), type);
+	    else if (_ops[i] == NEGATE) {
+		expr = new Negate(stack.back(), type);
+		stack.pop_back();
+	    } else {
+		expr = stack.back();
+		stack.pop_back();
+		left = stack.back();
+		stack.pop_back();
+
+		if (_ops[i] == ADD)
+		    expr = new Add(left, expr, type);
+		else
+		    expr = new Subtract(left, expr, type);
+	    }
+
+	    stack.push_back(expr);
+	}
+
+	expr = new Dereference(new Add(_dst, offset, _dst->type()), type);
+	stmts.push_back(new Assignment(expr, stack.back()));
+	stack.clear();
+    }
+
+    return new Block(new Scope(), stmts);
+}
+
+
 /*
  * Function:	Function::Function (constructor)
  *
@@ -476,3 +610,431 @@ Function::Function(const Symbol *id, Block *body)
     : _id(id), _body(body)
 {
 }
+
+
+/*
+ * Function:	Function::id (accessor)
+ *
+ * Description:	Return the symbol of this function.
+ */
+
+const Symbol *Function::id() const
+{
+    return _id;
+}
+
+
+/*
+ * Function:	Function::body (accessor)
+ *
+ * Description:	Return the body of this function.
+ */
+
+Block *Function::body() const
+{
+    return _body;
+}
+
+
+/*
+ * Function:	Call::operands (accessor)
+ *
+ * Description:	Append the slots of the arguments of this call.
+ */
+
+void Call::operands(vector<Expression **> &slots)
+{
+    for (unsigned i = 0; i < _args.size(); i ++)
+	slots.push_back(&_args[i]);
+}
+
+
+/*
+ * Function:	Inline::operands (accessor)
+ *
+ * Description:	Append the slots of the arguments of this inlined call.
+ *		The body is not an operand, since its variables are private
+ *		to it.
+ */
+
+void Inline::operands(vector<Expression **> &slots)
+{
+    for (unsigned i = 0; i < _args.size(); i ++)
+	slots.push_back(&_args[i]);
+}
+
+
+/*
+ * Function:	Not::operands (accessor)
+ *
+ * Description:	Append the slot of the operand of this expression.
+ */
+
+void Not::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_expr);
+}
+
+
+/*
+ * Function:	Negate::operands (accessor)
+ *
+ * Description:	Append the slot of the operand of this expression.
+ */
+
+void Negate::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_expr);
+}
+
+
+/*
+ * Function:	Dereference::operands (accessor)
+ *
+ * Description:	Append the slot of the operand of this expression.
+ */
+
+void Dereference::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_expr);
+}
+
+
+/*
+ * Function:	Address::operands (accessor)
+ *
+ * Description:	Append the slot of the operand of this expression.
+ */
+
+void Address::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_expr);
+}
+
+
+/*
+ * Function:	Promote::operands (accessor)
+ *
+ * Description:	Append the slot of the operand of this expression.
+ */
+
+void Promote::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_expr);
+}
+
+
+/*
+ * Function:	Multiply::operands (accessor)
+ *
+ * Description:	Append the slots of the left and right operands of this
+ *		expression.
+ */
+
+void Multiply::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_left);
+    slots.push_back(&_right);
+}
+
+
+/*
+ * Function:	Divide::operands (accessor)
+ *
+ * Description:	Append the slots of the left and right operands of this
+ *		expression.
+ */
+
+void Divide::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_left);
+    slots.push_back(&_right);
+}
+
+
+/*
+ * Function:	Remainder::operands (accessor)
+ *
+ * Description:	Append the slots of the left and right operands of this
+ *		expression.
+ */
+
+void Remainder::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_left);
+    slots.push_back(&_right);
+}
+
+
+/*
+ * Function:	Add::operands (accessor)
+ *
+ * Description:	Append the slots of the left and right operands of this
+ *		expression.
+ */
+
+void Add::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_left);
+    slots.push_back(&_right);
+}
+
+
+/*
+ * Function:	Subtract::operands (accessor)
+ *
+ * Description:	Append the slots of the left and right operands of this
+ *		expression.
+ */
+
+void Subtract::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_left);
+    slots.push_back(&_right);
+}
+
+
+/*
+ * Function:	LessThan::operands (accessor)
+ *
+ * Description:	Append the slots of the left and right operands of this
+ *		expression.
+ */
+
+void LessThan::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_left);
+    slots.push_back(&_right);
+}
+
+
+/*
+ * Function:	GreaterThan::operands (accessor)
+ *
+ * Description:	Append the slots of the left and right operands of this
+ *		expression.
+ */
+
+void GreaterThan::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_left);
+    slots.push_back(&_right);
+}
+
+
+/*
+ * Function:	LessOrEqual::operands (accessor)
+ *
+ * Description:	Append the slots of the left and right operands of this
+ *		expression.
+ */
+
+void LessOrEqual::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_left);
+    slots.push_back(&_right);
+}
+
+
+/*
+ * Function:	GreaterOrEqual::operands (accessor)
+ *
+ * Description:	Append the slots of the left and right operands of this
+ *		expression.
+ */
+
+void GreaterOrEqual::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_left);
+    slots.push_back(&_right);
+}
+
+
+/*
+ * Function:	Equal::operands (accessor)
+ *
+ * Description:	Append the slots of the left and right operands of this
+ *		expression.
+ */
+
+void Equal::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_left);
+    slots.push_back(&_right);
+}
+
+
+/*
+ * Function:	NotEqual::operands (accessor)
+ *
+ * Description:	Append the slots of the left and right operands of this
+ *		expression.
+ */
+
+void NotEqual::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_left);
+    slots.push_back(&_right);
+}
+
+
+/*
+ * Function:	LogicalAnd::operands (accessor)
+ *
+ * Description:	Append the slots of the left and right operands of this
+ *		expression.
+ */
+
+void LogicalAnd::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_left);
+    slots.push_back(&_right);
+}
+
+
+/*
+ * Function:	LogicalOr::operands (accessor)
+ *
+ * Description:	Append the slots of the left and right operands of this
+ *		expression.
+ */
+
+void LogicalOr::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_left);
+    slots.push_back(&_right);
+}
+
+
+/*
+ * Function:	Assignment::operands (accessor)
+ *
+ * Description:	Append the slots of the left and right sides of this
+ *		assignment.
+ */
+
+void Assignment::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_left);
+    slots.push_back(&_right);
+}
+
+
+/*
+ * Function:	Return::operands (accessor)
+ *
+ * Description:	Append the slot of the returned expression.
+ */
+
+void Return::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_expr);
+}
+
+
+/*
+ * Function:	Block::substatements (accessor)
+ *
+ * Description:	Append the slots of the statements of this block.
+ */
+
+void Block::substatements(vector<Statement **> &slots)
+{
+    for (unsigned i = 0; i < _stmts.size(); i ++)
+	slots.push_back(&_stmts[i]);
+}
+
+
+/*
+ * Function:	While::operands (accessor)
+ *
+ * Description:	Append the slot of the test of this loop.
+ */
+
+void While::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_expr);
+}
+
+
+/*
+ * Function:	While::substatements (accessor)
+ *
+ * Description:	Append the slot of the body of this loop.
+ */
+
+void While::substatements(vector<Statement **> &slots)
+{
+    slots.push_back(&_stmt);
+}
+
+
+/*
+ * Function:	For::operands (accessor)
+ *
+ * Description:	Append the slot of the test of this loop.
+ */
+
+void For::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_expr);
+}
+
+
+/*
+ * Function:	For::substatements (accessor)
+ *
+ * Description:	Append the slots of the initialization, increment, and
+ *		body of this loop, in that order.
+ */
+
+void For::substatements(vector<Statement **> &slots)
+{
+    slots.push_back(&_init);
+    slots.push_back(&_incr);
+    slots.push_back(&_stmt);
+}
+
+
+/*
+ * Function:	If::operands (accessor)
+ *
+ * Description:	Append the slot of the test of this statement.
+ */
+
+void If::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_expr);
+}
+
+
+/*
+ * Function:	If::substatements (accessor)
+ *
+ * Description:	Append the slots of the then and else statements, if any.
+ */
+
+void If::substatements(vector<Statement **> &slots)
+{
+    slots.push_back(&_thenStmt);
+
+    if (_elseStmt != nullptr)
+	slots.push_back(&_elseStmt);
+}
+
+
+/*
+ * Function:	Vector::operands (accessor)
+ *
+ * Description:	Append the slots of the destination and of the arguments
+ *		of the operations.
+ */
+
+void Vector::operands(vector<Expression **> &slots)
+{
+    slots.push_back(&_dst);
+
+    for (unsigned i = 0; i < _args.size(); i ++)
+	if (_args[i] != nullptr)
+	    slots.push_back(&_args[i]);
+}
@@ -21,14 +21,22 @@
  *		Tree.cpp - constructors and accessors
  *		allocator.cpp - member functions to do storage allocation
  *		generator.cpp - member functions to do code generation
+ *		lowerer.cpp - member functions to lower to bytecode
+ *		translator.cpp - member functions to translate to C
+ *		inliner.cpp - member functions to inline calls
+ *		tailcall.cpp - member functions to find tail calls
  */
 
 # ifndef TREE_H
 # define TREE_H
+# include <iosfwd>
 # include <string>
 # include <vector>
 # include "Scope.h"
 
+struct Location;
+struct Renaming;
+
 typedef std::vector<class Statement *> Statements;
 typedef std::vector<class Expression *> Expressions;
 
@@ -45,6 +53,8 @@ public:
     virtual void allocate(int &offset) const {}
     virtual void generate() {}
 	virtual void generate(bool &indirect)  {}
+    virtual void lower() {}
+    virtual void translate(std::ostream &ostr, unsigned indent) const {}
 };
 
 
@@ -53,6 +63,13 @@ public:
 class Statement : public Node {
 protected:
     Statement() {}
+
+public:
+    virtual Statement *clone(Renaming &renaming) const = 0;
+    virtual unsigned cost() const = 0;
+    virtual void markTailCalls(bool last) {}
+    virtual void operands(std::vector<class Expression **> &slots) {}
+    virtual void substatements(std::vector<Statement **> &slots) {}
 };
 
 
@@ -71,6 +88,22 @@ public:
     bool lvalue() const;
 	virtual void generate(); 
 	virtual void generate(bool &indirect); 
+
+    virtual void lower();
+    virtual int lowerValue();
+    virtual void lowerAddress(Location &loc);
+    virtual void lowerPointer(Location &loc);
+    virtual bool lowerIndex(int &reg, unsigned &scale);
+    virtual void lowerTest(bool sense, unsigned label);
+    virtual bool constant(long &value) const;
+
+    virtual void translate(std::ostream &ostr, unsigned indent) const;
+    virtual void write(std::ostream &ostr) const;
+    virtual int precedence() const;
+    virtual const Expression *index(unsigned size) const;
+    virtual bool subscript(const Expression *&base, const Expression *&index) const;
+
+    virtual Expression *clone(Renaming &renaming) const = 0;
 };
 
 
@@ -83,6 +116,10 @@ public:
     String(const string &value);
     const string &value() const;
 	virtual void generate(); 
+    virtual int lowerValue();
+    virtual void write(std::ostream &ostr) const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
 };
 
 
@@ -95,6 +132,11 @@ public:
     Identifier(const Symbol *symbol);
     const Symbol *symbol() const;
     virtual void generate();
+    virtual int lowerValue();
+    virtual void lowerAddress(Location &loc);
+    virtual void write(std::ostream &ostr) const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
 };
 
 
@@ -108,6 +150,11 @@ public:
     Number(const string &value);
     const string &value() const;
     virtual void generate();
+    virtual int lowerValue();
+    virtual bool constant(long &value) const;
+    virtual void write(std::ostream &ostr) const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
 };
 
 
@@ -116,10 +163,40 @@ public:
 class Call : public Expression {
     const Symbol *_id;
     Expressions _args;
+    bool _tail;
 
 public:
     Call(const Symbol *id, const Expressions &args, const Type &type);
+    const Symbol *id() const;
     virtual void generate();
+    virtual int lowerValue();
+    virtual void write(std::ostream &ostr) const;
+    virtual int precedence() const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
+    virtual void markTailCalls(bool last);
+};
+
+
+/* An inlined call: the body of a small function in place of a call to
+   it, with the parameters as the first variables of the body */
+
+class Inline : public Expression {
+    const Symbol *_id;
+    Expressions _args;
+    class Block *_body;
+
+public:
+    Inline(const Symbol *id, const Expressions &args, Block *body, const Type &type);
+    const Symbol *id() const;
+    Block *body() const;
+    virtual void generate();
+    virtual int lowerValue();
+    virtual void write(std::ostream &ostr) const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
 };
 
 
@@ -131,6 +208,13 @@ class Not : public Expression {
 public:
     Not(Expression *expr, const Type &type);
 	virtual void generate(); 
+    virtual int lowerValue();
+    virtual void lowerTest(bool sense, unsigned label);
+    virtual void write(std::ostream &ostr) const;
+    virtual int precedence() const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
 };
 
 
@@ -143,6 +227,13 @@ class Negate : public Expression {
 public:
     Negate(Expression *expr, const Type &type);
 	virtual void generate();
+    virtual int lowerValue();
+    virtual bool constant(long &value) const;
+    virtual void write(std::ostream &ostr) const;
+    virtual int precedence() const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
 };
 
 
@@ -155,6 +246,13 @@ public:
     Dereference(Expression *expr, const Type &type);
 	virtual void generate(); 
 	virtual void generate(bool &indirect); 
+    virtual int lowerValue();
+    virtual void lowerAddress(Location &loc);
+    virtual void write(std::ostream &ostr) const;
+    virtual int precedence() const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
 };
 
 
@@ -166,17 +264,33 @@ class Address : public Expression {
 public:
     Address(Expression *expr, const Type &type);
 	virtual void generate(); 
+    virtual int lowerValue();
+    virtual void lowerPointer(Location &loc);
+    virtual void write(std::ostream &ostr) const;
+    virtual int precedence() const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
 };
 
 
-/* An integer promotion expression: (int) expr */
+/* An integer promotion expression: (int) expr, or (long) expr */
 
 class Promote : public Expression {
     Expression *_expr;
 
 public:
     Promote(Expression *expr);
+    Promote(Expression *expr, const Type &type);
 	virtual void generate(); 
+    virtual int lowerValue();
+    virtual bool constant(long &value) const;
+    virtual void write(std::ostream &ostr) const;
+    virtual int precedence() const;
+    virtual const Expression *index(unsigned size) const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
 };
 
 
@@ -188,6 +302,15 @@ class Multiply : public Expression {
 public:
     Multiply(Expression *left, Expression *right, const Type &type);
 	virtual void generate(); 
+    virtual int lowerValue();
+    virtual bool lowerIndex(int &reg, unsigned &scale);
+    virtual bool constant(long &value) const;
+    virtual void write(std::ostream &ostr) const;
+    virtual int precedence() const;
+    virtual const Expression *index(unsigned size) const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
 };
 
 
@@ -199,6 +322,12 @@ class Divide : public Expression {
 public:
     Divide(Expression *left, Expression *right, const Type &type);
 	virtual void generate(); 
+    virtual int lowerValue();
+    virtual void write(std::ostream &ostr) const;
+    virtual int precedence() const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
 };
 
 
@@ -210,6 +339,12 @@ class Remainder : public Expression {
 public:
     Remainder(Expression *left, Expression *right, const Type &type);
 	virtual void generate(); 
+    virtual int lowerValue();
+    virtual void write(std::ostream &ostr) const;
+    virtual int precedence() const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
 };
 
 
@@ -221,6 +356,14 @@ class Add : public Expression {
 public:
     Add(Expression *left, Expression *right, const Type &type);
 	virtual void generate(); 
+    virtual int lowerValue();
+    virtual void lowerPointer(Location &loc);
+    virtual void write(std::ostream &ostr) const;
+    virtual int precedence() const;
+    virtual bool subscript(const Expression *&base, const Expression *&index) const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
 };
 
 
@@ -232,6 +375,12 @@ class Subtract : public Expression {
 public:
     Subtract(Expression *left, Expression *right, const Type &type);
 	virtual void generate(); 
+    virtual int lowerValue();
+    virtual void write(std::ostream &ostr) const;
+    virtual int precedence() const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
 };
 
 
@@ -243,6 +392,13 @@ class LessThan : public Expression {
 public:
     LessThan(Expression *left, Expression *right, const Type &type);
 	virtual void generate(); 
+    virtual int lowerValue();
+    virtual void lowerTest(bool sense, unsigned label);
+    virtual void write(std::ostream &ostr) const;
+    virtual int precedence() const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
 };
 
 
@@ -254,6 +410,13 @@ class GreaterThan : public Expression {
 public:
     GreaterThan(Expression *left, Expression *right, const Type &type);
 	virtual void generate(); 
+    virtual int lowerValue();
+    virtual void lowerTest(bool sense, unsigned label);
+    virtual void write(std::ostream &ostr) const;
+    virtual int precedence() const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
 };
 
 
@@ -265,6 +428,13 @@ class LessOrEqual : public Expression {
 public:
     LessOrEqual(Expression *left, Expression *right, const Type &type);
 	virtual void generate(); 
+    virtual int lowerValue();
+    virtual void lowerTest(bool sense, unsigned label);
+    virtual void write(std::ostream &ostr) const;
+    virtual int precedence() const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
 };
 
 
@@ -276,6 +446,13 @@ class GreaterOrEqual : public Expression {
 public:
     GreaterOrEqual(Expression *left, Expression *right, const Type &type);
 	virtual void generate(); 
+    virtual int lowerValue();
+    virtual void lowerTest(bool sense, unsigned label);
+    virtual void write(std::ostream &ostr) const;
+    virtual int precedence() const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
 };
 
 
@@ -287,6 +464,13 @@ class Equal : public Expression {
 public:
     Equal(Expression *left, Expression *right, const Type &type);
 	virtual void generate(); 
+    virtual int lowerValue();
+    virtual void lowerTest(bool sense, unsigned label);
+    virtual void write(std::ostream &ostr) const;
+    virtual int precedence() const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
 };
 
 
@@ -298,6 +482,13 @@ class NotEqual : public Expression {
 public:
     NotEqual(Expression *left, Expression *right, const Type &type);
 	virtual void generate(); 
+    virtual int lowerValue();
+    virtual void lowerTest(bool sense, unsigned label);
+    virtual void write(std::ostream &ostr) const;
+    virtual int precedence() const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
 };
 
 
@@ -309,6 +500,13 @@ class LogicalAnd: public Expression {
 public:
     LogicalAnd(Expression *left, Expression *right, const Type &type);
 	virtual void generate(); 
+    virtual int lowerValue();
+    virtual void lowerTest(bool sense, unsigned label);
+    virtual void write(std::ostream &ostr) const;
+    virtual int precedence() const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
 };
 
 
@@ -320,6 +518,13 @@ class LogicalOr : public Expression {
 public:
     LogicalOr(Expression *left, Expression *right, const Type &type);
 	virtual void generate(); 
+    virtual int lowerValue();
+    virtual void lowerTest(bool sense, unsigned label);
+    virtual void write(std::ostream &ostr) const;
+    virtual int precedence() const;
+    virtual Expression *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
 };
 
 
@@ -331,6 +536,11 @@ class Assignment : public Statement {
 public:
     Assignment(Expression *left, Expression *right);
     virtual void generate();
+    virtual void lower();
+    virtual void translate(std::ostream &ostr, unsigned indent) const;
+    virtual Statement *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
 };
 
 
@@ -342,6 +552,12 @@ class Return : public Statement {
 public:
     Return(Expression *expr);
 	virtual void generate(); 
+    virtual void lower();
+    virtual void translate(std::ostream &ostr, unsigned indent) const;
+    virtual Statement *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
+    virtual void markTailCalls(bool last);
 };
 
 
@@ -354,8 +570,15 @@ class Block : public Statement {
 public:
     Block(Scope *decls, const Statements &stmts);
     Scope *declarations() const;
+    const Statements &statements() const;
     virtual void allocate(int &offset) const;
     virtual void generate();
+    virtual void lower();
+    virtual void translate(std::ostream &ostr, unsigned indent) const;
+    virtual Statement *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void substatements(std::vector<Statement **> &slots);
+    virtual void markTailCalls(bool last);
 };
 
 
@@ -369,6 +592,13 @@ public:
     While(Expression *expr, Statement *stmt);
     virtual void allocate(int &offset) const;
 	virtual void generate(); 
+    virtual void lower();
+    virtual void translate(std::ostream &ostr, unsigned indent) const;
+    virtual Statement *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
+    virtual void substatements(std::vector<Statement **> &slots);
+    virtual void markTailCalls(bool last);
 };
 
 
@@ -384,6 +614,13 @@ public:
     For(Statement *init, Expression *expr, Statement *incr, Statement *stmt);
     virtual void allocate(int &offset) const;
 	virtual void generate(); 
+    virtual void lower();
+    virtual void translate(std::ostream &ostr, unsigned indent) const;
+    virtual Statement *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
+    virtual void substatements(std::vector<Statement **> &slots);
+    virtual void markTailCalls(bool last);
 };
 
 
@@ -397,6 +634,41 @@ public:
     If(Expression *expr, Statement *thenStmt, Statement *elseStmt);
     virtual void allocate(int &offset) const;
 	virtual void generate(); 
+    virtual void lower();
+    virtual void translate(std::ostream &ostr, unsigned indent) const;
+    virtual Statement *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
+    virtual void substatements(std::vector<Statement **> &slots);
+    virtual void markTailCalls(bool last);
+};
+
+
+/* A vector assignment: four consecutive ints starting at the address dst
+   are each assigned a lane of a vector expression, which is given as a
+   sequence of operations on a stack of vectors.  A load takes four ints
+   from an address, a splat repeats an int in every lane, and a step
+   adds the number of each lane to an int.  The others combine the
+   vectors on top of the stack.  Every load is done before any store. */
+
+class Vector : public Statement {
+public:
+    enum Operation { LOAD, SPLAT, STEP, ADD, SUBTRACT, NEGATE };
+
+private:
+    Expression *_dst;
+    std::vector<Operation> _ops;
+    Expressions _args;
+
+public:
+    Vector(Expression *dst, const std::vector<Operation> &ops, const Expressions &args);
+    Statement *lanes() const;
+    virtual void generate();
+    virtual void lower();
+    virtual void translate(std::ostream &ostr, unsigned indent) const;
+    virtual Statement *clone(Renaming &renaming) const;
+    virtual unsigned cost() const;
+    virtual void operands(std::vector<Expression **> &slots);
 };
 
 
@@ -408,8 +680,13 @@ class Function : public Node {
 
 public:
     Function(const Symbol *id, Block *body);
+    const Symbol *id() const;
+    Block *body() const;
+    void markTailCalls();
     virtual void allocate(int &offset) const;
     virtual void generate();
+    virtual void lower();
+    virtual void translate(std::ostream &ostr, unsigned indent) const;
 };
 
 # endif /* TREE_H */
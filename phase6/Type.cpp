@@ -337,6 +337,8 @@ ostream &operator <<(ostream &ostr, const Type &type)
 	    ostr << "int";
 	else if (type.specifier() == CHAR)
 	    ostr << "char";
+	else if (type.specifier() == LONG)
+	    ostr << "long";
 	else if (type.specifier() == VOID)
 	    ostr << "void";
 	else
@@ -44,6 +44,9 @@ unsigned Type::size() const
     if (_specifier == CHAR)
 	return count * SIZEOF_CHAR;
 
+    if (_specifier == LONG)
+	return count * SIZEOF_LONG;
+
     return 0;
 }
 
@@ -67,6 +70,9 @@ unsigned Type::alignment() const
     if (_specifier == INT)
 	return ALIGNOF_INT;
 
+    if (_specifier == LONG)
+	return ALIGNOF_LONG;
+
     return 0;
 }
 
@@ -164,24 +170,34 @@ void If::allocate(int &offset) const
  *
  * Description:	Allocate storage for this function and return the number of
  *		bytes required.  The parameters are allocated offsets as
- *		well.
+ *		well.  Any parameters passed in registers are saved in the
+ *		frame like local variables, and the rest are found above
+ *		the return address.
  */
 
 void Function::allocate(int &offset) const
 {
     Parameters *params;
     Symbols symbols;
+    unsigned i, nregs;
 
 
     params = _id->type().parameters();
     symbols = _body->declarations()->symbols();
+    nregs = min((unsigned) params->size(), target->numRegisterArgs);
     offset = PARAM_OFFSET;
 
-    for (unsigned i = 0; i < params->size(); i ++) {
+    for (i = nregs; i < params->size(); i ++) {
 	symbols[i]->_offset = offset;
 	offset += SIZEOF_ARG;
     }
 
     offset = 0;
+
+    for (i = 0; i < nregs; i ++) {
+	offset -= symbols[i]->type().size();
+	symbols[i]->_offset = offset;
+    }
+
     _body->allocate(offset);
 }
@@ -0,0 +1,1358 @@
+/*
+ * File:	assembler.cpp
+ *
+ * Description:	This file contains the public and private function
+ *		definitions for the assembler, which encodes the AT&T
+ *		syntax written by our code generator as IA-32 or x86-64
+ *		machine code, as given by the object being assembled into.
+ *
+ *		We only need to handle what the generator writes, which is
+ *		a small set of instructions with the usual operand forms,
+ *		labels, and a handful of directives.  Anything else is
+ *		reported as an error rather than guessed at.
+ *
+ *		Assembly is done in a single pass.  Every reference to a
+ *		label is encoded at full size and recorded as a fixup.
+ *		Once everything has been read, a fixup either resolves to
+ *		a known value, as is the case for a branch to a local label
+ *		or a use of a constant from a .set directive, or becomes a
+ *		relocation in the object.
+ *
+ *		For x86-64, the REX prefix is emitted whenever an operand
+ *		is 64 bits wide or one of the new registers is used, and
+ *		memory operands may be relative to %rip.  The only SSE2
+ *		instructions are the few used for vectorized loops, and
+ *		an XMM register is an operand sixteen bytes wide.
+ */
+
+# include <cctype>
+# include <cstdlib>
+# include <map>
+# include <utility>
+# include <sstream>
+# include <iostream>
+# include "assembler.h"
+
+using namespace std;
+
+typedef vector<string> Strings;
+
+struct Operand {
+    enum { REGISTER, IMMEDIATE, MEMORY } kind;
+    int reg, base, index;
+    unsigned size, scale;
+    bool rex;
+    string symbol;
+    int64_t value;
+};
+
+struct Fixup {
+    unsigned section;
+    uint64_t offset, end;
+    string symbol;
+    int64_t addend;
+    Object::RelocationType type;
+};
+
+static const char *registers[][8] = {
+    {"al", "cl", "dl", "bl", "ah", "ch", "dh", "bh"},
+    {"ax", "cx", "dx", "bx", "sp", "bp", "si", "di"},
+    {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi"},
+    {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi"},
+};
+
+static const char *bytes64[] = {"spl", "bpl", "sil", "dil"};
+
+# define RIP 16
+
+
+static const char *conditions[] = {
+    "o", "no", "b", "ae", "e", "ne", "be", "a",
+    "s", "ns", "p", "np", "l", "ge", "le", "g",
+};
+
+static const struct {
+    const char *name;
+    int code;
+} synonyms[] = {
+    {"c", 2}, {"nae", 2}, {"nb", 3}, {"nc", 3}, {"z", 4}, {"nz", 5},
+    {"na", 6}, {"nbe", 7}, {"pe", 10}, {"po", 11}, {"nge", 12},
+    {"nl", 13}, {"ng", 14}, {"nle", 15},
+};
+
+static const struct {
+    const char *name;
+    unsigned digit;
+} arithmetic[] = {
+    {"add", 0}, {"or", 1}, {"adc", 2}, {"sbb", 3},
+    {"and", 4}, {"sub", 5}, {"xor", 6}, {"cmp", 7},
+};
+
+static const struct {
+    const char *name;
+    unsigned digit;
+} unary[] = {
+    {"not", 2}, {"neg", 3}, {"mul", 4}, {"div", 6}, {"idiv", 7},
+};
+
+static const struct {
+    const char *name;
+    unsigned digit;
+} shifts[] = {
+    {"rol", 0}, {"ror", 1}, {"shl", 4}, {"sal", 4}, {"shr", 5}, {"sar", 7},
+};
+
+/* The SSE2 instructions on packed ints, with their mandatory prefix
+   and the opcode that follows 0F.  The destination is always an XMM
+   register, except for a store with movdqu, whose opcode is 7F. */
+
+static const struct {
+    const char *name;
+    unsigned prefix, opcode;
+} packed[] = {
+    {"movd", 0x66, 0x6E}, {"movdqa", 0x66, 0x6F}, {"movdqu", 0xF3, 0x6F},
+    {"pshufd", 0x66, 0x70}, {"paddd", 0x66, 0xFE}, {"psubd", 0x66, 0xFA},
+    {"pxor", 0x66, 0xEF},
+};
+
+# define lengthof(array) (sizeof(array) / sizeof(array[0]))
+
+
+/*
+ * The state of a single assembly.  It isn't worth passing all of this
+ * around as parameters, and we can't make it global since several units
+ * may be assembled at once.
+ */
+
+class Assembler {
+    Object &_object;
+    ostream &_err;
+    unsigned _section, _line;
+    vector<Fixup> _fixups;
+    map<string, int64_t> _constants;
+    bool _failed;
+
+    vector<uint8_t> &bytes();
+    void emit(uint64_t value, unsigned size);
+    void fixup(const string &symbol, int64_t addend, unsigned trailing,
+	       Object::RelocationType type);
+    void immediate(const Operand &op, unsigned size);
+    void displacement(const Operand &op, unsigned trailing);
+    void modrm(unsigned reg, const Operand &rm, unsigned trailing);
+    void prefix(unsigned size, const Operand *reg, const Operand *rm);
+    void error(const string &message);
+
+    bool parseExpression(const string &s, string &symbol, int64_t &value);
+    bool parseRegister(const string &s, int &reg, unsigned &size, bool &rex);
+    bool parseOperand(const string &s, Operand &op);
+
+    void directive(const string &name, const string &args);
+    void instruction(const string &name, vector<Operand> &ops);
+    void packedInstruction(unsigned i, vector<Operand> &ops);
+    void resolve();
+
+public:
+    Assembler(Object &object, ostream &err);
+    bool assemble(const string &text);
+};
+
+
+/*
+ * Function:	trim
+ *
+ * Description:	Return the string without leading or trailing white space.
+ */
+
+static string trim(const string &s)
+{
+    size_t first = s.find_first_not_of(" \t\r");
+    size_t last = s.find_last_not_of(" \t\r");
+
+    return first == string::npos ? "" : s.substr(first, last - first + 1);
+}
+
+
+/*
+ * Function:	split
+ *
+ * Description:	Split a list of operands at the commas that are not within
+ *		parentheses or string literals.
+ */
+
+static Strings split(const string &s)
+{
+    Strings result;
+    string current;
+    bool quoted = false;
+    int depth = 0;
+
+
+    for (unsigned i = 0; i < s.size(); i ++) {
+	if (quoted && s[i] == '\\' && i + 1 < s.size()) {
+	    current += s[i ++];
+	    current += s[i];
+	    continue;
+	}
+
+	if (s[i] == '"')
+	    quoted = !quoted;
+	else if (!quoted && s[i] == '(')
+	    depth ++;
+	else if (!quoted && s[i] == ')')
+	    depth --;
+
+	if (!quoted && depth == 0 && s[i] == ',') {
+	    result.push_back(trim(current));
+	    current.clear();
+	} else
+	    current += s[i];
+    }
+
+    if (!trim(current).empty() || !result.empty())
+	result.push_back(trim(current));
+
+    return result;
+}
+
+
+/*
+ * Function:	fits
+ *
+ * Description:	Return whether the value fits in a signed byte.
+ */
+
+static bool fits(int64_t value)
+{
+    return value >= -128 && value <= 127;
+}
+
+
+/*
+ * Function:	condition
+ *
+ * Description:	Return the condition code for the given suffix of a
+ *		conditional instruction, or -1 if it isn't one.
+ */
+
+static int condition(const string &s)
+{
+    for (unsigned i = 0; i < lengthof(conditions); i ++)
+	if (s == conditions[i])
+	    return i;
+
+    for (unsigned i = 0; i < lengthof(synonyms); i ++)
+	if (s == synonyms[i].name)
+	    return synonyms[i].code;
+
+    return -1;
+}
+
+
+/*
+ * Function:	known
+ *
+ * Description:	Return whether the name is that of an instruction whose
+ *		name may be followed by a suffix giving the operand size.
+ */
+
+static bool known(const string &name)
+{
+    static const char *others[] = {
+	"mov", "test", "lea", "imul", "inc", "dec", "push", "pop",
+    };
+
+
+    for (unsigned i = 0; i < lengthof(arithmetic); i ++)
+	if (name == arithmetic[i].name)
+	    return true;
+
+    for (unsigned i = 0; i < lengthof(unary); i ++)
+	if (name == unary[i].name)
+	    return true;
+
+    for (unsigned i = 0; i < lengthof(shifts); i ++)
+	if (name == shifts[i].name)
+	    return true;
+
+    for (unsigned i = 0; i < lengthof(others); i ++)
+	if (name == others[i])
+	    return true;
+
+    return false;
+}
+
+
+/*
+ * Function:	Assembler::Assembler (constructor)
+ *
+ * Description:	Initialize an assembly into the given object, which
+ *		starts out in the text section.
+ */
+
+Assembler::Assembler(Object &object, ostream &err)
+    : _object(object), _err(err), _line(0), _failed(false)
+{
+    _section = _object.section(".text");
+    _object.section(".data");
+    _object.section(".bss");
+}
+
+
+/*
+ * Function:	Assembler::error
+ *
+ * Description:	Report an error on the current line.
+ */
+
+void Assembler::error(const string &message)
+{
+    _err << "assembler: line " << _line << ": " << message << endl;
+    _failed = true;
+}
+
+
+/*
+ * Function:	Assembler::bytes
+ *
+ * Description:	Return the contents of the current section.
+ */
+
+vector<uint8_t> &Assembler::bytes()
+{
+    return _object.sections[_section].bytes;
+}
+
+
+/*
+ * Function:	Assembler::emit
+ *
+ * Description:	Emit a little-endian value of the given size in bytes.
+ */
+
+void Assembler::emit(uint64_t value, unsigned size)
+{
+    for (unsigned i = 0; i < size; i ++)
+	bytes().push_back(value >> (8 * i));
+}
+
+
+/*
+ * Function:	Assembler::fixup
+ *
+ * Description:	Record a reference to a symbol in the four bytes about to
+ *		be emitted, followed by TRAILING more bytes of the current
+ *		instruction, and emit the addend as a placeholder.
+ */
+
+void Assembler::fixup(const string &symbol, int64_t addend, unsigned trailing,
+		      Object::RelocationType type)
+{
+    Fixup f;
+
+
+    f.section = _section;
+    f.offset = bytes().size();
+    f.end = f.offset + 4 + trailing;
+    f.symbol = symbol;
+    f.addend = addend;
+    f.type = type;
+
+    _fixups.push_back(f);
+    emit(addend, 4);
+}
+
+
+/*
+ * Function:	Assembler::immediate
+ *
+ * Description:	Emit an immediate operand of the given size.  A 64-bit
+ *		immediate is emitted as 32 bits and sign-extended.
+ */
+
+void Assembler::immediate(const Operand &op, unsigned size)
+{
+    if (size > 4)
+	size = 4;
+
+    if (!op.symbol.empty()) {
+	if (size != 4)
+	    error("symbolic immediate must be 32 bits");
+
+	fixup(op.symbol, op.value, 0, Object::ABSOLUTE32);
+    } else
+	emit(op.value, size);
+}
+
+
+/*
+ * Function:	Assembler::displacement
+ *
+ * Description:	Emit a 32-bit displacement, which may refer to a symbol.
+ */
+
+void Assembler::displacement(const Operand &op, unsigned trailing)
+{
+    if (!op.symbol.empty())
+	fixup(op.symbol, op.value, trailing, Object::ABSOLUTE32);
+    else
+	emit(op.value, 4);
+}
+
+
+/*
+ * Function:	Assembler::prefix
+ *
+ * Description:	Emit any prefixes needed for the operand size and, on
+ *		x86-64, the REX prefix needed for the register operand REG
+ *		and the register or memory operand RM.  Either may be null
+ *		if the instruction doesn't have one.
+ */
+
+void Assembler::prefix(unsigned size, const Operand *reg, const Operand *rm)
+{
+    unsigned rex = 0;
+    bool needed = false;
+
+
+    if (size == 2)
+	emit(0x66, 1);
+
+    if (_object.bits != 64) {
+	if (size == 8)
+	    error("64-bit operand in 32-bit code");
+
+	return;
+    }
+
+    if (size == 8)
+	rex |= 8;
+
+    if (reg != nullptr) {
+	rex |= reg->reg >= 8 ? 4 : 0;
+	needed = reg->rex;
+    }
+
+    if (rm != nullptr && rm->kind == Operand::REGISTER) {
+	rex |= rm->reg >= 8 ? 1 : 0;
+	needed = needed || rm->rex;
+
+    } else if (rm != nullptr && rm->kind == Operand::MEMORY) {
+	rex |= rm->index >= 8 ? 2 : 0;
+	rex |= rm->base >= 8 && rm->base != RIP ? 1 : 0;
+    }
+
+    if (rex != 0 || needed)
+	emit(0x40 | rex, 1);
+}
+
+
+/*
+ * Function:	Assembler::modrm
+ *
+ * Description:	Emit the ModR/M byte, and any SIB byte and displacement,
+ *		for the given register field and register or memory
+ *		operand.  TRAILING is the number of bytes of the
+ *		instruction that will follow, such as an immediate.
+ */
+
+void Assembler::modrm(unsigned reg, const Operand &rm, unsigned trailing)
+{
+    unsigned mod, scale;
+    bool sib;
+
+
+    reg = (reg & 7) << 3;
+
+    if (rm.kind == Operand::REGISTER) {
+	emit(0xC0 | reg | (rm.reg & 7), 1);
+	return;
+    }
+
+    if (rm.base == RIP) {
+	emit(0x05 | reg, 1);
+
+	if (!rm.symbol.empty())
+	    fixup(rm.symbol, rm.value, trailing, Object::RELATIVE32);
+	else
+	    emit(rm.value, 4);
+
+	return;
+    }
+
+    if (rm.base < 0 && rm.index < 0) {
+	if (_object.bits == 64) {
+	    emit(0x04 | reg, 1);
+	    emit(0x25, 1);
+	} else
+	    emit(0x05 | reg, 1);
+
+	displacement(rm, trailing);
+	return;
+    }
+
+
+    if (rm.base < 0)
+	mod = 0;
+    else if (rm.symbol.empty() && rm.value == 0 && (rm.base & 7) != 5)
+	mod = 0;
+    else if (rm.symbol.empty() && fits(rm.value))
+	mod = 1;
+    else
+	mod = 2;
+
+    sib = rm.index >= 0 || rm.base < 0 || (rm.base & 7) == 4;
+
+    if (sib) {
+	for (scale = 0; (1u << scale) < rm.scale; scale ++)
+	    continue;
+
+	emit(mod << 6 | reg | 4, 1);
+	emit(scale << 6 | ((rm.index >= 0 ? rm.index : 4) & 7) << 3 |
+	     (rm.base >= 0 ? rm.base & 7 : 5), 1);
+    } else
+	emit(mod << 6 | reg | (rm.base & 7), 1);
+
+    if (mod == 1)
+	emit(rm.value, 1);
+
+    else if (mod == 2 || rm.base < 0)
+	displacement(rm, trailing);
+}
+
+
+/*
+ * Function:	Assembler::parseExpression
+ *
+ * Description:	Parse an expression, which is a number, a symbol, or a
+ *		symbol plus or minus a number.
+ */
+
+bool Assembler::parseExpression(const string &s, string &symbol, int64_t &value)
+{
+    size_t i = 0;
+    char *end;
+
+
+    symbol.clear();
+    value = 0;
+
+    if (s.empty())
+	return true;
+
+    if (isalpha(s[0]) || s[0] == '_' || s[0] == '.') {
+	while (i < s.size() && (isalnum(s[i]) || s[i] == '_' || s[i] == '.'))
+	    i ++;
+
+	symbol = s.substr(0, i);
+
+	if (i == s.size())
+	    return true;
+
+	if (s[i] != '+' && s[i] != '-')
+	    return false;
+
+	if (s[i] == '+')
+	    i ++;
+    }
+
+    value = strtoll(s.c_str() + i, &end, 0);
+    return end != s.c_str() + i && *end == '\0';
+}
+
+
+/*
+ * Function:	Assembler::parseRegister
+ *
+ * Description:	Parse a register name, without the leading %.  The
+ *		registers new to x86-64 are only allowed in 64-bit code,
+ *		and REX is set for the byte registers that need a REX
+ *		prefix even though their numbers are small.  The XMM
+ *		registers have size 16.
+ */
+
+bool Assembler::parseRegister(const string &s, int &reg, unsigned &size, bool &rex)
+{
+    bool wide = _object.bits == 64;
+    string rest;
+    char *end;
+
+
+    rex = false;
+
+    for (unsigned i = 0; i < lengthof(registers); i ++)
+	for (unsigned j = 0; j < 8; j ++)
+	    if (s == registers[i][j]) {
+		reg = j;
+		size = 1 << i;
+		return size < 8 || wide;
+	    }
+
+    for (unsigned j = 0; j < lengthof(bytes64); j ++)
+	if (s == bytes64[j]) {
+	    reg = j + 4;
+	    size = 1;
+	    rex = true;
+	    return wide;
+	}
+
+    if (s == "rip") {
+	reg = RIP;
+	size = 8;
+	return wide;
+    }
+
+    if (s.size() > 3 && s.compare(0, 3, "xmm") == 0 && isdigit(s[3])) {
+	reg = strtol(s.c_str() + 3, &end, 10);
+	size = 16;
+	return *end == '\0' && reg < (wide ? 16 : 8);
+    }
+
+    if (s.size() < 2 || s[0] != 'r' || !isdigit(s[1]))
+	return false;
+
+    reg = strtol(s.c_str() + 1, &end, 10);
+    rest = end;
+    size = rest == "" ? 8 : rest == "d" ? 4 : rest == "w" ? 2 : rest == "b" ? 1 : 0;
+    return wide && reg >= 8 && reg <= 15 && size > 0;
+}
+
+
+/*
+ * Function:	Assembler::parseOperand
+ *
+ * Description:	Parse an operand: a register, an immediate, or a memory
+ *		reference of the form disp(base,index,scale).
+ */
+
+bool Assembler::parseOperand(const string &s, Operand &op)
+{
+    size_t paren;
+    Strings parts;
+    unsigned size;
+    bool rex;
+
+
+    op.reg = op.base = op.index = -1;
+    op.size = 0;
+    op.scale = 1;
+    op.value = 0;
+    op.rex = false;
+
+    if (s.empty())
+	return false;
+
+    if (s[0] == '%') {
+	op.kind = Operand::REGISTER;
+	return parseRegister(s.substr(1), op.reg, op.size, op.rex) && op.reg != RIP;
+    }
+
+    if (s[0] == '$') {
+	op.kind = Operand::IMMEDIATE;
+	return parseExpression(trim(s.substr(1)), op.symbol, op.value);
+    }
+
+    op.kind = Operand::MEMORY;
+    paren = s.find('(');
+
+    if (!parseExpression(trim(s.substr(0, paren)), op.symbol, op.value))
+	return false;
+
+    if (paren == string::npos)
+	return true;
+
+    if (s[s.size() - 1] != ')')
+	return false;
+
+    parts = split(s.substr(paren + 1, s.size() - paren - 2));
+
+    if (parts.empty() || parts.size() > 3)
+	return false;
+
+    if (!parts[0].empty())
+	if (parts[0][0] != '%' || !parseRegister(parts[0].substr(1), op.base, size, rex))
+	    return false;
+
+    if (parts.size() > 1)
+	if (parts[1][0] != '%' || !parseRegister(parts[1].substr(1), op.index, size, rex) || op.index == RIP)
+	    return false;
+
+    if (parts.size() > 2)
+	op.scale = atoi(parts[2].c_str());
+
+    if (op.base == RIP && parts.size() > 1)
+	return false;
+
+
+    return op.scale == 1 || op.scale == 2 || op.scale == 4 || op.scale == 8;
+}
+
+
+/*
+ * Function:	Assembler::directive
+ *
+ * Description:	Handle an assembler directive.
+ */
+
+void Assembler::directive(const string &name, const string &args)
+{
+    Strings list = split(args);
+    Object::Symbol *symbol;
+    string sym;
+    int64_t value;
+    unsigned i, n;
+
+
+    if (name == ".text" || name == ".data" || name == ".bss")
+	_section = _object.section(name);
+
+    else if (name == ".section" && !list.empty())
+	_section = _object.section(list[0]);
+
+    else if (name == ".globl" || name == ".global") {
+	for (i = 0; i < list.size(); i ++)
+	    _object.symbols[_object.symbol(list[i])].global = true;
+
+    } else if (name == ".set" || name == ".equ") {
+	if (list.size() != 2 || !parseExpression(list[1], sym, value) || !sym.empty())
+	    error("invalid " + name);
+	else
+	    _constants[list[0]] = value;
+
+    } else if (name == ".comm") {
+	if (list.size() < 2)
+	    error("invalid .comm");
+	else {
+	    symbol = &_object.symbols[_object.symbol(list[0])];
+	    symbol->section = Object::COMMON;
+	    symbol->size = atoi(list[1].c_str());
+	    symbol->value = list.size() > 2 ? atoi(list[2].c_str()) : 1;
+	    symbol->global = true;
+	}
+
+    } else if (name == ".asciz" || name == ".string" || name == ".ascii") {
+	for (i = 0; i < list.size(); i ++) {
+	    const string &s = list[i];
+
+	    if (s.size() < 2 || s[0] != '"' || s[s.size() - 1] != '"') {
+		error("invalid string");
+		return;
+	    }
+
+	    for (unsigned j = 1; j + 1 < s.size(); j ++) {
+		if (s[j] != '\\' || j + 2 >= s.size()) {
+		    emit(s[j], 1);
+		    continue;
+		}
+
+		switch (s[++ j]) {
+		case 'n': emit('\n', 1); break;
+		case 't': emit('\t', 1); break;
+		case 'r': emit('\r', 1); break;
+		case 'b': emit('\b', 1); break;
+		case 'f': emit('\f', 1); break;
+		case 'v': emit('\v', 1); break;
+		case 'a': emit('\a', 1); break;
+
+		case 'x':
+		    for (value = 0; j + 2 < s.size() && isxdigit(s[j + 1]); j ++)
+			value = value * 16 + (isdigit(s[j + 1]) ? s[j + 1] - '0' :
+			    tolower(s[j + 1]) - 'a' + 10);
+
+		    emit(value, 1);
+		    break;
+
+		default:
+		    if (s[j] >= '0' && s[j] <= '7') {
+			value = s[j] - '0';
+
+			for (n = 1; n < 3 && j + 2 < s.size() && s[j + 1] >= '0' && s[j + 1] <= '7'; n ++)
+			    value = value * 8 + s[++ j] - '0';
+
+			emit(value, 1);
+		    } else
+			emit(s[j], 1);
+		}
+	    }
+
+	    if (name != ".ascii")
+		emit(0, 1);
+	}
+
+    } else if (name == ".long" || name == ".int" || name == ".byte") {
+	for (i = 0; i < list.size(); i ++) {
+	    if (!parseExpression(list[i], sym, value))
+		error("invalid expression");
+	    else if (name == ".byte")
+		emit(value, 1);
+	    else if (!sym.empty())
+		fixup(sym, value, 0, Object::ABSOLUTE32);
+	    else
+		emit(value, 4);
+	}
+
+    } else if (name == ".zero" || name == ".skip" || name == ".space") {
+	if (!list.empty())
+	    bytes().resize(bytes().size() + atoi(list[0].c_str()), 0);
+
+    } else if (name == ".align" || name == ".balign" || name == ".p2align") {
+	if (list.empty())
+	    return;
+
+	n = atoi(list[0].c_str());
+
+	if (name == ".p2align")
+	    n = 1 << n;
+
+	if (n > _object.sections[_section].alignment)
+	    _object.sections[_section].alignment = n;
+
+	while (bytes().size() % n)
+	    bytes().push_back(_object.sections[_section].executable ? 0x90 : 0);
+
+    } else if (name != ".type" && name != ".size" && name != ".file" &&
+	    name != ".ident")
+	error("unknown directive " + name);
+}
+
+
+/*
+ * Function:	Assembler::instruction
+ *
+ * Description:	Encode a single instruction.  The operands are in AT&T
+ *		order, with the destination last.
+ */
+
+void Assembler::instruction(const string &name, vector<Operand> &ops)
+{
+    unsigned size = 0, i, n = ops.size();
+    string base = name, sym;
+    Operand *src, *dst;
+    int cc;
+
+
+    /* Instructions with no operands, or whose names would otherwise
+       confuse us when looking for a size suffix. */
+
+    if (n == 0) {
+	if (name == "ret")
+	    emit(0xC3, 1);
+	else if (name == "leave")
+	    emit(0xC9, 1);
+	else if (name == "cltd" || name == "cdq")
+	    emit(0x99, 1);
+	else if ((name == "cqto" || name == "cqo") && _object.bits == 64)
+	    emit(0x9948, 2);
+	else if ((name == "cltq" || name == "cdqe") && _object.bits == 64)
+	    emit(0x9848, 2);
+	else if (name == "nop")
+	    emit(0x90, 1);
+	else
+	    error("unknown instruction " + name);
+
+	return;
+    }
+
+    src = &ops[0];
+    dst = &ops[n - 1];
+
+    if (name == "call" || name == "jmp" || (name[0] == 'j' && condition(name.substr(1)) >= 0)) {
+	if (n != 1 || src->kind != Operand::MEMORY || src->base >= 0) {
+	    error("invalid operand to " + name);
+	    return;
+	}
+
+	if (name == "call")
+	    emit(0xE8, 1);
+	else if (name == "jmp")
+	    emit(0xE9, 1);
+	else {
+	    emit(0x0F, 1);
+	    emit(0x80 | condition(name.substr(1)), 1);
+	}
+
+	fixup(src->symbol, src->value, 0, Object::RELATIVE32);
+	return;
+    }
+
+    if (name.compare(0, 3, "set") == 0 && condition(name.substr(3)) >= 0) {
+	prefix(1, nullptr, src);
+	emit(0x0F, 1);
+	emit(0x90 | condition(name.substr(3)), 1);
+	modrm(0, *src, 0);
+	return;
+    }
+
+    if (name == "movslq") {
+	if (n != 2 || dst->kind != Operand::REGISTER || src->kind == Operand::IMMEDIATE) {
+	    error("invalid operands to " + name);
+	    return;
+	}
+
+	prefix(8, dst, src);
+	emit(0x63, 1);
+	modrm(dst->reg, *src, 0);
+	return;
+    }
+
+    if (name.size() == 6 && name.compare(0, 3, "mov") == 0 &&
+	    (name[3] == 's' || name[3] == 'z') && (name[4] == 'b' || name[4] == 'w') &&
+	    (name[5] == 'w' || name[5] == 'l' || name[5] == 'q')) {
+	if (n != 2 || dst->kind != Operand::REGISTER || src->kind == Operand::IMMEDIATE) {
+	    error("invalid operands to " + name);
+	    return;
+	}
+
+	prefix(name[5] == 'q' ? 8 : name[5] == 'w' ? 2 : 4, dst, src);
+	emit(0x0F, 1);
+	emit((name[3] == 'z' ? 0xB6 : 0xBE) | (name[4] == 'w'), 1);
+	modrm(dst->reg, *src, 0);
+	return;
+    }
+
+    for (i = 0; i < lengthof(packed); i ++)
+	if (name == packed[i].name) {
+	    packedInstruction(i, ops);
+	    return;
+	}
+
+    if (name.size() > 5 && name.compare(0, 4, "cmov") == 0) {
+	cc = condition(name.substr(4, name.size() - 5));
+
+	if (cc < 0 || n != 2 || dst->kind != Operand::REGISTER || src->kind == Operand::IMMEDIATE) {
+	    error("invalid instruction " + name);
+	    return;
+	}
+
+	prefix(dst->size, dst, src);
+	emit(0x0F, 1);
+	emit(0x40 | cc, 1);
+	modrm(dst->reg, *src, 0);
+	return;
+    }
+
+
+    /* Everything else has an optional suffix giving the operand size,
+       which otherwise comes from a register operand. */
+
+    if (!known(base)) {
+	switch (name[name.size() - 1]) {
+	case 'b': size = 1; break;
+	case 'w': size = 2; break;
+	case 'l': size = 4; break;
+	case 'q': size = 8; break;
+	}
+
+	base = name.substr(0, name.size() - 1);
+    }
+
+    for (i = 0; i < n && size == 0; i ++)
+	if (ops[i].kind == Operand::REGISTER)
+	    size = ops[i].size;
+
+    if (size == 0)
+	size = 4;
+
+    for (i = 0; i < lengthof(arithmetic); i ++)
+	if (base == arithmetic[i].name) {
+	    if (n != 2 || dst->kind == Operand::IMMEDIATE) {
+		error("invalid operands to " + name);
+
+	    } else if (src->kind == Operand::IMMEDIATE) {
+		prefix(size, nullptr, dst);
+
+		if (size == 1) {
+		    emit(0x80, 1);
+		    modrm(arithmetic[i].digit, *dst, 1);
+		    immediate(*src, 1);
+		} else if (src->symbol.empty() && fits(src->value)) {
+		    emit(0x83, 1);
+		    modrm(arithmetic[i].digit, *dst, 1);
+		    immediate(*src, 1);
+		} else {
+		    emit(0x81, 1);
+		    modrm(arithmetic[i].digit, *dst, 4);
+		    immediate(*src, size == 2 ? 2 : 4);
+		}
+
+	    } else if (src->kind == Operand::REGISTER) {
+		prefix(size, src, dst);
+		emit(arithmetic[i].digit << 3 | (size == 1 ? 0 : 1), 1);
+		modrm(src->reg, *dst, 0);
+
+	    } else if (dst->kind == Operand::REGISTER) {
+		prefix(size, dst, src);
+		emit(arithmetic[i].digit << 3 | (size == 1 ? 2 : 3), 1);
+		modrm(dst->reg, *src, 0);
+
+	    } else
+		error("invalid operands to " + name);
+
+	    return;
+	}
+
+    for (i = 0; i < lengthof(unary); i ++)
+	if (base == unary[i].name) {
+	    if (n != 1 || src->kind == Operand::IMMEDIATE)
+		error("invalid operand to " + name);
+	    else {
+		prefix(size, nullptr, src);
+		emit(size == 1 ? 0xF6 : 0xF7, 1);
+		modrm(unary[i].digit, *src, 0);
+	    }
+
+	    return;
+	}
+
+    for (i = 0; i < lengthof(shifts); i ++)
+	if (base == shifts[i].name) {
+	    prefix(size, nullptr, dst);
+
+	    if (n == 1 || (src->kind == Operand::IMMEDIATE && src->value == 1 && src->symbol.empty())) {
+		emit(size == 1 ? 0xD0 : 0xD1, 1);
+		modrm(shifts[i].digit, *dst, 0);
+	    } else if (src->kind == Operand::IMMEDIATE && src->symbol.empty()) {
+		emit(size == 1 ? 0xC0 : 0xC1, 1);
+		modrm(shifts[i].digit, *dst, 1);
+		emit(src->value, 1);
+	    } else if (src->kind == Operand::REGISTER && src->reg == 1 && src->size == 1) {
+		emit(size == 1 ? 0xD2 : 0xD3, 1);
+		modrm(shifts[i].digit, *dst, 0);
+	    } else
+		error("invalid operands to " + name);
+
+	    return;
+	}
+
+    if (base == "mov") {
+	if (n != 2 || dst->kind == Operand::IMMEDIATE)
+	    error("invalid operands to " + name);
+
+	else if (src->kind == Operand::IMMEDIATE && dst->kind == Operand::REGISTER && size != 8) {
+	    prefix(size, nullptr, dst);
+	    emit((size == 1 ? 0xB0 : 0xB8) | (dst->reg & 7), 1);
+	    immediate(*src, size);
+
+	} else if (src->kind == Operand::IMMEDIATE) {
+	    prefix(size, nullptr, dst);
+	    emit(size == 1 ? 0xC6 : 0xC7, 1);
+	    modrm(0, *dst, size > 4 ? 4 : size);
+	    immediate(*src, size);
+
+	} else if (src->kind == Operand::REGISTER) {
+	    prefix(size, src, dst);
+	    emit(size == 1 ? 0x88 : 0x89, 1);
+	    modrm(src->reg, *dst, 0);
+
+	} else if (dst->kind == Operand::REGISTER) {
+	    prefix(size, dst, src);
+	    emit(size == 1 ? 0x8A : 0x8B, 1);
+	    modrm(dst->reg, *src, 0);
+
+	} else
+	    error("invalid operands to " + name);
+
+    } else if (base == "test") {
+	if (n != 2 || dst->kind == Operand::IMMEDIATE)
+	    error("invalid operands to " + name);
+
+	else if (src->kind == Operand::IMMEDIATE) {
+	    prefix(size, nullptr, dst);
+	    emit(size == 1 ? 0xF6 : 0xF7, 1);
+	    modrm(0, *dst, size == 1 ? 1 : 4);
+	    immediate(*src, size == 1 ? 1 : 4);
+
+	} else if (src->kind == Operand::REGISTER) {
+	    prefix(size, src, dst);
+	    emit(size == 1 ? 0x84 : 0x85, 1);
+	    modrm(src->reg, *dst, 0);
+
+	} else
+	    error("invalid operands to " + name);
+
+    } else if (base == "lea") {
+	if (n != 2 || src->kind != Operand::MEMORY || dst->kind != Operand::REGISTER)
+	    error("invalid operands to " + name);
+	else {
+	    prefix(size, dst, src);
+	    emit(0x8D, 1);
+	    modrm(dst->reg, *src, 0);
+	}
+
+    } else if (base == "imul") {
+	if (n == 1) {
+	    prefix(size, nullptr, src);
+	    emit(size == 1 ? 0xF6 : 0xF7, 1);
+	    modrm(5, *src, 0);
+
+	} else if (dst->kind != Operand::REGISTER)
+	    error("invalid operands to " + name);
+
+	else if (src->kind == Operand::IMMEDIATE) {
+	    Operand &rm = (n == 3 ? ops[1] : *dst);
+
+	    prefix(size, dst, &rm);
+
+	    if (src->symbol.empty() && fits(src->value)) {
+		emit(0x6B, 1);
+		modrm(dst->reg, rm, 1);
+		immediate(*src, 1);
+	    } else {
+		emit(0x69, 1);
+		modrm(dst->reg, rm, 4);
+		immediate(*src, 4);
+	    }
+
+	} else if (n == 2) {
+	    prefix(size, dst, src);
+	    emit(0x0F, 1);
+	    emit(0xAF, 1);
+	    modrm(dst->reg, *src, 0);
+
+	} else
+	    error("invalid operands to " + name);
+
+    } else if (base == "inc" || base == "dec") {
+	if (n != 1 || src->kind == Operand::IMMEDIATE)
+	    error("invalid operand to " + name);
+	else {
+	    prefix(size, nullptr, src);
+	    emit(size == 1 ? 0xFE : 0xFF, 1);
+	    modrm(base == "dec", *src, 0);
+	}
+
+    } else if (base == "push") {
+	if (n != 1)
+	    error("invalid operands to " + name);
+
+	else if (src->kind == Operand::REGISTER) {
+	    prefix(0, nullptr, src);
+	    emit(0x50 | (src->reg & 7), 1);
+
+	} else if (src->kind == Operand::IMMEDIATE && src->symbol.empty() && fits(src->value)) {
+	    emit(0x6A, 1);
+	    immediate(*src, 1);
+
+	} else if (src->kind == Operand::IMMEDIATE) {
+	    emit(0x68, 1);
+	    immediate(*src, 4);
+
+	} else {
+	    prefix(0, nullptr, src);
+	    emit(0xFF, 1);
+	    modrm(6, *src, 0);
+	}
+
+    } else if (base == "pop") {
+	if (n != 1 || src->kind == Operand::IMMEDIATE)
+	    error("invalid operands to " + name);
+
+	else if (src->kind == Operand::REGISTER) {
+	    prefix(0, nullptr, src);
+	    emit(0x58 | (src->reg & 7), 1);
+
+	} else {
+	    prefix(0, nullptr, src);
+	    emit(0x8F, 1);
+	    modrm(0, *src, 0);
+	}
+
+    } else
+	error("unknown instruction " + name);
+}
+
+
+/*
+ * Function:	Assembler::packedInstruction
+ *
+ * Description:	Encode an SSE2 instruction.  The mandatory prefix comes
+ *		before any REX prefix.  The shuffle takes its immediate
+ *		first, and movd moves from a 32-bit register or memory.
+ */
+
+void Assembler::packedInstruction(unsigned i, vector<Operand> &ops)
+{
+    string name = packed[i].name;
+    unsigned opcode = packed[i].opcode, n = ops.size();
+    Operand *xmm, *rm, *imm = nullptr;
+
+
+    if (name == "pshufd") {
+	if (n != 3 || ops[0].kind != Operand::IMMEDIATE || !ops[0].symbol.empty()) {
+	    error("invalid operands to " + name);
+	    return;
+	}
+
+	imm = &ops[0];
+    } else if (n != 2) {
+	error("invalid operands to " + name);
+	return;
+    }
+
+    xmm = &ops[n - 1];
+    rm = &ops[n - 2];
+
+    if (name == "movdqu" && rm->kind == Operand::REGISTER && xmm->kind == Operand::MEMORY) {
+	swap(xmm, rm);
+	opcode = 0x7F;
+    }
+
+    if (xmm->kind != Operand::REGISTER || xmm->size != 16 || rm->kind == Operand::IMMEDIATE ||
+	    (rm->kind == Operand::REGISTER && rm->size != (name == "movd" ? 4u : 16u))) {
+	error("invalid operands to " + name);
+	return;
+    }
+
+    emit(packed[i].prefix, 1);
+    prefix(4, xmm, rm);
+    emit(0x0F, 1);
+    emit(opcode, 1);
+    modrm(xmm->reg, *rm, imm != nullptr ? 1 : 0);
+
+    if (imm != nullptr)
+	emit(imm->value, 1);
+}
+
+
+/*
+ * Function:	Assembler::resolve
+ *
+ * Description:	Resolve the fixups.  A use of a constant is replaced by its
+ *		value, and a branch to a local label in the same section
+ *		is replaced by its distance.  Everything else becomes a
+ *		relocation.  An ELF relocation on this machine keeps its
+ *		addend in the bytes being relocated, so for a relative
+ *		reference we also account for the bytes of the
+ *		instruction that follow the reference.
+ */
+
+void Assembler::resolve()
+{
+    Object::Relocation r;
+    int64_t value;
+    int index;
+
+
+    for (unsigned i = 0; i < _fixups.size(); i ++) {
+	Fixup &f = _fixups[i];
+	vector<uint8_t> &data = _object.sections[f.section].bytes;
+	index = _object.find(f.symbol);
+
+	if (_constants.count(f.symbol) > 0) {
+	    value = _constants[f.symbol] + f.addend;
+
+	    if (f.type == Object::RELATIVE32)
+		value -= f.end;
+
+	} else if (index >= 0 && f.type == Object::RELATIVE32 &&
+		_object.symbols[index].section == (int) f.section &&
+		!_object.symbols[index].global)
+	    value = _object.symbols[index].value + f.addend - f.end;
+
+	else {
+	    r.section = f.section;
+	    r.offset = f.offset;
+	    r.symbol = _object.symbol(f.symbol);
+	    r.type = f.type;
+	    r.addend = f.addend;
+
+	    if (f.type == Object::RELATIVE32)
+		r.addend -= f.end - f.offset;
+
+	    _object.relocations.push_back(r);
+	    value = r.addend;
+	}
+
+	for (unsigned j = 0; j < 4; j ++)
+	    data[f.offset + j] = value >> (8 * j);
+    }
+}
+
+
+/*
+ * Function:	Assembler::assemble
+ *
+ * Description:	Assemble the text, returning whether it was successful.
+ */
+
+bool Assembler::assemble(const string &text)
+{
+    istringstream lines(text);
+    string line, name, rest;
+    vector<Operand> ops;
+    Strings list;
+    Object::Symbol *symbol;
+    size_t i;
+    bool quoted;
+
+
+    while (getline(lines, line)) {
+	_line ++;
+
+
+	/* Strip any comment, taking care not to look inside strings. */
+
+	for (i = 0, quoted = false; i < line.size(); i ++)
+	    if (line[i] == '"' && (i == 0 || line[i - 1] != '\\'))
+		quoted = !quoted;
+	    else if (line[i] == '#' && !quoted)
+		break;
+
+	line = trim(line.substr(0, i));
+
+
+	/* Define any labels at the start of the line. */
+
+	while ((i = line.find(':')) != string::npos && line.find('"') > i &&
+		line.find_first_of(" \t") > i) {
+	    symbol = &_object.symbols[_object.symbol(line.substr(0, i))];
+
+	    if (symbol->section != Object::UNDEFINED)
+		error("symbol " + symbol->name + " is already defined");
+
+	    symbol->section = _section;
+	    symbol->value = bytes().size();
+	    line = trim(line.substr(i + 1));
+	}
+
+	if (line.empty())
+	    continue;
+
+	i = line.find_first_of(" \t");
+	name = line.substr(0, i);
+	rest = i == string::npos ? "" : trim(line.substr(i));
+
+	if (name[0] == '.') {
+	    directive(name, rest);
+	    continue;
+	}
+
+	list = split(rest);
+	ops.resize(list.size());
+
+	for (i = 0; i < list.size(); i ++)
+	    if (!parseOperand(list[i], ops[i])) {
+		error("invalid operand " + list[i]);
+		break;
+	    }
+
+	if (i == list.size())
+	    instruction(name, ops);
+    }
+
+    resolve();
+    return !_failed;
+}
+
+
+/*
+ * Function:	assemble
+ *
+ * Description:	Assemble the text into the object, reporting any errors to
+ *		ERR, and return whether it was successful.
+ */
+
+bool assemble(const string &text, Object &object, ostream &err)
+{
+    Assembler assembler(object, err);
+    return assembler.assemble(text);
+}
@@ -0,0 +1,18 @@
+/*
+ * File:	assembler.h
+ *
+ * Description:	This file contains the public function declarations for
+ *		the assembler, which translates the assembly produced by
+ *		our code generator into object code without running an
+ *		external assembler.
+ */
+
+# ifndef ASSEMBLER_H
+# define ASSEMBLER_H
+# include <string>
+# include <iosfwd>
+# include "Object.h"
+
+bool assemble(const std::string &text, Object &object, std::ostream &err);
+
+# endif /* ASSEMBLER_H */
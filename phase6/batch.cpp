@@ -0,0 +1,217 @@
+/*
+ * File:	batch.cpp
+ *
+ * Description:	This file contains the public and private function
+ *		definitions for batch compilation.  Each source file named
+ *		on the command line, or listed in an @file, is compiled
+ *		into its own assembly file, or object file, by a pool of
+ *		worker threads.
+ *
+ *		Every unit is compiled into memory and its diagnostics are
+ *		collected separately, so a unit with errors neither leaves
+ *		a partial assembly file behind nor interleaves its messages
+ *		with those of other units.  Nothing a unit does can stop
+ *		the others from being compiled.
+ */
+
+# include <chrono>
+# include <fstream>
+# include <sstream>
+# include <iostream>
+# include <iomanip>
+# include <algorithm>
+# include <cstdio>
+# include <sys/stat.h>
+# include "Scheduler.h"
+# include "parser.h"
+# include "batch.h"
+
+using namespace std;
+using namespace std::chrono;
+
+static bool objects;
+
+struct Unit {
+    string path;
+    off_t bytes;
+    int errors;
+    double millis;
+    string diagnostics;
+};
+
+
+/*
+ * Function:	expand
+ *
+ * Description:	Expand the arguments into a list of units.  An argument of
+ *		the form @file names a file containing a list of source
+ *		files separated by white space.
+ */
+
+static bool expand(const vector<string> &args, vector<Unit> &units)
+{
+    string path;
+    struct stat sb;
+
+
+    for (unsigned i = 0; i < args.size(); i ++) {
+	if (args[i][0] == '@') {
+	    ifstream list(args[i].c_str() + 1);
+
+	    if (!list) {
+		cerr << "scc: cannot open " << args[i].substr(1) << endl;
+		return false;
+	    }
+
+	    while (list >> path)
+		units.push_back(Unit{path, 0, 0, 0, ""});
+
+	} else
+	    units.push_back(Unit{args[i], 0, 0, 0, ""});
+    }
+
+    for (unsigned i = 0; i < units.size(); i ++)
+	if (stat(units[i].path.c_str(), &sb) == 0)
+	    units[i].bytes = sb.st_size;
+
+    return true;
+}
+
+
+/*
+ * Function:	output
+ *
+ * Description:	Return the name of the output file for the given source
+ *		file, which replaces a .c suffix with .s, or .o if we are
+ *		writing object files, or appends the new suffix.
+ */
+
+static string output(const string &path)
+{
+    string suffix = objects ? ".o" : ".s";
+
+    if (path.size() > 2 && path.compare(path.size() - 2, 2, ".c") == 0)
+	return path.substr(0, path.size() - 2) + suffix;
+
+    return path + suffix;
+}
+
+
+/*
+ * Function:	build
+ *
+ * Description:	Compile a single unit, recording its errors and how long
+ *		it took.  The assembly file is written only if the unit
+ *		compiled cleanly, and a stale one is removed otherwise.
+ */
+
+static void build(Unit &unit)
+{
+    steady_clock::time_point start = steady_clock::now();
+    stringstream out, err;
+    ifstream in(unit.path.c_str());
+
+
+    if (!in) {
+	err << "cannot open file" << endl;
+	unit.errors = 1;
+
+    } else {
+	try {
+	    unit.errors = compile(in, out, err, objects);
+	} catch (const exception &e) {
+	    err << "internal error: " << e.what() << endl;
+	    unit.errors ++;
+	}
+
+	if (unit.errors == 0) {
+	    ofstream ofs(output(unit.path).c_str(), ios::binary);
+
+	    if (!(ofs << out.rdbuf())) {
+		err << "cannot write " << output(unit.path) << endl;
+		unit.errors = 1;
+	    }
+
+	} else
+	    remove(output(unit.path).c_str());
+    }
+
+    unit.diagnostics = err.str();
+    unit.millis = duration<double, milli>(steady_clock::now() - start).count();
+}
+
+
+/*
+ * Function:	compileBatch
+ *
+ * Description:	Compile each of the units named by the arguments using the
+ *		given number of worker threads, and report the time taken
+ *		by each unit and the overall throughput to the standard
+ *		error.  The units are submitted smallest first, so each
+ *		worker starts on the largest units it was dealt and the
+ *		small ones are left at the front of the queues for idle
+ *		workers to steal.  If OBJECT is true, each unit is written
+ *		as an object file.  Return the number of failed units.
+ */
+
+int compileBatch(const vector<string> &args, unsigned jobs, bool object)
+{
+    vector<Unit> units;
+    vector<Unit *> order;
+    steady_clock::time_point start;
+    double seconds;
+    off_t bytes = 0;
+    int failed = 0;
+    string line;
+
+
+    objects = object;
+
+    if (!expand(args, units))
+	return 1;
+
+    for (unsigned i = 0; i < units.size(); i ++)
+	order.push_back(&units[i]);
+
+    stable_sort(order.begin(), order.end(), [](Unit *a, Unit *b) {
+	return a->bytes < b->bytes;
+    });
+
+    start = steady_clock::now();
+
+    Scheduler scheduler(jobs);
+
+    for (unsigned i = 0; i < order.size(); i ++) {
+	Unit *unit = order[i];
+	scheduler.submit([unit]() { build(*unit); });
+    }
+
+    scheduler.wait();
+    seconds = duration<double>(steady_clock::now() - start).count();
+
+    for (unsigned i = 0; i < units.size(); i ++) {
+	istringstream diagnostics(units[i].diagnostics);
+
+	while (getline(diagnostics, line))
+	    cerr << units[i].path << ": " << line << endl;
+
+	cerr << "scc: " << units[i].path << ": " << fixed;
+	cerr << setprecision(3) << units[i].millis << " ms";
+	cerr << (units[i].errors ? " (failed)" : "") << endl;
+
+	bytes += units[i].bytes;
+	failed += units[i].errors > 0;
+    }
+
+    cerr << "scc: " << units.size() << " units, " << failed << " failed, ";
+    cerr << setprecision(3) << seconds * 1000 << " ms on ";
+    cerr << scheduler.workers() << " threads";
+
+    if (seconds > 0) {
+	cerr << ", " << setprecision(1) << units.size() / seconds;
+	cerr << " units/s, " << bytes / seconds / 1024 << " KB/s";
+    }
+
+    cerr << endl;
+    return failed;
+}
@@ -0,0 +1,17 @@
+/*
+ * File:	batch.h
+ *
+ * Description:	This file contains the public function declarations for
+ *		batch compilation, in which many translation units are
+ *		compiled by a single process.
+ */
+
+# ifndef BATCH_H
+# define BATCH_H
+# include <string>
+# include <vector>
+
+int compileBatch(const std::vector<std::string> &args, unsigned jobs,
+    bool object = false);
+
+# endif /* BATCH_H */
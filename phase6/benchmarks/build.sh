@@ -0,0 +1,46 @@
+#!/bin/sh
+#
+# File:		build.sh
+#
+# Description:	Compare the time taken to build object files for the
+#		examples by running the system assembler on our output
+#		against writing the object files directly with scc -c.
+#
+#		usage: build.sh [iterations]
+#
+
+cd `dirname $0`/.. || exit 1
+n=${1:-50}
+tmp=${TMPDIR:-/tmp}/scc-build.$$
+mkdir -p $tmp || exit 1
+trap 'rm -rf $tmp' 0
+
+time_it() {
+    start=`date +%s%N`
+    i=0
+    while [ $i -lt $n ]; do
+	for f in examples/*.c; do
+	    "$@" $f $tmp/`basename $f .c`.o || exit 1
+	done
+	i=`expr $i + 1`
+    done
+    end=`date +%s%N`
+    echo `expr \( $end - $start \) / 1000000`
+}
+
+with_as() {
+    ./scc < $1 > $2.s && as --32 -o $2 $2.s
+}
+
+with_scc() {
+    ./scc -c < $1 > $2
+}
+
+a=`time_it with_as`
+b=`time_it with_scc`
+units=`expr $n \* \`ls examples/*.c | wc -l\``
+
+echo "$units units"
+echo "scc | as:  $a ms"
+echo "scc -c:    $b ms"
+echo "saved:     `expr $a - $b` ms (`expr 100 \* \( $a - $b \) / $a`%)"
@@ -0,0 +1,43 @@
+#!/bin/sh
+#
+# File:		count.sh
+#
+# Description:	Count the instructions generated for each of the examples
+#		with and without the given passes, using scc -fno-pass,
+#		for the i386 and for x86-64.  The counts are static, of
+#		the instructions in the assembly.
+#
+#		usage: count.sh pass ... [-- example ...]
+#
+
+cd `dirname $0`/.. || exit 1
+flags=
+
+while [ $# -gt 0 ] && [ "$1" != -- ]; do
+    flags="$flags -fno-$1"
+    shift
+done
+
+[ $# -gt 0 ] && shift
+examples=${*:-`ls examples/*.c`}
+
+count() {
+    input=$1
+    shift
+    ./scc "$@" < $input | grep -c '^	[a-z]'
+}
+
+for target in -m32 -m64; do
+    echo "$target"
+    before=0 after=0
+
+    for file in $examples; do
+	off=`count $file $target $flags`
+	on=`count $file $target`
+	before=`expr $before + $off`
+	after=`expr $after + $on`
+	printf "    %-20s %6d %6d (%+d)\n" `basename $file` $off $on `expr $on - $off`
+    done
+
+    printf "    %-20s %6d %6d (%+d)\n" total $before $after `expr $after - $before`
+done
@@ -0,0 +1,49 @@
+#!/bin/sh
+#
+# File:		emit-c.sh
+#
+# Description:	Compare the time taken to run fib, qsort, and matrix from
+#		the examples when compiled by our own x86-64 backend,
+#		using scc -m64, against compiling the C written by scc
+#		--emit-c with gcc -O2.  Only the running time is measured.
+#		The examples are given larger inputs than their own, except
+#		for qsort, whose input is fixed, so it is run repeatedly.
+#
+#		usage: emit-c.sh [fib-input] [matrix-input] [qsort-iterations]
+#
+
+cd `dirname $0`/.. || exit 1
+fib=${1:-35}
+matrix=${2:-600}
+qsort=${3:-200}
+tmp=${TMPDIR:-/tmp}/emit-c.$$
+trap 'rm -rf $tmp' 0
+mkdir $tmp || exit 1
+
+time_it() {
+    n=$1 input=$2
+    shift 2
+    start=`date +%s%N`
+    i=0
+    while [ $i -lt $n ]; do
+	echo $input | "$@" > /dev/null
+	i=`expr $i + 1`
+    done
+    end=`date +%s%N`
+    echo `expr \( $end - $start \) / 1000000`
+}
+
+compare() {
+    name=$1
+    ./scc -m64 -c < examples/$name.c > $tmp/$name.o || exit 1
+    gcc -no-pie -o $tmp/$name.scc $tmp/$name.o || exit 1
+    ./scc --emit-c < examples/$name.c > $tmp/$name.c || exit 1
+    gcc -O2 -w -o $tmp/$name.gcc $tmp/$name.c || exit 1
+    a=`time_it $2 "$3" $tmp/$name.scc`
+    b=`time_it $2 "$3" $tmp/$name.gcc`
+    printf "%-8s scc: %6d ms   gcc -O2: %6d ms\n" $name $a $b
+}
+
+compare fib 1 $fib
+compare matrix 1 $matrix
+compare qsort $qsort "`cat examples/qsort.in`"
@@ -0,0 +1,76 @@
+/*
+ * File:	loops.c
+ *
+ * Description:	Run some simple loops over arrays many times: a sum, a
+ *		dot product, a scaled add, and a copy.  The number of
+ *		passes is read from the standard input.
+ */
+
+int a[1000], b[1000], c[1000];
+
+int sum(int *x, int n)
+{
+    int i, s;
+
+    s = 0;
+
+    for (i = 0; i < n; i = i + 1)
+	s = s + x[i];
+
+    return s;
+}
+
+int dot(int *x, int *y, int n)
+{
+    int i, s;
+
+    s = 0;
+    i = 0;
+
+    while (i < n) {
+	s = s + x[i] * y[i];
+	i = i + 1;
+    }
+
+    return s;
+}
+
+int scale(int *x, int *y, int k, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i = i + 1)
+	y[i] = y[i] + k * x[i];
+}
+
+int copy(int *x, int *y, int n)
+{
+    int i;
+
+    for (i = n - 1; i >= 0; i = i - 1)
+	y[i] = x[i];
+}
+
+int main(void)
+{
+    int i, passes, total;
+
+    scanf("%d", &passes);
+
+    for (i = 0; i < 1000; i = i + 1) {
+	a[i] = i % 17;
+	b[i] = i % 13;
+    }
+
+    total = 0;
+
+    while (passes > 0) {
+	scale(a, b, 3, 997);
+	copy(b, c, 999);
+	total = total + sum(c, 1000) % 1000 + dot(a, b, 1000) % 1000;
+	passes = passes - 1;
+    }
+
+    printf("%d\n", total);
+    return 0;
+}
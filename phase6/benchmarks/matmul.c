@@ -0,0 +1,60 @@
+/*
+ * File:	matmul.c
+ *
+ * Description:	Multiply a 16 by 1024 matrix of ints by a 1024 by 1024
+ *		one, with the loops in the textbook order, in which the
+ *		innermost loop walks down a column of the second matrix,
+ *		and transpose the second matrix.  The matrices are stored
+ *		by rows in arrays.  The number of passes is read from the
+ *		standard input.
+ */
+
+int a[16384], b[1048576], c[16384], t[1048576];
+
+int multiply(void)
+{
+    int i, j, k;
+
+    for (i = 0; i < 16; i = i + 1)
+	for (j = 0; j < 1024; j = j + 1)
+	    c[i * 1024 + j] = 0;
+
+    for (i = 0; i < 16; i = i + 1)
+	for (j = 0; j < 1024; j = j + 1)
+	    for (k = 0; k < 1024; k = k + 1)
+		c[i * 1024 + j] = c[i * 1024 + j] + a[i * 1024 + k] * b[k * 1024 + j];
+}
+
+int transpose(void)
+{
+    int i, j;
+
+    for (i = 0; i < 1024; i = i + 1)
+	for (j = 0; j < 1024; j = j + 1)
+	    t[j * 1024 + i] = b[i * 1024 + j];
+}
+
+int main(void)
+{
+    int i, passes, total;
+
+    scanf("%d", &passes);
+
+    for (i = 0; i < 16384; i = i + 1)
+	a[i] = i % 17 - 8;
+
+    for (i = 0; i < 1048576; i = i + 1)
+	b[i] = i % 13 - 6;
+
+    total = 0;
+
+    while (passes > 0) {
+	multiply();
+	transpose();
+	total = total + c[passes * 277 % 16384] % 1000 + t[passes * 991 % 1048576];
+	passes = passes - 1;
+    }
+
+    printf("%d\n", total);
+    return 0;
+}
@@ -0,0 +1,40 @@
+#!/bin/sh
+#
+# File:		nest.sh
+#
+# Description:	Compare the running time of matmul.c, compiled for x86-64
+#		with neither loop interchange nor tiling, with interchange
+#		alone, and with both, using each given tile size.  The
+#		time is only that of running it.
+#
+#		usage: nest.sh [passes] [size ...]
+#
+
+cd `dirname $0`/.. || exit 1
+passes=${1:-8}
+[ $# -gt 0 ] && shift
+sizes=${*:-16 32 64}
+tmp=${TMPDIR:-/tmp}/nest.$$
+trap 'rm -rf $tmp' 0
+mkdir $tmp || exit 1
+
+measure() {
+    ./scc -m64 -c "$@" < benchmarks/matmul.c > $tmp/a.o || exit 1
+    gcc -no-pie -o $tmp/a $tmp/a.o || exit 1
+    start=`date +%s%N`
+    echo $passes | $tmp/a > /dev/null
+    end=`date +%s%N`
+    time=`expr \( $end - $start \) / 1000000`
+}
+
+measure -fno-interchange -fno-tile
+base=$time
+printf "neither            time: %6d ms\n" $base
+
+measure -fno-tile
+printf "interchange        time: %6d ms (%+4d%%)\n" $time `expr 100 \* \( $time - $base \) / $base`
+
+for k in $sizes; do
+    measure --tile-size $k
+    printf "tile size %-4d     time: %6d ms (%+4d%%)\n" $k $time `expr 100 \* \( $time - $base \) / $base`
+done
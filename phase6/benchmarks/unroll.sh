@@ -0,0 +1,41 @@
+#!/bin/sh
+#
+# File:		unroll.sh
+#
+# Description:	Compare the code size and running time of the loops in
+#		loops.c, compiled for x86-64 without unrolling, using scc
+#		--unroll-factor 1, and with each given unroll factor.  The
+#		size is that of the text of the object file, and the time
+#		only that of running it.
+#
+#		usage: unroll.sh [passes] [factor ...]
+#
+
+cd `dirname $0`/.. || exit 1
+passes=${1:-20000}
+[ $# -gt 0 ] && shift
+factors=${*:-2 4 8}
+tmp=${TMPDIR:-/tmp}/unroll.$$
+trap 'rm -rf $tmp' 0
+mkdir $tmp || exit 1
+
+measure() {
+    ./scc -m64 -c --unroll-factor $1 < benchmarks/loops.c > $tmp/$1.o || exit 1
+    gcc -no-pie -o $tmp/$1 $tmp/$1.o || exit 1
+    size=`size $tmp/$1.o | awk 'NR == 2 { print $1 }'`
+    start=`date +%s%N`
+    echo $passes | $tmp/$1 > /dev/null
+    end=`date +%s%N`
+    time=`expr \( $end - $start \) / 1000000`
+}
+
+measure 1
+base=$size basetime=$time
+printf "factor 1   text: %6d bytes            time: %6d ms\n" $base $basetime
+
+for k in $factors; do
+    measure $k
+    printf "factor %-3d text: %6d bytes (%+4d%%)   time: %6d ms (%+4d%%)\n" $k $size \
+	`expr 100 \* \( $size - $base \) / $base` $time \
+	`expr 100 \* \( $time - $basetime \) / $basetime`
+done
@@ -0,0 +1,43 @@
+#!/bin/sh
+#
+# File:		vm.sh
+#
+# Description:	Compare the time taken to run fib, qsort, and matrix from
+#		the examples as native code, using scc --run, against
+#		running them in the bytecode interpreter, using scc
+#		--interpret.  Both include the time to compile.  The
+#		examples are given larger inputs than their own, except
+#		for qsort, whose input is fixed, so it is run repeatedly.
+#
+#		usage: vm.sh [fib-input] [matrix-input] [qsort-iterations]
+#
+
+cd `dirname $0`/.. || exit 1
+fib=${1:-32}
+matrix=${2:-400}
+qsort=${3:-200}
+
+time_it() {
+    n=$1 input=$2
+    shift 2
+    start=`date +%s%N`
+    i=0
+    while [ $i -lt $n ]; do
+	echo $input | "$@" > /dev/null
+	i=`expr $i + 1`
+    done
+    end=`date +%s%N`
+    echo `expr \( $end - $start \) / 1000000`
+}
+
+compare() {
+    name=$1
+    a=`time_it $2 "$3" ./scc --run examples/$name.c`
+    b=`time_it $2 "$3" ./scc --interpret examples/$name.c`
+    printf "%-8s native: %6d ms   interpreted: %6d ms   (%s.%sx)\n" $name $a $b \
+	`expr $b / $a` `expr \( 10 \* $b / $a \) % 10`
+}
+
+compare fib 1 $fib
+compare matrix 1 $matrix
+compare qsort $qsort "`cat examples/qsort.in`"
@@ -0,0 +1,112 @@
+/*
+ * File:	bytecode.h
+ *
+ * Description:	This file contains the definitions for the bytecode that
+ *		Simple C is lowered into when it is to be interpreted
+ *		rather than compiled to machine code.
+ *
+ *		The bytecode is register based.  Each function has its own
+ *		set of registers, each holding a 64-bit value, and its own
+ *		block of memory for any variables that must have an
+ *		address.  Register 0 always holds the address of that
+ *		memory, and the parameters arrive in registers 1 through n.
+ *		Scalar variables whose address is never taken live in
+ *		registers, as do all temporaries.
+ *
+ *		An instruction has up to three register operands, A, B,
+ *		and C, and an immediate.  The destination, if any, is
+ *		always A.  A branch keeps the index of its target in C.
+ */
+
+# ifndef BYTECODE_H
+# define BYTECODE_H
+# include <deque>
+# include <string>
+# include <vector>
+# include <cstdint>
+
+/* The opcodes, listed once so the interpreter can build its table of
+   handlers in the same order.  Those ending in Q operate on 64-bit
+   values, and those ending in I take their right operand from the
+   immediate.  The loads and stores ending in X are indexed, with the
+   scale in the immediate.  A tail call is a call whose callee takes
+   over the frame of the caller and returns to its caller. */
+
+# define OPCODES \
+    OPCODE(MOV) OPCODE(LI) \
+    OPCODE(ADD) OPCODE(SUB) OPCODE(MUL) OPCODE(DIV) OPCODE(REM) \
+    OPCODE(ADDQ) OPCODE(SUBQ) OPCODE(MULQ) OPCODE(DIVQ) OPCODE(REMQ) \
+    OPCODE(ADDI) OPCODE(MULI) OPCODE(ADDQI) OPCODE(MULQI) \
+    OPCODE(NEG) OPCODE(NEGQ) OPCODE(NOT) OPCODE(SEXTB) OPCODE(SEXTW) \
+    OPCODE(LT) OPCODE(GT) OPCODE(LE) OPCODE(GE) OPCODE(EQ) OPCODE(NE) \
+    OPCODE(LB) OPCODE(LW) OPCODE(LQ) OPCODE(LBX) OPCODE(LWX) OPCODE(LQX) \
+    OPCODE(SB) OPCODE(SW) OPCODE(SQ) OPCODE(SBX) OPCODE(SWX) OPCODE(SQX) \
+    OPCODE(LEA) \
+    OPCODE(JMP) OPCODE(BZ) OPCODE(BNZ) \
+    OPCODE(BLT) OPCODE(BGT) OPCODE(BLE) OPCODE(BGE) OPCODE(BEQ) OPCODE(BNE) \
+    OPCODE(BLTI) OPCODE(BGTI) OPCODE(BLEI) OPCODE(BGEI) OPCODE(BEQI) \
+    OPCODE(BNEI) \
+    OPCODE(CALL) OPCODE(CALLN) OPCODE(TAIL) OPCODE(TAILN) OPCODE(RET)
+
+# define OPCODE(name) OP_##name,
+enum Opcode { OPCODES NUM_OPCODES };
+# undef OPCODE
+
+struct Instruction {
+    Opcode op;
+    int a, b, c;
+    intptr_t imm;
+};
+
+typedef std::vector<Instruction> Instructions;
+
+
+/* The address of a memory operand: BASE + INDEX * SCALE + OFFSET, where
+   an INDEX of -1 means there is none. */
+
+struct Location {
+    int base, index;
+    unsigned scale;
+    intptr_t offset;
+};
+
+
+/* A function of the program.  The memory is kept a multiple of 16 bytes
+   so the memory of the next call is aligned. */
+
+struct Routine {
+    std::string name;
+    Instructions code;
+    unsigned registers, memory;
+};
+
+
+/* A function called by the program.  Until the program is linked, we
+   only know its name and the size of its result.  Afterward, it is either
+   one of our own routines or a function of the C library. */
+
+struct Callee {
+    std::string name;
+    unsigned size;
+    int routine;
+    void *native;
+};
+
+
+/* The arguments of each call are kept apart from the instructions: the
+   C operand of a call is the index of the number of arguments, which is
+   followed by the registers holding them. */
+
+struct Program {
+    std::vector<Routine> routines;
+    std::vector<Callee> callees;
+    std::vector<int> arguments;
+    std::deque<std::string> strings;
+    std::vector<void *> globals;
+
+    ~Program();
+};
+
+void initLowerer(Program &program);
+
+# endif /* BYTECODE_H */
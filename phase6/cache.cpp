@@ -0,0 +1,237 @@
+/*
+ * File:	cache.cpp
+ *
+ * Description:	This file contains the public and private function
+ *		definitions for the on-disk cache of generated code for
+ *		functions.
+ *
+ *		Each entry is a file in the cache directory named by the
+ *		fingerprint of a function, which the parser computes from
+ *		the tokens of its definition and the declarations of
+ *		everything it refers to.  The salt given when the cache is
+ *		opened is mixed into every fingerprint, so code generated
+ *		under different options never collides.  Along with the
+ *		code, an entry holds the summary of the function that the
+ *		functions after it need if its body is skipped.
+ *
+ *		Several compilers may share a cache directory.  An entry is
+ *		written to a temporary file and then renamed into place, so
+ *		a reader sees either the whole entry or nothing.  Two
+ *		writers of the same entry write the same contents, so it
+ *		doesn't matter which one wins.  The running totals in the
+ *		stats file are updated under a lock.
+ */
+
+# include <atomic>
+# include <cerrno>
+# include <cstdio>
+# include <cstring>
+# include <fstream>
+# include <sstream>
+# include <iostream>
+# include <iomanip>
+# include <thread>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/file.h>
+# include <sys/stat.h>
+# include "cache.h"
+
+using namespace std;
+
+static string directory, salt;
+static atomic<unsigned> hits, misses, stores;
+
+
+/*
+ * Function:	openCache
+ *
+ * Description:	Start caching in the given directory, creating it if
+ *		necessary.
+ */
+
+bool openCache(const string &dir, const string &s)
+{
+    if (mkdir(dir.c_str(), 0777) < 0 && errno != EEXIST) {
+	cerr << "scc: " << dir << ": " << strerror(errno) << endl;
+	return false;
+    }
+
+    directory = dir;
+    salt = s;
+    return true;
+}
+
+
+/*
+ * Function:	cacheEnabled
+ *
+ * Description:	Return whether a cache is in use.
+ */
+
+bool cacheEnabled()
+{
+    return !directory.empty();
+}
+
+
+/*
+ * Function:	path
+ *
+ * Description:	Return the name of the file for the given entry.
+ */
+
+static string path(uint64_t key)
+{
+    stringstream ss;
+
+    ss << directory << "/" << hex << setw(16) << setfill('0') << key;
+    return ss.str();
+}
+
+
+/*
+ * Function:	fingerprint
+ *
+ * Description:	Return the 64-bit FNV-1a hash of the salt and data.
+ */
+
+uint64_t fingerprint(const string &data)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    string s = salt + '\0' + data;
+
+
+    for (unsigned i = 0; i < s.size(); i ++) {
+	hash ^= (unsigned char) s[i];
+	hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+
+/*
+ * Function:	findFragment
+ *
+ * Description:	Look up the entry for the given key, and if found, read it
+ *		into the fragment.  An entry that can't be read counts as
+ *		a miss.
+ */
+
+bool findFragment(uint64_t key, Fragment &fragment)
+{
+    ifstream ifs(path(key).c_str());
+    unsigned count, size, length;
+    string magic, line;
+
+
+    if (ifs >> magic >> fragment.labels >> count >> size >> length && magic == "scc2") {
+	getline(ifs, line);
+	fragment.strings.clear();
+
+	while (fragment.strings.size() < count && getline(ifs, line))
+	    fragment.strings.push_back(line);
+
+	fragment.text.resize(size);
+	fragment.summary.resize(length);
+
+	if (fragment.strings.size() == count && ifs.read(&fragment.text[0], size))
+	    if (ifs.read(&fragment.summary[0], length)) {
+		hits ++;
+		return true;
+	    }
+    }
+
+    misses ++;
+    return false;
+}
+
+
+/*
+ * Function:	storeFragment
+ *
+ * Description:	Write the fragment as the entry for the given key.  A
+ *		failure to write is not an error; we just don't cache it.
+ */
+
+void storeFragment(uint64_t key, const Fragment &fragment)
+{
+    stringstream temp;
+
+
+    temp << path(key) << ".tmp." << getpid() << "." << this_thread::get_id();
+
+    {
+	ofstream ofs(temp.str().c_str());
+
+	ofs << "scc2 " << fragment.labels << " " << fragment.strings.size();
+	ofs << " " << fragment.text.size() << " " << fragment.summary.size() << endl;
+
+	for (unsigned i = 0; i < fragment.strings.size(); i ++)
+	    ofs << fragment.strings[i] << endl;
+
+	ofs << fragment.text << fragment.summary;
+
+	if (!ofs.flush()) {
+	    remove(temp.str().c_str());
+	    return;
+	}
+    }
+
+    if (rename(temp.str().c_str(), path(key).c_str()) == 0)
+	stores ++;
+    else
+	remove(temp.str().c_str());
+}
+
+
+/*
+ * Function:	closeCache
+ *
+ * Description:	Stop caching, adding our counts to the running totals for
+ *		the cache, and if requested, report both.
+ */
+
+void closeCache(bool report)
+{
+    unsigned long totals[3] = {0, 0, 0};
+    string stats;
+    char buf[100];
+    ssize_t n;
+    int fd;
+
+
+    if (!cacheEnabled())
+	return;
+
+    stats = directory + "/stats";
+    fd = open(stats.c_str(), O_RDWR | O_CREAT, 0666);
+
+    if (fd >= 0 && flock(fd, LOCK_EX) == 0) {
+	n = read(fd, buf, sizeof(buf) - 1);
+	buf[n > 0 ? n : 0] = '\0';
+	sscanf(buf, "%lu %lu %lu", &totals[0], &totals[1], &totals[2]);
+
+	totals[0] += hits;
+	totals[1] += misses;
+	totals[2] += stores;
+
+	n = snprintf(buf, sizeof(buf), "%lu %lu %lu\n", totals[0], totals[1], totals[2]);
+
+	if (ftruncate(fd, 0) == 0 && pwrite(fd, buf, n, 0) != n)
+	    cerr << "scc: cannot update " << stats << endl;
+    }
+
+    if (fd >= 0)
+	close(fd);
+
+    if (report) {
+	cerr << "scc: cache " << directory << ": " << hits << " hits, ";
+	cerr << misses << " misses, " << stores << " stored (total ";
+	cerr << totals[0] << " hits, " << totals[1] << " misses, ";
+	cerr << totals[2] << " stored)" << endl;
+    }
+
+    directory.clear();
+}
@@ -0,0 +1,22 @@
+/*
+ * File:	cache.h
+ *
+ * Description:	This file contains the public function declarations for
+ *		the on-disk cache of generated code for functions.
+ */
+
+# ifndef CACHE_H
+# define CACHE_H
+# include <string>
+# include <cstdint>
+# include "generator.h"
+
+bool openCache(const std::string &dir, const std::string &salt);
+void closeCache(bool report);
+bool cacheEnabled();
+
+uint64_t fingerprint(const std::string &data);
+bool findFragment(uint64_t key, Fragment &fragment);
+void storeFragment(uint64_t key, const Fragment &fragment);
+
+# endif /* CACHE_H */
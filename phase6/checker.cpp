@@ -18,19 +18,20 @@
 # include <iostream>
 # include "lexer.h"
 # include "checker.h"
+# include "machine.h"
 # include "nullptr.h"
 # include "tokens.h"
 # include "Symbol.h"
 # include "Scope.h"
 # include "Type.h"
 
-# define FUNCDEFN 1
-
 
 using namespace std;
 
-static Scope *outermost, *toplevel;
+static thread_local Scope *outermost, *toplevel;
+static thread_local Symbol *function;
 static const Type error, integer(INT), character(CHAR), voidPointer(VOID, 1);
+static const Type longInteger(LONG);
 
 static string redefined = "redefinition of '%s'";
 static string redeclared = "redeclaration of '%s'";
@@ -120,17 +121,35 @@ Scope *openScope()
  * Function:	closeScope
  *
  * Description:	Remove the top-level scope, and make its enclosing scope
- *		the new top-level scope.
+ *		the new top-level scope.  Closing the outermost scope
+ *		finishes the translation unit, so the next unit opened on
+ *		this thread starts from scratch.
  */
 
 Scope *closeScope()
 {
     Scope *old = toplevel;
     toplevel = toplevel->enclosing();
+
+    if (toplevel == nullptr)
+	outermost = nullptr;
+
     return old;
 }
 
 
+/*
+ * Function:	currentScope
+ *
+ * Description:	Return the top-level scope without changing it.
+ */
+
+Scope *currentScope()
+{
+    return toplevel;
+}
+
+
 /*
  * Function:	defineFunction
  *
@@ -146,6 +165,7 @@ Symbol *defineFunction(const string &name, const Type &type)
 	report(redefined, name);
 
     symbol->_attributes = FUNCDEFN;
+    function = symbol;
     return symbol;
 }
 
@@ -181,7 +201,9 @@ Symbol *declareFunction(const string &name, const Type &type)
  * Function:	declareVariable
  *
  * Description:	Declare a variable with the specified NAME and TYPE.  Any
- *		redeclaration is discarded.
+ *		redeclaration is discarded.  A local array is used by its
+ *		address, so the frame of the function has its address
+ *		taken.
  */
 
 Symbol *declareVariable(const string &name, const Type &type)
@@ -192,6 +214,9 @@ Symbol *declareVariable(const string &name, const Type &type)
 	symbol = new Symbol(name, checkIfVoidObject(name, type));
 	toplevel->insert(symbol);
 
+	if (type.isArray() && toplevel != outermost && function != nullptr)
+	    function->_attributes |= FRAMEADDR;
+
     } else if (outermost != toplevel)
 	report(redeclared, name);
 
@@ -287,6 +312,26 @@ Expression *checkCall(const Symbol *id, Expressions &args)
 }
 
 
+/*
+ * Function:	scale
+ *
+ * Description:	Return an expression that scales the integer operand of
+ *		pointer arithmetic by the size of the type pointed to by
+ *		the pointer type T.  If pointers are wider than ints, the
+ *		operand is widened first so the arithmetic is done at the
+ *		width of a pointer.
+ */
+
+static Expression *scale(Expression *expr, const Type &t)
+{
+    if (SIZEOF_PTR == SIZEOF_INT)
+	return new Multiply(expr, new Number(t.deref().size()), integer);
+
+    expr = new Promote(expr, longInteger);
+    return new Multiply(expr, new Number(t.deref().size()), longInteger);
+}
+
+
 /*
  * Function:	checkArray
  *
@@ -304,7 +349,7 @@ Expression *checkArray(Expression *left, Expression *right)
     Type result = error;
 
     if (t1.isPointer())
-	right = new Multiply(right, new Number(t1.deref().size()), integer);
+	right = scale(right, t1);
 
     Expression *expr = new Add(left, right, t1);
 
@@ -403,7 +448,8 @@ Expression *checkDereference(Expression *expr)
  *
  * Description:	Check an address expression: the operand must be an lvalue,
  *		and if the operand has type T, then the result has type
- *		"pointer to T."
+ *		"pointer to T."  Taking the address of a local variable
+ *		is noted in the attributes of the function.
  *
  *		T -> pointer(T)
  */
@@ -411,13 +457,18 @@ Expression *checkDereference(Expression *expr)
 Expression *checkAddress(Expression *expr)
 {
     const Type &t = expr->type();
+    const Identifier *id = dynamic_cast<const Identifier *>(expr);
     Type result = error;
 
 
     if (t != error) {
-	if (expr->lvalue())
+	if (expr->lvalue()) {
 	    result = Type(t.specifier(), t.indirection() + 1);
-	else
+
+	    if (id != nullptr && outermost->find(id->symbol()->name()) != id->symbol())
+		function->_attributes |= FRAMEADDR;
+
+	} else
 	    report(invalid_lvalue);
     }
 
@@ -540,11 +591,11 @@ Expression *checkAdd(Expression *left, Expression *right)
 	    result = t1;
 
 	else if (t1.isPointer() && t1 != voidPointer && t2 == integer) {
-	    right = new Multiply(right, new Number(t1.deref().size()), integer);
+	    right = scale(right, t1);
 	    result = t1;
 
 	} else if (t1 == integer && t2.isPointer() && t2 != voidPointer) {
-	    left = new Multiply(left, new Number(t2.deref().size()), integer);
+	    left = scale(left, t2);
 	    result = t2;
 
 	} else
@@ -586,17 +637,24 @@ Expression *checkSubtract(Expression *left, Expression *right)
 	    result = integer;
 
 	else if (t1.isPointer() && t1 != voidPointer && t2 == integer) {
-	    right = new Multiply(right, new Number(t1.deref().size()), integer);
+	    right = scale(right, t1);
 	    result = t1;
 
 	} else
 	    report(invalid_operands, "-");
     }
 
-    tree = new Subtract(left, right, result);
+    if (t1.isPointer() && t1 == t2 && SIZEOF_PTR != SIZEOF_INT) {
+	tree = new Subtract(left, right, longInteger);
+	tree = new Divide(tree, new Number(t1.deref().size()), longInteger);
+	tree = new Promote(tree, result);
+
+    } else {
+	tree = new Subtract(left, right, result);
 
-    if (t1.isPointer() && t1 == t2)
-	tree = new Divide(tree, new Number(t1.deref().size()), integer);
+	if (t1.isPointer() && t1 == t2)
+	    tree = new Divide(tree, new Number(t1.deref().size()), integer);
+    }
 
     return tree;
 }
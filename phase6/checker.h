@@ -10,8 +10,18 @@
 # include "Scope.h"
 # include "Tree.h"
 
+/* The attributes of a function symbol: whether it has been defined,
+   whether the address of anything in its frame may have been taken, in
+   which case the frame must outlive any call it makes, and whether it is
+   a copy specialized by the optimizer, which is private to the unit */
+
+# define FUNCDEFN	1
+# define FRAMEADDR	2
+# define SPECIALIZED	4
+
 Scope *openScope();
 Scope *closeScope();
+Scope *currentScope();
 
 Symbol *defineFunction(const std::string &name, const Type &type);
 Symbol *declareFunction(const std::string &name, const Type &type);
@@ -0,0 +1,325 @@
+/*
+ * File:	cse.cpp
+ *
+ * Description:	This file contains the function definitions for
+ *		eliminating common subexpressions.
+ *
+ *		We number the values of the expressions of a function as
+ *		we walk its statements in the order they run, keeping
+ *		those still available: expressions computed by a statement
+ *		that dominates the current one, with nothing written since
+ *		that they read.  An expression with the key of an available
+ *		one is replaced by a temporary, which is set to the value
+ *		just before the statement that first computed it, where
+ *		that occurrence is replaced too.
+ *
+ *		Simple C has no goto, break, or continue, so the walk is
+ *		just the nesting of the statements.  The test of an if
+ *		statement dominates both branches, and whatever either
+ *		writes is no longer available after it.  Whatever a loop
+ *		writes is no longer available in it, and what its body
+ *		computes is available only in the rest of the body.
+ *		Since the test of a loop is evaluated in every iteration,
+ *		but the temporary could be set only before the loop, an
+ *		expression first computed in the test is not reused.
+ *
+ *		Invalidation is conservative.  After each statement, an
+ *		expression is no longer available if the statement assigns
+ *		a variable it names, stores through a pointer to a type
+ *		that may alias memory it reads, or calls a function that
+ *		might write that memory; see invariant.  An expression is
+ *		first computed only where it is certainly evaluated, and
+ *		only if it would be the same just before the statement,
+ *		so that computing it there neither changes its value nor
+ *		traps before a call that would have run.  Within a statement
+ *		with such a call, it is not reused, since we cannot tell on
+ *		which side of the call it is evaluated.
+ */
+
+# include <map>
+# include "optimizer.h"
+
+using namespace std;
+
+struct Value {
+    string key;
+    Expression *expr;
+    Expression **slot;
+    Statement **anchor;
+    vector<Expression **> uses;
+};
+
+static thread_local vector<Value *> values, available;
+static thread_local Effects current;
+
+
+/*
+ * Function:	reusable
+ *
+ * Description:	Return whether an available value may replace an
+ *		expression in the current statement.
+ */
+
+static bool reusable(const Value *value)
+{
+    return !current.calls || invariant(value->expr, current);
+}
+
+
+/*
+ * Function:	hoistable
+ *
+ * Description:	Return whether an expression may be computed just
+ *		before the current statement instead.
+ */
+
+static bool hoistable(Expression *expr)
+{
+    return !current.calls || (invariant(expr, current) && !traps(expr));
+}
+
+
+/*
+ * Function:	scan
+ *
+ * Description:	Scan an expression of the current statement, replacing
+ *		the largest available subexpressions and making available
+ *		those computed for the first time.  The right operand of
+ *		a logical expression is evaluated only conditionally, and
+ *		so may reuse a value but not make one available.
+ */
+
+static void scan(Expression **slot, Statement **anchor, bool certain)
+{
+    Expression *expr = *slot;
+    vector<Expression **> exprs;
+    bool candidate, logical;
+    Value *value;
+    string name;
+
+
+    if (dynamic_cast<Address *>(expr) != nullptr) {
+	expr = *operand(expr);
+
+	if (dynamic_cast<Dereference *>(expr) != nullptr)
+	    scan(operand(expr), anchor, certain);
+
+	return;
+    }
+
+    if (dynamic_cast<Call *>(expr) || dynamic_cast<Inline *>(expr))
+	candidate = false;
+    else
+	candidate = !trivial(expr) && expr->type().isScalar();
+
+    if (candidate) {
+	name = key(expr);
+
+	for (unsigned i = 0; i < available.size(); i ++)
+	    if (available[i]->key == name) {
+		if (reusable(available[i])) {
+		    available[i]->uses.push_back(slot);
+		    return;
+		}
+
+		candidate = false;
+		break;
+	    }
+    }
+
+    expr->operands(exprs);
+    logical = dynamic_cast<LogicalAnd *>(expr) || dynamic_cast<LogicalOr *>(expr);
+
+    for (unsigned i = 0; i < exprs.size(); i ++) {
+	if (dynamic_cast<Call *>(*exprs[i]) || dynamic_cast<Inline *>(*exprs[i]))
+	    candidate = false;
+
+	scan(exprs[i], anchor, certain && !(logical && i > 0));
+    }
+
+    if (candidate && certain && hoistable(expr)) {
+	value = new Value();
+	value->key = name;
+	value->expr = expr;
+	value->slot = slot;
+	value->anchor = anchor;
+	values.push_back(value);
+	available.push_back(value);
+    }
+}
+
+
+/*
+ * Function:	kill
+ *
+ * Description:	Remove from the available values any that a statement
+ *		might change.
+ */
+
+static void kill(Statement *stmt)
+{
+    vector<Value *> survivors;
+    Effects writes;
+
+
+    effects(stmt, writes);
+
+    for (unsigned i = 0; i < available.size(); i ++)
+	if (invariant(available[i]->expr, writes))
+	    survivors.push_back(available[i]);
+
+    available = survivors;
+}
+
+
+/*
+ * Function:	evaluate (statement)
+ *
+ * Description:	Scan the expressions of a simple statement.  The left
+ *		side of an assignment is not read, but its address is
+ *		computed.
+ */
+
+static void evaluate(Statement **slot)
+{
+    vector<Expression **> exprs;
+    Expression *left;
+
+
+    current = Effects();
+    effects(*slot, current);
+    (*slot)->operands(exprs);
+
+    if (dynamic_cast<Assignment *>(*slot) != nullptr) {
+	left = *exprs[0];
+	exprs.erase(exprs.begin());
+
+	if (dynamic_cast<Dereference *>(left) != nullptr)
+	    scan(operand(left), slot, true);
+    }
+
+    for (unsigned i = 0; i < exprs.size(); i ++)
+	scan(exprs[i], slot, true);
+}
+
+
+/*
+ * Function:	evaluate (test)
+ *
+ * Description:	Scan the test of the statement in the given slot.
+ */
+
+static void evaluate(Expression **test, Statement **slot, bool certain)
+{
+    current = Effects();
+    effects(*test, current);
+    scan(test, slot, certain);
+}
+
+
+/*
+ * Function:	visit
+ *
+ * Description:	Walk a statement in the order its parts run, reusing and
+ *		making available the values of its expressions.
+ */
+
+static void visit(Statement **slot)
+{
+    Statement *stmt = *slot;
+    vector<Statement **> stmts;
+    vector<Value *> saved;
+
+
+    stmt->substatements(stmts);
+
+    if (dynamic_cast<Block *>(stmt) != nullptr) {
+	for (unsigned i = 0; i < stmts.size(); i ++)
+	    visit(stmts[i]);
+
+    } else if (dynamic_cast<If *>(stmt) != nullptr) {
+	evaluate(operand(stmt), slot, true);
+	kill(*operand(stmt));
+	saved = available;
+
+	for (unsigned i = 0; i < stmts.size(); i ++) {
+	    available = saved;
+	    visit(stmts[i]);
+	}
+
+	available = saved;
+
+	for (unsigned i = 0; i < stmts.size(); i ++)
+	    kill(*stmts[i]);
+
+    } else if (dynamic_cast<While *>(stmt) || dynamic_cast<For *>(stmt)) {
+	if (dynamic_cast<For *>(stmt) != nullptr)
+	    visit(stmts[0]);
+
+	kill(stmt);
+	saved = available;
+	evaluate(operand(stmt), slot, false);
+
+	if (dynamic_cast<For *>(stmt) != nullptr) {
+	    visit(stmts[2]);
+	    visit(stmts[1]);
+	} else
+	    visit(stmts[0]);
+
+	available = saved;
+
+    } else {
+	evaluate(slot);
+	kill(stmt);
+    }
+}
+
+
+/*
+ * Function:	eliminateSubexpressions
+ *
+ * Description:	Eliminate the common subexpressions of a function.  Each
+ *		value reused is computed into a temporary declared in the
+ *		outermost block of the function, since it may be read in
+ *		statements after the block that sets it.
+ */
+
+void eliminateSubexpressions(Function *function)
+{
+    map<Statement **, Statements> assigns;
+    map<Statement **, Statements>::iterator it;
+    vector<Statement **> stmts;
+    Symbol *symbol;
+    Value *value;
+
+
+    values.clear();
+    available.clear();
+    function->body()->substatements(stmts);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	visit(stmts[i]);
+
+    for (unsigned i = 0; i < values.size(); i ++) {
+	value = values[i];
+
+	if (!value->uses.empty()) {
+	    symbol = temporary(function->body()->declarations(), value->expr->type());
+	    assigns[value->anchor].push_back(new Assignment(new Identifier(symbol), value->expr));
+	    *value->slot = new Identifier(symbol);
+
+	    for (unsigned j = 0; j < value->uses.size(); j ++)
+		*value->uses[j] = new Identifier(symbol);
+	}
+
+	delete value;
+    }
+
+    for (it = assigns.begin(); it != assigns.end(); it ++) {
+	it->second.push_back(*it->first);
+	*it->first = new Block(new Scope(), it->second);
+    }
+
+    values.clear();
+    available.clear();
+}
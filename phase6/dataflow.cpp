@@ -0,0 +1,417 @@
+/*
+ * File:	dataflow.cpp
+ *
+ * Description:	This file contains the function definitions for
+ *		propagating copies and eliminating dead stores.
+ *
+ *		Both work only on local variables whose address is never
+ *		taken, which can be read and written only by name, and
+ *		both follow the flow of control through the nesting of
+ *		the statements, since Simple C has no goto, break, or
+ *		continue.
+ *
+ *		After an assignment x = y, where y is another such
+ *		variable or a constant, each read of x that the assignment
+ *		reaches is replaced by y, until either is assigned again.
+ *		A copy reaches a branch of an if statement or the body of
+ *		a loop only if neither is assigned in the statement, and
+ *		a copy of a variable declared in a block, such as a
+ *		temporary of another pass, does not reach past the block.
+ *
+ *		A variable is live if its value may be read before it is
+ *		assigned again, and an assignment to one that is dead
+ *		afterwards is removed, since the variable dies with the
+ *		function.  Liveness flows backwards, so the variables
+ *		live at the top of a loop are found by iterating over its
+ *		body until they no longer change.  An assignment whose
+ *		right side calls a function is replaced by the call.
+ */
+
+# include <map>
+# include "optimizer.h"
+# include "inliner.h"
+
+using namespace std;
+
+static thread_local map<const Symbol *, Expression *> copies;
+static thread_local set<const Symbol *> live;
+static thread_local bool removing;
+
+
+/*
+ * Function:	candidate
+ *
+ * Description:	Return whether a variable is one we can follow, being a
+ *		local scalar whose address is never taken.
+ */
+
+static bool candidate(const Symbol *symbol)
+{
+    return !addressed(symbol) && symbol->type().isScalar();
+}
+
+
+/*
+ * Function:	target
+ *
+ * Description:	Return the variable assigned by name by a statement, if
+ *		it is one we can follow.
+ */
+
+static const Symbol *target(Statement *stmt)
+{
+    Identifier *id;
+
+
+    if (dynamic_cast<Assignment *>(stmt) == nullptr)
+	return nullptr;
+
+    if ((id = dynamic_cast<Identifier *>(*operand(stmt))) == nullptr)
+	return nullptr;
+
+    return candidate(id->symbol()) ? id->symbol() : nullptr;
+}
+
+
+/*
+ * Function:	copyable
+ *
+ * Description:	Return whether an expression may be read in place of a
+ *		variable that was assigned its value, being a constant or
+ *		a variable we can follow.
+ */
+
+static bool copyable(Expression *expr)
+{
+    Identifier *id;
+
+
+    if (dynamic_cast<Number *>(expr) != nullptr)
+	return true;
+
+    if ((id = dynamic_cast<Identifier *>(expr)) != nullptr)
+	return candidate(id->symbol());
+
+    if (dynamic_cast<Address *>(expr) != nullptr)
+	return dynamic_cast<Identifier *>(*operand(expr)) != nullptr;
+
+    return false;
+}
+
+
+/*
+ * Function:	substitute
+ *
+ * Description:	Replace the reads of copied variables in an expression.
+ */
+
+static void substitute(Expression **slot)
+{
+    map<const Symbol *, Expression *>::iterator it;
+    vector<Expression **> exprs;
+    Renaming renaming;
+    Identifier *id;
+
+
+    if ((id = dynamic_cast<Identifier *>(*slot)) != nullptr) {
+	if ((it = copies.find(id->symbol())) != copies.end())
+	    *slot = it->second->clone(renaming);
+
+	return;
+    }
+
+    if (dynamic_cast<Address *>(*slot) != nullptr)
+	return;
+
+    (*slot)->operands(exprs);
+
+    for (unsigned i = 0; i < exprs.size(); i ++)
+	substitute(exprs[i]);
+}
+
+
+/*
+ * Function:	kill
+ *
+ * Description:	Forget the copies that a statement might invalidate, by
+ *		assigning either variable.
+ */
+
+static void kill(Statement *stmt)
+{
+    map<const Symbol *, Expression *>::iterator it;
+    Effects writes;
+    Identifier *id;
+
+
+    effects(stmt, writes);
+
+    for (it = copies.begin(); it != copies.end(); )
+	if (writes.assigned.count(it->first) > 0)
+	    copies.erase(it ++);
+	else if ((id = dynamic_cast<Identifier *>(it->second)) && writes.assigned.count(id->symbol()) > 0)
+	    copies.erase(it ++);
+	else
+	    it ++;
+}
+
+
+/*
+ * Function:	leave
+ *
+ * Description:	Forget the copies of or into the variables a block
+ *		declares, since they die with it and their storage may be
+ *		reused by the statements after it.
+ */
+
+static void leave(Block *block)
+{
+    map<const Symbol *, Expression *>::iterator it;
+    const Symbols &symbols = block->declarations()->symbols();
+    bool dead;
+
+
+    for (it = copies.begin(); it != copies.end(); ) {
+	dead = false;
+
+	for (unsigned i = 0; i < symbols.size() && !dead; i ++)
+	    if (it->first == symbols[i] || names(it->second, symbols[i]))
+		dead = true;
+
+	if (dead)
+	    copies.erase(it ++);
+	else
+	    it ++;
+    }
+}
+
+
+/*
+ * Function:	propagate
+ *
+ * Description:	Propagate copies through a statement, walking its parts
+ *		in the order they run.
+ */
+
+static void propagate(Statement *stmt)
+{
+    map<const Symbol *, Expression *> saved;
+    vector<Expression **> exprs;
+    vector<Statement **> stmts;
+    const Symbol *symbol;
+
+
+    stmt->operands(exprs);
+    stmt->substatements(stmts);
+
+    if (dynamic_cast<Block *>(stmt) != nullptr) {
+	for (unsigned i = 0; i < stmts.size(); i ++)
+	    propagate(*stmts[i]);
+
+	leave(static_cast<Block *>(stmt));
+
+    } else if (dynamic_cast<If *>(stmt) != nullptr) {
+	substitute(exprs[0]);
+	kill(stmt);
+	saved = copies;
+
+	for (unsigned i = 0; i < stmts.size(); i ++) {
+	    copies = saved;
+	    propagate(*stmts[i]);
+	}
+
+	copies = saved;
+
+    } else if (dynamic_cast<While *>(stmt) || dynamic_cast<For *>(stmt)) {
+	if (dynamic_cast<For *>(stmt) != nullptr)
+	    propagate(*stmts[0]);
+
+	kill(stmt);
+	saved = copies;
+	substitute(exprs[0]);
+
+	if (dynamic_cast<For *>(stmt) != nullptr) {
+	    propagate(*stmts[2]);
+	    propagate(*stmts[1]);
+	} else
+	    propagate(*stmts[0]);
+
+	copies = saved;
+
+    } else {
+	symbol = target(stmt);
+
+	for (unsigned i = (symbol != nullptr ? 1 : 0); i < exprs.size(); i ++)
+	    substitute(exprs[i]);
+
+	kill(stmt);
+
+	if (symbol != nullptr && copyable(*exprs[1]) && !names(*exprs[1], symbol))
+	    if ((*exprs[1])->type() == symbol->type())
+		copies[symbol] = *exprs[1];
+    }
+}
+
+
+/*
+ * Function:	reads
+ *
+ * Description:	Add to the live variables those read by an expression.
+ */
+
+static void reads(Expression *expr)
+{
+    vector<Expression **> exprs;
+    Identifier *id;
+
+
+    if ((id = dynamic_cast<Identifier *>(expr)) != nullptr) {
+	if (candidate(id->symbol()))
+	    live.insert(id->symbol());
+
+	return;
+    }
+
+    expr->operands(exprs);
+
+    for (unsigned i = 0; i < exprs.size(); i ++)
+	reads(*exprs[i]);
+}
+
+
+/*
+ * Function:	sweep
+ *
+ * Description:	Remove the dead stores in a statement, walking its parts
+ *		backwards from the variables live after it, and leaving
+ *		those live before it.  Nothing is removed unless we are
+ *		removing, so that the body of a loop can be walked until
+ *		the variables live at its top are known.
+ */
+
+static void sweep(Statement **slot)
+{
+    Statement *stmt = *slot;
+    vector<Expression **> exprs;
+    vector<Statement **> stmts;
+    set<const Symbol *> after, header, before;
+    const Symbol *symbol;
+    Effects calls;
+    bool outer;
+
+
+    stmt->operands(exprs);
+    stmt->substatements(stmts);
+
+    if (dynamic_cast<Block *>(stmt) != nullptr) {
+	for (unsigned i = stmts.size(); i > 0; i --)
+	    sweep(stmts[i - 1]);
+
+    } else if (dynamic_cast<If *>(stmt) != nullptr) {
+	after = live;
+
+	if (stmts.size() == 1)
+	    before = after;
+
+	for (unsigned i = 0; i < stmts.size(); i ++) {
+	    live = after;
+	    sweep(stmts[i]);
+	    before.insert(live.begin(), live.end());
+	}
+
+	live = before;
+	reads(*exprs[0]);
+
+    } else if (dynamic_cast<While *>(stmt) || dynamic_cast<For *>(stmt)) {
+	after = live;
+	outer = removing;
+	removing = false;
+	reads(*exprs[0]);
+
+	do {
+	    header = live;
+
+	    if (dynamic_cast<For *>(stmt) != nullptr)
+		sweep(stmts[1]);
+
+	    sweep(stmts.back());
+	    live.insert(after.begin(), after.end());
+	    reads(*exprs[0]);
+	} while (live != header);
+
+	removing = outer;
+
+	if (dynamic_cast<For *>(stmt) != nullptr)
+	    sweep(stmts[1]);
+
+	sweep(stmts.back());
+	live = header;
+
+	if (dynamic_cast<For *>(stmt) != nullptr)
+	    sweep(stmts[0]);
+
+    } else if (dynamic_cast<Return *>(stmt) != nullptr) {
+	live.clear();
+	reads(*exprs[0]);
+
+    } else if ((symbol = target(stmt)) != nullptr && live.count(symbol) == 0) {
+	effects(*exprs[1], calls);
+
+	if (!calls.calls) {
+	    if (removing)
+		*slot = new Block(new Scope(), Statements());
+
+	} else if (dynamic_cast<Call *>(*exprs[1]) || dynamic_cast<Inline *>(*exprs[1])) {
+	    if (removing)
+		*slot = *exprs[1];
+
+	    reads(*exprs[1]);
+
+	} else
+	    reads(*exprs[1]);
+
+    } else {
+	if (symbol != nullptr)
+	    live.erase(symbol);
+
+	for (unsigned i = (symbol != nullptr ? 1 : 0); i < exprs.size(); i ++)
+	    reads(*exprs[i]);
+    }
+}
+
+
+/*
+ * Function:	propagateCopies
+ *
+ * Description:	Propagate the copies in a function.
+ */
+
+void propagateCopies(Function *function)
+{
+    copies.clear();
+    propagate(function->body());
+    copies.clear();
+}
+
+
+/*
+ * Function:	eliminateDeadStores
+ *
+ * Description:	Remove the dead stores in a function.  No variable is
+ *		live when it returns.
+ */
+
+void eliminateDeadStores(Function *function)
+{
+    vector<Statement **> stmts;
+
+
+    live.clear();
+    removing = true;
+    function->body()->substatements(stmts);
+
+    for (unsigned i = stmts.size(); i > 0; i --)
+	sweep(stmts[i - 1]);
+
+    live.clear();
+}
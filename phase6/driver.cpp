@@ -0,0 +1,244 @@
+/*
+ * File:	driver.cpp
+ *
+ * Description:	This file contains the main function for the Simple C
+ *		compiler, which interprets the command line.  By default,
+ *		a single program is read from the standard input and its
+ *		assembly written to the standard output.  With -c, an
+ *		ELF object file is written instead.  With --run, the
+ *		program is compiled and run in memory.  With --interpret,
+ *		the program is lowered into bytecode and interpreted.
+ *		With --emit-c, the program is translated into C for the
+ *		C compiler of the host instead.  Code is generated for
+ *		the i386 unless -m64 selects x86-64.  Calls to small
+ *		leaf functions are inlined unless --inline-limit is zero,
+ *		and --inline-report lists each call that was.  Frame
+ *		pointers are omitted unless -fno-omit-frame-pointer keeps
+ *		them for profilers that walk the stack.  Each pass of the
+ *		optimizer, such as licm, may be disabled with -fno-licm,
+ *		--unroll-factor sets how many copies of the body of a
+ *		loop are made when it is unrolled, --tile-size sets how
+ *		many iterations of each loop of a nest are run in a tile,
+ *		and --specialize-budget sets how large the copies of the
+ *		functions a function calls that are specialized for its
+ *		constant arguments may be in all.
+ *
+ *		usage: scc [options] [--batch file ... | @listfile ...]
+ *		       scc [options] --run file
+ *		       scc [options] --interpret file
+ *		       scc [options] --server socket
+ *		       scc --client socket
+ *
+ *		options: -c, -m32, -m64, -j jobs, --cache-dir dir, --cache-stats,
+ *			 --emit-c, --inline-limit n, --inline-report,
+ *			 -fomit-frame-pointer, -fno-omit-frame-pointer,
+ *			 -fpass, -fno-pass, --unroll-factor n, --tile-size n,
+ *			 --specialize-budget n
+ */
+
+# include <cerrno>
+# include <cstdlib>
+# include <cstring>
+# include <string>
+# include <vector>
+# include <fstream>
+# include <iostream>
+# include "parser.h"
+# include "cache.h"
+# include "inliner.h"
+# include "optimizer.h"
+# include "generator.h"
+# include "batch.h"
+# include "server.h"
+# include "jit.h"
+# include "vm.h"
+# include "machine.h"
+
+using namespace std;
+
+# define MAXJOBS 256
+# define MAXINLINE 1000
+# define MAXUNROLL 64
+# define MAXTILE 4096
+# define MAXBUDGET 100000
+
+
+/*
+ * Function:	usage
+ *
+ * Description:	Report the correct usage of the compiler and exit.
+ */
+
+static void usage()
+{
+    cerr << "usage: scc [options] [--batch file ... | @listfile ...]" << endl;
+    cerr << "       scc [options] --run file" << endl;
+    cerr << "       scc [options] --interpret file" << endl;
+    cerr << "       scc [options] --server socket" << endl;
+    cerr << "       scc --client socket" << endl;
+    cerr << "options: -c, -m32, -m64, -j jobs, --cache-dir dir, --cache-stats," << endl;
+    cerr << "         --emit-c, --inline-limit n, --inline-report," << endl;
+    cerr << "         -fomit-frame-pointer, -fno-omit-frame-pointer," << endl;
+    cerr << "         -fpass, -fno-pass, --unroll-factor n, --tile-size n," << endl;
+    cerr << "         --specialize-budget n" << endl;
+    exit(EXIT_FAILURE);
+}
+
+
+/*
+ * Function:	number
+ *
+ * Description:	Return the value of the numeric argument of an option,
+ *		reporting the correct usage if it is not a number from low
+ *		to high.
+ */
+
+static unsigned number(const char *arg, long low, long high)
+{
+    char *end;
+    long value;
+
+
+    errno = 0;
+    value = strtol(arg, &end, 10);
+
+    if (errno != 0 || end == arg || *end != '\0' || value < low || value > high)
+	usage();
+
+    return value;
+}
+
+
+/*
+ * Function:	main
+ *
+ * Description:	Interpret the command line and compile accordingly.
+ */
+
+int main(int argc, char *argv[])
+{
+    vector<string> files;
+    string server, client, cache, program;
+    unsigned jobs = 0;
+    bool batch = false, stats = false, object = false, machine = false;
+    bool interpreted = false, source = false;
+    int i, status;
+
+
+    for (i = 1; i < argc; i ++) {
+	if (strcmp(argv[i], "--batch") == 0)
+	    batch = true;
+
+	else if (strcmp(argv[i], "--server") == 0 && i + 1 < argc)
+	    server = argv[++ i];
+
+	else if (strcmp(argv[i], "--client") == 0 && i + 1 < argc)
+	    client = argv[++ i];
+
+	else if (strcmp(argv[i], "--run") == 0 && i + 1 < argc)
+	    program = argv[++ i];
+
+	else if (strcmp(argv[i], "--interpret") == 0 && i + 1 < argc) {
+	    program = argv[++ i];
+	    interpreted = true;
+
+	}
+	else if (strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc)
+	    cache = argv[++ i];
+
+	else if (strcmp(argv[i], "--cache-stats") == 0)
+	    stats = true;
+
+	else if (strcmp(argv[i], "-c") == 0)
+	    object = true;
+
+	else if (strcmp(argv[i], "--emit-c") == 0)
+	    source = true;
+
+	else if (strcmp(argv[i], "-m32") == 0)
+	    machine = selectTarget("i386");
+
+	else if (strcmp(argv[i], "-m64") == 0)
+	    machine = selectTarget("x86-64");
+
+	else if (strcmp(argv[i], "--inline-limit") == 0 && i + 1 < argc)
+	    inlineThreshold = number(argv[++ i], 0, MAXINLINE);
+
+	else if (strcmp(argv[i], "--inline-report") == 0)
+	    inlineReport = true;
+
+	else if (strcmp(argv[i], "-fomit-frame-pointer") == 0)
+	    omitFramePointer = true;
+
+	else if (strcmp(argv[i], "-fno-omit-frame-pointer") == 0)
+	    omitFramePointer = false;
+
+	else if (strncmp(argv[i], "-f", 2) == 0 && optimization(argv[i] + 2))
+	    continue;
+
+	else if (strcmp(argv[i], "--unroll-factor") == 0 && i + 1 < argc)
+	    unrollFactor = number(argv[++ i], 1, MAXUNROLL);
+
+	else if (strcmp(argv[i], "--tile-size") == 0 && i + 1 < argc)
+	    tileSize = number(argv[++ i], 1, MAXTILE);
+
+	else if (strcmp(argv[i], "--specialize-budget") == 0 && i + 1 < argc)
+	    specializeBudget = number(argv[++ i], 0, MAXBUDGET);
+
+	else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+	    jobs = number(argv[++ i], 1, MAXJOBS);
+
+	else if (argv[i][0] == '-')
+	    usage();
+
+	else
+	    files.push_back(argv[i]);
+    }
+
+    if (!batch && !files.empty())
+	usage();
+
+    if (source && (batch || object || !program.empty()))
+	usage();
+
+    if ((!program.empty() || source) && !machine)
+	target = hostTarget();
+
+    if (!cache.empty() && !openCache(cache, string(target->name) + " inline " + to_string(inlineThreshold) +
+	    (omitFramePointer ? "" : " frame-pointer") + optimizations() +
+	    " unroll " + to_string(unrollFactor) + " tile " + to_string(tileSize) +
+	    " specialize " + to_string(specializeBudget)))
+	exit(EXIT_FAILURE);
+
+    if (batch)
+	status = compileBatch(files, jobs, object) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+    else if (!server.empty())
+	status = runServer(server, jobs);
+
+    else if (!client.empty())
+	status = runClient(client);
+
+    else if (!program.empty()) {
+	ifstream in(program.c_str());
+
+	if (!in) {
+	    cerr << "scc: cannot open " << program << endl;
+	    status = EXIT_FAILURE;
+
+	} else if (interpreted && interpret(in, cerr, status) > 0)
+	    status = EXIT_FAILURE;
+
+	else if (!interpreted && runProgram(in, cerr, status) > 0)
+	    status = EXIT_FAILURE;
+    }
+
+    else if (source)
+	status = translate(cin, cout, cerr) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+    else
+	status = compile(cin, cout, cerr, object) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+    closeCache(stats);
+    exit(status);
+}
@@ -0,0 +1,356 @@
+/*
+ * File:	elf.cpp
+ *
+ * Description:	This file contains the public and private function
+ *		definitions for writing object code as an ELF relocatable
+ *		file, which the system linker can link like any other
+ *		object file.  The class of the file, ELF32 for the i386 or
+ *		ELF64 for x86-64, follows the object being written.
+ *
+ *		The file is laid out as the header, followed by the
+ *		contents of each section, followed by the section header
+ *		table.  In addition to the sections of the object, we write
+ *		a relocation section for each section that needs one, the
+ *		symbol table with its string table, and an empty
+ *		.note.GNU-stack section so the linker doesn't give us an
+ *		executable stack.
+ *
+ *		Labels beginning with .L are local to the assembly and
+ *		don't appear in the symbol table.  A relocation against one
+ *		is made against its section instead.
+ *
+ *		The i386 uses REL relocations, which keep their addends in
+ *		the bytes being relocated, while x86-64 uses RELA
+ *		relocations, which keep them in the relocation itself.
+ */
+
+# include <elf.h>
+# include <cstring>
+# include <ostream>
+# include "elf.h"
+
+using namespace std;
+
+typedef vector<uint8_t> Bytes;
+
+struct ELF32 {
+    typedef Elf32_Ehdr Ehdr;
+    typedef Elf32_Shdr Shdr;
+    typedef Elf32_Sym Sym;
+    typedef Elf32_Rel Rel;
+
+    static const unsigned elfclass = ELFCLASS32, machine = EM_386;
+    static const unsigned type = SHT_REL, alignment = 4;
+
+    static void relocate(Bytes &buf, uint8_t *p, const Object::Relocation &r,
+	    const Object::Section &, bool, unsigned symbol, int32_t addend) {
+	Rel rel;
+
+	memcpy(p, &addend, sizeof(addend));
+	rel.r_offset = r.offset;
+	rel.r_info = ELF32_R_INFO(symbol,
+	    r.type == Object::RELATIVE32 ? R_386_PC32 : R_386_32);
+	buf.insert(buf.end(), (uint8_t *) &rel, (uint8_t *) (&rel + 1));
+    }
+};
+
+struct ELF64 {
+    typedef Elf64_Ehdr Ehdr;
+    typedef Elf64_Shdr Shdr;
+    typedef Elf64_Sym Sym;
+    typedef Elf64_Rela Rel;
+
+    static const unsigned elfclass = ELFCLASS64, machine = EM_X86_64;
+    static const unsigned type = SHT_RELA, alignment = 8;
+
+    static void relocate(Bytes &buf, uint8_t *p, const Object::Relocation &r,
+	    const Object::Section &section, bool undefined, unsigned symbol,
+	    int32_t addend) {
+	Rel rel;
+	unsigned type;
+
+	if (r.type == Object::RELATIVE32)
+	    type = undefined ? R_X86_64_PLT32 : R_X86_64_PC32;
+	else
+	    type = section.executable ? R_X86_64_32S : R_X86_64_32;
+
+	memset(p, 0, 4);
+	rel.r_offset = r.offset;
+	rel.r_info = ELF64_R_INFO(symbol, type);
+	rel.r_addend = addend;
+	buf.insert(buf.end(), (uint8_t *) &rel, (uint8_t *) (&rel + 1));
+    }
+};
+
+
+/*
+ * Function:	add
+ *
+ * Description:	Add a string to a string table and return its offset.
+ */
+
+static unsigned add(string &table, const string &s)
+{
+    unsigned offset = table.size();
+
+    table += s;
+    table += '\0';
+    return offset;
+}
+
+
+/*
+ * Function:	append
+ *
+ * Description:	Append the raw bytes of a value to a buffer.
+ */
+
+template<class T>
+static void append(Bytes &buf, const T &value)
+{
+    const uint8_t *p = (const uint8_t *) &value;
+    buf.insert(buf.end(), p, p + sizeof(value));
+}
+
+
+/*
+ * Function:	isLocalLabel
+ *
+ * Description:	Return whether the symbol is a local label.
+ */
+
+static bool isLocalLabel(const Object::Symbol &symbol)
+{
+    return symbol.name.compare(0, 2, ".L") == 0 && !symbol.global &&
+	symbol.section >= 0;
+}
+
+
+/*
+ * Function:	write
+ *
+ * Description:	Write the object as an ELF relocatable file of the class
+ *		given by E.
+ */
+
+template<class E>
+static void write(const Object &object, ostream &ostr)
+{
+    typedef typename E::Shdr Shdr;
+    unsigned nsections = object.sections.size();
+    vector<Shdr> headers;
+    vector<Bytes> contents;
+    vector<unsigned> index(object.symbols.size());
+    vector<Bytes> relocs(nsections);
+    Bytes symtab;
+    string strtab(1, '\0'), shstrtab(1, '\0');
+    unsigned nlocals, symtabIndex, first, offset;
+    Shdr shdr;
+    typename E::Sym sym;
+    typename E::Ehdr ehdr;
+
+
+    /* The section headers for the sections of the object come first, so
+       the index of each is one more than its index in the object. */
+
+    memset(&shdr, 0, sizeof(shdr));
+    headers.push_back(shdr);
+    contents.push_back(Bytes());
+
+    for (unsigned i = 0; i < nsections; i ++) {
+	const Object::Section &s = object.sections[i];
+
+	memset(&shdr, 0, sizeof(shdr));
+	shdr.sh_name = add(shstrtab, s.name);
+	shdr.sh_type = s.nobits ? SHT_NOBITS : SHT_PROGBITS;
+	shdr.sh_flags = SHF_ALLOC;
+	shdr.sh_flags |= s.writable ? SHF_WRITE : 0;
+	shdr.sh_flags |= s.executable ? SHF_EXECINSTR : 0;
+	shdr.sh_size = s.bytes.size();
+	shdr.sh_addralign = s.alignment;
+	headers.push_back(shdr);
+	contents.push_back(s.nobits ? Bytes() : s.bytes);
+    }
+
+    memset(&shdr, 0, sizeof(shdr));
+    shdr.sh_name = add(shstrtab, ".note.GNU-stack");
+    shdr.sh_type = SHT_PROGBITS;
+    shdr.sh_addralign = 1;
+    headers.push_back(shdr);
+    contents.push_back(Bytes());
+
+
+    /* The symbol table has the null symbol, a symbol for each section,
+       and any other local symbols, followed by the global symbols. */
+
+    memset(&sym, 0, sizeof(sym));
+    append(symtab, sym);
+
+    for (unsigned i = 0; i < nsections; i ++) {
+	memset(&sym, 0, sizeof(sym));
+	sym.st_info = ELF32_ST_INFO(STB_LOCAL, STT_SECTION);
+	sym.st_shndx = i + 1;
+	append(symtab, sym);
+    }
+
+    for (int pass = 0; pass < 2; pass ++) {
+	if (pass == 1)
+	    first = symtab.size() / sizeof(sym);
+
+	for (unsigned i = 0; i < object.symbols.size(); i ++) {
+	    const Object::Symbol &s = object.symbols[i];
+	    bool global = s.global || s.section == Object::UNDEFINED;
+
+	    if (isLocalLabel(s)) {
+		index[i] = s.section + 1;
+		continue;
+	    }
+
+	    if (global != (pass == 1))
+		continue;
+
+	    memset(&sym, 0, sizeof(sym));
+	    sym.st_name = add(strtab, s.name);
+	    sym.st_value = s.value;
+	    sym.st_size = s.size;
+	    sym.st_info = ELF32_ST_INFO(global ? STB_GLOBAL : STB_LOCAL, STT_NOTYPE);
+
+	    if (s.section == Object::UNDEFINED)
+		sym.st_shndx = SHN_UNDEF;
+
+	    else if (s.section == Object::COMMON) {
+		sym.st_shndx = SHN_COMMON;
+		sym.st_info = ELF32_ST_INFO(STB_GLOBAL, STT_OBJECT);
+
+	    } else if (s.section == Object::ABSOLUTE)
+		sym.st_shndx = SHN_ABS;
+
+	    else {
+		sym.st_shndx = s.section + 1;
+
+		if (object.sections[s.section].executable)
+		    sym.st_info = ELF32_ST_INFO(ELF32_ST_BIND(sym.st_info), STT_FUNC);
+	    }
+
+	    index[i] = symtab.size() / sizeof(sym);
+	    append(symtab, sym);
+	}
+    }
+
+    nlocals = first;
+
+
+    for (unsigned i = 0; i < object.relocations.size(); i ++) {
+	const Object::Relocation &r = object.relocations[i];
+	const Object::Symbol &s = object.symbols[r.symbol];
+	int32_t addend = r.addend;
+
+	if (isLocalLabel(s))
+	    addend += s.value;
+
+	E::relocate(relocs[r.section], &contents[r.section + 1][r.offset], r,
+	    object.sections[r.section], s.section == Object::UNDEFINED,
+	    index[r.symbol], addend);
+    }
+
+    symtabIndex = headers.size();
+
+    for (unsigned i = 0; i < nsections; i ++)
+	if (!relocs[i].empty())
+	    symtabIndex ++;
+
+    for (unsigned i = 0; i < nsections; i ++)
+	if (!relocs[i].empty()) {
+	    memset(&shdr, 0, sizeof(shdr));
+	    shdr.sh_name = add(shstrtab, (E::type == SHT_RELA ? ".rela" : ".rel") + object.sections[i].name);
+	    shdr.sh_type = E::type;
+	    shdr.sh_flags = SHF_INFO_LINK;
+	    shdr.sh_link = symtabIndex;
+	    shdr.sh_info = i + 1;
+	    shdr.sh_size = relocs[i].size();
+	    shdr.sh_addralign = E::alignment;
+	    shdr.sh_entsize = sizeof(typename E::Rel);
+	    headers.push_back(shdr);
+	    contents.push_back(relocs[i]);
+	}
+
+    memset(&shdr, 0, sizeof(shdr));
+    shdr.sh_name = add(shstrtab, ".symtab");
+    shdr.sh_type = SHT_SYMTAB;
+    shdr.sh_link = symtabIndex + 1;
+    shdr.sh_info = nlocals;
+    shdr.sh_size = symtab.size();
+    shdr.sh_addralign = E::alignment;
+    shdr.sh_entsize = sizeof(sym);
+    headers.push_back(shdr);
+    contents.push_back(symtab);
+
+    memset(&shdr, 0, sizeof(shdr));
+    shdr.sh_name = add(shstrtab, ".strtab");
+    shdr.sh_type = SHT_STRTAB;
+    shdr.sh_size = strtab.size();
+    shdr.sh_addralign = 1;
+    headers.push_back(shdr);
+    contents.push_back(Bytes(strtab.begin(), strtab.end()));
+
+    memset(&shdr, 0, sizeof(shdr));
+    shdr.sh_name = add(shstrtab, ".shstrtab");
+    shdr.sh_type = SHT_STRTAB;
+    shdr.sh_size = shstrtab.size();
+    shdr.sh_addralign = 1;
+    headers.push_back(shdr);
+    contents.push_back(Bytes(shstrtab.begin(), shstrtab.end()));
+
+
+    /* Now lay out the file and write it. */
+
+    Bytes file(sizeof(ehdr));
+
+    for (unsigned i = 1; i < headers.size(); i ++) {
+	offset = file.size();
+
+	if (headers[i].sh_addralign > 1)
+	    offset = (offset + headers[i].sh_addralign - 1) & ~(headers[i].sh_addralign - 1);
+
+	file.resize(offset);
+	headers[i].sh_offset = offset;
+	file.insert(file.end(), contents[i].begin(), contents[i].end());
+    }
+
+    file.resize((file.size() + E::alignment - 1) & ~(E::alignment - 1));
+
+    memset(&ehdr, 0, sizeof(ehdr));
+    memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+    ehdr.e_ident[EI_CLASS] = E::elfclass;
+    ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+    ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+    ehdr.e_type = ET_REL;
+    ehdr.e_machine = E::machine;
+    ehdr.e_version = EV_CURRENT;
+    ehdr.e_shoff = file.size();
+    ehdr.e_ehsize = sizeof(ehdr);
+    ehdr.e_shentsize = sizeof(shdr);
+    ehdr.e_shnum = headers.size();
+    ehdr.e_shstrndx = headers.size() - 1;
+    memcpy(&file[0], &ehdr, sizeof(ehdr));
+
+    for (unsigned i = 0; i < headers.size(); i ++)
+	append(file, headers[i]);
+
+    ostr.write((const char *) &file[0], file.size());
+}
+
+
+/*
+ * Function:	writeElf
+ *
+ * Description:	Write the object as an ELF relocatable file.
+ */
+
+void writeElf(const Object &object, ostream &ostr)
+{
+    if (object.bits == 64)
+	write<ELF64>(object, ostr);
+    else
+	write<ELF32>(object, ostr);
+}
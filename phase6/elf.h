@@ -0,0 +1,15 @@
+/*
+ * File:	elf.h
+ *
+ * Description:	This file contains the public function declarations for
+ *		writing object code as an ELF relocatable file.
+ */
+
+# ifndef ELF_H
+# define ELF_H
+# include <iosfwd>
+# include "Object.h"
+
+void writeElf(const Object &object, std::ostream &ostr);
+
+# endif /* ELF_H */
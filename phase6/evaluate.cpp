@@ -0,0 +1,578 @@
+/*
+ * File:	evaluate.cpp
+ *
+ * Description:	This file contains the function definitions for
+ *		evaluating calls to pure functions at compile time.
+ *
+ *		A call whose arguments are all constants is run by an
+ *		interpreter over the copy of the body of the function kept
+ *		before it was optimized, and replaced by the value it
+ *		returns.  The same is done for an inlined call, whose body
+ *		is run instead.  The function must be pure: it may read and
+ *		write only its own int variables, and call only
+ *		functions that are themselves pure and already defined.
+ *		Anything else, including reading a global or a variable
+ *		not yet assigned, taking an address, dereferencing a
+ *		pointer, calling a function of the C library, or falling
+ *		off the end of a function, makes the evaluation fail, and
+ *		the call is left alone.  Whether a function is pure is
+ *		decided once, from its whole body, as it is optimized, so
+ *		that the cache need keep only the bodies of pure functions.
+ *
+ *		Arithmetic wraps as it does in the generated code, and a
+ *		division by zero or one that overflows fails.
+ *		A single evaluation may take only so many steps and nest
+ *		only so many calls, so that a function that loops forever
+ *		or recurses too deeply fails instead of hanging or
+ *		exhausting the stack of the compiler.  The value of each
+ *		call is remembered for the rest of the translation unit,
+ *		as is a failure, but only of a call evaluated first, since
+ *		a call within it may fail just because the budget ran out.
+ */
+
+# include <map>
+# include <climits>
+# include "optimizer.h"
+# include "tokens.h"
+
+using namespace std;
+
+# define MAXSTEPS 1000000
+# define MAXCALLS 256
+
+typedef pair<const Symbol *, vector<long> > Key;
+
+struct Frame {
+    set<const Symbol *> declared;
+    map<const Symbol *, long> values;
+};
+
+struct Failure {};
+
+static thread_local map<Key, long> results;
+static thread_local set<Key> failures;
+static thread_local map<const Symbol *, bool> purities;
+static thread_local Frame *frame;
+static thread_local unsigned long steps;
+static thread_local unsigned calls;
+static thread_local long result;
+
+static long evaluate(Expression *expr);
+
+
+/*
+ * Function:	initEvaluations
+ *
+ * Description:	Forget the calls evaluated in the previous translation
+ *		unit.
+ */
+
+void initEvaluations()
+{
+    results.clear();
+    failures.clear();
+    purities.clear();
+}
+
+
+/*
+ * Function:	pure
+ *
+ * Description:	Return whether a function was found to be pure when it
+ *		was optimized.
+ */
+
+bool pure(const Symbol *id)
+{
+    map<const Symbol *, bool>::iterator it;
+
+
+    if ((it = purities.find(id)) == purities.end())
+	return false;
+
+    return it->second;
+}
+
+
+/*
+ * Function:	pure (statement)
+ *
+ * Description:	Return whether a statement is one we can run, naming only
+ *		the given variables and those it declares, and calling only
+ *		pure functions.
+ */
+
+static bool pure(Statement *stmt, set<const Symbol *> &declared)
+{
+    vector<Expression **> exprs;
+    vector<Statement **> stmts;
+    set<const Symbol *> locals;
+    Identifier *id;
+    Symbols symbols;
+
+
+    stmt->operands(exprs);
+    stmt->substatements(stmts);
+
+    if (dynamic_cast<Expression *>(stmt) != nullptr) {
+	if (static_cast<Expression *>(stmt)->type() != Type(INT))
+	    return false;
+
+	if ((id = dynamic_cast<Identifier *>(stmt)) != nullptr)
+	    return declared.count(id->symbol()) > 0;
+
+	if (dynamic_cast<Call *>(stmt) != nullptr) {
+	    if (!pure(static_cast<Call *>(stmt)->id()))
+		return false;
+
+	} else if (dynamic_cast<Inline *>(stmt) != nullptr) {
+	    if (!pure(static_cast<Inline *>(stmt)->body(), locals))
+		return false;
+
+	} else if (dynamic_cast<Dereference *>(stmt) || dynamic_cast<Address *>(stmt))
+	    return false;
+
+	else if (dynamic_cast<Promote *>(stmt) != nullptr)
+	    return false;
+
+    } else if (dynamic_cast<Block *>(stmt) != nullptr) {
+	symbols = static_cast<Block *>(stmt)->declarations()->symbols();
+	declared.insert(symbols.begin(), symbols.end());
+
+    } else if (dynamic_cast<Assignment *>(stmt) != nullptr) {
+	if (dynamic_cast<Identifier *>(*exprs[0]) == nullptr)
+	    return false;
+
+    } else if (!dynamic_cast<Return *>(stmt) && !dynamic_cast<If *>(stmt))
+	if (!dynamic_cast<While *>(stmt) && !dynamic_cast<For *>(stmt))
+	    return false;
+
+    for (unsigned i = 0; i < exprs.size(); i ++)
+	if (!pure(*exprs[i], declared))
+	    return false;
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	if (!pure(*stmts[i], declared))
+	    return false;
+
+    return true;
+}
+
+
+/*
+ * Function:	fail
+ *
+ * Description:	Abandon the evaluation.
+ */
+
+static void fail()
+{
+    throw Failure();
+}
+
+
+/*
+ * Function:	tick
+ *
+ * Description:	Take a step, failing if the evaluation has taken too many.
+ */
+
+static void tick()
+{
+    if (++ steps > MAXSTEPS)
+	fail();
+}
+
+
+/*
+ * Function:	convert
+ *
+ * Description:	Convert a value to a type, failing if it is not an int.
+ */
+
+static long convert(long value, const Type &type)
+{
+    if (type != Type(INT))
+	fail();
+
+    return (int) value;
+}
+
+
+/*
+ * Function:	arithmetic
+ *
+ * Description:	Compute a binary expression whose operands have the given
+ *		values, in unsigned arithmetic so that it wraps, or fail if
+ *		it is not one we evaluate or its value is undefined.
+ */
+
+static long arithmetic(Expression *expr, long left, long right)
+{
+    unsigned long l = left, r = right;
+
+
+    if (dynamic_cast<Add *>(expr) != nullptr)
+	return l + r;
+
+    if (dynamic_cast<Subtract *>(expr) != nullptr)
+	return l - r;
+
+    if (dynamic_cast<Multiply *>(expr) != nullptr)
+	return l * r;
+
+    if (dynamic_cast<Divide *>(expr) || dynamic_cast<Remainder *>(expr)) {
+	if (right == 0 || (left == INT_MIN && right == -1))
+	    fail();
+
+	return dynamic_cast<Divide *>(expr) ? left / right : left % right;
+    }
+
+    if (dynamic_cast<LessThan *>(expr) != nullptr)
+	return left < right;
+
+    if (dynamic_cast<GreaterThan *>(expr) != nullptr)
+	return left > right;
+
+    if (dynamic_cast<LessOrEqual *>(expr) != nullptr)
+	return left <= right;
+
+    if (dynamic_cast<GreaterOrEqual *>(expr) != nullptr)
+	return left >= right;
+
+    if (dynamic_cast<Equal *>(expr) != nullptr)
+	return left == right;
+
+    if (dynamic_cast<NotEqual *>(expr) != nullptr)
+	return left != right;
+
+    fail();
+    return 0;
+}
+
+
+/*
+ * Function:	execute
+ *
+ * Description:	Run a statement, returning true if it returns, in which
+ *		case the value is left in the result.
+ */
+
+static bool execute(Statement *stmt)
+{
+    vector<Expression **> exprs;
+    vector<Statement **> stmts;
+    Identifier *id;
+    Symbols symbols;
+
+
+    tick();
+    stmt->operands(exprs);
+    stmt->substatements(stmts);
+
+    if (dynamic_cast<Expression *>(stmt) != nullptr) {
+	evaluate(static_cast<Expression *>(stmt));
+	return false;
+    }
+
+    if (dynamic_cast<Block *>(stmt) != nullptr) {
+	symbols = static_cast<Block *>(stmt)->declarations()->symbols();
+	frame->declared.insert(symbols.begin(), symbols.end());
+
+	for (unsigned i = 0; i < stmts.size(); i ++)
+	    if (execute(*stmts[i]))
+		return true;
+
+	return false;
+    }
+
+    if (dynamic_cast<Assignment *>(stmt) != nullptr) {
+	if ((id = dynamic_cast<Identifier *>(*exprs[0])) == nullptr)
+	    fail();
+
+	if (frame->declared.count(id->symbol()) == 0)
+	    fail();
+
+	frame->values[id->symbol()] = convert(evaluate(*exprs[1]), id->type());
+	return false;
+    }
+
+    if (dynamic_cast<Return *>(stmt) != nullptr) {
+	result = evaluate(*exprs[0]);
+	return true;
+    }
+
+    if (dynamic_cast<If *>(stmt) != nullptr) {
+	if (evaluate(*exprs[0]))
+	    return execute(*stmts[0]);
+
+	return stmts.size() > 1 && execute(*stmts[1]);
+    }
+
+    if (dynamic_cast<While *>(stmt) != nullptr) {
+	while (evaluate(*exprs[0]))
+	    if (execute(*stmts[0]))
+		return true;
+
+	return false;
+    }
+
+    if (dynamic_cast<For *>(stmt) != nullptr) {
+	if (execute(*stmts[0]))
+	    return true;
+
+	while (evaluate(*exprs[0])) {
+	    if (execute(*stmts[2]) || execute(*stmts[1]))
+		return true;
+	}
+
+	return false;
+    }
+
+    fail();
+    return false;
+}
+
+
+/*
+ * Function:	run
+ *
+ * Description:	Run a body with its parameters, the first variables it
+ *		declares, set to the given values, and return the value it
+ *		returns, converted to the given type.
+ */
+
+static long run(Block *body, const vector<long> &args, const Type &type)
+{
+    Symbols symbols = body->declarations()->symbols();
+    Frame *saved = frame;
+    Frame callee;
+    long value;
+
+
+    if (args.size() > symbols.size() || ++ calls > MAXCALLS)
+	fail();
+
+    for (unsigned i = 0; i < args.size(); i ++)
+	callee.values[symbols[i]] = convert(args[i], symbols[i]->type());
+
+    frame = &callee;
+
+    if (!execute(body))
+	fail();
+
+    value = convert(result, type);
+    frame = saved;
+    calls --;
+    return value;
+}
+
+
+/*
+ * Function:	invoke
+ *
+ * Description:	Return the value of a call to a function with the given
+ *		arguments, evaluating the call if it is new.  The value is
+ *		remembered only once the call returns, so that a call
+ *		abandoned when the budget runs out leaves nothing behind.
+ */
+
+static long invoke(const Symbol *id, const vector<long> &args, const Type &type)
+{
+    map<Key, long>::iterator it;
+    Key key(id, args);
+    long value;
+
+
+    if ((it = results.find(key)) != results.end())
+	return it->second;
+
+    if (failures.count(key) > 0 || !pure(id))
+	fail();
+
+    if (args.size() != id->type().parameters()->size())
+	fail();
+
+    value = run(original(id)->body(), args, type);
+    results[key] = value;
+    return value;
+}
+
+
+/*
+ * Function:	evaluate
+ *
+ * Description:	Return the value of an expression.  The right operand of
+ *		a logical expression is evaluated only if the left does not
+ *		decide it.
+ */
+
+static long evaluate(Expression *expr)
+{
+    vector<Expression **> exprs;
+    vector<long> args;
+    Identifier *id;
+    Inline *body;
+    Call *call;
+    long value;
+
+
+    tick();
+
+    if (expr->type() != Type(INT))
+	fail();
+
+    if (dynamic_cast<Number *>(expr) != nullptr) {
+	expr->constant(value);
+	return value;
+    }
+
+    if ((id = dynamic_cast<Identifier *>(expr)) != nullptr) {
+	if (frame->values.count(id->symbol()) == 0)
+	    fail();
+
+	return frame->values[id->symbol()];
+    }
+
+    expr->operands(exprs);
+
+    if ((call = dynamic_cast<Call *>(expr)) != nullptr) {
+	for (unsigned i = 0; i < exprs.size(); i ++)
+	    args.push_back(evaluate(*exprs[i]));
+
+	return invoke(call->id(), args, expr->type());
+    }
+
+    if ((body = dynamic_cast<Inline *>(expr)) != nullptr) {
+	for (unsigned i = 0; i < exprs.size(); i ++)
+	    args.push_back(evaluate(*exprs[i]));
+
+	return run(body->body(), args, expr->type());
+    }
+
+    if (dynamic_cast<Not *>(expr) != nullptr)
+	return !evaluate(*exprs[0]);
+
+    if (dynamic_cast<Negate *>(expr) != nullptr)
+	return convert(- (unsigned long) evaluate(*exprs[0]), expr->type());
+
+    if (dynamic_cast<LogicalAnd *>(expr) != nullptr)
+	return evaluate(*exprs[0]) && evaluate(*exprs[1]);
+
+    if (dynamic_cast<LogicalOr *>(expr) != nullptr)
+	return evaluate(*exprs[0]) || evaluate(*exprs[1]);
+
+    if (exprs.size() != 2)
+	fail();
+
+    value = evaluate(*exprs[0]);
+    return convert(arithmetic(expr, value, evaluate(*exprs[1])), expr->type());
+}
+
+
+/*
+ * Function:	fold
+ *
+ * Description:	Evaluate a call or inlined call whose arguments are all
+ *		constants, returning false if it fails.
+ */
+
+static bool fold(Expression *expr, long &value)
+{
+    vector<Expression **> args;
+    Frame empty;
+    Key key;
+
+
+    expr->operands(args);
+
+    for (unsigned i = 0; i < args.size(); i ++) {
+	if (!(*args[i])->constant(value))
+	    return false;
+
+	key.second.push_back(value);
+    }
+
+    if (dynamic_cast<Call *>(expr) != nullptr) {
+	key.first = static_cast<Call *>(expr)->id();
+
+	if (failures.count(key) > 0)
+	    return false;
+    }
+
+    frame = &empty;
+    steps = 0;
+    calls = 0;
+
+    try {
+	if (key.first != nullptr)
+	    value = invoke(key.first, key.second, expr->type());
+	else
+	    value = run(static_cast<Inline *>(expr)->body(), key.second, expr->type());
+
+    } catch (const Failure &) {
+	if (key.first != nullptr)
+	    failures.insert(key);
+
+	return false;
+    }
+
+    return true;
+}
+
+
+/*
+ * Function:	visit
+ *
+ * Description:	Replace the calls in a statement that evaluate to int
+ *		constants, innermost first, so that a call whose arguments
+ *		are such calls may be evaluated too.
+ */
+
+static void visit(Statement *stmt)
+{
+    vector<Expression **> exprs;
+    vector<Statement **> stmts;
+    Expression *expr;
+    long value;
+
+
+    stmt->operands(exprs);
+    stmt->substatements(stmts);
+
+    for (unsigned i = 0; i < exprs.size(); i ++) {
+	visit(*exprs[i]);
+	expr = *exprs[i];
+
+	if (dynamic_cast<Call *>(expr) || dynamic_cast<Inline *>(expr))
+	    if (expr->type() == Type(INT) && fold(expr, value))
+		*exprs[i] = number(value);
+    }
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	visit(*stmts[i]);
+}
+
+
+/*
+ * Function:	evaluateCalls
+ *
+ * Description:	Decide whether a function is pure, supposing at first
+ *		that it is in case it calls itself, and replace the calls in
+ *		it to pure functions with constant arguments by the values
+ *		they return.
+ */
+
+void evaluateCalls(Function *function)
+{
+    const Symbol *id = function->id();
+    set<const Symbol *> declared;
+
+
+    if (original(id) != nullptr) {
+	purities[id] = true;
+	purities[id] = pure(original(id)->body(), declared);
+    }
+
+    visit(function->body());
+}
@@ -0,0 +1,41 @@
+/* copies.c */
+
+int g0, g1;
+
+int last(int t)
+{
+    int i, s, u, loc[8];
+
+    s = 0;
+    u = 0;
+
+    for (i = 2; i < 3; i = i + 2) {
+	s = s + (i + (3 + i));
+	u = t + t;
+	loc[i] = u + t;
+    }
+
+    for (i = 0; i < 8; i = i + 1)
+	loc[i] = i * s;
+
+    for (i = 0; i < 8; i = i + 1)
+	s = s + loc[i];
+
+    return u + s;
+}
+
+int main(void)
+{
+    int i, j, b, y;
+
+    b = 5;
+    y = 2;
+    g1 = 0;
+
+    for (i = 0; i < 10; i = i + 3)
+	for (j = 0; j < 13; j = j + 2)
+	    g0 = !(!g1 - (b - y));
+
+    printf("%d\n", g0);
+    printf("%d\n", last(g1 + 3));
+}
@@ -0,0 +1,29 @@
+/* depth.c */
+
+/*
+ * return the depth of a recursion, too deep to be evaluated when
+ * compiled, after calls whose values may be evaluated
+ */
+
+int depth(int n)
+{
+    if (n == 0) return 0;
+    return 1 + depth(n - 1);
+}
+
+
+int sum(int n, int s)
+{
+    if (n == 0) return s;
+    return sum(n - 1, s + n);
+}
+
+
+int main(void)
+{
+    printf("%d\n", depth(300));
+    printf("%d\n", depth(299));
+    printf("%d\n", depth(100));
+    printf("%d\n", sum(256, 0));
+    printf("%d\n", sum(300, 0));
+}
@@ -0,0 +1,70 @@
+/* fold.c */
+
+/*
+ * call functions with constants that decide which of their statements
+ * are run, as well as with values known only at run time, and print
+ * the results
+ */
+
+int apply(int kind, int x, int y)
+{
+    int i, s;
+
+    s = 0;
+
+    if (kind == 0) {
+	for (i = 0; i < y; i = i + 1)
+	    s = s + x;
+    } else if (kind == 1) {
+	s = x;
+
+	for (i = 0; i < y; i = i + 1)
+	    s = s * 3 % 10007;
+    } else if (kind == 2)
+	s = x / y - x % y;
+    else
+	s = -x;
+
+    return s;
+}
+
+
+int power(int x, int n)
+{
+    if (n == 0)
+	return 1;
+
+    if (n % 2 == 1)
+	return x * power(x, n - 1) % 10007;
+
+    return power(x * x % 10007, n / 2);
+}
+
+
+int bump(int n, int k)
+{
+    int *p;
+
+    p = &k;
+    *p = *p + n;
+
+    if (k > 100)
+	return k - 100;
+
+    return k;
+}
+
+
+int main(void)
+{
+    int k, n;
+
+    scanf("%d", &k);
+    printf("%d %d %d %d\n", apply(0, k, 7), apply(1, k, 5), apply(2, k, 4), apply(3, k, 1));
+
+    for (n = 0; n < 4; n = n + 1)
+	printf("%d\n", apply(n, k + n, n + 2));
+
+    printf("%d %d %d\n", power(k, 5), power(k, 13), power(3, k));
+    printf("%d %d\n", bump(3, 99), bump(k, 99));
+}
@@ -0,0 +1,59 @@
+/* nest.c */
+
+/*
+ * walk matrices stored by rows in arrays, in nests of loops some of
+ * which may be run in another order and some of which may not, and
+ * print a checksum of each result
+ */
+
+int a[10000], b[10000], t[10000];
+
+
+int sum(int *p, int n)
+{
+    int i, s;
+
+    s = 0;
+
+    for (i = 0; i < n; i = i + 1)
+	s = (s * 31 + p[i]) % 100003;
+
+    return s;
+}
+
+
+int main(void)
+{
+    int i, j, k;
+
+    scanf("%d", &k);
+
+    for (i = 0; i < 10000; i = i + 1) {
+	a[i] = i % 23 - k;
+	b[i] = i % 19 + k;
+    }
+
+    for (j = 0; j < 100; j = j + 1)
+	for (i = 0; i < 100; i = i + 1)
+	    a[i * 100 + j] = a[i * 100 + j] + b[i * 100 + j] * 2;
+
+    printf("%d\n", sum(a, 10000));
+
+    for (i = 0; i < 97; i = i + 1)
+	for (j = 0; j < 99; j = j + 1)
+	    t[j * 100 + i] = a[i * 100 + j] - i;
+
+    printf("%d\n", sum(t, 10000));
+
+    for (j = 0; j < 99; j = j + 1)
+	for (i = 1; i < 100; i = i + 1)
+	    b[i * 100 + j] = b[(i - 1) * 100 + j + 1] + 1;
+
+    printf("%d\n", sum(b, 10000));
+
+    for (i = 1; i < 100; i = i + 3)
+	for (j = 1; j < 100; j = j + 2)
+	    a[j * 100 + i] = a[(j - 1) * 100 + i] + a[j * 100 + i - 1];
+
+    printf("%d\n", sum(a, 10000));
+}
@@ -0,0 +1,44 @@
+/* search.c */
+
+/*
+ * search by tail recursion, far deeper than the stack would allow if
+ * each call kept its frame
+ */
+
+int key(int i)
+{
+    return i % 1009 * 4001 + i / 1009;
+}
+
+
+int find(int k, int i, int n)
+{
+    if (i == n) return -1;
+    if (key(i) == k) return i;
+    return find(k, i + 1, n);
+}
+
+
+int gcd(int a, int b)
+{
+    if (b == 0) return a;
+    return gcd(b, a % b);
+}
+
+
+int count(int n, int total)
+{
+    if (n == 0) return total;
+    return count(n - 1, total + gcd(n, 360));
+}
+
+
+int main(void)
+{
+    int n;
+
+    scanf("%d", &n);
+    printf("%d\n", find(key(n - 1), 0, n));
+    printf("%d\n", find(-1, 0, n));
+    printf("%d\n", count(n, 0));
+}
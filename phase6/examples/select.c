@@ -0,0 +1,71 @@
+/* select.c */
+
+/*
+ * pick values with if statements that only assign a variable, using
+ * comparisons, plain values, and numbers as the values picked, and
+ * print a checksum of what is picked
+ */
+
+int seed, low;
+char c;
+
+
+int next(void)
+{
+    seed = (seed * 1103 + 12345) % 65536;
+    return seed;
+}
+
+
+int main(void)
+{
+    int i, x, y, s, t, u, v;
+    int l;
+
+    scanf("%d", &seed);
+    s = 0;
+    low = 65536;
+
+    for (i = 0; i < 1000; i = i + 1) {
+	x = next() - 32768;
+	y = next() % 7 - 3;
+
+	if (x > y)
+	    t = x;
+	else
+	    t = y;
+
+	if (y != 0)
+	    u = 1;
+	else
+	    u = 0;
+
+	if (x <= 0)
+	    v = -5;
+	else
+	    v = 12;
+
+	if (y)
+	    v = v + 1;
+
+	if (x < low)
+	    low = x;
+
+	if (y >= 2)
+	    u = 0;
+
+	if (x % 2)
+	    l = x;
+	else
+	    l = 3;
+
+	if (y < 0)
+	    c = 97;
+	else
+	    c = y;
+
+	s = (s * 7 + t + u * 3 + v + c + l % 11) % 100003;
+    }
+
+    printf("%d %d\n", s, low);
+}
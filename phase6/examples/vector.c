@@ -0,0 +1,64 @@
+/* vector.c */
+
+/*
+ * add arrays of ints, some of them overlapping, for each count up to a
+ * number read, so that most counts are not a multiple of four, and
+ * print a checksum of each result
+ */
+
+int a[40], b[40], c[40];
+
+
+void fill(int *p, int n, int k)
+{
+    int i;
+
+    for (i = 0; i < n; i = i + 1)
+	p[i] = i * k - 7;
+}
+
+
+int sum(int *p, int n)
+{
+    int i, s;
+
+    s = 0;
+
+    for (i = 0; i < n; i = i + 1)
+	s = (s * 31 + p[i]) % 100003;
+
+    return s;
+}
+
+
+void add(int *dst, int *x, int *y, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i = i + 1)
+	dst[i] = x[i] + y[i] - i;
+}
+
+
+int main(void)
+{
+    int i, n, m;
+
+    scanf("%d", &n);
+
+    for (m = 0; m <= n; m = m + 1) {
+	fill(a, 40, 3);
+	fill(b, 40, 5);
+	fill(c, 40, -2);
+
+	for (i = 0; i < m; i = i + 1)
+	    c[i] = a[i] - b[i] + 4;
+
+	add(a, b, c, m);
+	add(b + 1, b, a, m);
+	add(c, c + 2, c + 1, m);
+	add(a + 3, a, a, m);
+
+	printf("%d %d %d %d\n", m, sum(a, 40), sum(b, 40), sum(c, 40));
+    }
+}
@@ -6,38 +6,158 @@
  *
  *		Extra functionality:
  *		- putting all the global declarations at the end
+ *		- selecting values without branches in simple ifs
+ *
+ *		On x86-64, ints are still four bytes but pointers are
+ *		eight, so the instructions and registers used for a value
+ *		are chosen by the width of its type.  Every temporary is
+ *		as wide as a pointer.
  */
 
+# include <cctype>
+# include <cstdlib>
+# include <algorithm>
 # include <sstream>
 # include <iostream>
 # include <vector>
 # include "generator.h"
+# include "checker.h"
 # include "machine.h"
 # include "label.h"
+# include "tokens.h"
 
 using namespace std;
 
-static unsigned maxargs;
-static int temp_offset; 
-static Label *labelptr; 
-static vector<string> stringlabels; 
+static thread_local ostream *out = &cout;
+static thread_local unsigned maxargs;
+static thread_local int temp_offset; 
+static thread_local Label *labelptr; 
+static thread_local Label *bodyptr;
+static thread_local const Function *function;
+static thread_local bool framed, leaf;
+static thread_local int depth;
+
+bool omitFramePointer = true;
+static thread_local vector<string> stringlabels; 
 
-unsigned Label::counter = 0; 
+thread_local unsigned Label::counter = 0; 
 ostream &operator<<(ostream &ostr, const Label &lbl) {
 	return ostr << ".L" << lbl.number; 
 }
 
 
+/*
+ * Function:	frame
+ *
+ * Description:	Return the operand for the given offset from the frame
+ *		pointer.  Without a frame pointer, the offset is from where
+ *		it would point, which is the size of the frame above the
+ *		stack pointer, plus whatever has been pushed since.
+ */
+
+static string frame(int offset)
+{
+    stringstream ss;
+
+
+    if (framed)
+	ss << offset << "(" << target->framePointer << ")";
+    else {
+	ss << function->id()->name() << ".size";
+
+	if (offset + depth != 0)
+	    ss << showpos << offset + depth << noshowpos;
+
+	ss << "(" << target->stackPointer << ")";
+    }
+
+    return ss.str();
+}
+
+
 /*
  * Function:	operator <<
  *
  * Description:	Convenience function for writing the operand of an
- *		expression.
+ *		expression.  Variables and temporaries in the frame are
+ *		always known by their offset from the frame pointer, and
+ *		written relative to the stack pointer if there is none.
  */
 
 ostream &operator <<(ostream &ostr, Expression *expr)
 {
-    return ostr << expr->_operand;
+    const string &operand = expr->_operand;
+    string suffix = string("(") + target->framePointer + ")";
+
+
+    if (!framed && operand.size() > suffix.size() &&
+	    operand.compare(operand.size() - suffix.size(), suffix.size(), suffix) == 0)
+	return ostr << frame(atoi(operand.c_str()));
+
+    return ostr << operand;
+}
+
+
+/*
+ * Function:	width
+ *
+ * Description:	Return the width in bytes of the register needed to hold
+ *		the value of an expression, which is that of a pointer for
+ *		pointers and longs, and that of an int otherwise.
+ */
+
+static unsigned width(Expression *expr)
+{
+    const Type &t = expr->type();
+
+    if (t.isPointer() || (t.isScalar() && t.specifier() == LONG))
+	return SIZEOF_PTR;
+
+    return SIZEOF_INT;
+}
+
+
+/*
+ * Function:	suffix
+ *
+ * Description:	Return the instruction suffix for an operand of the given
+ *		width, or for the value of an expression.
+ */
+
+static const char *suffix(unsigned size)
+{
+    return size == 1 ? "b" : size == 2 ? "w" : size == 8 ? "q" : "l";
+}
+
+static const char *suffix(Expression *expr)
+{
+    return suffix(width(expr));
+}
+
+
+/*
+ * Function:	reg
+ *
+ * Description:	Return the name of a register of the given width, or wide
+ *		enough for the value of an expression.  The register is
+ *		named as on the 8086, such as "ax" or "di", or by number
+ *		for the new registers of x86-64.
+ */
+
+static string reg(const string &name, unsigned size)
+{
+    if (isdigit(name[1]))
+	return "%" + name + (size == 1 ? "b" : size == 2 ? "w" : size == 4 ? "d" : "");
+
+    if (size == 1)
+	return "%" + (name[1] == 'x' ? name.substr(0, 1) : name) + "l";
+
+    return (size == 8 ? "%r" : size == 4 ? "%e" : "%") + name;
+}
+
+static string reg(const string &name, Expression *expr)
+{
+    return reg(name, width(expr));
 }
 
 
@@ -54,7 +174,9 @@ void Identifier::generate()
 
 
     if (_symbol->_offset != 0)
-	ss << _symbol->_offset << "(%ebp)";
+	ss << _symbol->_offset << "(" << target->framePointer << ")";
+    else if (target->bits == 64)
+	ss << global_prefix << _symbol->name() << "(%rip)";
     else
 	ss << global_prefix << _symbol->name();
 
@@ -79,68 +201,198 @@ void Number::generate()
 }
 
 
-# if STACK_ALIGNMENT == 4
-
 /*
- * Function:	Call::generate
- *
- * Description:	Generate code for a function call expression, in which each
- *		argument is simply a variable or an integer literal.
+ * Function:	jump
+ *
+ * Description:	Generate a tail call as a jump, if we can.  A call of the
+ *		function itself stores the arguments in the parameters
+ *		and jumps back to the top of the body, so the recursion
+ *		becomes a loop.  A call of another function places the
+ *		arguments where its caller would, which on i386 is in our
+ *		own argument area and so only if they fit, then gives up
+ *		our frame and jumps to it, so that it returns to our
+ *		caller.  All the arguments are generated before any is
+ *		stored, and any that is a parameter is copied, since it
+ *		may be overwritten before it is used.
  */
 
-void Call::generate()
+static bool jump(const Symbol *id, const Expressions &args)
 {
-    unsigned numBytes = 0;
-	_operand = gettemp(); 
+    Symbols symbols = function->body()->declarations()->symbols();
+    unsigned nparams = function->id()->type().parameters()->size();
+    const char *word = suffix(SIZEOF_PTR);
+    const char *fp = target->framePointer, *sp = target->stackPointer;
 
-    for (int i = _args.size() - 1; i >= 0; i --) {
-	_args[i]->generate();
-	cout << "\tpushl\t" << _args[i] << endl;
-	numBytes += _args[i]->type().size();
+
+    if (id != function->id()) {
+	if (target->numRegisterArgs > 0 && args.size() > target->numRegisterArgs)
+	    return false;
+
+	if (target->numRegisterArgs == 0 && (STACK_ALIGNMENT != 4 || args.size() > nparams))
+	    return false;
     }
 
-    cout << "\tcall\t" << global_prefix << _id->name() << endl;
+    for (unsigned i = 0; i < args.size(); i ++)
+	args[i]->generate();
 
-    if (numBytes > 0)
-	cout << "\taddl\t$" << numBytes << ", %esp" << endl;
-	
-	cout << "\tmovl\t%eax," << this << endl; 
+    if (id == function->id() || target->numRegisterArgs == 0)
+	for (unsigned i = 0; i < args.size(); i ++)
+	    for (unsigned j = 0; j < nparams; j ++) {
+		stringstream ss;
+
+		ss << symbols[j]->_offset << "(" << fp << ")";
+
+		if (args[i]->_operand == ss.str()) {
+		    *out << "\tmov" << suffix(args[i]) << "\t" << args[i] << ", " << reg("ax", args[i]) << endl;
+		    args[i]->_operand = gettemp();
+		    *out << "\tmov" << suffix(args[i]) << "\t" << reg("ax", args[i]) << ", " << args[i] << endl;
+		    break;
+		}
+	    }
+
+    if (id == function->id()) {
+	for (unsigned i = 0; i < args.size(); i ++) {
+	    unsigned size = symbols[i]->type().size();
+
+	    *out << "\tmov" << suffix(args[i]) << "\t" << args[i] << ", " << reg("ax", args[i]) << endl;
+	    *out << "\tmov" << suffix(size) << "\t" << reg("ax", size) << ", ";
+	    *out << frame(symbols[i]->_offset) << endl;
+	}
+
+	*out << "\tjmp\t" << *bodyptr << endl;
+	return true;
+    }
+
+    for (unsigned i = 0; i < args.size(); i ++)
+	if (target->numRegisterArgs > 0) {
+	    *out << "\tmov" << suffix(args[i]) << "\t" << args[i] << ", ";
+	    *out << reg(target->registerArgs[i], args[i]) << endl;
+	} else {
+	    *out << "\tmovl\t" << args[i] << ", %eax" << endl;
+	    *out << "\tmovl\t%eax, " << frame(PARAM_OFFSET + i * SIZEOF_ARG) << endl;
+	}
+
+    if (framed) {
+	*out << "\tmov" << word << "\t" << fp << ", " << sp << endl;
+	*out << "\tpop" << word << "\t" << fp << endl;
+    } else {
+	*out << "\tadd" << word << "\t$" << function->id()->name() << ".size+";
+	*out << SIZEOF_PTR << ", " << sp << endl;
+    }
+
+    if (target->numRegisterArgs > 0)
+	*out << "\tmovl\t$0, %eax" << endl;
+
+    *out << "\tjmp\t" << global_prefix << id->name() << endl;
+    return true;
 }
 
-# else
 
 /*
- * If the stack has to be aligned to a certain size before a function call
- * then we cannot push the arguments in the order we see them.  If we had
- * nested function calls, we cannot guarantee that the stack would be
- * aligned.
+ * Function:	Call::generate
  *
- * Instead, we must know the maximum number of arguments so we can compute
- * the size of the frame.  Again, we cannot just move the arguments onto
- * the stack as we see them because of nested function calls.  Rather, we
- * have to generate code for all arguments first and then move the results
- * onto the stack.  This will likely cause a lot of spills.
+ * Description:	Generate code for a function call expression, in which each
+ *		argument is simply a variable or an integer literal.
  *
- * For now, since each argument is going to be either a number of in
- * memory, we just load it into %eax and then move %eax onto the stack.
+ *		On i386 Linux, the arguments are simply pushed in reverse
+ *		order.  If the stack has to be aligned to a certain size
+ *		before a function call then we cannot push the arguments
+ *		in the order we see them.  If we had nested function
+ *		calls, we cannot guarantee that the stack would be
+ *		aligned.
+ *
+ *		Instead, we must know the maximum number of arguments so we
+ *		can compute the size of the frame.  Again, we cannot just
+ *		move the arguments onto the stack as we see them because
+ *		of nested function calls.  Rather, we have to generate code
+ *		for all arguments first and then move the results onto the
+ *		stack.  This will likely cause a lot of spills.
+ *
+ *		On x86-64, all the arguments are generated first, then any
+ *		beyond those passed in registers are pushed, with padding
+ *		to keep the stack aligned, and the rest are loaded into
+ *		their registers.  Since the callee might take a variable
+ *		number of arguments, %al says no vector registers are used.
+ *
+ *		A tail call is made with a jump instead, if possible.  What
+ *		is pushed is counted, since the operands in the frame are
+ *		relative to the stack pointer if there is no frame pointer.
  */
 
 void Call::generate()
 {
-    if (_args.size() > maxargs)
-	maxargs = _args.size();
+    unsigned numBytes = 0, nregs;
+    _operand = gettemp();
 
-    for (int i = _args.size() - 1; i >= 0; i --) {
-	_args[i]->generate();
-	cout << "\tmovl\t" << _args[i] << ", %eax" << endl;
-	cout << "\tmovl\t%eax, " << i * SIZEOF_ARG << "(%esp)" << endl;
+    if (_tail && jump(_id, _args))
+	return;
+
+    leaf = false;
+
+    if (target->numRegisterArgs > 0) {
+	nregs = min((unsigned) _args.size(), target->numRegisterArgs);
+
+	for (unsigned i = 0; i < _args.size(); i ++)
+	    _args[i]->generate();
+
+	if ((_args.size() - nregs) % 2) {
+	    *out << "\tsubq\t$8, %rsp" << endl;
+	    numBytes += 8;
+	    depth += 8;
+	}
+
+	for (int i = _args.size() - 1; i >= (int) nregs; i --) {
+	    *out << "\tmov" << suffix(_args[i]) << "\t" << _args[i];
+	    *out << ", " << reg("ax", _args[i]) << endl;
+	    *out << "\tpushq\t%rax" << endl;
+	    numBytes += SIZEOF_ARG;
+	    depth += SIZEOF_ARG;
+	}
+
+	for (unsigned i = 0; i < nregs; i ++) {
+	    *out << "\tmov" << suffix(_args[i]) << "\t" << _args[i] << ", ";
+	    *out << reg(target->registerArgs[i], _args[i]) << endl;
+	}
+
+	*out << "\tmovl\t$0, %eax" << endl;
+	*out << "\tcall\t" << global_prefix << _id->name() << endl;
+
+	if (numBytes > 0)
+	    *out << "\taddq\t$" << numBytes << ", %rsp" << endl;
+
+	depth -= numBytes;
+
+    } else if (STACK_ALIGNMENT == 4) {
+	for (int i = _args.size() - 1; i >= 0; i --) {
+	    _args[i]->generate();
+	    *out << "\tpushl\t" << _args[i] << endl;
+	    numBytes += _args[i]->type().size();
+	    depth += _args[i]->type().size();
+	}
+
+	*out << "\tcall\t" << global_prefix << _id->name() << endl;
+
+	if (numBytes > 0)
+	    *out << "\taddl\t$" << numBytes << ", %esp" << endl;
+
+	depth -= numBytes;
+
+    } else {
+	if (_args.size() > maxargs)
+	    maxargs = _args.size();
+
+	for (int i = _args.size() - 1; i >= 0; i --) {
+	    _args[i]->generate();
+	    *out << "\tmovl\t" << _args[i] << ", %eax" << endl;
+	    *out << "\tmovl\t%eax, " << i * SIZEOF_ARG << "(%esp)" << endl;
+	}
+
+	*out << "\tcall\t" << global_prefix << _id->name() << endl;
     }
 
-    cout << "\tcall\t" << global_prefix << _id->name() << endl;
+    *out << "\tmov" << suffix(this) << "\t" << reg("ax", this) << "," << this << endl;
 }
 
-# endif
-
 
 /*
  * Function:	Assignment::generate
@@ -153,22 +405,22 @@ void Call::generate()
 
 void Assignment::generate()
 {
-	bool indirect; 
+	bool indirect;
     _left->generate(indirect);
     _right->generate();
 
-    cout << "\tmovl\t" << _right << ", %eax" << endl;
+    *out << "\tmov" << suffix(_right) << "\t" << _right << ", " << reg("ax", _right) << endl;
 	if (indirect) {
-		cout << "\tmovl\t" << _left << ",%ecx" << endl; 
-		if (_right->type().size() == 1) 
-			cout << "\tmovb\t%al,(%ecx)" << endl;
-	    else 
-			cout << "\tmovl\t%eax,(%ecx)" << endl; 	
+		*out << "\tmov" << suffix(SIZEOF_PTR) << "\t" << _left << "," << reg("cx", SIZEOF_PTR) << endl;
+		if (_right->type().size() == 1)
+			*out << "\tmovb\t%al,(" << reg("cx", SIZEOF_PTR) << ")" << endl;
+	    else
+			*out << "\tmov" << suffix(_right) << "\t" << reg("ax", _right) << ",(" << reg("cx", SIZEOF_PTR) << ")" << endl;
 	} else {
 		if (_right->type().size() == 1)
-   			cout << "\tmovsbl\t%al," << _left << endl; 
-		else 
-			cout << "\tmovl\t%eax, " << _left << endl;
+   			*out << "\tmovb\t%al," << _left << endl;
+		else
+			*out << "\tmov" << suffix(_right) << "\t" << reg("ax", _right) << ", " << _left << endl;
 	}
 }
 
@@ -194,28 +446,47 @@ void Block::generate()
  * Description:	Generate code for this function, which entails allocating
  *		space for local variables, then emitting our prologue, the
  *		body of the function, and the epilogue.
+ *
+ *		Unless frame pointers are kept, the variables and
+ *		temporaries are addressed from the stack pointer instead,
+ *		and the frame is allocated in place of saving the frame
+ *		pointer, so it is laid out just the same.  The body is
+ *		generated first, since a function that calls nothing needs
+ *		no frame at all if it has nothing in it, or on x86-64, if
+ *		it fits in the red zone below the stack pointer.  A copy
+ *		specialized by the optimizer is not made global.
  */
 
 void Function::generate()
 {
     int offset = 0;
-	Label returnLabel; 
-	labelptr = &returnLabel; 
-
-    /* Generate our prologue. */
+	Label returnLabel, bodyLabel;
+	labelptr = &returnLabel;
+    bodyptr = &bodyLabel;
+    function = this;
+    const char *word = suffix(SIZEOF_PTR);
+    const char *fp = target->framePointer, *sp = target->stackPointer;
+    Parameters *params = _id->type().parameters();
+    Symbols symbols = _body->declarations()->symbols();
+    unsigned nregs = min((unsigned) params->size(), target->numRegisterArgs);
+    ostream *saved = out;
+    stringstream body;
+    bool allocated;
+    int size;
+
+    /* Generate the body of this function, to which its tail calls of
+       itself jump back. */
 
     allocate(offset);
-    cout << global_prefix << _id->name() << ":" << endl;
-    cout << "\tpushl\t%ebp" << endl;
-    cout << "\tmovl\t%esp, %ebp" << endl;
-    cout << "\tsubl\t$" << _id->name() << ".size, %esp" << endl;
-
-
-    /* Generate the body of this function. */
+    framed = !omitFramePointer;
+    leaf = true;
+    depth = 0;
+    out = &body;
 
 	temp_offset = offset; 
 
     maxargs = 0;
+    markTailCalls();
     _body->generate();
 
 	offset = temp_offset;
@@ -225,18 +496,74 @@ void Function::generate()
     while ((offset - PARAM_OFFSET) % STACK_ALIGNMENT)
 	offset --;
 
+    out = saved;
+    size = -offset;
+
+    if (framed)
+	allocated = true;
+    else if (leaf && target->bits == 64)
+	allocated = size + SIZEOF_PTR > 128;
+    else
+	allocated = size > 0 || (!leaf && STACK_ALIGNMENT != 4);
+
+
+    /* Generate our prologue, saving any parameters passed in registers. */
+
+    *out << global_prefix << _id->name() << ":" << endl;
+
+    if (framed) {
+	*out << "\tpush" << word << "\t" << fp << endl;
+	*out << "\tmov" << word << "\t" << sp << ", " << fp << endl;
+	*out << "\tsub" << word << "\t$" << _id->name() << ".size, " << sp << endl;
+    } else if (allocated)
+	*out << "\tsub" << word << "\t$" << _id->name() << ".size+" << SIZEOF_PTR << ", " << sp << endl;
+
+    for (unsigned i = 0; i < nregs; i ++) {
+	unsigned size = symbols[i]->type().size();
+
+	*out << "\tmov" << suffix(size) << "\t" << reg(target->registerArgs[i], size);
+	*out << ", " << frame(symbols[i]->_offset) << endl;
+    }
+
+    *out << bodyLabel << ":" << endl;
+    *out << body.str();
+
 
     /* Generate our epilogue. */
 
-	cout << returnLabel << ":" << endl; 
-    cout << "\tmovl\t%ebp, %esp" << endl;
-    cout << "\tpopl\t%ebp" << endl;
-    cout << "\tret" << endl << endl;
+	*out << returnLabel << ":" << endl;
+
+    if (framed) {
+	*out << "\tmov" << word << "\t" << fp << ", " << sp << endl;
+	*out << "\tpop" << word << "\t" << fp << endl;
+    } else if (allocated)
+	*out << "\tadd" << word << "\t$" << _id->name() << ".size+" << SIZEOF_PTR << ", " << sp << endl;
+
+    *out << "\tret" << endl << endl;
+
+    if (!(_id->_attributes & SPECIALIZED))
+	*out << "\t.globl\t" << global_prefix << _id->name() << endl;
 
-    cout << "\t.globl\t" << global_prefix << _id->name() << endl;
-    cout << "\t.set\t" << _id->name() << ".size, " << -offset << endl;
+    *out << "\t.set\t" << _id->name() << ".size, " << (allocated ? size : -(int) SIZEOF_PTR) << endl;
 
-    cout << endl;
+    *out << endl;
+}
+
+
+/*
+ * Function:	initGenerator
+ *
+ * Description:	Prepare to generate code for a new translation unit, with
+ *		the assembly written to OSTR.  Labels are numbered from
+ *		zero again so the output for a unit does not depend on
+ *		what else this thread has compiled.
+ */
+
+void initGenerator(ostream &ostr)
+{
+    out = &ostr;
+    Label::counter = 0;
+    stringlabels.clear();
 }
 
 
@@ -249,20 +576,109 @@ void Function::generate()
 void generateGlobals(const Symbols &globals)
 {
     if (globals.size() > 0)
-	cout << "\t.data" << endl;
+	*out << "\t.data" << endl;
 
     for (unsigned i = 0; i < globals.size(); i ++) {
-	cout << "\t.comm\t" << global_prefix << globals[i]->name();
-	cout << ", " << globals[i]->type().size();
-	cout << ", " << globals[i]->type().alignment() << endl;
+	*out << "\t.comm\t" << global_prefix << globals[i]->name();
+	*out << ", " << globals[i]->type().size();
+	*out << ", " << globals[i]->type().alignment() << endl;
+    }
+
+    if (stringlabels.size() > 0)
+	*out << "\t.section\t.rodata" << endl;
+
+    for (unsigned j = 0; j < stringlabels.size(); j++) {
+	*out << stringlabels[j] << endl;
     }
+}
+
+/*
+ * Function:	relocate
+ *
+ * Description:	Return the text with the number of every label in it
+ *		shifted by DELTA.  If LEADING is true, only a label at the
+ *		very start is shifted, which is what we want for string
+ *		literals since their contents might look like labels.
+ */
+
+static string relocate(const string &text, int delta, bool leading = false)
+{
+    stringstream ss;
+    size_t i, j;
+    int number;
+
 
+    for (i = 0; (j = text.find(".L", i)) != string::npos; i = j) {
+	if (leading && j > 0)
+	    break;
 
-	for (unsigned j = 0; j < stringlabels.size(); j++) {
-		cout << stringlabels[j] << endl; 
+	ss << text.substr(i, j - i) << ".L";
+	j += 2;
+
+	if (j < text.size() && isdigit(text[j])) {
+	    for (number = 0; j < text.size() && isdigit(text[j]); j ++)
+		number = number * 10 + text[j] - '0';
+
+	    ss << number + delta;
 	}
+    }
+
+    ss << text.substr(i);
+    return ss.str();
 }
 
+
+/*
+ * Function:	generateFragment
+ *
+ * Description:	Generate code for the function as usual, and also save a
+ *		relocatable copy of the code and its string literals in
+ *		the fragment.
+ */
+
+void generateFragment(Function *function, Fragment &fragment)
+{
+    stringstream ss;
+    ostream *saved = out;
+    unsigned base = Label::counter, first = stringlabels.size();
+
+
+    out = &ss;
+    function->generate();
+    out = saved;
+    *out << ss.str();
+
+    fragment.text = relocate(ss.str(), -(int) base);
+    fragment.labels = Label::counter - base;
+    fragment.strings.clear();
+
+    for (unsigned i = first; i < stringlabels.size(); i ++)
+	fragment.strings.push_back(relocate(stringlabels[i], -(int) base, true));
+}
+
+
+/*
+ * Function:	emitFragment
+ *
+ * Description:	Emit previously generated code for a function, in place of
+ *		generating it, by renumbering its labels to follow those
+ *		already used.
+ */
+
+void emitFragment(const Fragment &fragment)
+{
+    unsigned base = Label::counter;
+
+
+    *out << relocate(fragment.text, base);
+
+    for (unsigned i = 0; i < fragment.strings.size(); i ++)
+	stringlabels.push_back(relocate(fragment.strings[i], base, true));
+
+    Label::counter += fragment.labels;
+}
+
+
 /*
  * Function:	gettemp()
  *
@@ -274,8 +690,8 @@ void generateGlobals(const Symbols &globals)
 string gettemp() {
 
 	stringstream ss; 
-	temp_offset -= 4;
-	ss << temp_offset << "(%ebp)"; 
+	temp_offset -= SIZEOF_PTR;
+	ss << temp_offset << "(" << target->framePointer << ")"; 
 	return ss.str(); 	
 }
 
@@ -316,9 +732,9 @@ void Negate::generate(){
 	_expr->generate(); 
 	_operand = gettemp(); 
 
-	cout << "\tmovl\t" << _expr << ",%eax" << endl; 
-	cout << "\tnegl\t%eax" << endl; 
-	cout << "\tmovl\t%eax," << this << endl; 
+	*out << "\tmovl\t" << _expr << ",%eax" << endl; 
+	*out << "\tnegl\t%eax" << endl; 
+	*out << "\tmovl\t%eax," << this << endl; 
 }
 
 /*
@@ -334,11 +750,11 @@ void Not::generate() {
 	_expr->generate(); 
 	_operand = gettemp(); 
 
-	cout << "\tmovl\t" << _expr << ",%eax" << endl; 
-	cout << "\tcmpl\t$0,%eax" << endl; 
-	cout << "\tsete\t%al" << endl; 
-	cout << "\tmovzbl\t%al,%eax" << endl; 
-	cout << "\tmovl\t%eax," << this << endl; 
+	*out << "\tmov" << suffix(_expr) << "\t" << _expr << "," << reg("ax", _expr) << endl;
+	*out << "\tcmp" << suffix(_expr) << "\t$0," << reg("ax", _expr) << endl;
+	*out << "\tsete\t%al" << endl; 
+	*out << "\tmovzbl\t%al,%eax" << endl; 
+	*out << "\tmovl\t%eax," << this << endl; 
 }
 
 /*
@@ -354,9 +770,9 @@ void Add::generate() {
 	_right->generate(); 
 	_operand = gettemp(); 
 
-	cout << "\tmovl\t" << _left << ",%eax" << endl; 
-	cout << "\taddl\t" << _right << ",%eax" << endl; 
-	cout << "\tmovl\t%eax," << this << endl; 
+	*out << "\tmov" << suffix(this) << "\t" << _left << "," << reg("ax", this) << endl;
+	*out << "\tadd" << suffix(this) << "\t" << _right << "," << reg("ax", this) << endl;
+	*out << "\tmov" << suffix(this) << "\t" << reg("ax", this) << "," << this << endl;
 }
 
 /*
@@ -372,9 +788,9 @@ void Subtract::generate() {
 	_right->generate(); 
 	_operand = gettemp(); 
 
-	cout << "\tmovl\t" << _left << ",%eax" << endl; 
-	cout << "\tsubl\t" << _right << ",%eax" << endl; 
-	cout << "\tmovl\t%eax," << this << endl;
+	*out << "\tmov" << suffix(this) << "\t" << _left << "," << reg("ax", this) << endl;
+	*out << "\tsub" << suffix(this) << "\t" << _right << "," << reg("ax", this) << endl;
+	*out << "\tmov" << suffix(this) << "\t" << reg("ax", this) << "," << this << endl;
 }
 
 /* 
@@ -390,9 +806,9 @@ void Multiply::generate() {
 	_right->generate(); 
 	_operand = gettemp(); 
 
-	cout << "\tmovl\t" << _left << ",%eax" << endl; 
-	cout << "\timull\t" << _right << ",%eax" << endl; 
-	cout << "\tmovl\t%eax," << this << endl; 
+	*out << "\tmov" << suffix(this) << "\t" << _left << "," << reg("ax", this) << endl;
+	*out << "\timul" << suffix(this) << "\t" << _right << "," << reg("ax", this) << endl;
+	*out << "\tmov" << suffix(this) << "\t" << reg("ax", this) << "," << this << endl;
 }
 
 /* 
@@ -408,11 +824,11 @@ void Divide::generate() {
 	_right->generate(); 
 	_operand = gettemp(); 
 
-	cout << "\tmovl\t" << _left << ",%eax" << endl; 
-	cout << "\tmovl\t" << _right << ",%ecx" << endl; 
-	cout << "\tcltd" << endl; 
-	cout << "\tidivl\t%ecx" << endl; 
-	cout << "\tmovl\t%eax," << this << endl; 
+	*out << "\tmov" << suffix(this) << "\t" << _left << "," << reg("ax", this) << endl;
+	*out << "\tmov" << suffix(this) << "\t" << _right << "," << reg("cx", this) << endl;
+	*out << (width(this) == 8 ? "\tcqto" : "\tcltd") << endl;
+	*out << "\tidiv" << suffix(this) << "\t" << reg("cx", this) << endl;
+	*out << "\tmov" << suffix(this) << "\t" << reg("ax", this) << "," << this << endl; 
 }
 
 /*
@@ -428,11 +844,11 @@ void Remainder::generate() {
 	_right->generate(); 
 	_operand = gettemp(); 
 
-	cout << "\tmovl\t" << _left << ",%eax" << endl; 
-	cout << "\tmovl\t" << _right << ",%ecx" << endl; 
-	cout << "\tcltd" << endl; 
-	cout << "\tidivl\t%ecx" << endl; 
-	cout << "\tmovl\t%edx," << this << endl; 
+	*out << "\tmov" << suffix(this) << "\t" << _left << "," << reg("ax", this) << endl;
+	*out << "\tmov" << suffix(this) << "\t" << _right << "," << reg("cx", this) << endl;
+	*out << (width(this) == 8 ? "\tcqto" : "\tcltd") << endl;
+	*out << "\tidiv" << suffix(this) << "\t" << reg("cx", this) << endl;
+	*out << "\tmov" << suffix(this) << "\t" << reg("dx", this) << "," << this << endl; 
 }
 
 /* 
@@ -448,11 +864,11 @@ void LessThan::generate() {
 	_right->generate(); 
 	_operand = gettemp(); 
 
-	cout << "\tmovl\t" << _left << ",%eax" << endl; 
-	cout << "\tcmpl\t" << _right << ",%eax" << endl; 
-	cout << "\tsetl\t%al" << endl; 
-	cout << "\tmovzbl\t%al,%eax" << endl; 
-	cout << "\tmovl\t%eax," << this << endl;  
+	*out << "\tmov" << suffix(_left) << "\t" << _left << "," << reg("ax", _left) << endl;
+	*out << "\tcmp" << suffix(_left) << "\t" << _right << "," << reg("ax", _left) << endl; 
+	*out << "\tsetl\t%al" << endl; 
+	*out << "\tmovzbl\t%al,%eax" << endl; 
+	*out << "\tmovl\t%eax," << this << endl;  
 }
 
 /* 
@@ -468,11 +884,11 @@ void GreaterThan::generate() {
 	_right->generate(); 
 	_operand = gettemp(); 
 
-	cout << "\tmovl\t" << _left << ",%eax" << endl; 
-	cout << "\tcmpl\t" << _right << ",%eax" << endl; 
-	cout << "\tsetg\t%al" << endl; 
-	cout << "\tmovzbl\t%al,%eax" << endl; 
-	cout << "\tmovl\t%eax," << this << endl;  
+	*out << "\tmov" << suffix(_left) << "\t" << _left << "," << reg("ax", _left) << endl;
+	*out << "\tcmp" << suffix(_left) << "\t" << _right << "," << reg("ax", _left) << endl; 
+	*out << "\tsetg\t%al" << endl; 
+	*out << "\tmovzbl\t%al,%eax" << endl; 
+	*out << "\tmovl\t%eax," << this << endl;  
 }
 
 /*
@@ -488,11 +904,11 @@ void LessOrEqual::generate() {
 	_right->generate(); 
 	_operand = gettemp(); 
 
-	cout << "\tmovl\t" << _left << ",%eax" << endl; 
-	cout << "\tcmpl\t" << _right << ",%eax" << endl; 
-	cout << "\tsetle\t%al" << endl; 
-	cout << "\tmovzbl\t%al,%eax" << endl; 
-	cout << "\tmovl\t%eax," << this << endl;  
+	*out << "\tmov" << suffix(_left) << "\t" << _left << "," << reg("ax", _left) << endl;
+	*out << "\tcmp" << suffix(_left) << "\t" << _right << "," << reg("ax", _left) << endl; 
+	*out << "\tsetle\t%al" << endl; 
+	*out << "\tmovzbl\t%al,%eax" << endl; 
+	*out << "\tmovl\t%eax," << this << endl;  
 }
 
 /* 
@@ -508,11 +924,11 @@ void GreaterOrEqual::generate() {
 	_right->generate(); 
 	_operand = gettemp(); 
 
-	cout << "\tmovl\t" << _left << ",%eax" << endl; 
-	cout << "\tcmpl\t" << _right << ",%eax" << endl; 
-	cout << "\tsetge\t%al" << endl; 
-	cout << "\tmovzbl\t%al,%eax" << endl; 
-	cout << "\tmovl\t%eax," << this << endl;  
+	*out << "\tmov" << suffix(_left) << "\t" << _left << "," << reg("ax", _left) << endl;
+	*out << "\tcmp" << suffix(_left) << "\t" << _right << "," << reg("ax", _left) << endl; 
+	*out << "\tsetge\t%al" << endl; 
+	*out << "\tmovzbl\t%al,%eax" << endl; 
+	*out << "\tmovl\t%eax," << this << endl;  
 }
 
 /*
@@ -528,11 +944,11 @@ void Equal::generate() {
 	_right->generate(); 
 	_operand = gettemp(); 
 
-	cout << "\tmovl\t" << _left << ",%eax" << endl; 
-	cout << "\tcmpl\t" << _right << ",%eax" << endl; 
-	cout << "\tsete\t%al" << endl; 
-	cout << "\tmovzbl\t%al,%eax" << endl; 
-	cout << "\tmovl\t%eax," << this << endl;  
+	*out << "\tmov" << suffix(_left) << "\t" << _left << "," << reg("ax", _left) << endl;
+	*out << "\tcmp" << suffix(_left) << "\t" << _right << "," << reg("ax", _left) << endl; 
+	*out << "\tsete\t%al" << endl; 
+	*out << "\tmovzbl\t%al,%eax" << endl; 
+	*out << "\tmovl\t%eax," << this << endl;  
 }
 
 /*
@@ -548,11 +964,11 @@ void NotEqual::generate() {
 	_right->generate(); 
 	_operand = gettemp(); 
 
-	cout << "\tmovl\t" << _left << ",%eax" << endl; 
-	cout << "\tcmpl\t" << _right << ",%eax" << endl; 
-	cout << "\tsetne\t%al" << endl; 
-	cout << "\tmovzbl\t%al,%eax" << endl; 
-	cout << "\tmovl\t%eax," << this << endl;  
+	*out << "\tmov" << suffix(_left) << "\t" << _left << "," << reg("ax", _left) << endl;
+	*out << "\tcmp" << suffix(_left) << "\t" << _right << "," << reg("ax", _left) << endl; 
+	*out << "\tsetne\t%al" << endl; 
+	*out << "\tmovzbl\t%al,%eax" << endl; 
+	*out << "\tmovl\t%eax," << this << endl;  
 }
 
 /*
@@ -570,8 +986,8 @@ void Address::generate() {
 		_operand = _expr->_operand; 
 	} else {
 		_operand = gettemp(); 
-		cout << "\tleal\t" << _expr << ",%eax" << endl; 
-		cout << "\tmovl\t%eax," << this << endl; 
+		*out << "\tlea" << suffix(this) << "\t" << _expr << "," << reg("ax", this) << endl;
+		*out << "\tmov" << suffix(this) << "\t" << reg("ax", this) << "," << this << endl; 
 	}
 }
 
@@ -587,12 +1003,12 @@ void Dereference::generate() {
 	_expr->generate(); 
 	_operand = gettemp(); 
 
-	cout << "\tmovl\t" << _expr << ",%eax" << endl; 
+	*out << "\tmov" << suffix(_expr) << "\t" << _expr << "," << reg("ax", _expr) << endl;
 	if (_type.size() == 1)
-		cout << "\tmovsbl\t(%eax),%eax" << endl; 
-	else 
-		cout << "\tmovl\t(%eax),%eax" << endl; 
-	cout << "\tmovl\t%eax," << this << endl; 
+		*out << "\tmovsbl\t(" << reg("ax", _expr) << "),%eax" << endl;
+	else
+		*out << "\tmov" << suffix(this) << "\t(" << reg("ax", _expr) << ")," << reg("ax", this) << endl;
+	*out << "\tmov" << suffix(this) << "\t" << reg("ax", this) << "," << this << endl; 
 }
 
 /* 
@@ -622,7 +1038,7 @@ void String::generate() {
 	stringstream ss; 
 	Label s; 
 	ss << s;
-    _operand = ss.str(); 
+    _operand = ss.str() + (target->bits == 64 ? "(%rip)" : ""); 
 	ss << ":\t.asciz\t" << _value;  
 	stringlabels.push_back(ss.str()); 
 }
@@ -640,18 +1056,18 @@ void LogicalAnd::generate() {
 	_operand = gettemp(); 
 	
 	_left->generate(); 
-	cout << "\tmovl\t" << _left << ",%eax" << endl; 
-	cout << "\tcmpl\t$0,%eax" << endl; 
-	cout << "\tje\t" << lbl << endl; 
+	*out << "\tmov" << suffix(_left) << "\t" << _left << "," << reg("ax", _left) << endl;
+	*out << "\tcmp" << suffix(_left) << "\t$0," << reg("ax", _left) << endl; 
+	*out << "\tje\t" << lbl << endl; 
 
 	_right->generate();
-    cout << "\tmovl\t" << _right << ",%eax" << endl; 
-	cout << "\tcmpl\t$0,%eax" << endl; 
+    *out << "\tmov" << suffix(_right) << "\t" << _right << "," << reg("ax", _right) << endl;
+	*out << "\tcmp" << suffix(_right) << "\t$0," << reg("ax", _right) << endl; 
 
-	cout << lbl << ":" << endl; 
-	cout << "\tsetne\t%al" << endl; 
-	cout << "\tmovzbl\t%al,%eax" << endl; 
-	cout << "\tmovl\t%eax," << this << endl;
+	*out << lbl << ":" << endl; 
+	*out << "\tsetne\t%al" << endl; 
+	*out << "\tmovzbl\t%al,%eax" << endl; 
+	*out << "\tmovl\t%eax," << this << endl;
 }
 
 /* 
@@ -667,18 +1083,61 @@ void LogicalOr::generate() {
 	_operand = gettemp(); 
 
 	_left->generate(); 
-	cout << "\tmovl\t" << _left << ",%eax" << endl; 
-	cout << "\tcmpl\t$0,%eax" << endl; 
-	cout << "\tjne\t" << lbl << endl; 
+	*out << "\tmov" << suffix(_left) << "\t" << _left << "," << reg("ax", _left) << endl;
+	*out << "\tcmp" << suffix(_left) << "\t$0," << reg("ax", _left) << endl; 
+	*out << "\tjne\t" << lbl << endl; 
 
 	_right->generate(); 
-	cout << "\tmovl\t" << _right << ",%eax" << endl; 
-	cout << "\tcmpl\t$0,%eax" << endl; 
+	*out << "\tmov" << suffix(_right) << "\t" << _right << "," << reg("ax", _right) << endl;
+	*out << "\tcmp" << suffix(_right) << "\t$0," << reg("ax", _right) << endl; 
 
-	cout << lbl << ":" << endl; 
-	cout << "\tsetne\t%al" << endl; 
-	cout << "\tmovzbl\t%al,%eax" << endl; 
-	cout << "\tmovl\t%eax," << this << endl; 
+	*out << lbl << ":" << endl; 
+	*out << "\tsetne\t%al" << endl; 
+	*out << "\tmovzbl\t%al,%eax" << endl; 
+	*out << "\tmovl\t%eax," << this << endl; 
+}
+
+/*
+ * Function:	Inline::generate
+ *
+ * Description:	Generate code for an inlined call.  The variables of the
+ *		body are given slots below the temporaries, like the
+ *		temporaries themselves, and the arguments are stored in
+ *		the parameters.  A return in the body leaves its value in
+ *		the accumulator and jumps to the end, just as it would
+ *		leave the function.
+ */
+
+void Inline::generate()
+{
+    Symbols symbols = _body->declarations()->symbols();
+    Label *saved = labelptr;
+    Label exit;
+    int offset;
+
+
+    for (unsigned i = 0; i < _args.size(); i ++)
+	_args[i]->generate();
+
+    offset = temp_offset;
+    _body->allocate(offset);
+    temp_offset = offset;
+
+    for (unsigned i = 0; i < _args.size(); i ++) {
+	unsigned size = symbols[i]->type().size();
+
+	*out << "\tmov" << suffix(_args[i]) << "\t" << _args[i] << ", " << reg("ax", _args[i]) << endl;
+	*out << "\tmov" << suffix(size) << "\t" << reg("ax", size) << ", ";
+	*out << frame(symbols[i]->_offset) << endl;
+    }
+
+    labelptr = &exit;
+    _body->generate();
+    labelptr = saved;
+
+    *out << exit << ":" << endl;
+    _operand = gettemp();
+    *out << "\tmov" << suffix(this) << "\t" << reg("ax", this) << ", " << this << endl;
 }
 
 /* 
@@ -691,85 +1150,455 @@ void LogicalOr::generate() {
 
 void Return::generate() {
 
-	_expr->generate(); 
-	cout << "\tmovl\t" << _expr << ",%eax" << endl; 
-	cout << "\tjmp\t" << *labelptr << endl; 
+	_expr->generate();
+	*out << "\tmov" << suffix(_expr) << "\t" << _expr << "," << reg("ax", _expr) << endl;
+	*out << "\tjmp\t" << *labelptr << endl; 
+}
+
+/*
+ * Function:	condition
+ *
+ * Description:	Return the condition code under which a comparison is
+ *		true, or null if the expression is not a comparison.
+ */
+
+static const char *condition(Expression *expr)
+{
+    if (dynamic_cast<LessThan *>(expr) != nullptr)
+	return "l";
+
+    if (dynamic_cast<GreaterThan *>(expr) != nullptr)
+	return "g";
+
+    if (dynamic_cast<LessOrEqual *>(expr) != nullptr)
+	return "le";
+
+    if (dynamic_cast<GreaterOrEqual *>(expr) != nullptr)
+	return "ge";
+
+    if (dynamic_cast<Equal *>(expr) != nullptr)
+	return "e";
+
+    if (dynamic_cast<NotEqual *>(expr) != nullptr)
+	return "ne";
+
+    return nullptr;
+}
+
+
+/*
+ * Function:	assignment
+ *
+ * Description:	Return the assignment that a branch of an if statement
+ *		consists of, looking through any blocks around it, or null
+ *		if the branch does anything else.
+ */
+
+static Assignment *assignment(Statement *stmt)
+{
+    vector<Statement **> stmts;
+
+
+    while (dynamic_cast<Block *>(stmt) != nullptr) {
+	stmts.clear();
+	stmt->substatements(stmts);
+
+	if (stmts.size() != 1)
+	    return nullptr;
+
+	stmt = *stmts[0];
+    }
+
+    return dynamic_cast<Assignment *>(stmt);
+}
+
+
+/*
+ * Function:	cheap
+ *
+ * Description:	Return whether an expression may be assigned to a variable
+ *		without a branch, being a variable or a number that needs
+ *		no code and cannot trap, of the same width.
+ */
+
+static bool cheap(Expression *expr, Identifier *var)
+{
+    if (!dynamic_cast<Identifier *>(expr) && !dynamic_cast<Number *>(expr))
+	return false;
+
+    if (expr->type().size() == 1 || var->type().size() == 1)
+	return false;
+
+    return expr->type().isScalar() && width(expr) == width(var);
+}
+
+
+/*
+ * Function:	prepare
+ *
+ * Description:	Generate code for the operands of a test if it is a
+ *		comparison, which need not be turned into a value, and
+ *		otherwise for the test itself.
+ */
+
+static void prepare(Expression *test)
+{
+    vector<Expression **> operands;
+
+
+    if (condition(test) != nullptr) {
+	test->operands(operands);
+	(*operands[0])->generate();
+	(*operands[1])->generate();
+    } else
+	test->generate();
+}
+
+
+/*
+ * Function:	compare
+ *
+ * Description:	Generate code to compare a test that has been prepared,
+ *		and return the condition code under which it is true.
+ */
+
+static const char *compare(Expression *test)
+{
+    vector<Expression **> operands;
+    Expression *left;
+
+
+    if (condition(test) == nullptr) {
+	*out << "\tmov" << suffix(test) << "\t" << test << "," << reg("dx", test) << endl;
+	*out << "\tcmp" << suffix(test) << "\t$0," << reg("dx", test) << endl;
+	return "ne";
+    }
+
+    test->operands(operands);
+    left = *operands[0];
+    *out << "\tmov" << suffix(left) << "\t" << left << "," << reg("dx", left) << endl;
+    *out << "\tcmp" << suffix(left) << "\t" << *operands[1] << "," << reg("dx", left) << endl;
+    return condition(test);
+}
+
+
+/*
+ * Function:	select
+ *
+ * Description:	Generate code for an if statement that only selects which
+ *		of two cheap values to assign to a variable, in which the
+ *		branch that assigns nothing assigns the variable itself,
+ *		returning false if it is not one.  The value is selected
+ *		by a conditional move, or if both are numbers, computed
+ *		from the flag set by the test, so that the statement has no
+ *		branch to mispredict.  A comparison is not generated as a
+ *		value, but compared directly.
+ */
+
+static bool select(Expression *test, Statement *thenStmt, Statement *elseStmt)
+{
+    vector<Expression **> slots;
+    Expression *value, *fallback;
+    Assignment *assign;
+    Identifier *var;
+    const char *cc;
+    string source;
+    long v, f;
+
+
+    if ((assign = assignment(thenStmt)) == nullptr)
+	return false;
+
+    assign->operands(slots);
+
+    if ((var = dynamic_cast<Identifier *>(*slots[0])) == nullptr)
+	return false;
+
+    value = *slots[1];
+    fallback = var;
+
+    if (elseStmt != nullptr) {
+	if ((assign = assignment(elseStmt)) == nullptr)
+	    return false;
+
+	slots.clear();
+	assign->operands(slots);
+
+	if (!dynamic_cast<Identifier *>(*slots[0]))
+	    return false;
+
+	if (static_cast<Identifier *>(*slots[0])->symbol() != var->symbol())
+	    return false;
+
+	fallback = *slots[1];
+    }
+
+    if (!cheap(value, var) || !cheap(fallback, var))
+	return false;
+
+    prepare(test);
+    var->generate();
+    value->generate();
+    fallback->generate();
+
+    if (value->constant(v) && fallback->constant(f)) {
+	cc = compare(test);
+	*out << "\tset" << cc << "\t%al" << endl;
+	*out << "\tmovzbl\t%al,%eax" << endl;
+
+	if (v - f != 1)
+	    *out << "\timull\t$" << (int) (v - f) << ",%eax" << endl;
+
+	if (f != 0)
+	    *out << "\taddl\t$" << f << ",%eax" << endl;
+
+	*out << "\tmovl\t%eax," << var << endl;
+	return true;
+    }
+
+    *out << "\tmov" << suffix(var) << "\t" << fallback << "," << reg("ax", var) << endl;
+
+    if (dynamic_cast<Number *>(value) != nullptr) {
+	*out << "\tmov" << suffix(var) << "\t" << value << "," << reg("cx", var) << endl;
+	source = reg("cx", var);
+    } else {
+	stringstream ss;
+
+	ss << value;
+	source = ss.str();
+    }
+
+    cc = compare(test);
+    *out << "\tcmov" << cc << suffix(var) << "\t" << source << "," << reg("ax", var) << endl;
+    *out << "\tmov" << suffix(var) << "\t" << reg("ax", var) << "," << var << endl;
+    return true;
 }
 
+
+/*
+ * Function:	inverse
+ *
+ * Description:	Return the condition code under which a test with the
+ *		given one is false.
+ */
+
+static const char *inverse(const string &cc)
+{
+    static const char *codes[] = {"l", "ge", "g", "le", "e", "ne"};
+
+
+    for (unsigned i = 0; i < sizeof(codes) / sizeof(codes[0]); i ++)
+	if (cc == codes[i])
+	    return codes[i ^ 1];
+
+    return nullptr;
+}
+
+
+/*
+ * Function:	branch
+ *
+ * Description:	Generate code for a test and a jump to the given label if
+ *		the test has the given sense.
+ */
+
+static void branch(Expression *test, bool sense, const Label &label)
+{
+    const char *cc;
+
+
+    prepare(test);
+    cc = compare(test);
+    *out << "\tj" << (sense ? cc : inverse(cc)) << "\t" << label << endl;
+}
+
+
 /* 
  * Function:	If::generate()
  *
- * Description: Generate code for an IF-THEN-ELSE statement
+ * Description: Generate code for an IF-THEN-ELSE statement, unless it
+ *		only selects a value to assign.
  *
  */
 
 void If::generate() {
 	
 	Label elsestmt, exit; 
+
+	if (select(_expr, _thenStmt, _elseStmt))
+	    return;
 	
 	_expr->generate(); 
-	cout << "\tmovl\t" << _expr << ",%eax" << endl; 
-	cout << "\tcmpl\t$0,%eax" << endl; 
-	cout << "\tje\t" << elsestmt << endl; 
+	*out << "\tmov" << suffix(_expr) << "\t" << _expr << "," << reg("ax", _expr) << endl;
+	*out << "\tcmp" << suffix(_expr) << "\t$0," << reg("ax", _expr) << endl; 
+	*out << "\tje\t" << elsestmt << endl; 
 	_thenStmt->generate(); 
-	cout << "\tjmp\t" << exit << endl; 
-	cout << elsestmt << ":" << endl; 
+	*out << "\tjmp\t" << exit << endl; 
+	*out << elsestmt << ":" << endl; 
     if (_elseStmt != nullptr) 
 		_elseStmt->generate();	
-	cout << exit << ":" << endl;
+	*out << exit << ":" << endl;
 }
 
-/* 
- * Function:	While::generate()
+/*
+ * Function:	straight
  *
- * Description: Generate code for a WHILE loop.
+ * Description:	Return whether an expression is straight-line code, with no
+ *		branch or call of its own, and so is cheap to copy.
+ */
+
+static bool straight(Expression *expr)
+{
+    vector<Expression **> operands;
+
+
+    if (dynamic_cast<LogicalAnd *>(expr) || dynamic_cast<LogicalOr *>(expr))
+	return false;
+
+    if (dynamic_cast<Call *>(expr) || dynamic_cast<Inline *>(expr))
+	return false;
+
+    expr->operands(operands);
+
+    for (unsigned i = 0; i < operands.size(); i ++)
+	if (!straight(*operands[i]))
+	    return false;
+
+    return true;
+}
+
+
+/*
+ * Function:	enter
+ *
+ * Description:	Generate code to enter a loop with the given test, whose
+ *		body starts at the top, aligned, and whose test is at the
+ *		bottom, after the body.  A test that is straight-line code
+ *		is copied to guard the loop, jumping to the exit if false,
+ *		and otherwise the loop is entered by jumping to the test,
+ *		as the interpreter does.
+ */
+
+static void enter(Expression *test, const Label &top, const Label &bottom, const Label &exit)
+{
+    if (straight(test))
+	branch(test, false, exit);
+    else
+	*out << "\tjmp\t" << bottom << endl;
+
+    *out << "\t.p2align\t4" << endl;
+    *out << top << ":" << endl;
+}
+
+
+/*
+ * Function:	While::generate
  *
+ * Description:	Generate code for a while loop, with the test at the bottom
+ *		so that each iteration takes one branch.
  */
 
-void While::generate() {
-	
-	Label loop, exit; 
+void While::generate()
+{
+    Label loop, test, exit;
 
-	cout << loop << ":" << endl;
-	_expr->generate(); 
-	cout << "\tmovl\t" << _expr << ",%eax" << endl; 
-	cout << "\tcmpl\t$0,%eax" << endl; 
-	cout << "\tje\t" << exit << endl; 
-	
-	_stmt->generate(); 
-	cout << "\tjmp\t" << loop << endl; 
 
-	cout << exit << ":" << endl; 
+    enter(_expr, loop, test, exit);
+    _stmt->generate();
+    *out << test << ":" << endl;
+    branch(_expr, true, loop);
+    *out << exit << ":" << endl;
 }
 
-/* 
- * Function:	For::generate()
+
+/*
+ * Function:	For::generate
  *
- * Description: Generate code for a FOR loop.
+ * Description:	Generate code for a for loop, with the test at the bottom
+ *		so that each iteration takes one branch.
+ */
+
+void For::generate()
+{
+    Label loop, test, exit;
+
+
+    _init->generate();
+    enter(_expr, loop, test, exit);
+    _stmt->generate();
+    _incr->generate();
+    *out << test << ":" << endl;
+    branch(_expr, true, loop);
+    *out << exit << ":" << endl;
+}
+
+/*
+ * Function:	Vector::generate
  *
+ * Description:	Generate SSE2 code for a vector assignment.  The scalar
+ *		arguments are generated first, and then the operations
+ *		are done on a stack of vectors in %xmm0 upward, with the
+ *		register above the top free for a constant or a zero.  The
+ *		numbers of the lanes are kept with the string literals.
  */
 
-void For::generate() {
+void Vector::generate()
+{
+    string ax = reg("ax", SIZEOF_PTR);
+    unsigned n = 0;
+    stringstream ss;
+    Label lanes;
 
-	Label loop, exit;
 
-	/* initialize */
-	_init->generate(); 
+    _dst->generate();
 
-	/* start of loop */
-	cout << loop << ":" << endl; 
-	_expr->generate(); 
-	cout << "\tmovl\t" << _expr << ",%eax" << endl; 
-	cout << "\tcmpl\t$0,%eax" << endl; 
-	cout << "\tje\t" << exit << endl;
+    for (unsigned i = 0; i < _args.size(); i ++)
+	if (_args[i] != nullptr)
+	    _args[i]->generate();
+
+    for (unsigned i = 0; i < _ops.size(); i ++) {
+	if (_ops[i] == LOAD) {
+	    *out << "	mov" << suffix(SIZEOF_PTR) << "	" << _args[i] << ", " << ax << endl;
+	    *out << "	movdqu	(" << ax << "), %xmm" << n ++ << endl;
+
+	} else if (_ops[i] == SPLAT || _ops[i] == STEP) {
+	    *out << "	movl	" << _args[i] << ", %eax" << endl;
+	    *out << "	movd	%eax, %xmm" << n << endl;
+	    *out << "	pshufd	$0, %xmm" << n << ", %xmm" << n << endl;
+
+	    if (_ops[i] == STEP) {
+		if (ss.str().empty())
+		    ss << lanes;
+
+		*out << "	movdqu	" << lanes << (target->bits == 64 ? "(%rip)" : "");
+		*out << ", %xmm" << n + 1 << endl;
+		*out << "	paddd	%xmm" << n + 1 << ", %xmm" << n << endl;
+	    }
 
-	_stmt->generate();
-    _incr->generate(); 	
-	cout << "\tjmp\t" << loop << endl; 
+	    n ++;
 
-	cout << exit << ":" << endl; 
+	} else if (_ops[i] == NEGATE) {
+	    *out << "	pxor	%xmm" << n << ", %xmm" << n << endl;
+	    *out << "	psubd	%xmm" << n - 1 << ", %xmm" << n << endl;
+	    *out << "	movdqa	%xmm" << n << ", %xmm" << n - 1 << endl;
+
+	} else {
+	    *out << (_ops[i] == ADD ? "	paddd" : "	psubd") << "	%xmm" << n - 1;
+	    *out << ", %xmm" << n - 2 << endl;
+	    n --;
+	}
+    }
+
+    *out << "	mov" << suffix(SIZEOF_PTR) << "	" << _dst << ", " << ax << endl;
+    *out << "	movdqu	%xmm0, (" << ax << ")" << endl;
+
+    if (!ss.str().empty()) {
+	ss << ":	.long	0, 1, 2, 3";
+	stringlabels.push_back(ss.str());
+    }
 }
 
+
 /* 
  * Function: 	Promote::generate()
  *
@@ -779,11 +1608,19 @@ void For::generate() {
 
 void Promote::generate() {
 
-	Type t = _expr->type(); 
-	_expr->generate(); 
-	if (t.size() == 1) {
-		_operand = gettemp(); 
-		cout << "\tmovsbl\t" << _expr << ",%eax" << endl;
-		cout << "\tmovl\t%eax," << this << endl; 
+	Type t = _expr->type();
+	_expr->generate();
+	if (_expr->_operand[0] == '$') {
+		_operand = _expr->_operand;
+	} else if (t.size() == 1) {
+		_operand = gettemp();
+		*out << "\tmovsb" << suffix(this) << "\t" << _expr << "," << reg("ax", this) << endl;
+		*out << "\tmov" << suffix(this) << "\t" << reg("ax", this) << "," << this << endl;
+	} else if (width(this) > width(_expr)) {
+		_operand = gettemp();
+		*out << "\tmovslq\t" << _expr << ",%rax" << endl;
+		*out << "\tmovq\t%rax," << this << endl;
+	} else {
+		_operand = _expr->_operand;
 	}
 }
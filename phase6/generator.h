@@ -4,14 +4,34 @@
  * Description:	This file contains the function declarations for the code
  *		generator for Simple C.  Most of the function declarations
  *		are actually member functions provided as part of Tree.h.
+ *		Functions are generated without a frame pointer unless
+ *		it is asked for, as a profiler walking the stack might.
  */
 
 # ifndef GENERATOR_H
 # define GENERATOR_H
 # include "Tree.h"
 # include <string>
+# include <vector>
+# include <iosfwd>
 
+/* The code for a single function, with its labels numbered from zero so
+   that it may be spliced into any translation unit, and what the
+   functions after it need to know of it when its body is skipped. */
+
+struct Fragment {
+    std::string text;
+    std::vector<std::string> strings;
+    unsigned labels;
+    std::string summary;
+};
+
+extern bool omitFramePointer;
+
+void initGenerator(std::ostream &ostr);
 void generateGlobals(const Symbols &globals);
+void generateFragment(Function *function, Fragment &fragment);
+void emitFragment(const Fragment &fragment);
 std::string gettemp(); 
 
 # endif /* GENERATOR_H */
@@ -0,0 +1,449 @@
+/*
+ * File:	induction.cpp
+ *
+ * Description:	This file contains the function definitions for strength
+ *		reduction of induction variables.
+ *
+ *		A basic induction variable of a loop is a local int that
+ *		the loop assigns only by adding or subtracting a constant
+ *		in statements evaluated in every iteration: the increment
+ *		of a for statement or statements at the top of the body,
+ *		of which there are several once the loop is unrolled.
+ *		Each subscript a[i] with i such a variable and a
+ *		invariant computes a + i * size, a linear function of i.
+ *		We compute each such address just once, before the loop,
+ *		into a pointer that is then advanced by step * size
+ *		wherever i is, and so replace a multiply and an add in
+ *		every iteration with a single add.  A subscript a[i + c],
+ *		with c a constant, as in an unrolled loop, uses the same
+ *		pointer, offset by c * size.
+ *
+ *		If, after that, the variable is read nowhere in the function
+ *		but in its own increments and in comparing it with an
+ *		invariant bound in the test, then the test compares the
+ *		pointer with the address of the bound instead, and the
+ *		variable, no longer needed, is no longer incremented.
+ */
+
+# include <cstdlib>
+# include "optimizer.h"
+# include "inliner.h"
+# include "tokens.h"
+
+using namespace std;
+
+struct Derived {
+    string key;
+    Expression *expr;
+    Expression *base;
+    Multiply *index;
+    vector<Expression **> slots;
+    vector<long> offsets;
+    Symbol *symbol;
+};
+
+static thread_local Effects loop;
+static thread_local const Symbol *counter;
+static thread_local vector<Statement **> steps;
+static thread_local vector<Derived> derived;
+
+
+/*
+ * Function:	linear
+ *
+ * Description:	Return whether an expression is the address base + (i +
+ *		offset) * size, with i the counter, perhaps widened, the
+ *		offset a constant, perhaps zero, and base an invariant
+ *		that is safe to compute before the loop.
+ */
+
+static bool linear(Expression *expr, Expression *&base, Multiply *&index, long &offset)
+{
+    vector<Expression **> exprs, factors, terms;
+    Expression *factor;
+    long value;
+
+
+    if (dynamic_cast<Add *>(expr) == nullptr || !expr->type().isPointer())
+	return false;
+
+    expr->operands(exprs);
+
+    for (unsigned i = 0; i < 2; i ++) {
+	index = dynamic_cast<Multiply *>(*exprs[i]);
+	base = *exprs[1 - i];
+
+	if (index == nullptr || !base->type().isPointer())
+	    continue;
+
+	factors.clear();
+	index->operands(factors);
+	factor = *factors[0];
+	offset = 0;
+
+	if (dynamic_cast<Promote *>(factor) != nullptr)
+	    factor = *operand(factor);
+
+	if (dynamic_cast<Add *>(factor) || dynamic_cast<Subtract *>(factor)) {
+	    terms.clear();
+	    factor->operands(terms);
+
+	    if (!(*terms[1])->constant(offset))
+		continue;
+
+	    offset = dynamic_cast<Subtract *>(factor) ? -offset : offset;
+	    factor = *terms[0];
+	}
+
+	if (!names(factor, counter) || !(*factors[1])->constant(value))
+	    continue;
+
+	if (value > 0 && invariant(base, loop) && !traps(base))
+	    return true;
+    }
+
+    return false;
+}
+
+
+/*
+ * Function:	search
+ *
+ * Description:	Search a statement for addresses that are linear in the
+ *		counter, skipping its increments.  Those with the same
+ *		base and size differ only by a constant, and so share a
+ *		pointer.
+ */
+
+static void search(Statement *stmt)
+{
+    vector<Expression **> exprs;
+    vector<Statement **> stmts;
+    Expression *base;
+    Multiply *index;
+    long offset;
+    unsigned i;
+
+
+    for (unsigned i = 0; i < steps.size(); i ++)
+	if (stmt == *steps[i])
+	    return;
+
+    stmt->operands(exprs);
+    stmt->substatements(stmts);
+
+    for (unsigned j = 0; j < exprs.size(); j ++) {
+	if (!linear(*exprs[j], base, index, offset)) {
+	    search(*exprs[j]);
+	    continue;
+	}
+
+	string name = key(base) + key(*operand(index, 1));
+
+	for (i = 0; i < derived.size(); i ++)
+	    if (derived[i].key == name)
+		break;
+
+	if (i == derived.size()) {
+	    derived.push_back(Derived());
+	    derived[i].key = name;
+	    derived[i].expr = *exprs[j];
+	    derived[i].base = base;
+	    derived[i].index = index;
+	}
+
+	derived[i].slots.push_back(exprs[j]);
+	derived[i].offsets.push_back(offset);
+    }
+
+    for (unsigned j = 0; j < stmts.size(); j ++)
+	search(*stmts[j]);
+}
+
+
+/*
+ * Function:	scale
+ *
+ * Description:	Return the address base + expr * size, scaling expr as
+ *		the given index was, or folding it if it is a constant.
+ */
+
+static Expression *scale(const Derived &d, Expression *expr)
+{
+    vector<Expression **> factors;
+    Renaming renaming;
+    long value, size;
+
+
+    d.index->operands(factors);
+
+    if (expr->constant(value) && value >= 0 && (*factors[1])->constant(size)) {
+	if (value == 0)
+	    return d.base->clone(renaming);
+
+	expr = new Number(to_string(value * size));
+	return new Add(d.base->clone(renaming), expr, d.expr->type());
+    }
+
+    if (dynamic_cast<Promote *>(*factors[0]) != nullptr)
+	expr = new Promote(expr, (*factors[0])->type());
+
+    expr = new Multiply(expr, (*factors[1])->clone(renaming), d.index->type());
+    return new Add(d.base->clone(renaming), expr, d.expr->type());
+}
+
+
+/*
+ * Function:	initial
+ *
+ * Description:	Return the constant to which a for statement initializes
+ *		the counter, if it does.
+ */
+
+static Expression *initial(Statement *stmt)
+{
+    vector<Expression **> exprs;
+    vector<Statement **> stmts;
+    long value;
+
+
+    if (dynamic_cast<For *>(stmt) == nullptr)
+	return nullptr;
+
+    stmt->substatements(stmts);
+
+    if (dynamic_cast<Assignment *>(*stmts[0]) == nullptr)
+	return nullptr;
+
+    (*stmts[0])->operands(exprs);
+
+    if (!names(*exprs[0], counter) || !(*exprs[1])->constant(value))
+	return nullptr;
+
+    return *exprs[1];
+}
+
+
+/*
+ * Function:	bound
+ *
+ * Description:	Return the slots of the counter and of an invariant bound
+ *		if the test compares them in a way that is preserved by
+ *		comparing their addresses instead, given the sign of the
+ *		step.
+ */
+
+static bool bound(Expression *test, long sign, Expression **&var, Expression **&limit)
+{
+    vector<Expression **> exprs;
+    bool ascending, descending;
+
+
+    test->operands(exprs);
+
+    if (exprs.size() != 2)
+	return false;
+
+    if (names(*exprs[0], counter)) {
+	var = exprs[0];
+	limit = exprs[1];
+	ascending = dynamic_cast<LessThan *>(test) || dynamic_cast<LessOrEqual *>(test);
+	descending = dynamic_cast<GreaterThan *>(test) || dynamic_cast<GreaterOrEqual *>(test);
+
+    } else if (names(*exprs[1], counter)) {
+	var = exprs[1];
+	limit = exprs[0];
+	ascending = dynamic_cast<GreaterThan *>(test) || dynamic_cast<GreaterOrEqual *>(test);
+	descending = dynamic_cast<LessThan *>(test) || dynamic_cast<LessOrEqual *>(test);
+
+    } else
+	return false;
+
+    if (!invariant(*limit, loop) || (*limit)->type() != Type(INT))
+	return false;
+
+    if (dynamic_cast<NotEqual *>(test) != nullptr)
+	return true;
+
+    return sign > 0 ? ascending : descending;
+}
+
+
+/*
+ * Function:	displace
+ *
+ * Description:	Return the address that is a pointer plus a constant
+ *		number of bytes, or just the pointer if the constant is zero.
+ */
+
+static Expression *displace(const Symbol *symbol, long delta)
+{
+    Expression *expr = new Identifier(symbol);
+    Number *number = new Number(to_string(labs(delta)));
+
+
+    if (delta > 0)
+	return new Add(expr, number, symbol->type());
+
+    if (delta < 0)
+	return new Subtract(expr, number, symbol->type());
+
+    return expr;
+}
+
+
+/*
+ * Function:	reduce
+ *
+ * Description:	Reduce the strength of the addresses linear in the
+ *		counter, adding the pointers and their initialization to
+ *		the preheader.  Return whether anything was done.
+ */
+
+static bool reduce(Function *function, Statement *stmt, long total,
+		   Scope *decls, Statements &preheader)
+{
+    vector<Statements> increments;
+    Expression **var, **limit;
+    Expression *start, *next;
+    unsigned reads, writes;
+    Symbol *symbol;
+    long size;
+
+
+    derived.clear();
+    search(stmt);
+
+    if (derived.empty())
+	return false;
+
+    start = initial(stmt);
+    increments.resize(steps.size());
+
+    for (unsigned i = 0; i < derived.size(); i ++) {
+	Derived &d = derived[i];
+
+	d.symbol = temporary(decls, d.expr->type());
+	next = scale(d, start != nullptr ? start : new Identifier(counter));
+	preheader.push_back(new Assignment(new Identifier(d.symbol), next));
+	(*operand(d.index, 1))->constant(size);
+
+	for (unsigned j = 0; j < d.slots.size(); j ++)
+	    *d.slots[j] = displace(d.symbol, d.offsets[j] * size);
+
+	for (unsigned j = 0; j < steps.size(); j ++) {
+	    next = displace(d.symbol, step(*steps[j], counter) * size);
+	    increments[j].push_back(new Assignment(new Identifier(d.symbol), next));
+	}
+    }
+
+    writes = 0;
+    reads = count(function->body(), counter, writes);
+
+    if (reads == steps.size() + 1 && bound(*operand(stmt), total, var, limit)) {
+	symbol = temporary(decls, derived[0].expr->type());
+	preheader.push_back(new Assignment(new Identifier(symbol), scale(derived[0], *limit)));
+	*var = new Identifier(derived[0].symbol);
+	*limit = new Identifier(symbol);
+
+    } else
+	for (unsigned j = 0; j < steps.size(); j ++)
+	    increments[j].insert(increments[j].begin(), *steps[j]);
+
+    for (unsigned j = 0; j < steps.size(); j ++)
+	*steps[j] = new Block(new Scope(), increments[j]);
+
+    return true;
+}
+
+
+/*
+ * Function:	optimize
+ *
+ * Description:	Reduce the strength of the induction variables of a loop,
+ *		replacing the loop with a block that initializes the new
+ *		pointers after any initialization of a for statement and
+ *		then runs the loop.
+ */
+
+static void optimize(Function *function, Statement **slot)
+{
+    Statement *stmt = *slot;
+    set<const Symbol *>::iterator it;
+    Statements preheader, outer;
+    vector<Statement **> stmts;
+    Scope *decls;
+    bool changed;
+    long total;
+
+
+    loop = Effects();
+    effects(stmt, loop);
+    decls = new Scope();
+    changed = false;
+
+    for (it = loop.assigned.begin(); it != loop.assigned.end(); it ++) {
+	counter = *it;
+
+	if (counter->type() != Type(INT))
+	    continue;
+
+	if ((total = induction(stmt, counter, steps)) != 0)
+	    changed |= reduce(function, stmt, total, decls, preheader);
+    }
+
+    if (!changed)
+	return;
+
+    stmt->substatements(stmts);
+
+    if (dynamic_cast<For *>(stmt) != nullptr) {
+	outer.push_back(*stmts[0]);
+	*stmts[0] = new Block(new Scope(), Statements());
+    }
+
+    outer.insert(outer.end(), preheader.begin(), preheader.end());
+    outer.push_back(stmt);
+    *slot = new Block(decls, outer);
+}
+
+
+/*
+ * Function:	visit
+ *
+ * Description:	Reduce the strength of the induction variables of every
+ *		loop in a statement, innermost loops first.
+ */
+
+static void visit(Function *function, Statement **slot)
+{
+    vector<Statement **> stmts;
+
+
+    (*slot)->substatements(stmts);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	visit(function, stmts[i]);
+
+    if (dynamic_cast<While *>(*slot) || dynamic_cast<For *>(*slot))
+	optimize(function, slot);
+}
+
+
+/*
+ * Function:	reduceInductions
+ *
+ * Description:	Reduce the strength of the induction variables of the
+ *		loops of a function.
+ */
+
+void reduceInductions(Function *function)
+{
+    vector<Statement **> stmts;
+
+
+    function->body()->substatements(stmts);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	visit(function, stmts[i]);
+}
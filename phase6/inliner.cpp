@@ -0,0 +1,829 @@
+/*
+ * File:	inliner.cpp
+ *
+ * Description:	This file contains the public and member function
+ *		definitions for inlining calls to small leaf functions.
+ *
+ *		As each function is parsed, we record the functions it
+ *		calls in the call graph.  Once its body is complete, its
+ *		cost is measured as the number of nodes in its tree.  A
+ *		function that calls nothing, or whose every call was itself
+ *		inlined, and whose cost is within the threshold, becomes a
+ *		candidate for inlining.  Since Simple C is compiled in a
+ *		single pass, only calls to functions already defined can
+ *		be inlined, and a recursive function is never a leaf.
+ *
+ *		A call to a candidate is replaced by an Inline expression
+ *		holding a copy of the body, in which the parameters and
+ *		other variables are replaced by fresh ones.  The backends
+ *		assign the arguments to the parameters, and a return
+ *		becomes a jump to the end of the copy, where the value is
+ *		found as though the call had been made.
+ */
+
+# include <map>
+# include <set>
+# include <ostream>
+# include "Tree.h"
+# include "checker.h"
+# include "inliner.h"
+# include "lexer.h"
+
+using namespace std;
+
+unsigned inlineThreshold = 24;
+bool inlineReport = false;
+
+static thread_local map<const Symbol *, const Function *> candidates;
+static thread_local map<const Symbol *, set<const Symbol *> > graph;
+static thread_local Symbol *current;
+static thread_local ostream *diagnostics;
+
+
+/*
+ * Function:	clone
+ *
+ * Description:	Copy a list of expressions.
+ */
+
+static Expressions clone(const Expressions &exprs, Renaming &renaming)
+{
+    Expressions copies;
+
+    for (unsigned i = 0; i < exprs.size(); i ++)
+	copies.push_back(exprs[i]->clone(renaming));
+
+    return copies;
+}
+
+
+/*
+ * Function:	cost
+ *
+ * Description:	Return the total cost of a list of expressions.
+ */
+
+static unsigned cost(const Expressions &exprs)
+{
+    unsigned total = 0;
+
+    for (unsigned i = 0; i < exprs.size(); i ++)
+	total += exprs[i]->cost();
+
+    return total;
+}
+
+
+/*
+ * Function:	String::clone
+ */
+
+Expression *String::clone(Renaming &renaming) const
+{
+    return new String(_value);
+}
+
+
+/*
+ * Function:	String::cost
+ */
+
+unsigned String::cost() const
+{
+    return 1;
+}
+
+
+/*
+ * Function:	Identifier::clone
+ *
+ * Description:	Copy an identifier, replacing a variable of the function
+ *		being inlined with its fresh copy.  Globals are unchanged.
+ */
+
+Expression *Identifier::clone(Renaming &renaming) const
+{
+    Renaming::iterator it = renaming.find(_symbol);
+
+    return new Identifier(it != renaming.end() ? it->second : _symbol);
+}
+
+
+/*
+ * Function:	Identifier::cost
+ */
+
+unsigned Identifier::cost() const
+{
+    return 1;
+}
+
+
+/*
+ * Function:	Number::clone
+ */
+
+Expression *Number::clone(Renaming &renaming) const
+{
+    return new Number(_value);
+}
+
+
+/*
+ * Function:	Number::cost
+ */
+
+unsigned Number::cost() const
+{
+    return 1;
+}
+
+
+/*
+ * Function:	Call::clone
+ */
+
+Expression *Call::clone(Renaming &renaming) const
+{
+    return new Call(_id, ::clone(_args, renaming), _type);
+}
+
+
+/*
+ * Function:	Call::cost
+ */
+
+unsigned Call::cost() const
+{
+    return 1 + ::cost(_args);
+}
+
+
+/*
+ * Function:	Inline::clone
+ */
+
+Expression *Inline::clone(Renaming &renaming) const
+{
+    Block *body = static_cast<Block *>(_body->clone(renaming));
+
+    return new Inline(_id, ::clone(_args, renaming), body, _type);
+}
+
+
+/*
+ * Function:	Inline::cost
+ *
+ * Description:	An inlined call costs as much as the body it expanded to.
+ */
+
+unsigned Inline::cost() const
+{
+    return ::cost(_args) + _body->cost();
+}
+
+
+/*
+ * Function:	Not::clone
+ */
+
+Expression *Not::clone(Renaming &renaming) const
+{
+    return new Not(_expr->clone(renaming), _type);
+}
+
+
+/*
+ * Function:	Not::cost
+ */
+
+unsigned Not::cost() const
+{
+    return 1 + _expr->cost();
+}
+
+
+/*
+ * Function:	Negate::clone
+ */
+
+Expression *Negate::clone(Renaming &renaming) const
+{
+    return new Negate(_expr->clone(renaming), _type);
+}
+
+
+/*
+ * Function:	Negate::cost
+ */
+
+unsigned Negate::cost() const
+{
+    return 1 + _expr->cost();
+}
+
+
+/*
+ * Function:	Dereference::clone
+ */
+
+Expression *Dereference::clone(Renaming &renaming) const
+{
+    return new Dereference(_expr->clone(renaming), _type);
+}
+
+
+/*
+ * Function:	Dereference::cost
+ */
+
+unsigned Dereference::cost() const
+{
+    return 1 + _expr->cost();
+}
+
+
+/*
+ * Function:	Address::clone
+ */
+
+Expression *Address::clone(Renaming &renaming) const
+{
+    return new Address(_expr->clone(renaming), _type);
+}
+
+
+/*
+ * Function:	Address::cost
+ */
+
+unsigned Address::cost() const
+{
+    return 1 + _expr->cost();
+}
+
+
+/*
+ * Function:	Promote::clone
+ */
+
+Expression *Promote::clone(Renaming &renaming) const
+{
+    return new Promote(_expr->clone(renaming), _type);
+}
+
+
+/*
+ * Function:	Promote::cost
+ */
+
+unsigned Promote::cost() const
+{
+    return 1 + _expr->cost();
+}
+
+
+/*
+ * Function:	Multiply::clone
+ */
+
+Expression *Multiply::clone(Renaming &renaming) const
+{
+    return new Multiply(_left->clone(renaming), _right->clone(renaming), _type);
+}
+
+
+/*
+ * Function:	Multiply::cost
+ */
+
+unsigned Multiply::cost() const
+{
+    return 1 + _left->cost() + _right->cost();
+}
+
+
+/*
+ * Function:	Divide::clone
+ */
+
+Expression *Divide::clone(Renaming &renaming) const
+{
+    return new Divide(_left->clone(renaming), _right->clone(renaming), _type);
+}
+
+
+/*
+ * Function:	Divide::cost
+ */
+
+unsigned Divide::cost() const
+{
+    return 1 + _left->cost() + _right->cost();
+}
+
+
+/*
+ * Function:	Remainder::clone
+ */
+
+Expression *Remainder::clone(Renaming &renaming) const
+{
+    return new Remainder(_left->clone(renaming), _right->clone(renaming), _type);
+}
+
+
+/*
+ * Function:	Remainder::cost
+ */
+
+unsigned Remainder::cost() const
+{
+    return 1 + _left->cost() + _right->cost();
+}
+
+
+/*
+ * Function:	Add::clone
+ */
+
+Expression *Add::clone(Renaming &renaming) const
+{
+    return new Add(_left->clone(renaming), _right->clone(renaming), _type);
+}
+
+
+/*
+ * Function:	Add::cost
+ */
+
+unsigned Add::cost() const
+{
+    return 1 + _left->cost() + _right->cost();
+}
+
+
+/*
+ * Function:	Subtract::clone
+ */
+
+Expression *Subtract::clone(Renaming &renaming) const
+{
+    return new Subtract(_left->clone(renaming), _right->clone(renaming), _type);
+}
+
+
+/*
+ * Function:	Subtract::cost
+ */
+
+unsigned Subtract::cost() const
+{
+    return 1 + _left->cost() + _right->cost();
+}
+
+
+/*
+ * Function:	LessThan::clone
+ */
+
+Expression *LessThan::clone(Renaming &renaming) const
+{
+    return new LessThan(_left->clone(renaming), _right->clone(renaming), _type);
+}
+
+
+/*
+ * Function:	LessThan::cost
+ */
+
+unsigned LessThan::cost() const
+{
+    return 1 + _left->cost() + _right->cost();
+}
+
+
+/*
+ * Function:	GreaterThan::clone
+ */
+
+Expression *GreaterThan::clone(Renaming &renaming) const
+{
+    return new GreaterThan(_left->clone(renaming), _right->clone(renaming), _type);
+}
+
+
+/*
+ * Function:	GreaterThan::cost
+ */
+
+unsigned GreaterThan::cost() const
+{
+    return 1 + _left->cost() + _right->cost();
+}
+
+
+/*
+ * Function:	LessOrEqual::clone
+ */
+
+Expression *LessOrEqual::clone(Renaming &renaming) const
+{
+    return new LessOrEqual(_left->clone(renaming), _right->clone(renaming), _type);
+}
+
+
+/*
+ * Function:	LessOrEqual::cost
+ */
+
+unsigned LessOrEqual::cost() const
+{
+    return 1 + _left->cost() + _right->cost();
+}
+
+
+/*
+ * Function:	GreaterOrEqual::clone
+ */
+
+Expression *GreaterOrEqual::clone(Renaming &renaming) const
+{
+    return new GreaterOrEqual(_left->clone(renaming), _right->clone(renaming), _type);
+}
+
+
+/*
+ * Function:	GreaterOrEqual::cost
+ */
+
+unsigned GreaterOrEqual::cost() const
+{
+    return 1 + _left->cost() + _right->cost();
+}
+
+
+/*
+ * Function:	Equal::clone
+ */
+
+Expression *Equal::clone(Renaming &renaming) const
+{
+    return new Equal(_left->clone(renaming), _right->clone(renaming), _type);
+}
+
+
+/*
+ * Function:	Equal::cost
+ */
+
+unsigned Equal::cost() const
+{
+    return 1 + _left->cost() + _right->cost();
+}
+
+
+/*
+ * Function:	NotEqual::clone
+ */
+
+Expression *NotEqual::clone(Renaming &renaming) const
+{
+    return new NotEqual(_left->clone(renaming), _right->clone(renaming), _type);
+}
+
+
+/*
+ * Function:	NotEqual::cost
+ */
+
+unsigned NotEqual::cost() const
+{
+    return 1 + _left->cost() + _right->cost();
+}
+
+
+/*
+ * Function:	LogicalAnd::clone
+ */
+
+Expression *LogicalAnd::clone(Renaming &renaming) const
+{
+    return new LogicalAnd(_left->clone(renaming), _right->clone(renaming), _type);
+}
+
+
+/*
+ * Function:	LogicalAnd::cost
+ */
+
+unsigned LogicalAnd::cost() const
+{
+    return 1 + _left->cost() + _right->cost();
+}
+
+
+/*
+ * Function:	LogicalOr::clone
+ */
+
+Expression *LogicalOr::clone(Renaming &renaming) const
+{
+    return new LogicalOr(_left->clone(renaming), _right->clone(renaming), _type);
+}
+
+
+/*
+ * Function:	LogicalOr::cost
+ */
+
+unsigned LogicalOr::cost() const
+{
+    return 1 + _left->cost() + _right->cost();
+}
+
+
+/*
+ * Function:	Assignment::clone
+ */
+
+Statement *Assignment::clone(Renaming &renaming) const
+{
+    return new Assignment(_left->clone(renaming), _right->clone(renaming));
+}
+
+
+/*
+ * Function:	Assignment::cost
+ */
+
+unsigned Assignment::cost() const
+{
+    return 1 + _left->cost() + _right->cost();
+}
+
+
+/*
+ * Function:	Return::clone
+ */
+
+Statement *Return::clone(Renaming &renaming) const
+{
+    return new Return(_expr->clone(renaming));
+}
+
+
+/*
+ * Function:	Return::cost
+ */
+
+unsigned Return::cost() const
+{
+    return 1 + _expr->cost();
+}
+
+
+/*
+ * Function:	Block::clone
+ *
+ * Description:	Copy a block, declaring a fresh variable for each of its
+ *		own before copying its statements.
+ */
+
+Statement *Block::clone(Renaming &renaming) const
+{
+    const Symbols &symbols = _decls->symbols();
+    Scope *decls = new Scope();
+    Statements stmts;
+    Symbol *symbol;
+
+
+    for (unsigned i = 0; i < symbols.size(); i ++) {
+	symbol = new Symbol(symbols[i]->name(), symbols[i]->type());
+	renaming[symbols[i]] = symbol;
+	decls->insert(symbol);
+    }
+
+    for (unsigned i = 0; i < _stmts.size(); i ++)
+	stmts.push_back(_stmts[i]->clone(renaming));
+
+    return new Block(decls, stmts);
+}
+
+
+/*
+ * Function:	Block::cost
+ */
+
+unsigned Block::cost() const
+{
+    unsigned total = 0;
+
+    for (unsigned i = 0; i < _stmts.size(); i ++)
+	total += _stmts[i]->cost();
+
+    return total;
+}
+
+
+/*
+ * Function:	While::clone
+ */
+
+Statement *While::clone(Renaming &renaming) const
+{
+    return new While(_expr->clone(renaming), _stmt->clone(renaming));
+}
+
+
+/*
+ * Function:	While::cost
+ */
+
+unsigned While::cost() const
+{
+    return 1 + _expr->cost() + _stmt->cost();
+}
+
+
+/*
+ * Function:	For::clone
+ */
+
+Statement *For::clone(Renaming &renaming) const
+{
+    Statement *init = _init->clone(renaming);
+    Expression *expr = _expr->clone(renaming);
+    Statement *incr = _incr->clone(renaming);
+
+    return new For(init, expr, incr, _stmt->clone(renaming));
+}
+
+
+/*
+ * Function:	For::cost
+ */
+
+unsigned For::cost() const
+{
+    return 1 + _init->cost() + _expr->cost() + _incr->cost() + _stmt->cost();
+}
+
+
+/*
+ * Function:	If::clone
+ */
+
+Statement *If::clone(Renaming &renaming) const
+{
+    Expression *expr = _expr->clone(renaming);
+    Statement *thenStmt = _thenStmt->clone(renaming);
+    Statement *elseStmt = nullptr;
+
+
+    if (_elseStmt != nullptr)
+	elseStmt = _elseStmt->clone(renaming);
+
+    return new If(expr, thenStmt, elseStmt);
+}
+
+
+/*
+ * Function:	If::cost
+ */
+
+unsigned If::cost() const
+{
+    return 1 + _expr->cost() + _thenStmt->cost() + (_elseStmt ? _elseStmt->cost() : 0);
+}
+
+
+/*
+ * Function:	Vector::clone
+ */
+
+Statement *Vector::clone(Renaming &renaming) const
+{
+    Expressions args;
+
+
+    for (unsigned i = 0; i < _args.size(); i ++)
+	args.push_back(_args[i] != nullptr ? _args[i]->clone(renaming) : nullptr);
+
+    return new Vector(_dst->clone(renaming), _ops, args);
+}
+
+
+/*
+ * Function:	Vector::cost
+ */
+
+unsigned Vector::cost() const
+{
+    unsigned total = 1 + _dst->cost();
+
+    for (unsigned i = 0; i < _args.size(); i ++)
+	total += _args[i] != nullptr ? _args[i]->cost() : 1;
+
+    return total;
+}
+
+
+/*
+ * Function:	initInliner
+ *
+ * Description:	Prepare to inline calls in a new translation unit,
+ *		reporting the calls inlined to ERR if asked to.
+ */
+
+void initInliner(ostream &err)
+{
+    candidates.clear();
+    graph.clear();
+    current = nullptr;
+    diagnostics = &err;
+}
+
+
+/*
+ * Function:	enterFunction
+ *
+ * Description:	Note that the body of the given function is being parsed.
+ */
+
+void enterFunction(Symbol *symbol)
+{
+    current = symbol;
+    graph[symbol].clear();
+}
+
+
+/*
+ * Function:	leaveFunction
+ *
+ * Description:	Note that the body of the function is complete, and make
+ *		it a candidate for inlining if it is a small enough leaf.
+ */
+
+void leaveFunction(const Function *function)
+{
+    const Symbol *symbol = function->id();
+
+    if (graph[symbol].empty() && inlineThreshold > 0 &&
+	    function->body()->cost() <= inlineThreshold)
+	candidates[symbol] = function;
+
+    current = nullptr;
+}
+
+
+/*
+ * Function:	inlinable
+ *
+ * Description:	Return whether calls to the given function may be inlined.
+ */
+
+bool inlinable(const Symbol *id)
+{
+    return candidates.count(id) > 0;
+}
+
+
+/*
+ * Function:	inlineCall
+ *
+ * Description:	Return the expression for a call to the function ID with
+ *		the given arguments, which is the inlined body of the
+ *		function if it is a candidate, and otherwise CALL itself,
+ *		which is then an edge of the call graph.  The variables of
+ *		an inlined body live in the frame of the caller, so if the
+ *		address of any of them is taken, so is that of its frame.
+ */
+
+Expression *inlineCall(const Symbol *id, const Expressions &args, Expression *call)
+{
+    map<const Symbol *, const Function *>::iterator it;
+    Renaming renaming;
+    Block *body;
+
+
+    it = candidates.find(id);
+
+    if (it == candidates.end() || numerrors > 0 || call->type().isError()) {
+	if (current != nullptr)
+	    graph[current].insert(id);
+
+	return call;
+    }
+
+    body = static_cast<Block *>(it->second->body()->clone(renaming));
+    current->_attributes |= id->_attributes & FRAMEADDR;
+
+    if (inlineReport) {
+	*diagnostics << "line " << lineno << ": inlined " << id->name();
+	*diagnostics << " into " << current->name() << " (cost ";
+	*diagnostics << body->cost() << ")" << endl;
+    }
+
+    return new Inline(id, args, body, call->type());
+}
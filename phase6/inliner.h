@@ -0,0 +1,27 @@
+/*
+ * File:	inliner.h
+ *
+ * Description:	This file contains the public variable and function
+ *		declarations for inlining calls to small leaf functions.
+ *		The threshold is the largest cost, in tree nodes, of a
+ *		function that may be inlined, and zero disables inlining.
+ */
+
+# ifndef INLINER_H
+# define INLINER_H
+# include <iosfwd>
+# include <map>
+# include "Tree.h"
+
+struct Renaming : std::map<const Symbol *, Symbol *> {};
+
+extern unsigned inlineThreshold;
+extern bool inlineReport;
+
+void initInliner(std::ostream &err);
+void enterFunction(Symbol *symbol);
+void leaveFunction(const Function *function);
+bool inlinable(const Symbol *id);
+Expression *inlineCall(const Symbol *id, const Expressions &args, Expression *call);
+
+# endif /* INLINER_H */
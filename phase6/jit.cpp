@@ -0,0 +1,325 @@
+/*
+ * File:	jit.cpp
+ *
+ * Description:	This file contains the public and private function
+ *		definitions for running a Simple C program in memory.  The
+ *		program is compiled and assembled as usual, but rather than
+ *		writing an object file, we lay out its sections in memory
+ *		obtained from mmap, resolve the functions it calls, such as
+ *		printf and malloc, against the C library we were linked
+ *		with, apply the relocations ourselves, and call main.
+ *
+ *		The executable code comes first, followed by a stub for
+ *		each external function, which lets a call reach the C
+ *		library even if it is too far away for a 32-bit
+ *		displacement.  The data follows on its own pages so the
+ *		code can be made read-only once it is relocated.
+ *
+ *		So that perf can attribute samples to the functions of the
+ *		program, we write their addresses to /tmp/perf-<pid>.map.
+ */
+
+# include <cstdio>
+# include <cstring>
+# include <sstream>
+# include <fstream>
+# include <algorithm>
+# include <dlfcn.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include "assembler.h"
+# include "parser.h"
+# include "machine.h"
+# include "jit.h"
+
+using namespace std;
+
+# if defined(__x86_64__)
+# define STUB_SIZE 16
+# define MAP_FLAGS (MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT)
+# else
+# define STUB_SIZE 0
+# define MAP_FLAGS (MAP_PRIVATE | MAP_ANONYMOUS)
+# endif
+
+struct Image {
+    uint8_t *base;
+    size_t size, code;
+    vector<uintptr_t> sections, symbols;
+};
+
+
+/*
+ * Function:	align
+ *
+ * Description:	Round the offset up to a multiple of the alignment.
+ */
+
+static size_t align(size_t offset, size_t alignment)
+{
+    if (alignment > 1)
+	offset = (offset + alignment - 1) / alignment * alignment;
+
+    return offset;
+}
+
+
+/*
+ * Function:	layout
+ *
+ * Description:	Assign an offset within the image to each section and to
+ *		each common symbol, and return the size of the image.  The
+ *		executable sections and the stubs come first.
+ */
+
+static size_t layout(const Object &object, Image &image, size_t &stubs)
+{
+    size_t page = sysconf(_SC_PAGESIZE), offset = 0;
+
+
+    image.sections.resize(object.sections.size());
+    image.symbols.resize(object.symbols.size());
+
+    for (int pass = 0; pass < 2; pass ++) {
+	for (unsigned i = 0; i < object.sections.size(); i ++) {
+	    const Object::Section &s = object.sections[i];
+
+	    if (s.executable == (pass == 0)) {
+		offset = align(offset, s.alignment);
+		image.sections[i] = offset;
+		offset += s.bytes.size();
+	    }
+	}
+
+	if (pass == 0) {
+	    stubs = offset = align(offset, 16);
+
+	    for (unsigned i = 0; i < object.symbols.size(); i ++)
+		if (object.symbols[i].section == Object::UNDEFINED)
+		    offset += STUB_SIZE;
+
+	    image.code = offset = align(offset, page);
+	}
+    }
+
+    for (unsigned i = 0; i < object.symbols.size(); i ++)
+	if (object.symbols[i].section == Object::COMMON) {
+	    offset = align(offset, object.symbols[i].value);
+	    image.symbols[i] = offset;
+	    offset += object.symbols[i].size;
+	}
+
+    return align(offset, page);
+}
+
+
+/*
+ * Function:	stub
+ *
+ * Description:	Write a stub that jumps to the given address and return
+ *		the address of the stub.
+ */
+
+static uintptr_t stub(uint8_t *p, uintptr_t address)
+{
+    static const uint8_t jmp[] = {0xff, 0x25, 0, 0, 0, 0};
+
+    memcpy(p, jmp, sizeof(jmp));
+    memcpy(p + sizeof(jmp), &address, sizeof(address));
+    return (uintptr_t) p;
+}
+
+
+/*
+ * Function:	load
+ *
+ * Description:	Load the object into memory, resolving its external
+ *		symbols and applying its relocations.  The stub for an
+ *		external symbol is written the first time a relocation
+ *		needs it and shared by the rest, since only one per symbol
+ *		is laid out.
+ */
+
+static bool load(const Object &object, Image &image, ostream &err)
+{
+    vector<uintptr_t> trampolines;
+    size_t stubs;
+    uint8_t *p;
+    uintptr_t S, P;
+    int64_t value;
+    bool ok = true;
+
+
+    image.size = layout(object, image, stubs);
+    p = (uint8_t *) mmap(nullptr, image.size, PROT_READ | PROT_WRITE, MAP_FLAGS, -1, 0);
+
+    if (p == MAP_FAILED) {
+	err << "cannot allocate memory for program" << endl;
+	return false;
+    }
+
+    image.base = p;
+    trampolines.resize(object.symbols.size());
+
+    for (unsigned i = 0; i < object.sections.size(); i ++) {
+	const Object::Section &s = object.sections[i];
+
+	image.sections[i] += (uintptr_t) p;
+
+	if (!s.nobits && !s.bytes.empty())
+	    memcpy((void *) image.sections[i], &s.bytes[0], s.bytes.size());
+    }
+
+    for (unsigned i = 0; i < object.symbols.size(); i ++) {
+	const Object::Symbol &s = object.symbols[i];
+
+	if (s.section == Object::UNDEFINED) {
+	    image.symbols[i] = (uintptr_t) dlsym(RTLD_DEFAULT, s.name.c_str());
+
+	    if (image.symbols[i] == 0) {
+		err << "undefined symbol " << s.name << endl;
+		ok = false;
+	    }
+
+	} else if (s.section == Object::COMMON)
+	    image.symbols[i] += (uintptr_t) p;
+
+	else if (s.section == Object::ABSOLUTE)
+	    image.symbols[i] = s.value;
+
+	else
+	    image.symbols[i] = image.sections[s.section] + s.value;
+    }
+
+    for (unsigned i = 0; ok && i < object.relocations.size(); i ++) {
+	const Object::Relocation &r = object.relocations[i];
+	const Object::Symbol &s = object.symbols[r.symbol];
+
+	S = image.symbols[r.symbol];
+	P = image.sections[r.section] + r.offset;
+
+	if (r.type == Object::ABSOLUTE32) {
+	    value = S + r.addend;
+	    ok = (uint64_t) value == (uint32_t) value;
+
+	} else {
+	    value = (int64_t) (S + r.addend - P);
+
+	    if (STUB_SIZE > 0 && s.section == Object::UNDEFINED && value != (int32_t) value) {
+		if (trampolines[r.symbol] == 0) {
+		    trampolines[r.symbol] = stub(p + stubs, S);
+		    stubs += STUB_SIZE;
+		}
+
+		S = trampolines[r.symbol];
+		value = (int64_t) (S + r.addend - P);
+	    }
+
+	    ok = sizeof(uintptr_t) == 4 || value == (int32_t) value;
+	}
+
+	if (!ok)
+	    err << "relocation out of range for " << s.name << endl;
+	else
+	    memcpy((void *) P, &value, 4);
+    }
+
+    if (ok && mprotect(p, image.code, PROT_READ | PROT_EXEC) != 0) {
+	err << "cannot make program executable" << endl;
+	ok = false;
+    }
+
+    if (!ok)
+	munmap(p, image.size);
+
+    return ok;
+}
+
+
+/*
+ * Function:	writePerfMap
+ *
+ * Description:	Write the address and size of each function of the
+ *		program to the map file that perf reads for code it
+ *		cannot otherwise symbolize.
+ */
+
+static void writePerfMap(const Object &object, const Image &image)
+{
+    vector<pair<uintptr_t, unsigned> > functions;
+    stringstream path;
+    uintptr_t start, end;
+
+
+    for (unsigned i = 0; i < object.symbols.size(); i ++) {
+	const Object::Symbol &s = object.symbols[i];
+
+	if (s.section >= 0 && object.sections[s.section].executable &&
+		s.name.compare(0, 2, ".L") != 0)
+	    functions.push_back(make_pair(image.symbols[i], i));
+    }
+
+    sort(functions.begin(), functions.end());
+    path << "/tmp/perf-" << getpid() << ".map";
+    ofstream map(path.str().c_str());
+
+    for (unsigned i = 0; i < functions.size(); i ++) {
+	const Object::Symbol &s = object.symbols[functions[i].second];
+
+	start = functions[i].first;
+	end = image.sections[s.section] + object.sections[s.section].bytes.size();
+
+	if (i + 1 < functions.size())
+	    end = min(end, functions[i + 1].first);
+
+	map << hex << start << " " << end - start << " " << s.name << endl;
+    }
+}
+
+
+/*
+ * Function:	runProgram
+ *
+ * Description:	Compile the program read from IN and run it, leaving the
+ *		value returned by its main function in STATUS.  The
+ *		program reads the standard input and writes the standard
+ *		output of this process.  Return the number of errors
+ *		reported, in which case the program isn't run.
+ */
+
+int runProgram(istream &in, ostream &err, int &status)
+{
+    stringstream text;
+    Object object(target->bits);
+    Image image;
+    int index, errors;
+
+
+    errors = compile(in, text, err);
+
+    if (errors > 0)
+	return errors;
+
+    if (!assemble(text.str(), object, err) || !load(object, image, err))
+	return 1;
+
+    writePerfMap(object, image);
+    index = object.find("main");
+
+    if (index < 0 || object.symbols[index].section < 0) {
+	err << "no main function" << endl;
+	errors = 1;
+
+    } else if (target->bits != 8 * sizeof(uintptr_t)) {
+	err << "cannot run " << target->name << " code on this host" << endl;
+	errors = 1;
+
+    } else {
+	int (*main)() = (int (*)()) image.symbols[index];
+	status = main();
+	fflush(stdout);
+    }
+
+    munmap(image.base, image.size);
+    return errors;
+}
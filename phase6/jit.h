@@ -0,0 +1,15 @@
+/*
+ * File:	jit.h
+ *
+ * Description:	This file contains the public function declarations for
+ *		running a Simple C program in memory, without writing any
+ *		files or running the assembler and linker.
+ */
+
+# ifndef JIT_H
+# define JIT_H
+# include <iosfwd>
+
+int runProgram(std::istream &in, std::ostream &err, int &status);
+
+# endif /* JIT_H */
@@ -2,7 +2,7 @@
 #define LABEL_H
 
 struct Label{
-	static unsigned counter; 
+	static thread_local unsigned counter; 
 	unsigned number; 
 	Label() { number = counter++; }
 }; 
@@ -13,7 +13,11 @@
 # include "tokens.h"
 
 using namespace std;
-int numerrors, lineno = 1;
+thread_local int numerrors, lineno = 1;
+
+static thread_local istream *input = &cin;
+static thread_local ostream *diagnostics = &cerr;
+static thread_local int c;
 
 
 /* Yes, we could have used a map, but we'd probably initialize it with an
@@ -75,15 +79,33 @@ void report(const string &str, const string &arg)
     char buf[1000];
 
     snprintf(buf, sizeof(buf), str.c_str(), arg.c_str());
-    cerr << "line " << lineno << ": " << buf << endl;
+    *diagnostics << "line " << lineno << ": " << buf << endl;
     numerrors ++;
 }
 
 
+/*
+ * Function:	initLexer
+ *
+ * Description:	Prepare to tokenize a new translation unit read from IN,
+ *		with any errors reported to ERR.  All of our state is per
+ *		thread, so several units may be tokenized at once.
+ */
+
+void initLexer(istream &in, ostream &err)
+{
+    input = &in;
+    diagnostics = &err;
+    numerrors = 0;
+    lineno = 1;
+    c = input->get();
+}
+
+
 /*
  * Function:	lexan
  *
- * Description:	Read and tokenize the standard input stream.  The lexeme is
+ * Description:	Read and tokenize the input stream.  The lexeme is
  *		stored in a buffer.
  */
 
@@ -91,14 +113,13 @@ int lexan(string &lexbuf)
 {
     int p;
     unsigned i;
-    static int c = cin.get();
 
 
     /* The invariant here is that the next character has already been read
        and is ready to be classified.  In this way, we eliminate having to
        push back characters onto the stream, merely to read them again. */
 
-    while (!cin.eof()) {
+    while (!input->eof()) {
 	lexbuf.clear();
 
 
@@ -108,7 +129,7 @@ int lexan(string &lexbuf)
 	    if (c == '\n')
 		lineno ++;
 
-	    c = cin.get();
+	    c = input->get();
 	}
 
 
@@ -117,7 +138,7 @@ int lexan(string &lexbuf)
 	if (isalpha(c) || c == '_') {
 	    do {
 		lexbuf += c;
-		c = cin.get();
+		c = input->get();
 	    } while (isalnum(c) || c == '_');
 
 	    for (i = 0; i < numKeywords; i ++)
@@ -132,7 +153,7 @@ int lexan(string &lexbuf)
 	} else if (isdigit(c)) {
 	    do {
 		lexbuf += c;
-		c = cin.get();
+		c = input->get();
 	    } while (isdigit(c));
 
 	    return NUM;
@@ -152,11 +173,11 @@ int lexan(string &lexbuf)
 	    /* Check for '||' */
 
 	    case '|':
-		c = cin.get();
+		c = input->get();
 
 		if (c == '|') {
 		    lexbuf += c;
-		    c = cin.get();
+		    c = input->get();
 		    return OR;
 		}
 
@@ -166,11 +187,11 @@ int lexan(string &lexbuf)
 	    /* Check for '=' and '==' */
 
 	    case '=':
-		c = cin.get();
+		c = input->get();
 
 		if (c == '=') {
 		    lexbuf += c;
-		    c = cin.get();
+		    c = input->get();
 		    return EQL;
 		}
 
@@ -180,11 +201,11 @@ int lexan(string &lexbuf)
 	    /* Check for '&' and '&&' */
 
 	    case '&':
-		c = cin.get();
+		c = input->get();
 
 		if (c == '&') {
 		    lexbuf += c;
-		    c = cin.get();
+		    c = input->get();
 		    return AND;
 		}
 
@@ -194,11 +215,11 @@ int lexan(string &lexbuf)
 	    /* Check for '!' and '!=' */
 
 	    case '!':
-		c = cin.get();
+		c = input->get();
 
 		if (c == '=') {
 		    lexbuf += c;
-		    c = cin.get();
+		    c = input->get();
 		    return NEQ;
 		}
 
@@ -208,11 +229,11 @@ int lexan(string &lexbuf)
 	    /* Check for '<' and '<=' */
 
 	    case '<':
-		c = cin.get();
+		c = input->get();
 
 		if (c == '=') {
 		    lexbuf += c;
-		    c = cin.get();
+		    c = input->get();
 		    return LEQ;
 		}
 
@@ -222,11 +243,11 @@ int lexan(string &lexbuf)
 	    /* Check for '>' and '>=' */
 
 	    case '>':
-		c = cin.get();
+		c = input->get();
 
 		if (c == '=') {
 		    lexbuf += c;
-		    c = cin.get();
+		    c = input->get();
 		    return GEQ;
 		}
 
@@ -236,16 +257,16 @@ int lexan(string &lexbuf)
 	    /* Check for '-', '--', and '->' */
 
 	    case '-':
-		c = cin.get();
+		c = input->get();
 
 		if (c == '-') {
 		    lexbuf += c;
-		    c = cin.get();
+		    c = input->get();
 		    return DEC;
 
 		} else if (c == '>') {
 		    lexbuf += c;
-		    c = cin.get();
+		    c = input->get();
 		    return ARROW;
 		}
 
@@ -255,11 +276,11 @@ int lexan(string &lexbuf)
 	    /* Check for '+' and '++' */
 
 	    case '+':
-		c = cin.get();
+		c = input->get();
 
 		if (c == '+') {
 		    lexbuf += c;
-		    c = cin.get();
+		    c = input->get();
 		    return INC;
 		}
 
@@ -271,28 +292,28 @@ int lexan(string &lexbuf)
 	    case '*': case '%': case ':': case ';':
 	    case '(': case ')': case '[': case ']':
 	    case '{': case '}': case '.': case ',':
-		c = cin.get();
+		c = input->get();
 		return lexbuf[0];
 
 
 	    /* Check for '/' or a comment */
 
 	    case '/':
-		c = cin.get();
+		c = input->get();
 
 		if (c == '*') {
 		    do {
-			while (c != '*' && !cin.eof()) {
+			while (c != '*' && !input->eof()) {
 			    if (c == '\n')
 				lineno ++;
 
-			    c = cin.get();
+			    c = input->get();
 			}
 
-			c = cin.get();
-		    } while (c != '/' && !cin.eof());
+			c = input->get();
+		    } while (c != '/' && !input->eof());
 
-		    c = cin.get();
+		    c = input->get();
 		    break;
 
 		} else
@@ -304,14 +325,14 @@ int lexan(string &lexbuf)
 	    case '"':
 		do {
 		    p = c;
-		    c = cin.get();
+		    c = input->get();
 		    lexbuf += c;
-		} while ((c != '"' || p == '\\') && c != '\n' && !cin.eof());
+		} while ((c != '"' || p == '\\') && c != '\n' && !input->eof());
 
-		if (c == '\n' || cin.eof())
+		if (c == '\n' || input->eof())
 		    report("malformed string literal");
 
-		c = cin.get();
+		c = input->get();
 		return STRING;
 
 
@@ -324,7 +345,7 @@ int lexan(string &lexbuf)
 	    /* Everything else is illegal */
 
 	    default:
-		c = cin.get();
+		c = input->get();
 		return ERROR;
 	    }
 	}
@@ -7,9 +7,11 @@
 
 # ifndef LEXER_H
 # define LEXER_H
+# include <iosfwd>
 
-extern int lineno, numerrors;
+extern thread_local int lineno, numerrors;
 
+void initLexer(std::istream &in, std::ostream &err);
 int lexan(std::string &lexbuf);
 void report(const std::string &str, const std::string &arg = "");
 
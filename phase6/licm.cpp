@@ -0,0 +1,319 @@
+/*
+ * File:	licm.cpp
+ *
+ * Description:	This file contains the function definitions for hoisting
+ *		loop-invariant computations out of loops.
+ *
+ *		Simple C has no goto, break, or continue, so every while
+ *		and for statement is a natural loop whose only entry is
+ *		its test, whose header dominates its whole body, and whose
+ *		nest is just the nesting of the statements.  The loops are
+ *		visited innermost first, so that a computation hoisted out
+ *		of an inner loop may then be hoisted out of the outer one.
+ *
+ *		An expression is invariant if nothing it reads is written
+ *		in the loop: no variable it names is assigned, and, if it
+ *		reads memory, then no unknown function is called and
+ *		nothing is stored that may alias it.  An expression with
+ *		a call is never invariant.  The largest invariant expressions are computed
+ *		once into temporaries declared in a block around the loop,
+ *		which serves as its preheader.
+ *
+ *		An expression that may trap, because it dereferences a
+ *		pointer or divides, must not be evaluated if the loop would
+ *		not have evaluated it.  One in the test is hoisted as is,
+ *		since the test is always evaluated once.  One in the body
+ *		is hoisted only if it is evaluated in every iteration
+ *		before anything that might leave the loop, and then the
+ *		loop and its preheader are guarded by a copy of the test.
+ */
+
+# include "optimizer.h"
+# include "inliner.h"
+
+using namespace std;
+
+enum { CONDITIONAL, ANTICIPATED, ALWAYS };
+
+struct Invariant {
+    string key;
+    Expression *expr;
+    vector<Expression **> slots;
+    int evaluated;
+};
+
+static thread_local Effects loop;
+static thread_local vector<Invariant> invariants;
+
+static void search(Statement *stmt, int evaluated);
+
+
+/*
+ * Function:	record
+ *
+ * Description:	Record an occurrence of an invariant expression, along
+ *		with any others that compute the same value.
+ */
+
+static void record(Expression **slot, int evaluated)
+{
+    string name = key(*slot);
+    unsigned i;
+
+
+    for (i = 0; i < invariants.size(); i ++)
+	if (invariants[i].key == name)
+	    break;
+
+    if (i == invariants.size()) {
+	invariants.push_back(Invariant());
+	invariants[i].key = name;
+	invariants[i].expr = *slot;
+	invariants[i].evaluated = evaluated;
+    }
+
+    invariants[i].slots.push_back(slot);
+
+    if (evaluated > invariants[i].evaluated)
+	invariants[i].evaluated = evaluated;
+}
+
+
+/*
+ * Function:	search (expression)
+ *
+ * Description:	Search an expression for the largest invariant
+ *		subexpressions that may be hoisted, given how certainly
+ *		the expression is evaluated.  The right operand of a
+ *		logical expression is evaluated only conditionally.
+ */
+
+static void search(Expression **slot, int evaluated)
+{
+    Expression *expr = *slot;
+    vector<Expression **> exprs;
+    bool logical;
+
+
+    if (!trivial(expr) && expr->type().isScalar() && invariant(expr, loop)) {
+	if (!traps(expr)) {
+	    record(slot, ALWAYS);
+	    return;
+	}
+
+	if (evaluated != CONDITIONAL) {
+	    record(slot, evaluated);
+	    return;
+	}
+    }
+
+    if (dynamic_cast<Address *>(expr) != nullptr) {
+	expr = *operand(expr);
+
+	if (dynamic_cast<Dereference *>(expr) != nullptr)
+	    search(operand(expr), evaluated);
+
+	return;
+    }
+
+    expr->operands(exprs);
+    logical = dynamic_cast<LogicalAnd *>(expr) || dynamic_cast<LogicalOr *>(expr);
+
+    for (unsigned i = 0; i < exprs.size(); i ++)
+	search(exprs[i], logical && i > 0 ? CONDITIONAL : evaluated);
+}
+
+
+/*
+ * Function:	sequence
+ *
+ * Description:	Search the next statement of a sequence.  Once a
+ *		statement may call a function, which might not return, or
+ *		may itself return, neither it nor any statement after it
+ *		is certain to be evaluated.
+ */
+
+static void sequence(Statement *stmt, int &evaluated)
+{
+    Effects writes;
+
+
+    effects(stmt, writes);
+
+    if (writes.calls || writes.returns)
+	evaluated = CONDITIONAL;
+
+    search(stmt, evaluated);
+}
+
+
+/*
+ * Function:	search (statement)
+ *
+ * Description:	Search a statement for invariant expressions.  The test
+ *		of a statement is evaluated whenever the statement is,
+ *		as is the initialization of a for statement, but the
+ *		bodies are evaluated only conditionally.  The left side
+ *		of an assignment is not read, but its address is
+ *		computed.
+ */
+
+static void search(Statement *stmt, int evaluated)
+{
+    vector<Expression **> exprs;
+    vector<Statement **> stmts;
+    Expression *left;
+    bool logical;
+
+
+    stmt->operands(exprs);
+    stmt->substatements(stmts);
+
+    if (dynamic_cast<Block *>(stmt) != nullptr) {
+	for (unsigned i = 0; i < stmts.size(); i ++)
+	    sequence(*stmts[i], evaluated);
+
+	return;
+    }
+
+    if (dynamic_cast<Assignment *>(stmt) != nullptr) {
+	left = *exprs[0];
+	exprs.erase(exprs.begin());
+
+	if (dynamic_cast<Dereference *>(left) != nullptr)
+	    search(operand(left), evaluated);
+    }
+
+    logical = dynamic_cast<LogicalAnd *>(stmt) || dynamic_cast<LogicalOr *>(stmt);
+
+    for (unsigned i = 0; i < exprs.size(); i ++)
+	search(exprs[i], logical && i > 0 ? CONDITIONAL : evaluated);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	search(*stmts[i], i == 0 && dynamic_cast<For *>(stmt) ? evaluated : CONDITIONAL);
+}
+
+
+/*
+ * Function:	hoist
+ *
+ * Description:	Hoist the invariant expressions out of a while or for
+ *		statement, replacing it with a block that computes them
+ *		and then runs the loop.  If any may trap, the loop is
+ *		guarded by a copy of its test, which then must have no
+ *		calls, and the initialization of a for statement is moved
+ *		before the guard.
+ */
+
+static void hoist(Statement **slot)
+{
+    Statement *stmt = *slot;
+    vector<Expression **> exprs;
+    vector<Statement **> stmts;
+    Statements preheader, outer;
+    Expression *guard;
+    Renaming renaming;
+    Effects header;
+    Scope *decls;
+    Symbol *symbol;
+    int evaluated;
+    bool guarded, isFor;
+
+
+    stmt->operands(exprs);
+    stmt->substatements(stmts);
+    isFor = dynamic_cast<For *>(stmt) != nullptr;
+
+    loop = Effects();
+    effects(stmt, loop);
+    invariants.clear();
+
+    effects(*exprs[0], header);
+
+    if (isFor)
+	effects(*stmts[0], header);
+
+    search(exprs[0], header.calls ? CONDITIONAL : ALWAYS);
+
+    if (isFor)
+	search(*stmts[1], CONDITIONAL);
+
+    evaluated = header.calls ? CONDITIONAL : ANTICIPATED;
+    sequence(*stmts.back(), evaluated);
+
+    if (invariants.empty())
+	return;
+
+    guarded = false;
+
+    for (unsigned i = 0; i < invariants.size(); i ++)
+	if (invariants[i].evaluated == ANTICIPATED)
+	    guarded = true;
+
+    guard = guarded ? (*exprs[0])->clone(renaming) : nullptr;
+    decls = new Scope();
+
+    for (unsigned i = 0; i < invariants.size(); i ++) {
+	symbol = temporary(decls, invariants[i].expr->type());
+	preheader.push_back(new Assignment(new Identifier(symbol), invariants[i].expr));
+
+	for (unsigned j = 0; j < invariants[i].slots.size(); j ++)
+	    *invariants[i].slots[j] = new Identifier(symbol);
+    }
+
+    preheader.push_back(stmt);
+
+    if (!guarded) {
+	*slot = new Block(decls, preheader);
+	return;
+    }
+
+    if (isFor) {
+	outer.push_back(*stmts[0]);
+	*stmts[0] = new Block(new Scope(), Statements());
+    }
+
+    outer.push_back(new If(guard, new Block(new Scope(), preheader), nullptr));
+    *slot = new Block(decls, outer);
+}
+
+
+/*
+ * Function:	visit
+ *
+ * Description:	Hoist the invariant expressions out of every loop in a
+ *		statement, innermost loops first.
+ */
+
+static void visit(Statement **slot)
+{
+    vector<Statement **> stmts;
+
+
+    (*slot)->substatements(stmts);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	visit(stmts[i]);
+
+    if (dynamic_cast<While *>(*slot) || dynamic_cast<For *>(*slot))
+	hoist(slot);
+}
+
+
+/*
+ * Function:	hoistInvariants
+ *
+ * Description:	Hoist the loop-invariant expressions out of the loops of a
+ *		function.
+ */
+
+void hoistInvariants(Function *function)
+{
+    vector<Statement **> stmts;
+
+
+    function->body()->substatements(stmts);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	visit(stmts[i]);
+}
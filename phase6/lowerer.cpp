@@ -0,0 +1,1522 @@
+/*
+ * File:	lowerer.cpp
+ *
+ * Description:	This file contains the public and member function
+ *		definitions for lowering abstract syntax trees into the
+ *		bytecode described in bytecode.h, so the program can be
+ *		run by the interpreter rather than assembled.
+ *
+ *		Each expression is lowered into a register, which is
+ *		normally a new temporary, but is the register of the
+ *		variable itself if it has one.  Temporaries are only live
+ *		within a statement, so they are reused by the next.  If a
+ *		variable we've given a register turns out to have its
+ *		address taken, the function is simply lowered again with
+ *		the variable in memory.
+ *
+ *		A few common patterns are lowered into single instructions:
+ *		a comparison whose value is only tested becomes a
+ *		compare-and-branch, possibly against an immediate, and an
+ *		array index becomes an indexed load or store.  Loops are
+ *		tested at the bottom, so each iteration takes one branch.
+ */
+
+# include <map>
+# include <set>
+# include <cstdlib>
+# include "bytecode.h"
+# include "Tree.h"
+# include "tokens.h"
+
+using namespace std;
+
+static thread_local Program *program;
+static thread_local Routine *routine;
+static thread_local map<const Symbol *, int> registers;
+static thread_local map<const Symbol *, unsigned> offsets;
+static thread_local map<const Symbol *, void *> storage;
+static thread_local map<string, unsigned> callees;
+static thread_local set<const Symbol *> addressed;
+static thread_local vector<int> labels;
+static thread_local Type result;
+static thread_local int top, highest, first;
+static thread_local unsigned fence, done, start;
+static thread_local const Function *function;
+static thread_local int value = -1;
+static thread_local bool retry;
+
+
+/*
+ * Function:	Program::~Program
+ *
+ * Description:	Release the storage of the global variables.
+ */
+
+Program::~Program()
+{
+    for (unsigned i = 0; i < globals.size(); i ++)
+	free(globals[i]);
+}
+
+
+/*
+ * Function:	initLowerer
+ *
+ * Description:	Prepare to lower a new translation unit into PROGRAM.
+ */
+
+void initLowerer(Program &p)
+{
+    program = &p;
+    storage.clear();
+    callees.clear();
+}
+
+
+/*
+ * Function:	emit
+ *
+ * Description:	Append an instruction to the routine being lowered.
+ */
+
+static void emit(Opcode op, int a = 0, int b = 0, int c = 0, intptr_t imm = 0)
+{
+    Instruction insn;
+
+    insn.op = op;
+    insn.a = a;
+    insn.b = b;
+    insn.c = c;
+    insn.imm = imm;
+    routine->code.push_back(insn);
+}
+
+
+/*
+ * Function:	temp
+ *
+ * Description:	Return a new register for a temporary.
+ */
+
+static int temp()
+{
+    highest = max(highest, top + 1);
+    return top ++;
+}
+
+
+/*
+ * Function:	label
+ *
+ * Description:	Return a new label, which is not yet bound to any
+ *		instruction.
+ */
+
+static unsigned label()
+{
+    labels.push_back(-1);
+    return labels.size() - 1;
+}
+
+
+/*
+ * Function:	bind
+ *
+ * Description:	Bind the label to the next instruction to be emitted.
+ */
+
+static void bind(unsigned label)
+{
+    labels[label] = fence = routine->code.size();
+}
+
+
+/*
+ * Function:	isBranch
+ *
+ * Description:	Return whether the opcode has a branch target.
+ */
+
+static bool isBranch(Opcode op)
+{
+    return op >= OP_JMP && op <= OP_BNEI;
+}
+
+
+/*
+ * Function:	wide
+ *
+ * Description:	Return whether the value of an expression is 64 bits wide
+ *		rather than an int.
+ */
+
+static bool wide(const Expression *expr)
+{
+    const Type &t = expr->type();
+
+    return t.isPointer() || (t.isScalar() && t.specifier() == LONG);
+}
+
+
+/*
+ * Function:	memoryResident
+ *
+ * Description:	Return whether a variable must live in memory rather than
+ *		in a register.  Characters do too, so that storing into
+ *		them truncates.
+ */
+
+static bool memoryResident(const Symbol *symbol)
+{
+    const Type &t = symbol->type();
+
+    if (t.isArray() || addressed.count(symbol) > 0)
+	return true;
+
+    return t.specifier() == CHAR && t.indirection() == 0;
+}
+
+
+/*
+ * Function:	declare
+ *
+ * Description:	Give a local variable a register or a place in memory, if
+ *		it doesn't already have one.
+ */
+
+static void declare(const Symbol *symbol)
+{
+    const Type &t = symbol->type();
+    unsigned &memory = routine->memory;
+
+
+    if (registers.count(symbol) > 0 || offsets.count(symbol) > 0)
+	return;
+
+    if (memoryResident(symbol)) {
+	memory = (memory + t.alignment() - 1) / t.alignment() * t.alignment();
+	offsets[symbol] = memory;
+	memory += t.size();
+    } else
+	registers[symbol] = temp();
+}
+
+
+/*
+ * Function:	materialize
+ *
+ * Description:	Return a register holding the address of a location.
+ */
+
+static int materialize(Location &loc)
+{
+    int t;
+
+
+    if (loc.index >= 0) {
+	t = temp();
+	emit(OP_LEA, t, loc.base, loc.index, loc.scale);
+	loc.base = t;
+	loc.index = -1;
+    }
+
+    if (loc.offset != 0) {
+	t = temp();
+	emit(OP_ADDQI, t, loc.base, 0, loc.offset);
+	loc.base = t;
+	loc.offset = 0;
+    }
+
+    return loc.base;
+}
+
+
+/*
+ * Function:	access
+ *
+ * Description:	Emit a load or store of the given size.  An indexed access
+ *		has no room for an offset, so it is added to the base.
+ */
+
+static void access(Opcode op, int reg, Location loc, unsigned size)
+{
+    int t;
+
+
+    op = (Opcode) (op + (size == 1 ? 0 : size == 4 ? 1 : 2));
+
+    if (loc.index >= 0 && loc.offset != 0) {
+	t = temp();
+	emit(OP_ADDQI, t, loc.base, 0, loc.offset);
+	loc.base = t;
+	loc.offset = 0;
+    }
+
+    if (loc.index >= 0)
+	emit((Opcode) (op + 3), reg, loc.base, loc.index, loc.scale);
+    else
+	emit(op, reg, loc.base, 0, loc.offset);
+}
+
+
+/*
+ * Function:	load
+ *
+ * Description:	Load a value of the given size into a new register.
+ */
+
+static int load(const Location &loc, unsigned size)
+{
+    int t = temp();
+
+    access(OP_LB, t, loc, size);
+    return t;
+}
+
+
+/*
+ * Function:	move
+ *
+ * Description:	Move the value in register SRC into register DST.  If SRC
+ *		is a temporary that was just computed, and no branch can
+ *		bypass the instruction that computed it, it is computed
+ *		directly into DST instead.
+ */
+
+static void move(int dst, int src)
+{
+    Instructions &code = routine->code;
+
+
+    if (src == dst)
+	return;
+
+    if (src >= first && !code.empty() && fence < code.size() && code.back().a == src)
+	if (code.back().op < OP_SB || code.back().op == OP_LEA || code.back().op == OP_CALL) {
+	    code.back().a = dst;
+	    return;
+	}
+
+    emit(OP_MOV, dst, src);
+}
+
+
+/*
+ * Function:	binary
+ *
+ * Description:	Lower a binary operation, using the immediate form of the
+ *		opcode if the right operand is a constant and there is one.
+ */
+
+static int binary(Expression *left, Expression *right, Opcode op, Opcode imm)
+{
+    int l, r, t;
+    long value;
+
+
+    l = left->lowerValue();
+
+    if (imm != NUM_OPCODES && right->constant(value)) {
+	t = temp();
+	emit(imm, t, l, 0, value);
+	return t;
+    }
+
+    r = right->lowerValue();
+    t = temp();
+    emit(op, t, l, r);
+    return t;
+}
+
+
+/*
+ * Function:	branch
+ *
+ * Description:	Lower a comparison that is only tested, branching to the
+ *		label if the comparison is equal to SENSE.  OP is the
+ *		compare-and-branch for the comparison and INVERSE the one
+ *		for its negation.
+ */
+
+static void branch(Expression *left, Expression *right, Opcode op, Opcode inverse, bool sense, unsigned label)
+{
+    int l, r;
+    long value;
+
+
+    op = sense ? op : inverse;
+    l = left->lowerValue();
+
+    if (right->constant(value))
+	emit((Opcode) (op + OP_BLTI - OP_BLT), l, 0, label, value);
+    else {
+	r = right->lowerValue();
+	emit(op, l, r, label);
+    }
+}
+
+
+/*
+ * Function:	unescape
+ *
+ * Description:	Return the characters of a string literal, without its
+ *		quotes and with its escape sequences replaced.
+ */
+
+static string unescape(const string &s)
+{
+    string result;
+    unsigned i, n;
+    int value;
+
+
+    for (i = 1; i + 1 < s.size(); i ++) {
+	if (s[i] != '\\' || i + 2 >= s.size()) {
+	    result += s[i];
+	    continue;
+	}
+
+	switch (s[++ i]) {
+	case 'n': result += '\n'; break;
+	case 't': result += '\t'; break;
+	case 'r': result += '\r'; break;
+	case 'b': result += '\b'; break;
+	case 'f': result += '\f'; break;
+	case 'v': result += '\v'; break;
+	case 'a': result += '\a'; break;
+
+	default:
+	    if (s[i] >= '0' && s[i] <= '7') {
+		value = s[i] - '0';
+
+		for (n = 1; n < 3 && i + 2 < s.size() && s[i + 1] >= '0' && s[i + 1] <= '7'; n ++)
+		    value = value * 8 + s[++ i] - '0';
+
+		result += (char) value;
+	    } else
+		result += s[i];
+	}
+    }
+
+    return result;
+}
+
+
+/*
+ * Function:	Expression::lower
+ *
+ * Description:	Lower an expression used as a statement, whose value is
+ *		simply discarded.
+ */
+
+void Expression::lower()
+{
+    lowerValue();
+}
+
+
+/*
+ * Function:	Expression::lowerValue
+ *
+ * Description:	Lower an expression into a register and return the
+ *		register.  Every kind of expression has its own.
+ */
+
+int Expression::lowerValue()
+{
+    int t = temp();
+
+    emit(OP_LI, t);
+    return t;
+}
+
+
+/*
+ * Function:	Expression::lowerAddress
+ *
+ * Description:	Lower the address of an lvalue into a location.
+ */
+
+void Expression::lowerAddress(Location &loc)
+{
+    lowerPointer(loc);
+}
+
+
+/*
+ * Function:	Expression::lowerPointer
+ *
+ * Description:	Lower a pointer value into a location, so that it may be
+ *		dereferenced with the same instruction that computes any
+ *		offset or index.
+ */
+
+void Expression::lowerPointer(Location &loc)
+{
+    loc.base = lowerValue();
+    loc.index = -1;
+    loc.scale = 1;
+    loc.offset = 0;
+}
+
+
+/*
+ * Function:	Expression::lowerIndex
+ *
+ * Description:	Lower an array index already scaled by the size of an
+ *		element, returning false if the scale cannot be folded into
+ *		an indexed instruction.
+ */
+
+bool Expression::lowerIndex(int &reg, unsigned &scale)
+{
+    return false;
+}
+
+
+/*
+ * Function:	Expression::lowerTest
+ *
+ * Description:	Lower an expression whose value is only tested, branching
+ *		to the label if the value is true and SENSE is true, or if
+ *		the value is false and SENSE is false.
+ */
+
+void Expression::lowerTest(bool sense, unsigned label)
+{
+    emit(sense ? OP_BNZ : OP_BZ, lowerValue(), 0, label);
+}
+
+
+/*
+ * Function:	Expression::constant
+ *
+ * Description:	Return whether an expression is a constant, and if so,
+ *		its value.
+ */
+
+bool Expression::constant(long &value) const
+{
+    return false;
+}
+
+
+/*
+ * Function:	String::lowerValue
+ *
+ * Description:	Lower a string literal, whose characters are kept with the
+ *		program for as long as it runs.
+ */
+
+int String::lowerValue()
+{
+    int t = temp();
+
+    program->strings.push_back(unescape(_value));
+    emit(OP_LI, t, 0, 0, (intptr_t) program->strings.back().c_str());
+    return t;
+}
+
+
+/*
+ * Function:	Identifier::lowerValue
+ *
+ * Description:	Lower an identifier, which needs no code at all if the
+ *		variable has a register.
+ */
+
+int Identifier::lowerValue()
+{
+    Location loc;
+
+
+    if (registers.count(_symbol) > 0)
+	return registers[_symbol];
+
+    lowerAddress(loc);
+    return load(loc, _type.size());
+}
+
+
+/*
+ * Function:	Identifier::lowerAddress
+ *
+ * Description:	Lower the address of a variable.  A local variable is at
+ *		an offset in the memory of the function, and the storage
+ *		for a global variable is allocated the first time we see
+ *		it.  Asking for the address of a variable with a register
+ *		means the function must be lowered again.
+ */
+
+void Identifier::lowerAddress(Location &loc)
+{
+    loc.base = 0;
+    loc.index = -1;
+    loc.scale = 1;
+    loc.offset = 0;
+
+    if (registers.count(_symbol) > 0) {
+	addressed.insert(_symbol);
+	retry = true;
+
+    } else if (offsets.count(_symbol) > 0)
+	loc.offset = offsets[_symbol];
+
+    else {
+	if (storage.count(_symbol) == 0) {
+	    storage[_symbol] = calloc(1, max(_symbol->type().size(), 1U));
+	    program->globals.push_back(storage[_symbol]);
+	}
+
+	loc.base = temp();
+	emit(OP_LI, loc.base, 0, 0, (intptr_t) storage[_symbol]);
+    }
+}
+
+
+/*
+ * Function:	Number::lowerValue
+ *
+ * Description:	Lower a number into a register.
+ */
+
+int Number::lowerValue()
+{
+    int t = temp();
+    long value;
+
+
+    constant(value);
+    emit(OP_LI, t, 0, 0, wide(this) ? value : (int) value);
+    return t;
+}
+
+
+/*
+ * Function:	Number::constant
+ *
+ * Description:	Return the value of a number.
+ */
+
+bool Number::constant(long &value) const
+{
+    value = strtol(_value.c_str(), nullptr, 0);
+    return true;
+}
+
+
+/*
+ * Function:	Call::lowerValue
+ *
+ * Description:	Lower a function call.  The callee is only known by name
+ *		until the program is linked.  A tail call of the function
+ *		itself moves the arguments into the parameters, copying
+ *		any that are other variables first, and branches back to
+ *		the top.  Any other tail call reuses the frame of the caller.
+ */
+
+int Call::lowerValue()
+{
+    Symbols symbols = function->body()->declarations()->symbols();
+    vector<int> args;
+    unsigned index;
+    Location loc;
+    int t;
+
+
+    for (unsigned i = 0; i < _args.size(); i ++)
+	args.push_back(_args[i]->lowerValue());
+
+    if (_tail && _id == function->id()) {
+	for (unsigned i = 0; i < args.size(); i ++)
+	    if (args[i] < first && (registers.count(symbols[i]) == 0 || registers[symbols[i]] != args[i])) {
+		t = temp();
+		emit(OP_MOV, t, args[i]);
+		args[i] = t;
+	    }
+
+	for (unsigned i = 0; i < args.size(); i ++)
+	    if (registers.count(symbols[i]) > 0)
+		move(registers[symbols[i]], args[i]);
+
+	    else {
+		loc.base = 0;
+		loc.index = -1;
+		loc.scale = 1;
+		loc.offset = offsets[symbols[i]];
+		access(OP_SB, args[i], loc, symbols[i]->type().size());
+	    }
+
+	emit(OP_JMP, 0, 0, start);
+	return temp();
+    }
+
+    if (callees.count(_id->name()) == 0) {
+	Callee callee;
+
+	callee.name = _id->name();
+	callee.size = _type.size();
+	callee.routine = -1;
+	callee.native = nullptr;
+	callees[_id->name()] = program->callees.size();
+	program->callees.push_back(callee);
+    }
+
+    index = program->arguments.size();
+    program->arguments.push_back(args.size());
+    program->arguments.insert(program->arguments.end(), args.begin(), args.end());
+
+    t = temp();
+    emit(_tail ? OP_TAIL : OP_CALL, t, callees[_id->name()], index);
+    return t;
+}
+
+
+/*
+ * Function:	Inline::lowerValue
+ *
+ * Description:	Lower an inlined call.  The arguments are stored in fresh
+ *		parameters, and a return in the body moves its value into
+ *		the register of the result and branches to the end.  A
+ *		body that falls off its end yields zero, as a function
+ *		would.
+ */
+
+int Inline::lowerValue()
+{
+    Symbols symbols = _body->declarations()->symbols();
+    unsigned savedDone = done;
+    int savedValue = value;
+    Type savedResult = result;
+    vector<int> args;
+    Location loc;
+
+
+    for (unsigned i = 0; i < _args.size(); i ++)
+	args.push_back(_args[i]->lowerValue());
+
+    for (unsigned i = 0; i < _args.size(); i ++) {
+	declare(symbols[i]);
+
+	if (registers.count(symbols[i]) > 0)
+	    move(registers[symbols[i]], args[i]);
+
+	else {
+	    loc.base = 0;
+	    loc.index = -1;
+	    loc.scale = 1;
+	    loc.offset = offsets[symbols[i]];
+	    access(OP_SB, args[i], loc, symbols[i]->type().size());
+	}
+    }
+
+    value = temp();
+    done = label();
+    result = Type(_id->type().specifier(), _id->type().indirection());
+    _body->lower();
+    emit(OP_LI, value);
+    bind(done);
+
+    swap(value, savedValue);
+    done = savedDone;
+    result = savedResult;
+    return savedValue;
+}
+
+
+/*
+ * Function:	Not::lowerValue
+ *
+ * Description:	Lower a logical negation expression.
+ */
+
+int Not::lowerValue()
+{
+    int r = _expr->lowerValue(), t = temp();
+
+    emit(OP_NOT, t, r);
+    return t;
+}
+
+
+/*
+ * Function:	Not::lowerTest
+ *
+ * Description:	Lower a logical negation expression that is only tested,
+ *		which is just its operand tested the other way.
+ */
+
+void Not::lowerTest(bool sense, unsigned label)
+{
+    _expr->lowerTest(!sense, label);
+}
+
+
+/*
+ * Function:	Negate::lowerValue
+ *
+ * Description:	Lower an arithmetic negation expression.
+ */
+
+int Negate::lowerValue()
+{
+    int r, t;
+    long value;
+
+
+    if (constant(value)) {
+	t = temp();
+	emit(OP_LI, t, 0, 0, wide(this) ? value : (int) value);
+	return t;
+    }
+
+    r = _expr->lowerValue();
+    t = temp();
+    emit(wide(this) ? OP_NEGQ : OP_NEG, t, r);
+    return t;
+}
+
+
+/*
+ * Function:	Negate::constant
+ *
+ * Description:	Return whether the negation of a constant is a constant.
+ */
+
+bool Negate::constant(long &value) const
+{
+    if (!_expr->constant(value))
+	return false;
+
+    value = -value;
+    return true;
+}
+
+
+/*
+ * Function:	Dereference::lowerValue
+ *
+ * Description:	Lower a dereference expression into a single load.
+ */
+
+int Dereference::lowerValue()
+{
+    Location loc;
+
+    _expr->lowerPointer(loc);
+    return load(loc, _type.size());
+}
+
+
+/*
+ * Function:	Dereference::lowerAddress
+ *
+ * Description:	Lower the address of a dereference expression, which is
+ *		just its operand.
+ */
+
+void Dereference::lowerAddress(Location &loc)
+{
+    _expr->lowerPointer(loc);
+}
+
+
+/*
+ * Function:	Address::lowerValue
+ *
+ * Description:	Lower an address expression.
+ */
+
+int Address::lowerValue()
+{
+    Location loc;
+
+    _expr->lowerAddress(loc);
+    return materialize(loc);
+}
+
+
+/*
+ * Function:	Address::lowerPointer
+ *
+ * Description:	Lower an address expression into a location, so that
+ *		indexing an array needs no separate address computation.
+ */
+
+void Address::lowerPointer(Location &loc)
+{
+    _expr->lowerAddress(loc);
+}
+
+
+/*
+ * Function:	Promote::lowerValue
+ *
+ * Description:	Lower a promotion.  Values are kept sign-extended to 64
+ *		bits, so only narrowing a long to an int needs any code.
+ */
+
+int Promote::lowerValue()
+{
+    int r = _expr->lowerValue(), t;
+
+
+    if (wide(this) || !wide(_expr))
+	return r;
+
+    t = temp();
+    emit(OP_SEXTW, t, r);
+    return t;
+}
+
+
+/*
+ * Function:	Promote::constant
+ *
+ * Description:	Return whether a promoted constant is a constant.
+ */
+
+bool Promote::constant(long &value) const
+{
+    return _expr->constant(value);
+}
+
+
+/*
+ * Function:	Multiply::lowerValue
+ *
+ * Description:	Lower a multiply expression.
+ */
+
+int Multiply::lowerValue()
+{
+    int t;
+    long value;
+
+
+    if (constant(value)) {
+	t = temp();
+	emit(OP_LI, t, 0, 0, value);
+	return t;
+    }
+
+    if (wide(this))
+	return binary(_left, _right, OP_MULQ, OP_MULQI);
+
+    return binary(_left, _right, OP_MUL, OP_MULI);
+}
+
+
+/*
+ * Function:	Multiply::lowerIndex
+ *
+ * Description:	Lower a scaled array index, which can be folded into an
+ *		indexed instruction if the scale is 1, 2, 4, or 8.
+ */
+
+bool Multiply::lowerIndex(int &reg, unsigned &scale)
+{
+    long value;
+
+
+    if (!_right->constant(value) || (value != 1 && value != 2 && value != 4 && value != 8))
+	return false;
+
+    reg = _left->lowerValue();
+    scale = value;
+    return true;
+}
+
+
+/*
+ * Function:	Multiply::constant
+ *
+ * Description:	Return whether the product of two constants is a
+ *		constant, as is the case for a scaled constant index.
+ */
+
+bool Multiply::constant(long &value) const
+{
+    long left, right;
+
+
+    if (!_left->constant(left) || !_right->constant(right))
+	return false;
+
+    value = wide(this) ? left * right : (int) (left * right);
+    return true;
+}
+
+
+/*
+ * Function:	Divide::lowerValue
+ *
+ * Description:	Lower a divide expression.
+ */
+
+int Divide::lowerValue()
+{
+    return binary(_left, _right, wide(this) ? OP_DIVQ : OP_DIV, NUM_OPCODES);
+}
+
+
+/*
+ * Function:	Remainder::lowerValue
+ *
+ * Description:	Lower a remainder expression.
+ */
+
+int Remainder::lowerValue()
+{
+    return binary(_left, _right, wide(this) ? OP_REMQ : OP_REM, NUM_OPCODES);
+}
+
+
+/*
+ * Function:	Add::lowerValue
+ *
+ * Description:	Lower an addition expression.  Pointer arithmetic is done
+ *		as an address computation.
+ */
+
+int Add::lowerValue()
+{
+    Location loc;
+
+
+    if (_type.isPointer()) {
+	lowerPointer(loc);
+	return materialize(loc);
+    }
+
+    if (wide(this))
+	return binary(_left, _right, OP_ADDQ, OP_ADDQI);
+
+    return binary(_left, _right, OP_ADD, OP_ADDI);
+}
+
+
+/*
+ * Function:	Add::lowerPointer
+ *
+ * Description:	Lower pointer arithmetic into a location, folding a
+ *		constant into the offset and a scaled index into the
+ *		index.
+ */
+
+void Add::lowerPointer(Location &loc)
+{
+    Expression *pointer = _left, *index = _right;
+    unsigned scale;
+    int b, r, t;
+    long value;
+
+
+    if (!_type.isPointer()) {
+	Expression::lowerPointer(loc);
+	return;
+    }
+
+    if (!pointer->type().isPointer())
+	swap(pointer, index);
+
+    pointer->lowerPointer(loc);
+
+    if (index->constant(value))
+	loc.offset += value;
+
+    else if (loc.index < 0 && index->lowerIndex(r, scale)) {
+	loc.index = r;
+	loc.scale = scale;
+
+    } else {
+	b = materialize(loc);
+	r = index->lowerValue();
+	t = temp();
+	emit(OP_ADDQ, t, b, r);
+	loc.base = t;
+    }
+}
+
+
+/*
+ * Function:	Subtract::lowerValue
+ *
+ * Description:	Lower a subtraction expression.  Subtracting a constant is
+ *		adding its negation.
+ */
+
+int Subtract::lowerValue()
+{
+    int l, t;
+    long value;
+
+
+    if (_right->constant(value)) {
+	l = _left->lowerValue();
+	t = temp();
+	emit(wide(this) ? OP_ADDQI : OP_ADDI, t, l, 0, -value);
+	return t;
+    }
+
+    return binary(_left, _right, wide(this) ? OP_SUBQ : OP_SUB, NUM_OPCODES);
+}
+
+
+/*
+ * Function:	LessThan::lowerValue
+ *
+ * Description:	Lower a less-than expression.
+ */
+
+int LessThan::lowerValue()
+{
+    return binary(_left, _right, OP_LT, NUM_OPCODES);
+}
+
+
+/*
+ * Function:	LessThan::lowerTest
+ *
+ * Description:	Lower a less-than expression that is only tested.
+ */
+
+void LessThan::lowerTest(bool sense, unsigned label)
+{
+    branch(_left, _right, OP_BLT, OP_BGE, sense, label);
+}
+
+
+/*
+ * Function:	GreaterThan::lowerValue
+ *
+ * Description:	Lower a greater-than expression.
+ */
+
+int GreaterThan::lowerValue()
+{
+    return binary(_left, _right, OP_GT, NUM_OPCODES);
+}
+
+
+/*
+ * Function:	GreaterThan::lowerTest
+ *
+ * Description:	Lower a greater-than expression that is only tested.
+ */
+
+void GreaterThan::lowerTest(bool sense, unsigned label)
+{
+    branch(_left, _right, OP_BGT, OP_BLE, sense, label);
+}
+
+
+/*
+ * Function:	LessOrEqual::lowerValue
+ *
+ * Description:	Lower a less-than-or-equal expression.
+ */
+
+int LessOrEqual::lowerValue()
+{
+    return binary(_left, _right, OP_LE, NUM_OPCODES);
+}
+
+
+/*
+ * Function:	LessOrEqual::lowerTest
+ *
+ * Description:	Lower a less-than-or-equal expression that is only tested.
+ */
+
+void LessOrEqual::lowerTest(bool sense, unsigned label)
+{
+    branch(_left, _right, OP_BLE, OP_BGT, sense, label);
+}
+
+
+/*
+ * Function:	GreaterOrEqual::lowerValue
+ *
+ * Description:	Lower a greater-than-or-equal expression.
+ */
+
+int GreaterOrEqual::lowerValue()
+{
+    return binary(_left, _right, OP_GE, NUM_OPCODES);
+}
+
+
+/*
+ * Function:	GreaterOrEqual::lowerTest
+ *
+ * Description:	Lower a greater-than-or-equal expression that is only
+ *		tested.
+ */
+
+void GreaterOrEqual::lowerTest(bool sense, unsigned label)
+{
+    branch(_left, _right, OP_BGE, OP_BLT, sense, label);
+}
+
+
+/*
+ * Function:	Equal::lowerValue
+ *
+ * Description:	Lower an equality expression.
+ */
+
+int Equal::lowerValue()
+{
+    return binary(_left, _right, OP_EQ, NUM_OPCODES);
+}
+
+
+/*
+ * Function:	Equal::lowerTest
+ *
+ * Description:	Lower an equality expression that is only tested.
+ */
+
+void Equal::lowerTest(bool sense, unsigned label)
+{
+    branch(_left, _right, OP_BEQ, OP_BNE, sense, label);
+}
+
+
+/*
+ * Function:	NotEqual::lowerValue
+ *
+ * Description:	Lower an inequality expression.
+ */
+
+int NotEqual::lowerValue()
+{
+    return binary(_left, _right, OP_NE, NUM_OPCODES);
+}
+
+
+/*
+ * Function:	NotEqual::lowerTest
+ *
+ * Description:	Lower an inequality expression that is only tested.
+ */
+
+void NotEqual::lowerTest(bool sense, unsigned label)
+{
+    branch(_left, _right, OP_BNE, OP_BEQ, sense, label);
+}
+
+
+/*
+ * Function:	LogicalAnd::lowerValue
+ *
+ * Description:	Lower a logical-and expression, whose value is computed by
+ *		testing it.
+ */
+
+int LogicalAnd::lowerValue()
+{
+    int t = temp();
+    unsigned skip = label();
+
+
+    emit(OP_LI, t, 0, 0, 0);
+    lowerTest(false, skip);
+    emit(OP_LI, t, 0, 0, 1);
+    bind(skip);
+    return t;
+}
+
+
+/*
+ * Function:	LogicalAnd::lowerTest
+ *
+ * Description:	Lower a logical-and expression that is only tested, with
+ *		the usual short-circuit evaluation.
+ */
+
+void LogicalAnd::lowerTest(bool sense, unsigned label)
+{
+    unsigned skip;
+
+
+    if (!sense) {
+	_left->lowerTest(false, label);
+	_right->lowerTest(false, label);
+
+    } else {
+	skip = ::label();
+	_left->lowerTest(false, skip);
+	_right->lowerTest(true, label);
+	bind(skip);
+    }
+}
+
+
+/*
+ * Function:	LogicalOr::lowerValue
+ *
+ * Description:	Lower a logical-or expression, whose value is computed by
+ *		testing it.
+ */
+
+int LogicalOr::lowerValue()
+{
+    int t = temp();
+    unsigned skip = label();
+
+
+    emit(OP_LI, t, 0, 0, 1);
+    lowerTest(true, skip);
+    emit(OP_LI, t, 0, 0, 0);
+    bind(skip);
+    return t;
+}
+
+
+/*
+ * Function:	LogicalOr::lowerTest
+ *
+ * Description:	Lower a logical-or expression that is only tested, with
+ *		the usual short-circuit evaluation.
+ */
+
+void LogicalOr::lowerTest(bool sense, unsigned label)
+{
+    unsigned skip;
+
+
+    if (sense) {
+	_left->lowerTest(true, label);
+	_right->lowerTest(true, label);
+
+    } else {
+	skip = ::label();
+	_left->lowerTest(true, skip);
+	_right->lowerTest(false, label);
+	bind(skip);
+    }
+}
+
+
+/*
+ * Function:	Assignment::lower
+ *
+ * Description:	Lower an assignment statement.  A variable with a register
+ *		is assigned by computing the value directly into it.
+ */
+
+void Assignment::lower()
+{
+    Identifier *id = dynamic_cast<Identifier *>(_left);
+    Location loc;
+    int r;
+
+
+    if (id != nullptr && registers.count(id->symbol()) > 0) {
+	r = _right->lowerValue();
+	move(registers[id->symbol()], r);
+
+    } else {
+	_left->lowerAddress(loc);
+	r = _right->lowerValue();
+	access(OP_SB, r, loc, _left->type().size());
+    }
+}
+
+
+/*
+ * Function:	Return::lower
+ *
+ * Description:	Lower a return statement.  A character is truncated as it
+ *		would be if stored.  Within an inlined call, the value is
+ *		left in the register of its result instead.
+ */
+
+void Return::lower()
+{
+    int r = _expr->lowerValue(), t;
+
+
+    if (result.specifier() == CHAR && result.indirection() == 0) {
+	t = temp();
+	emit(OP_SEXTB, t, r);
+	r = t;
+    }
+
+    if (value >= 0) {
+	move(value, r);
+	emit(OP_JMP, 0, 0, done);
+    } else
+	emit(OP_RET, r);
+}
+
+
+/*
+ * Function:	Block::lower
+ *
+ * Description:	Lower a block, giving storage to its variables.  The
+ *		temporaries of each statement are free for the next.
+ */
+
+void Block::lower()
+{
+    Symbols symbols = _decls->symbols();
+    int saved;
+
+
+    for (unsigned i = 0; i < symbols.size(); i ++)
+	declare(symbols[i]);
+
+    saved = first;
+
+    for (unsigned i = 0; i < _stmts.size(); i ++) {
+	first = top;
+	_stmts[i]->lower();
+	top = first;
+    }
+
+    first = saved;
+}
+
+
+/*
+ * Function:	While::lower
+ *
+ * Description:	Lower a while statement, with the test at the bottom.
+ */
+
+void While::lower()
+{
+    unsigned top = label(), test = label();
+
+
+    emit(OP_JMP, 0, 0, test);
+    bind(top);
+    _stmt->lower();
+    bind(test);
+    _expr->lowerTest(true, top);
+}
+
+
+/*
+ * Function:	For::lower
+ *
+ * Description:	Lower a for statement, with the test at the bottom.
+ */
+
+void For::lower()
+{
+    unsigned top = label(), test = label();
+
+
+    _init->lower();
+    emit(OP_JMP, 0, 0, test);
+    bind(top);
+    _stmt->lower();
+    _incr->lower();
+    bind(test);
+    _expr->lowerTest(true, top);
+}
+
+
+/*
+ * Function:	If::lower
+ *
+ * Description:	Lower an if-then or if-then-else statement.
+ */
+
+void If::lower()
+{
+    unsigned skip = label(), end;
+
+
+    _expr->lowerTest(false, skip);
+    _thenStmt->lower();
+
+    if (_elseStmt != nullptr) {
+	end = label();
+	emit(OP_JMP, 0, 0, end);
+	bind(skip);
+	_elseStmt->lower();
+	bind(end);
+    } else
+	bind(skip);
+}
+
+
+/*
+ * Function:	Vector::lower
+ *
+ * Description:	Lower a vector assignment, which the interpreter runs one
+ *		lane at a time.
+ */
+
+void Vector::lower()
+{
+    lanes()->lower();
+}
+
+
+/*
+ * Function:	Function::lower
+ *
+ * Description:	Lower a function into a new routine of the program.  The
+ *		parameters arrive in registers 1 through n, and any that
+ *		must live in memory are stored there first.  A function
+ *		that falls off its end returns zero.
+ */
+
+void Function::lower()
+{
+    Parameters *params = _id->type().parameters();
+    Symbols symbols = _body->declarations()->symbols();
+    Location loc;
+    int t;
+
+
+    program->routines.push_back(Routine());
+    routine = &program->routines.back();
+    routine->name = _id->name();
+    result = Type(_id->type().specifier(), _id->type().indirection());
+    addressed.clear();
+    function = this;
+    markTailCalls();
+
+    do {
+	retry = false;
+	routine->code.clear();
+	labels.clear();
+	registers.clear();
+	offsets.clear();
+	routine->memory = 0;
+	fence = 0;
+	top = first = highest = 1 + params->size();
+
+	for (unsigned i = 0; i < params->size(); i ++)
+	    if (memoryResident(symbols[i])) {
+		declare(symbols[i]);
+		loc.base = 0;
+		loc.index = -1;
+		loc.scale = 1;
+		loc.offset = offsets[symbols[i]];
+		access(OP_SB, 1 + i, loc, symbols[i]->type().size());
+	    } else
+		registers[symbols[i]] = 1 + i;
+
+	start = label();
+	bind(start);
+	_body->lower();
+	t = temp();
+	emit(OP_LI, t);
+	emit(OP_RET, t);
+    } while (retry);
+
+    for (unsigned i = 0; i < routine->code.size(); i ++)
+	if (isBranch(routine->code[i].op))
+	    routine->code[i].c = labels[routine->code[i].c];
+
+    routine->registers = highest;
+    routine->memory = (routine->memory + 15) & ~15;
+}
@@ -0,0 +1,76 @@
+/*
+ * File:	machine.cpp
+ *
+ * Description:	This file contains the descriptions of the targets we
+ *		generate code for and the functions to select among them.
+ *
+ *		On i386, every argument is pushed on the stack and ints
+ *		and pointers are both four bytes.  On x86-64, pointers are
+ *		eight bytes, the first six arguments are passed in
+ *		registers, and the stack must be aligned to sixteen bytes
+ *		at every call.
+ */
+
+# include "machine.h"
+
+static const char *const x86_64_registers[] = {
+    "di", "si", "dx", "cx", "r8", "r9",
+};
+
+static const Target i386_target = {
+    "i386", 32,
+    4, 4,
+    4, 4,
+    4, 8, I386_STACK_ALIGNMENT,
+    0, nullptr,
+    "%ebp", "%esp",
+};
+
+static const Target x86_64_target = {
+    "x86-64", 64,
+    4, 4,
+    8, 8,
+    8, 16, 16,
+    6, x86_64_registers,
+    "%rbp", "%rsp",
+};
+
+const Target *target = &i386_target;
+
+
+/*
+ * Function:	selectTarget
+ *
+ * Description:	Select the target with the given name and return whether
+ *		there is such a target.
+ */
+
+bool selectTarget(const std::string &name)
+{
+    if (name == i386_target.name)
+	target = &i386_target;
+
+    else if (name == x86_64_target.name)
+	target = &x86_64_target;
+
+    else
+	return false;
+
+    return true;
+}
+
+
+/*
+ * Function:	hostTarget
+ *
+ * Description:	Return the target matching the machine we are running on.
+ */
+
+const Target *hostTarget()
+{
+# if defined(__x86_64__)
+    return &x86_64_target;
+# else
+    return &i386_target;
+# endif
+}
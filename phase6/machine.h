@@ -2,30 +2,61 @@
  * File:	machine.h
  *
  * Description:	This file contains the values of various parameters for the
- *		target machine architecture.
+ *		target machine architecture.  The sizes of types and the
+ *		calling convention depend on the target selected when the
+ *		compiler is run, so they come from a target description,
+ *		while the naming conventions depend only on the operating
+ *		system.
  */
 
+# ifndef MACHINE_H
+# define MACHINE_H
+# include <string>
+
+struct Target {
+    const char *name;
+    unsigned bits;
+
+    unsigned sizeofInt, alignofInt;
+    unsigned sizeofPtr, alignofPtr;
+
+    unsigned sizeofArg, paramOffset, stackAlignment;
+    unsigned numRegisterArgs;
+    const char *const *registerArgs;
+
+    const char *framePointer, *stackPointer;
+};
+
+extern const Target *target;
+
+bool selectTarget(const std::string &name);
+const Target *hostTarget();
+
 # define SIZEOF_CHAR 1
 # define ALIGNOF_CHAR 1
 
-# define SIZEOF_INT 4
-# define ALIGNOF_INT 4
+# define SIZEOF_INT (target->sizeofInt)
+# define ALIGNOF_INT (target->alignofInt)
 
-# define SIZEOF_PTR 4
-# define ALIGNOF_PTR 4
+# define SIZEOF_PTR (target->sizeofPtr)
+# define ALIGNOF_PTR (target->alignofPtr)
 
-# define SIZEOF_ARG 4
-# define PARAM_OFFSET 8
+# define SIZEOF_LONG SIZEOF_PTR
+# define ALIGNOF_LONG ALIGNOF_PTR
+
+# define SIZEOF_ARG (target->sizeofArg)
+# define PARAM_OFFSET (target->paramOffset)
+# define STACK_ALIGNMENT (target->stackAlignment)
 
 # if defined (__linux__) && (defined(__i386__) || defined(__x86_64__))
 
-# define STACK_ALIGNMENT 4
+# define I386_STACK_ALIGNMENT 4
 # define global_prefix ""
 # define label_prefix ".L"
 
 # elif defined (__APPLE__) && (defined(__i386__) || defined(__x86_64__))
 
-# define STACK_ALIGNMENT 16
+# define I386_STACK_ALIGNMENT 16
 # define global_prefix "_"
 # define label_prefix "L"
 
@@ -33,3 +64,5 @@
 
 # error Unsupport architecture
 # endif
+
+# endif /* MACHINE_H */
@@ -0,0 +1,253 @@
+/*
+ * File:	modref.cpp
+ *
+ * Description:	This file contains the function definitions for
+ *		summarizing what the functions of a program may write.
+ *
+ *		Since Simple C is compiled in a single pass, a function is
+ *		summarized as its body is optimized, before any other pass
+ *		has changed it, and the summary is used at each later call
+ *		to it, inlined or not.  A summary lists the globals the
+ *		function may write, the parameters through which it may
+ *		store and the types stored, any other stores through
+ *		pointers we cannot trace, and whether it calls a function
+ *		that may write anything at all.  What it writes in its own
+ *		locals is forgotten, since they die with it.  A store
+ *		through a parameter counts only if the parameter is never
+ *		assigned, so that it still holds the argument.  A call to
+ *		a function without a summary, because it is defined later
+ *		or only declared, clobbers memory as before.
+ *
+ *		A recursive function depends on its own summary, so it
+ *		starts out empty and is computed again until it no longer
+ *		changes.  Only a function already defined has a summary,
+ *		so one of two mutually recursive functions calls a function
+ *		without one, and both clobber memory.
+ *
+ *		A store in a summary matters only for its type and the
+ *		global it writes, if known, so that is all that is kept,
+ *		and no tree is made for it.  A summary is kept in the cache
+ *		with the code of its function, so that the body need not be
+ *		read again.
+ */
+
+# include <map>
+# include <sstream>
+# include "optimizer.h"
+# include "inliner.h"
+
+using namespace std;
+
+struct Summary {
+    bool clobbers;
+    vector<Store> stores;
+    vector<pair<unsigned, Type> > params;
+    set<string> keys;
+
+    Summary() : clobbers(false) {}
+};
+
+static thread_local map<const Symbol *, Summary> summaries;
+
+
+/*
+ * Function:	initSummaries
+ *
+ * Description:	Forget the summaries of the previous translation unit.
+ */
+
+void initSummaries()
+{
+    summaries.clear();
+}
+
+
+/*
+ * Function:	summarized
+ *
+ * Description:	Add to the given effects what a call with the given
+ *		arguments may write, returning false if the function called
+ *		has no summary.
+ */
+
+bool summarized(const Symbol *id, const vector<Expression **> &args, Effects &effects)
+{
+    map<const Symbol *, Summary>::iterator it;
+
+
+    if ((it = summaries.find(id)) == summaries.end())
+	return false;
+
+    const Summary &summary = it->second;
+
+    if (summary.clobbers)
+	effects.clobbers = true;
+
+    effects.stores.insert(effects.stores.end(), summary.stores.begin(), summary.stores.end());
+
+    for (unsigned i = 0; i < summary.params.size(); i ++)
+	if (summary.params[i].first < args.size()) {
+	    Expression *arg = *args[summary.params[i].first];
+	    effects.stores.push_back(Store(arg, summary.params[i].second));
+	}
+
+    return true;
+}
+
+
+/*
+ * Function:	summarize
+ *
+ * Description:	Return the summary of a function with the given effects.
+ */
+
+static Summary summarize(Function *function, const Effects &body)
+{
+    Symbols symbols = function->body()->declarations()->symbols();
+    unsigned nparams = function->id()->type().parameters()->size();
+    const Symbol *symbol;
+    Identifier *id;
+    Summary summary;
+    unsigned i;
+
+
+    summary.clobbers = body.clobbers;
+
+    for (unsigned j = 0; j < body.stores.size(); j ++) {
+	const Store &store = body.stores[j];
+	symbol = store.object;
+
+	if (symbol != nullptr && local(symbol))
+	    continue;
+
+	id = nullptr;
+
+	if (symbol == nullptr && store.pointer != nullptr)
+	    id = dynamic_cast<Identifier *>(base(store.pointer));
+
+	for (i = 0; id != nullptr && i < nparams; i ++)
+	    if (id->symbol() == symbols[i] && body.assigned.count(symbols[i]) == 0)
+		break;
+
+	stringstream ss;
+
+	if (id != nullptr && i < nparams) {
+	    ss << i << ':' << store.type;
+
+	    if (summary.keys.insert(ss.str()).second)
+		summary.params.push_back(make_pair(i, store.type));
+
+	} else {
+	    ss << (symbol != nullptr ? symbol->name() : "-") << ' ' << store.type;
+
+	    if (summary.keys.insert(ss.str()).second)
+		summary.stores.push_back(Store(symbol, store.type));
+	}
+    }
+
+    return summary;
+}
+
+
+/*
+ * Function:	summarizeEffects
+ *
+ * Description:	Summarize what a function may write, starting from an
+ *		empty summary and computing it again until it no longer
+ *		changes, in case the function calls itself.
+ */
+
+void summarizeEffects(Function *function)
+{
+    const Symbol *id = function->id();
+    Summary summary;
+    Effects body;
+
+
+    summaries[id] = Summary();
+
+    do {
+	summary = summaries[id];
+	body = Effects();
+	effects(function->body(), body);
+	summaries[id] = summarize(function, body);
+    } while (summaries[id].keys != summary.keys || summaries[id].clobbers != summary.clobbers);
+}
+
+
+/*
+ * Function:	saveSummary
+ *
+ * Description:	Write the summary of a function, if it has one, as one
+ *		line for each thing it may write.
+ */
+
+void saveSummary(const Symbol *id, ostream &out)
+{
+    map<const Symbol *, Summary>::iterator it;
+    const Symbol *symbol;
+
+
+    if ((it = summaries.find(id)) == summaries.end())
+	return;
+
+    const Summary &summary = it->second;
+
+    if (summary.clobbers)
+	out << "clobbers" << endl;
+
+    for (unsigned i = 0; i < summary.params.size(); i ++) {
+	const Type &type = summary.params[i].second;
+	out << "param " << summary.params[i].first << " ";
+	out << type.specifier() << " " << type.indirection() << endl;
+    }
+
+    for (unsigned i = 0; i < summary.stores.size(); i ++) {
+	const Type &type = summary.stores[i].type;
+	symbol = summary.stores[i].object;
+	out << "store " << (symbol != nullptr ? symbol->name() : "-") << " ";
+	out << type.specifier() << " " << type.indirection() << endl;
+    }
+}
+
+
+/*
+ * Function:	loadSummary
+ *
+ * Description:	Read the summary of a function written by saveSummary,
+ *		finding the globals it writes in the given scope.  Return
+ *		false, leaving the function without a summary, if it cannot
+ *		be read.
+ */
+
+bool loadSummary(const Symbol *id, istream &in, const Scope *scope)
+{
+    unsigned index, indirection;
+    Symbol *global;
+    Summary summary;
+    string word, name;
+    int specifier;
+
+
+    while (in >> word) {
+	if (word == "clobbers")
+	    summary.clobbers = true;
+
+	else if (word == "param" && in >> index >> specifier >> indirection)
+	    summary.params.push_back(make_pair(index, Type(specifier, indirection)));
+
+	else if (word == "store" && in >> name >> specifier >> indirection) {
+	    global = nullptr;
+
+	    if (name != "-" && (global = scope->find(name)) == nullptr)
+		return false;
+
+	    summary.stores.push_back(Store(global, Type(specifier, indirection)));
+
+	} else
+	    return false;
+    }
+
+    summaries[id] = summary;
+    return true;
+}
@@ -0,0 +1,741 @@
+/*
+ * File:	nest.cpp
+ *
+ * Description:	This file contains the function definitions for
+ *		interchanging and tiling nests of loops.
+ *
+ *		A nest is a for statement whose body is just another for
+ *		statement, whose own body contains no loop.  Each must step
+ *		a counter, a local int, by a positive constant from one
+ *		constant to another, so that the values each runs through
+ *		are known.  The body may store to memory but must assign
+ *		no variable and call no function.
+ *
+ *		Each reference to memory in the body is an invariant base
+ *		plus a linear function of the counters and of invariant
+ *		variables, or else unknown.  Both transformations run the
+ *		same iterations in a different order, in which two
+ *		iterations run in reverse order only if each counter of
+ *		one is less than that of the other.  Two references can
+ *		then conflict only if one is a store, their types may
+ *		alias, and they are not to distinct variables.  We solve for
+ *		the iterations in which references at the same base and
+ *		with the same linear function but for a constant touch the
+ *		same element, and assume any others conflict always.
+ *
+ *		A nest is interchanged if it is legal and the references
+ *		then step through memory by shorter strides in the inner
+ *		loop, so that x[i][j] is traversed by rows whichever loop
+ *		the author put outermost.  Since the counters run through
+ *		known values, they have the same values afterwards.
+ *
+ *		A nest is tiled if both loops run more times than the tile
+ *		size and some reference steps by a whole cache line in the
+ *		inner loop but not in the outer, so that its lines are
+ *		used for just one element before being evicted.  The nest
+ *		is then run in square tiles of iterations, each small
+ *		enough for the lines it uses to stay in the cache.
+ */
+
+# include <climits>
+# include <cstdlib>
+# include <map>
+# include "optimizer.h"
+# include "tokens.h"
+
+# define LINE 64
+# define MAXTRIP 100000
+
+using namespace std;
+
+struct Loop {
+    const Symbol *counter;
+    long start, finish, step, trip;
+};
+
+struct Reference {
+    Expression *base;
+    Type type;
+    bool store;
+    map<const Symbol *, long> terms;
+    long offset;
+};
+
+unsigned tileSize = 64;
+
+static thread_local Effects loop;
+static thread_local vector<Reference> references;
+
+
+/*
+ * Function:	counted
+ *
+ * Description:	Return whether a statement is a for statement that steps
+ *		a counter by a positive constant from a constant to a
+ *		constant bound, and the values it runs through.
+ */
+
+static bool counted(Statement *stmt, Loop &info)
+{
+    vector<Statement **> stmts, increments;
+    vector<Expression **> exprs;
+    Expression *test;
+    Identifier *id;
+    long limit;
+
+
+    if (dynamic_cast<For *>(stmt) == nullptr)
+	return false;
+
+    stmt->substatements(stmts);
+
+    if (dynamic_cast<Assignment *>(*stmts[0]) == nullptr)
+	return false;
+
+    (*stmts[0])->operands(exprs);
+
+    if ((id = dynamic_cast<Identifier *>(*exprs[0])) == nullptr || id->type() != Type(INT))
+	return false;
+
+    if (!(*exprs[1])->constant(info.start))
+	return false;
+
+    info.counter = id->symbol();
+    info.step = step(*stmts[1], info.counter);
+
+    if (info.step <= 0 || induction(stmt, info.counter, increments) != info.step)
+	return false;
+
+    if (increments.size() != 1 || increments[0] != stmts[1])
+	return false;
+
+    test = *operand(stmt);
+    exprs.clear();
+    test->operands(exprs);
+
+    if (exprs.size() != 2)
+	return false;
+
+    if (names(*exprs[0], info.counter) && (*exprs[1])->constant(limit)) {
+	if (dynamic_cast<LessOrEqual *>(test) != nullptr)
+	    limit ++;
+	else if (dynamic_cast<LessThan *>(test) == nullptr)
+	    return false;
+
+    } else if (names(*exprs[1], info.counter) && (*exprs[0])->constant(limit)) {
+	if (dynamic_cast<GreaterOrEqual *>(test) != nullptr)
+	    limit ++;
+	else if (dynamic_cast<GreaterThan *>(test) == nullptr)
+	    return false;
+
+    } else
+	return false;
+
+    info.trip = limit > info.start ? (limit - info.start + info.step - 1) / info.step : 0;
+    info.finish = info.start + info.trip * info.step;
+    return info.trip > 1 && info.trip <= MAXTRIP && info.finish < INT_MAX / 2;
+}
+
+
+/*
+ * Function:	child
+ *
+ * Description:	Return the slot of the loop that is the body of a loop,
+ *		perhaps in a block of its own.
+ */
+
+static Statement **child(Statement *stmt)
+{
+    vector<Statement **> stmts, slots;
+    Block *block;
+
+
+    stmt->substatements(stmts);
+
+    if ((block = dynamic_cast<Block *>(*stmts.back())) == nullptr)
+	return stmts.back();
+
+    if (!block->declarations()->symbols().empty())
+	return nullptr;
+
+    block->substatements(slots);
+    return slots.size() == 1 ? slots[0] : nullptr;
+}
+
+
+/*
+ * Function:	linear
+ *
+ * Description:	Return whether an int expression is a linear function of
+ *		the counters and of invariant variables, and its terms and
+ *		constant.
+ */
+
+static bool linear(Expression *expr, map<const Symbol *, long> &terms, long &offset)
+{
+    map<const Symbol *, long>::iterator it;
+    map<const Symbol *, long> others;
+    vector<Expression **> exprs;
+    long value, scale;
+    Identifier *id;
+
+
+    terms.clear();
+    offset = 0;
+
+    if (expr->constant(offset))
+	return true;
+
+    expr->operands(exprs);
+
+    if ((id = dynamic_cast<Identifier *>(expr)) != nullptr) {
+	if (id->type() != Type(INT))
+	    return false;
+
+	if (!invariant(expr, loop) && (addressed(id->symbol()) || !local(id->symbol())))
+	    return false;
+
+	terms[id->symbol()] = 1;
+	return true;
+    }
+
+    if (dynamic_cast<Promote *>(expr) != nullptr)
+	return (*exprs[0])->type() == Type(INT) && linear(*exprs[0], terms, offset);
+
+    if (dynamic_cast<Negate *>(expr) != nullptr) {
+	if (!linear(*exprs[0], terms, offset))
+	    return false;
+
+	scale = -1;
+
+    } else if (dynamic_cast<Multiply *>(expr) != nullptr) {
+	if ((*exprs[1])->constant(scale)) {
+	    if (!linear(*exprs[0], terms, offset))
+		return false;
+
+	} else if ((*exprs[0])->constant(scale)) {
+	    if (!linear(*exprs[1], terms, offset))
+		return false;
+
+	} else
+	    return false;
+
+    } else if (dynamic_cast<Add *>(expr) || dynamic_cast<Subtract *>(expr)) {
+	if (expr->type().isPointer() || (*exprs[0])->type().isPointer())
+	    return false;
+
+	if (!linear(*exprs[0], terms, offset) || !linear(*exprs[1], others, value))
+	    return false;
+
+	scale = dynamic_cast<Subtract *>(expr) ? -1 : 1;
+
+	for (it = others.begin(); it != others.end(); it ++)
+	    if ((terms[it->first] += scale * it->second) == 0)
+		terms.erase(it->first);
+
+	offset += scale * value;
+	return true;
+
+    } else
+	return false;
+
+    for (it = terms.begin(); it != terms.end(); it ++)
+	it->second *= scale;
+
+    offset *= scale;
+
+    if (scale == 0)
+	terms.clear();
+
+    return true;
+}
+
+
+/*
+ * Function:	record
+ *
+ * Description:	Record a reference to memory at the given address, as an
+ *		invariant base and a linear index if it is one.
+ */
+
+static void record(Expression *addr, const Type &type, bool store)
+{
+    vector<Expression **> exprs, factors;
+    Reference ref;
+    long size;
+
+
+    ref.base = nullptr;
+    ref.type = type;
+    ref.store = store;
+    ref.offset = 0;
+
+    if (invariant(addr, loop))
+	ref.base = addr;
+
+    else if (dynamic_cast<Add *>(addr) && addr->type().isPointer()) {
+	addr->operands(exprs);
+
+	if (dynamic_cast<Multiply *>(*exprs[1]) && invariant(*exprs[0], loop)) {
+	    (*exprs[1])->operands(factors);
+
+	    if ((*factors[1])->constant(size) && size == (long) type.size())
+		if (linear(*factors[0], ref.terms, ref.offset))
+		    ref.base = *exprs[0];
+	}
+    }
+
+    references.push_back(ref);
+}
+
+
+/*
+ * Function:	collect
+ *
+ * Description:	Collect the references to memory in a statement.  A read
+ *		of a variable whose address is taken is a reference at its
+ *		address.  The operand of an address expression is not
+ *		read, but its address may read memory.
+ */
+
+static void collect(Statement *stmt)
+{
+    vector<Expression **> exprs;
+    vector<Statement **> stmts;
+    Identifier *id;
+    Expression *expr;
+    Reference ref;
+
+
+    stmt->operands(exprs);
+    stmt->substatements(stmts);
+
+    for (unsigned i = 0; i < exprs.size(); i ++) {
+	expr = *exprs[i];
+
+	if (dynamic_cast<Address *>(expr) != nullptr) {
+	    if (dynamic_cast<Dereference *>(*operand(expr)) != nullptr)
+		collect(*operand(expr));
+
+	    continue;
+	}
+
+	if (dynamic_cast<Dereference *>(expr) != nullptr) {
+	    bool store = dynamic_cast<Assignment *>(stmt) && i == 0;
+	    record(*operand(expr), expr->type(), store);
+
+	} else if ((id = dynamic_cast<Identifier *>(expr)) != nullptr) {
+	    if (addressed(id->symbol()) && !id->type().isArray()) {
+		const Type &type = id->type();
+		ref.base = new Address(id, Type(type.specifier(), type.indirection() + 1));
+		ref.type = type;
+		ref.store = false;
+		ref.offset = 0;
+		references.push_back(ref);
+	    }
+	}
+
+	collect(expr);
+    }
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	collect(*stmts[i]);
+}
+
+
+/*
+ * Function:	distinct
+ *
+ * Description:	Return whether two bases are the addresses of different
+ *		variables, which cannot overlap.
+ */
+
+static bool distinct(Expression *left, Expression *right)
+{
+    Identifier *id1, *id2;
+
+
+    if (!dynamic_cast<Address *>(left) || !dynamic_cast<Address *>(right))
+	return false;
+
+    id1 = dynamic_cast<Identifier *>(*operand(left));
+    id2 = dynamic_cast<Identifier *>(*operand(right));
+    return id1 != nullptr && id2 != nullptr && id1->symbol() != id2->symbol();
+}
+
+
+/*
+ * Function:	reversed
+ *
+ * Description:	Return whether a * m + b * n == d for some nonzero m and
+ *		n of opposite signs, less than the trip counts in
+ *		magnitude: whether two iterations that run in reverse
+ *		order once the loops are reordered touch the same element.
+ */
+
+static bool reversed(long a, long b, long d, const Loop &outer, const Loop &inner)
+{
+    long rest, n;
+
+
+    for (long m = 1 - outer.trip; m < outer.trip; m ++) {
+	if (m == 0)
+	    continue;
+
+	rest = d - a * m;
+
+	if (b == 0) {
+	    if (rest == 0)
+		return true;
+
+	    continue;
+	}
+
+	if (rest % b != 0)
+	    continue;
+
+	n = rest / b;
+
+	if (n != 0 && labs(n) < inner.trip && (n > 0) != (m > 0))
+	    return true;
+    }
+
+    return false;
+}
+
+
+/*
+ * Function:	conflict
+ *
+ * Description:	Return whether two references may touch the same element
+ *		in two iterations that are run in reverse order once the
+ *		loops of a nest are reordered.
+ */
+
+static bool conflict(const Reference &r1, const Reference &r2, const Loop &outer, const Loop &inner)
+{
+    map<const Symbol *, long>::const_iterator it;
+    long a, b;
+
+
+    if (!r1.store && !r2.store)
+	return false;
+
+    if (!mayAlias(r1.type, r2.type))
+	return false;
+
+    if (r1.base == nullptr || r2.base == nullptr)
+	return true;
+
+    if (distinct(r1.base, r2.base))
+	return false;
+
+    if (key(r1.base) != key(r2.base) || r1.terms != r2.terms)
+	return true;
+
+    a = (it = r1.terms.find(outer.counter)) != r1.terms.end() ? it->second : 0;
+    b = (it = r1.terms.find(inner.counter)) != r1.terms.end() ? it->second : 0;
+    return reversed(a * outer.step, b * inner.step, r2.offset - r1.offset, outer, inner);
+}
+
+
+/*
+ * Function:	legal
+ *
+ * Description:	Return whether a nest may be run in a different order,
+ *		collecting the references to memory in its body.
+ */
+
+static bool legal(Statement *stmt, Statement *body, const Loop &outer, const Loop &inner)
+{
+    Effects effects;
+
+
+    if (outer.counter == inner.counter || nested(body))
+	return false;
+
+    ::effects(body, effects);
+
+    if (effects.calls || effects.returns || !effects.assigned.empty())
+	return false;
+
+    loop = Effects();
+    ::effects(stmt, loop);
+    references.clear();
+    collect(body);
+
+    for (unsigned i = 0; i < references.size(); i ++)
+	for (unsigned j = i; j < references.size(); j ++)
+	    if (conflict(references[i], references[j], outer, inner))
+		return false;
+
+    return true;
+}
+
+
+/*
+ * Function:	stride
+ *
+ * Description:	Return the number of bytes by which a reference steps in
+ *		each iteration of a loop, up to the size of a cache line.
+ */
+
+static long stride(const Reference &ref, const Loop &info)
+{
+    map<const Symbol *, long>::const_iterator it;
+    long bytes;
+
+
+    if (ref.base == nullptr || (it = ref.terms.find(info.counter)) == ref.terms.end())
+	return 0;
+
+    bytes = labs(it->second * info.step * ref.type.size());
+    return bytes < LINE ? bytes : LINE;
+}
+
+
+/*
+ * Function:	match
+ *
+ * Description:	Return whether a statement is a nest that may be run in a
+ *		different order, and its loops and the body of the inner.
+ */
+
+static bool match(Statement *stmt, Loop &outer, Loop &inner, Statement **&slot)
+{
+    vector<Statement **> stmts;
+
+
+    if (!counted(stmt, outer) || (slot = child(stmt)) == nullptr)
+	return false;
+
+    if (!counted(*slot, inner))
+	return false;
+
+    (*slot)->substatements(stmts);
+    return legal(stmt, *stmts.back(), outer, inner);
+}
+
+
+/*
+ * Function:	interchange
+ *
+ * Description:	Interchange the loops of a nest if they may be and the
+ *		references then step by shorter strides in the inner loop,
+ *		swapping their initializations, tests, and increments.
+ */
+
+static void interchange(Statement **slot)
+{
+    vector<Statement **> first, second;
+    long before, after;
+    Statement **nest;
+    Loop outer, inner;
+
+
+    if (!match(*slot, outer, inner, nest))
+	return;
+
+    before = after = 0;
+
+    for (unsigned i = 0; i < references.size(); i ++) {
+	before += stride(references[i], inner);
+	after += stride(references[i], outer);
+    }
+
+    if (after >= before)
+	return;
+
+    (*slot)->substatements(first);
+    (*nest)->substatements(second);
+    swap(*first[0], *second[0]);
+    swap(*first[1], *second[1]);
+    swap(*operand(*slot), *operand(*nest));
+}
+
+
+/*
+ * Function:	bounded
+ *
+ * Description:	Return a block that sets the limit of a tile: the tile
+ *		size past its first value, but no further than the loop
+ *		runs.
+ */
+
+static Statement *bounded(Symbol *limit, Symbol *first, const Loop &info)
+{
+    Statements stmts;
+    Expression *expr;
+
+
+    expr = new Number(to_string(tileSize * info.step));
+    expr = new Add(new Identifier(first), expr, Type(INT));
+    stmts.push_back(new Assignment(new Identifier(limit), expr));
+
+    expr = new GreaterThan(new Identifier(limit), new Number(to_string(info.finish)), Type(INT));
+    stmts.push_back(new If(expr, new Assignment(new Identifier(limit),
+	new Number(to_string(info.finish))), nullptr));
+
+    return new Block(new Scope(), stmts);
+}
+
+
+/*
+ * Function:	tiled
+ *
+ * Description:	Return a loop that steps a temporary through the first
+ *		values of the tiles of a loop.
+ */
+
+static Statement *tiled(Symbol *first, const Loop &info, Statement *body)
+{
+    Statement *init, *incr;
+    Expression *test;
+
+
+    init = new Assignment(new Identifier(first), new Number(to_string(info.start)));
+    test = new LessThan(new Identifier(first), new Number(to_string(info.finish)), Type(INT));
+    incr = new Assignment(new Identifier(first), new Add(new Identifier(first),
+	new Number(to_string(tileSize * info.step)), Type(INT)));
+
+    return new For(init, test, incr, body);
+}
+
+
+/*
+ * Function:	confine
+ *
+ * Description:	Make a loop run through the values of a single tile.
+ */
+
+static void confine(Statement *stmt, Symbol *first, Symbol *limit, const Loop &info)
+{
+    vector<Statement **> stmts;
+
+
+    stmt->substatements(stmts);
+    *stmts[0] = new Assignment(new Identifier(info.counter), new Identifier(first));
+    *operand(stmt) = new LessThan(new Identifier(info.counter), new Identifier(limit), Type(INT));
+}
+
+
+/*
+ * Function:	tile
+ *
+ * Description:	Tile a nest if it may be run in a different order, both
+ *		loops run more times than the tile size, and some reference
+ *		steps by a cache line in the inner loop but not the outer.
+ *		The nest is replaced by loops over the tiles, within which
+ *		the original loops run through those of the current tile.
+ */
+
+static void tile(Statement **slot)
+{
+    Symbol *outerFirst, *outerLimit, *innerFirst, *innerLimit;
+    Statement *stmt = *slot, *body;
+    Statements stmts;
+    Loop outer, inner;
+    Statement **nest;
+    bool profitable;
+    Scope *decls;
+
+
+    if (!match(stmt, outer, inner, nest))
+	return;
+
+    if (outer.trip <= (long) tileSize || inner.trip <= (long) tileSize)
+	return;
+
+    profitable = false;
+
+    for (unsigned i = 0; i < references.size(); i ++)
+	if (stride(references[i], inner) == LINE && stride(references[i], outer) < LINE)
+	    profitable = true;
+
+    if (!profitable)
+	return;
+
+    decls = new Scope();
+    outerFirst = temporary(decls, Type(INT));
+    outerLimit = temporary(decls, Type(INT));
+    innerFirst = temporary(decls, Type(INT));
+    innerLimit = temporary(decls, Type(INT));
+
+    confine(stmt, outerFirst, outerLimit, outer);
+    confine(*nest, innerFirst, innerLimit, inner);
+
+    stmts.push_back(bounded(innerLimit, innerFirst, inner));
+    stmts.push_back(stmt);
+    body = tiled(innerFirst, inner, new Block(new Scope(), stmts));
+
+    stmts.clear();
+    stmts.push_back(bounded(outerLimit, outerFirst, outer));
+    stmts.push_back(body);
+    body = tiled(outerFirst, outer, new Block(new Scope(), stmts));
+
+    stmts.clear();
+    stmts.push_back(body);
+    *slot = new Block(decls, stmts);
+}
+
+
+/*
+ * Function:	visit
+ *
+ * Description:	Apply a transformation to each nest in a statement.
+ */
+
+static void visit(Statement **slot, void (*transform)(Statement **))
+{
+    vector<Statement **> stmts;
+
+
+    (*slot)->substatements(stmts);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	visit(stmts[i], transform);
+
+    if (dynamic_cast<For *>(*slot) != nullptr)
+	transform(slot);
+}
+
+
+/*
+ * Function:	interchangeLoops
+ *
+ * Description:	Interchange the nests of loops of a function where doing
+ *		so shortens the strides of the inner loops.
+ */
+
+void interchangeLoops(Function *function)
+{
+    vector<Statement **> stmts;
+
+
+    function->body()->substatements(stmts);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	visit(stmts[i], interchange);
+}
+
+
+/*
+ * Function:	tileLoops
+ *
+ * Description:	Tile the nests of loops of a function, unless the tile
+ *		size is one.
+ */
+
+void tileLoops(Function *function)
+{
+    vector<Statement **> stmts;
+
+
+    if (tileSize < 2)
+	return;
+
+    function->body()->substatements(stmts);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	visit(stmts[i], tile);
+}
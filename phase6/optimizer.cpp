@@ -0,0 +1,1064 @@
+/*
+ * File:	optimizer.cpp
+ *
+ * Description:	This file contains the public function definitions for
+ *		optimizing the tree of a function before it is compiled.
+ *		Each pass rewrites the tree in place, finding its way
+ *		through it with the slots returned by the operands and
+ *		substatements accessors, so that the backends need know
+ *		nothing of the optimizer.  The passes are enabled by
+ *		default, and each may be turned off with -fno-name.
+ *
+ *		Also here are the analyses the passes share: which
+ *		variables are local to the function, which of those have
+ *		their address taken and which let it escape, which loads
+ *		and stores may refer to the same memory, and what a
+ *		statement may write.  A pointer based on the address of a
+ *		variable, as in a subscript of an array, can reach only
+ *		that variable.  Any other pointer may reach any global and
+ *		any local whose address escapes.
+ *		Simple C has no casts other than through void pointers,
+ *		so we assume that an int is never accessed as a long and
+ *		that a pointer is never accessed as an integer.  A char,
+ *		however, may alias anything.  A function of the C library
+ *		cannot name our variables, so a call to one writes only
+ *		what its arguments point to, if anything.  (We ignore %n.)
+ */
+
+# include <map>
+# include <typeinfo>
+# include <sstream>
+# include "optimizer.h"
+# include "checker.h"
+# include "inliner.h"
+# include "tokens.h"
+
+using namespace std;
+
+static struct {
+    const char *name;
+    bool enabled;
+    void (*pass)(Function *function);
+} passes[] = {
+    {"modref", true, summarizeEffects},
+    {"evaluate", true, evaluateCalls},
+    {"specialize", true, specializeCalls},
+    {"promote", true, promoteGlobals},
+    {"interchange", true, interchangeLoops},
+    {"tile", true, tileLoops},
+    {"licm", true, hoistInvariants},
+    {"vectorize", true, vectorizeLoops},
+    {"unroll", true, unrollLoops},
+    {"ivopts", true, reduceInductions},
+    {"cse", true, eliminateSubexpressions},
+    {"copyprop", true, propagateCopies},
+    {"dse", true, eliminateDeadStores},
+};
+
+# define numPasses (sizeof(passes) / sizeof(passes[0]))
+
+static const struct {
+    const char *name;
+    int writes;
+} library[] = {
+    {"printf", -1}, {"puts", -1}, {"putchar", -1}, {"getchar", -1},
+    {"malloc", -1}, {"calloc", -1}, {"free", -1}, {"exit", -1},
+    {"abort", -1}, {"atoi", -1}, {"abs", -1}, {"rand", -1}, {"srand", -1},
+    {"strlen", -1}, {"strcmp", -1}, {"strncmp", -1}, {"memcmp", -1},
+    {"isalpha", -1}, {"isdigit", -1}, {"isalnum", -1}, {"isspace", -1},
+    {"isupper", -1}, {"islower", -1}, {"toupper", -1}, {"tolower", -1},
+    {"scanf", 1}, {"sscanf", 2}, {"sprintf", 0}, {"realloc", 0},
+    {"strcpy", 0}, {"strncpy", 0}, {"strcat", 0}, {"memcpy", 0},
+    {"memset", 0},
+};
+
+# define numLibrary (sizeof(library) / sizeof(library[0]))
+
+static thread_local set<const Symbol *> locals, addresses, escapes;
+static thread_local map<const Symbol *, Function *> originals;
+
+
+/*
+ * Function:	optimization
+ *
+ * Description:	Enable the pass named by a flag such as licm, or disable
+ *		it if the name is preceded by no-.  Return false if there
+ *		is no such pass.
+ */
+
+bool optimization(const string &flag)
+{
+    bool enabled = flag.compare(0, 3, "no-") != 0;
+    string name = enabled ? flag : flag.substr(3);
+
+
+    for (unsigned i = 0; i < numPasses; i ++)
+	if (name == passes[i].name) {
+	    passes[i].enabled = enabled;
+	    return true;
+	}
+
+    return false;
+}
+
+
+/*
+ * Function:	optimizing
+ *
+ * Description:	Return whether the pass with the given name is enabled.
+ */
+
+bool optimizing(const string &name)
+{
+    for (unsigned i = 0; i < numPasses; i ++)
+	if (name == passes[i].name)
+	    return passes[i].enabled;
+
+    return false;
+}
+
+
+/*
+ * Function:	optimizations
+ *
+ * Description:	Return the flags of the disabled passes, so that the
+ *		code cached under one set of flags is not found under
+ *		another.
+ */
+
+string optimizations()
+{
+    string flags;
+
+
+    for (unsigned i = 0; i < numPasses; i ++)
+	if (!passes[i].enabled)
+	    flags += string(" no-") + passes[i].name;
+
+    return flags;
+}
+
+
+/*
+ * Function:	survey
+ *
+ * Description:	Find the local variables declared in a statement, the
+ *		variables whose address is taken, and those whose address
+ *		escapes.  An address escapes unless it is based, being the
+ *		pointer dereferenced by a load or store, possibly offset,
+ *		as the array in a subscript is.
+ */
+
+static void survey(Statement *stmt, bool based)
+{
+    vector<Expression **> exprs;
+    vector<Statement **> stmts;
+    Block *block;
+    Identifier *id;
+
+
+    stmt->operands(exprs);
+    stmt->substatements(stmts);
+
+    if ((block = dynamic_cast<Block *>(stmt)) != nullptr) {
+	const Symbols &symbols = block->declarations()->symbols();
+	locals.insert(symbols.begin(), symbols.end());
+    }
+
+    if (dynamic_cast<Address *>(stmt) != nullptr) {
+	if ((id = dynamic_cast<Identifier *>(*exprs[0])) != nullptr) {
+	    addresses.insert(id->symbol());
+
+	    if (!based)
+		escapes.insert(id->symbol());
+
+	} else if (dynamic_cast<Dereference *>(*exprs[0]) != nullptr)
+	    survey(*operand(*exprs[0]), based);
+
+	return;
+    }
+
+    if (dynamic_cast<Dereference *>(stmt) != nullptr)
+	based = true;
+    else if (!dynamic_cast<Add *>(stmt) && !dynamic_cast<Subtract *>(stmt))
+	based = false;
+
+    for (unsigned i = 0; i < exprs.size(); i ++)
+	survey(*exprs[i], based && (*exprs[i])->type().isPointer());
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	survey(*stmts[i], false);
+}
+
+
+/*
+ * Function:	initOptimizer
+ *
+ * Description:	Forget the functions of the previous translation unit.
+ */
+
+void initOptimizer()
+{
+    originals.clear();
+    initSummaries();
+    initEvaluations();
+    initSpecializations();
+}
+
+
+/*
+ * Function:	original
+ *
+ * Description:	Return a copy of a function as it was before it was
+ *		optimized, or null if it has not been defined.
+ */
+
+Function *original(const Symbol *id)
+{
+    map<const Symbol *, Function *>::iterator it;
+
+
+    if ((it = originals.find(id)) == originals.end())
+	return nullptr;
+
+    return it->second;
+}
+
+
+/*
+ * Function:	optimize
+ *
+ * Description:	Run each enabled pass over the given function, surveying
+ *		it anew before each, since a pass may copy statements
+ *		along with the variables they declare.  A copy of the
+ *		function is kept first for the passes that read the
+ *		bodies of the functions it calls.
+ */
+
+void optimize(Function *function)
+{
+    Renaming renaming;
+    Block *body;
+
+
+    if (optimizing("evaluate") || optimizing("specialize")) {
+	body = static_cast<Block *>(function->body()->clone(renaming));
+	originals[function->id()] = new Function(function->id(), body);
+    }
+
+    for (unsigned i = 0; i < numPasses; i ++)
+	if (passes[i].enabled) {
+	    locals.clear();
+	    addresses.clear();
+	    escapes.clear();
+	    survey(function->body(), false);
+	    passes[i].pass(function);
+	}
+}
+
+
+/*
+ * Function:	summary
+ *
+ * Description:	Return what the functions after the given one need to know
+ *		of it, for the cache entry of its code.  The summary is
+ *		just "body" if they may need its body itself: to inline
+ *		calls to it, to evaluate them if it is pure, or to
+ *		specialize them, or to compile the copies it calls.
+ *		Otherwise, it is what the function writes.
+ */
+
+string summary(Function *function)
+{
+    stringstream ss;
+
+
+    if (inlinable(function->id()))
+	return "body\n";
+
+    if (optimizing("evaluate") && pure(function->id()))
+	return "body\n";
+
+    if (optimizing("specialize") && specializes(function))
+	return "body\n";
+
+    saveSummary(function->id(), ss);
+    return ss.str();
+}
+
+
+/*
+ * Function:	restore
+ *
+ * Description:	Restore the summary of a function whose code was found in
+ *		the cache, looking up the globals it names in the given
+ *		scope, and returning false if its body is needed instead.
+ */
+
+bool restore(const Symbol *id, const string &summary, const Scope *scope)
+{
+    stringstream ss(summary);
+
+
+    if (summary.compare(0, 4, "body") == 0)
+	return false;
+
+    return !optimizing("modref") || loadSummary(id, ss, scope);
+}
+
+
+/*
+ * Function:	temporary
+ *
+ * Description:	Declare a fresh variable of the given type in a scope.
+ *		Its name cannot be written in Simple C, and so it never
+ *		collides with one that can.
+ */
+
+Symbol *temporary(Scope *scope, const Type &type)
+{
+    Symbol *symbol;
+
+
+    symbol = new Symbol("$" + to_string(scope->symbols().size()), type);
+    scope->insert(symbol);
+    locals.insert(symbol);
+    return symbol;
+}
+
+
+/*
+ * Function:	number
+ *
+ * Description:	Return an expression for an int constant.
+ */
+
+Expression *number(long value)
+{
+    if (value < 0)
+	return new Negate(new Number(to_string(-value)), Type(INT));
+
+    return new Number(to_string(value));
+}
+
+
+/*
+ * Function:	operand
+ *
+ * Description:	Return the slot of the nth operand of a statement.
+ */
+
+Expression **operand(Statement *stmt, unsigned n)
+{
+    vector<Expression **> exprs;
+
+
+    stmt->operands(exprs);
+    return exprs[n];
+}
+
+
+/*
+ * Function:	key
+ *
+ * Description:	Return a string that is the same for two expressions if
+ *		and only if they have the same shape, types, variables,
+ *		and constants, and so compute the same value when
+ *		evaluated in the same state.
+ */
+
+string key(Expression *expr)
+{
+    vector<Expression **> exprs;
+    stringstream ss;
+    Identifier *id;
+    Number *number;
+    String *str;
+
+
+    ss << typeid(*expr).name() << '<' << expr->type() << '>';
+
+    if ((id = dynamic_cast<Identifier *>(expr)) != nullptr)
+	ss << id->symbol();
+    else if ((number = dynamic_cast<Number *>(expr)) != nullptr)
+	ss << number->value();
+    else if ((str = dynamic_cast<String *>(expr)) != nullptr)
+	ss << str->value().size() << str->value();
+
+    expr->operands(exprs);
+    ss << '(';
+
+    for (unsigned i = 0; i < exprs.size(); i ++)
+	ss << key(*exprs[i]) << ',';
+
+    ss << ')';
+    return ss.str();
+}
+
+
+/*
+ * Function:	local
+ *
+ * Description:	Return whether a variable is local to the function.
+ */
+
+bool local(const Symbol *symbol)
+{
+    return locals.count(symbol) > 0;
+}
+
+
+/*
+ * Function:	addressed
+ *
+ * Description:	Return whether a variable may be accessed other than by
+ *		name, because it is global or its address is taken.
+ */
+
+bool addressed(const Symbol *symbol)
+{
+    return !local(symbol) || addresses.count(symbol) > 0;
+}
+
+
+/*
+ * Function:	escaped
+ *
+ * Description:	Return whether a variable may be accessed through a
+ *		pointer we cannot trace back to it, because it is global
+ *		or its address escapes.
+ */
+
+bool escaped(const Symbol *symbol)
+{
+    return !local(symbol) || escapes.count(symbol) > 0;
+}
+
+
+/*
+ * Function:	base
+ *
+ * Description:	Return the pointer on which an address is based, without
+ *		the offsets added to it, as the array of a subscript is.
+ */
+
+Expression *base(Expression *pointer)
+{
+    vector<Expression **> exprs;
+
+
+    while (true) {
+	if (dynamic_cast<Add *>(pointer) || dynamic_cast<Subtract *>(pointer)) {
+	    exprs.clear();
+	    pointer->operands(exprs);
+	    pointer = (*exprs[0])->type().isPointer() ? *exprs[0] : *exprs[1];
+
+	} else if (dynamic_cast<Address *>(pointer) != nullptr) {
+	    if (dynamic_cast<Dereference *>(*operand(pointer)) == nullptr)
+		return pointer;
+
+	    pointer = *operand(*operand(pointer));
+
+	} else
+	    return pointer;
+    }
+}
+
+
+/*
+ * Function:	target
+ *
+ * Description:	Return the variable a pointer can reach, if it is based
+ *		on the address of one, or null if we cannot tell.
+ */
+
+static const Symbol *target(Expression *pointer)
+{
+    pointer = base(pointer);
+
+    if (dynamic_cast<Address *>(pointer) == nullptr)
+	return nullptr;
+
+    return object(*operand(pointer));
+}
+
+
+/*
+ * Function:	object
+ *
+ * Description:	Return the variable whose memory is accessed by a load
+ *		or store, either by name or through a pointer based on its
+ *		address, or null if we cannot tell.
+ */
+
+const Symbol *object(Expression *expr)
+{
+    Identifier *id;
+
+
+    if ((id = dynamic_cast<Identifier *>(expr)) != nullptr)
+	return id->symbol();
+
+    if (dynamic_cast<Dereference *>(expr) == nullptr)
+	return nullptr;
+
+    return target(*operand(expr));
+}
+
+
+/*
+ * Function:	Store::Store (constructor)
+ *
+ * Description:	Initialize a store to the given variable or dereference,
+ *		as by an assignment to it.
+ */
+
+Store::Store(Expression *expr)
+    : expr(expr), pointer(nullptr), object(::object(expr)), type(expr->type())
+{
+    if (dynamic_cast<Dereference *>(expr) != nullptr)
+	pointer = *operand(expr);
+}
+
+
+/*
+ * Function:	Store::Store (constructor)
+ *
+ * Description:	Initialize a store of the given type through a pointer,
+ *		as by a call, without making a dereference of it.
+ */
+
+Store::Store(Expression *pointer, const Type &type)
+    : expr(nullptr), pointer(pointer), object(target(pointer)), type(type)
+{
+}
+
+
+/*
+ * Function:	Store::Store (constructor)
+ *
+ * Description:	Initialize a store of the given type to the given
+ *		variable, or through a pointer we cannot trace if it is
+ *		null, as kept in the summary of a function.
+ */
+
+Store::Store(const Symbol *object, const Type &type)
+    : expr(nullptr), pointer(nullptr), object(object), type(type)
+{
+}
+
+
+/*
+ * Function:	mayAlias (types)
+ *
+ * Description:	Return whether a value of one type may be stored in the
+ *		memory of a value of another.
+ */
+
+bool mayAlias(const Type &left, const Type &right)
+{
+    if (left.specifier() == CHAR && left.indirection() == 0)
+	return true;
+
+    if (right.specifier() == CHAR && right.indirection() == 0)
+	return true;
+
+    if (left.indirection() > 0 && right.indirection() > 0)
+	return true;
+
+    return left.specifier() == right.specifier() &&
+	left.indirection() == right.indirection();
+}
+
+
+/*
+ * Function:	mayAlias (store and expression)
+ *
+ * Description:	Return whether a store and a load or store, a variable or
+ *		a dereference, may access the same memory.  Two accesses
+ *		to different variables never do, and one to a variable
+ *		whose address never escapes is never through a pointer we
+ *		cannot trace back to it.
+ */
+
+bool mayAlias(const Store &store, Expression *expr)
+{
+    const Symbol *symbol;
+
+
+    if (!mayAlias(store.type, expr->type()))
+	return false;
+
+    symbol = object(expr);
+
+    if (store.object != nullptr && symbol != nullptr)
+	return store.object == symbol;
+
+    if (store.object != nullptr)
+	return escaped(store.object);
+
+    if (symbol != nullptr)
+	return escaped(symbol);
+
+    return true;
+}
+
+
+/*
+ * Function:	mayAlias (expressions)
+ *
+ * Description:	Return whether two loads or stores, each a variable or
+ *		a dereference, may access the same memory.
+ */
+
+bool mayAlias(Expression *left, Expression *right)
+{
+    return mayAlias(Store(left), right);
+}
+
+
+/*
+ * Function:	writes
+ *
+ * Description:	Return the index of the first argument through which a
+ *		call may write, every pointer argument from it on being
+ *		suspect, or -1 if it writes nothing we can see.  Return
+ *		the number of arguments if the function is unknown and may
+ *		write anything addressed.
+ */
+
+static int writes(const Symbol *id, unsigned count)
+{
+    if (id->_attributes & FUNCDEFN)
+	return count;
+
+    for (unsigned i = 0; i < numLibrary; i ++)
+	if (id->name() == library[i].name)
+	    return library[i].writes;
+
+    return count;
+}
+
+
+/*
+ * Function:	external
+ *
+ * Description:	Return whether a function is one of the C library that we
+ *		know, which cannot name our variables.
+ */
+
+bool external(const Symbol *id)
+{
+    if (id->_attributes & FUNCDEFN)
+	return false;
+
+    for (unsigned i = 0; i < numLibrary; i ++)
+	if (id->name() == library[i].name)
+	    return true;
+
+    return false;
+}
+
+
+/*
+ * Function:	effects
+ *
+ * Description:	Add to the given effects what a statement may write: the
+ *		variables assigned by name, the memory stored to other
+ *		than by a variable whose address is never taken, whether
+ *		it calls a function, whether that function may write
+ *		anything whose address escapes, and whether it returns.
+ *		A call, inlined or not, to a function whose effects have
+ *		been summarized writes what its summary says, and a call
+ *		to a function of the C library stores through its pointer
+ *		arguments.  Any other call clobbers memory.  A vector
+ *		assignment stores ints.
+ */
+
+void effects(Statement *stmt, Effects &effects)
+{
+    vector<Expression **> exprs;
+    vector<Statement **> stmts;
+    Identifier *id;
+    Inline *inlined;
+    Call *call;
+    int first;
+
+
+    stmt->operands(exprs);
+    stmt->substatements(stmts);
+
+    if (dynamic_cast<Assignment *>(stmt) != nullptr) {
+	if ((id = dynamic_cast<Identifier *>(*exprs[0])) != nullptr)
+	    effects.assigned.insert(id->symbol());
+
+	if (id == nullptr || addressed(id->symbol()))
+	    effects.stores.push_back(Store(*exprs[0]));
+    }
+
+    if ((call = dynamic_cast<Call *>(stmt)) != nullptr) {
+	effects.calls = true;
+
+	if (!summarized(call->id(), exprs, effects)) {
+	    first = writes(call->id(), exprs.size());
+
+	    if (first == (int) exprs.size())
+		effects.clobbers = true;
+
+	    for (int i = first; i >= 0 && i < (int) exprs.size(); i ++) {
+		const Type &type = (*exprs[i])->type();
+
+		if (type.isPointer() && type.deref().specifier() != VOID)
+		    effects.stores.push_back(Store(*exprs[i], type.deref()));
+		else if (type.isPointer())
+		    effects.stores.push_back(Store(*exprs[i], Type(CHAR)));
+	    }
+	}
+    }
+
+    if (dynamic_cast<Vector *>(stmt) != nullptr)
+	effects.stores.push_back(Store(*exprs[0], Type(INT)));
+
+    if ((inlined = dynamic_cast<Inline *>(stmt)) != nullptr) {
+	effects.calls = true;
+
+	if (!summarized(inlined->id(), exprs, effects))
+	    effects.clobbers = true;
+    }
+
+    if (dynamic_cast<Return *>(stmt) != nullptr)
+	effects.returns = true;
+
+    for (unsigned i = 0; i < exprs.size(); i ++)
+	::effects(*exprs[i], effects);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	::effects(*stmts[i], effects);
+}
+
+
+/*
+ * Function:	stored
+ *
+ * Description:	Return whether the memory accessed by a load may be
+ *		written by a call or store with the given effects.
+ */
+
+static bool stored(Expression *expr, const Effects &loop)
+{
+    const Symbol *symbol = object(expr);
+
+
+    if (loop.clobbers && (symbol == nullptr || escaped(symbol)))
+	return true;
+
+    for (unsigned i = 0; i < loop.stores.size(); i ++)
+	if (mayAlias(loop.stores[i], expr))
+	    return true;
+
+    return false;
+}
+
+
+/*
+ * Function:	invariant
+ *
+ * Description:	Return whether an expression computes the same value
+ *		before and after any statements with the given effects,
+ *		such as the iterations of a loop.  The operand of an
+ *		address expression is not read, so only its address need
+ *		be invariant.  An expression with a call never is.
+ */
+
+bool invariant(Expression *expr, const Effects &loop)
+{
+    vector<Expression **> exprs;
+    Identifier *id;
+
+
+    if (dynamic_cast<Call *>(expr) || dynamic_cast<Inline *>(expr))
+	return false;
+
+    if ((id = dynamic_cast<Identifier *>(expr)) != nullptr) {
+	const Symbol *symbol = id->symbol();
+
+	if (symbol->type().isArray())
+	    return true;
+
+	if (loop.assigned.count(symbol) > 0)
+	    return false;
+
+	return !addressed(symbol) || !stored(expr, loop);
+    }
+
+    if (dynamic_cast<Address *>(expr) != nullptr) {
+	expr = *operand(expr);
+
+	if (dynamic_cast<Dereference *>(expr) == nullptr)
+	    return true;
+
+	return invariant(*operand(expr), loop);
+    }
+
+    if (dynamic_cast<Dereference *>(expr) != nullptr)
+	if (stored(expr, loop))
+	    return false;
+
+    expr->operands(exprs);
+
+    for (unsigned i = 0; i < exprs.size(); i ++)
+	if (!invariant(*exprs[i], loop))
+	    return false;
+
+    return true;
+}
+
+
+/*
+ * Function:	traps
+ *
+ * Description:	Return whether evaluating an expression may trap, because
+ *		it dereferences a pointer or divides.
+ */
+
+bool traps(Expression *expr)
+{
+    vector<Expression **> exprs;
+
+
+    if (dynamic_cast<Address *>(expr) != nullptr) {
+	expr = *operand(expr);
+
+	if (dynamic_cast<Dereference *>(expr) == nullptr)
+	    return false;
+
+	return traps(*operand(expr));
+    }
+
+    if (dynamic_cast<Dereference *>(expr) != nullptr)
+	return true;
+
+    if (dynamic_cast<Divide *>(expr) || dynamic_cast<Remainder *>(expr))
+	return true;
+
+    expr->operands(exprs);
+
+    for (unsigned i = 0; i < exprs.size(); i ++)
+	if (traps(*exprs[i]))
+	    return true;
+
+    return false;
+}
+
+
+/*
+ * Function:	nested
+ *
+ * Description:	Return whether a statement contains a loop.
+ */
+
+bool nested(Statement *stmt)
+{
+    vector<Statement **> stmts;
+
+
+    if (dynamic_cast<While *>(stmt) || dynamic_cast<For *>(stmt))
+	return true;
+
+    stmt->substatements(stmts);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	if (nested(*stmts[i]))
+	    return true;
+
+    return false;
+}
+
+
+/*
+ * Function:	trivial
+ *
+ * Description:	Return whether an expression is no more expensive to
+ *		compute than to load from a temporary.
+ */
+
+bool trivial(Expression *expr)
+{
+    long value;
+
+
+    if (dynamic_cast<Identifier *>(expr) != nullptr)
+	return true;
+
+    if (dynamic_cast<Number *>(expr) || dynamic_cast<String *>(expr))
+	return true;
+
+    if (dynamic_cast<Address *>(expr) != nullptr)
+	return dynamic_cast<Dereference *>(*operand(expr)) == nullptr;
+
+    return expr->constant(value);
+}
+
+
+/*
+ * Function:	names
+ *
+ * Description:	Return whether an expression is the given variable.
+ */
+
+bool names(Expression *expr, const Symbol *symbol)
+{
+    Identifier *id = dynamic_cast<Identifier *>(expr);
+    return id != nullptr && id->symbol() == symbol;
+}
+
+
+/*
+ * Function:	step
+ *
+ * Description:	Return the constant by which a statement increments a
+ *		variable, or zero if it is not an increment of it.
+ */
+
+long step(Statement *stmt, const Symbol *symbol)
+{
+    vector<Expression **> exprs;
+    Expression *right;
+    long value;
+
+
+    if (dynamic_cast<Assignment *>(stmt) == nullptr)
+	return 0;
+
+    stmt->operands(exprs);
+    right = *exprs[1];
+
+    if (!names(*exprs[0], symbol))
+	return 0;
+
+    exprs.clear();
+    right->operands(exprs);
+
+    if (dynamic_cast<Add *>(right) != nullptr) {
+	if (names(*exprs[0], symbol) && (*exprs[1])->constant(value))
+	    return value;
+
+	if (names(*exprs[1], symbol) && (*exprs[0])->constant(value))
+	    return value;
+    }
+
+    if (dynamic_cast<Subtract *>(right) != nullptr)
+	if (names(*exprs[0], symbol) && (*exprs[1])->constant(value))
+	    return -value;
+
+    return 0;
+}
+
+
+/*
+ * Function:	count
+ *
+ * Description:	Return the number of times a statement reads a variable,
+ *		and add to writes the number of times it assigns it.
+ */
+
+unsigned count(Statement *stmt, const Symbol *symbol, unsigned &writes)
+{
+    vector<Expression **> exprs;
+    vector<Statement **> stmts;
+    unsigned reads = 0;
+
+
+    stmt->operands(exprs);
+    stmt->substatements(stmts);
+
+    if (names(dynamic_cast<Expression *>(stmt), symbol))
+	return 1;
+
+    if (dynamic_cast<Assignment *>(stmt) && names(*exprs[0], symbol)) {
+	exprs.erase(exprs.begin());
+	writes ++;
+    }
+
+    for (unsigned i = 0; i < exprs.size(); i ++)
+	reads += count(*exprs[i], symbol, writes);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	reads += count(*stmts[i], symbol, writes);
+
+    return reads;
+}
+
+
+/*
+ * Function:	unconditional
+ *
+ * Description:	Find the slots of the statements of a loop that are
+ *		evaluated exactly once in every iteration that completes:
+ *		those of its body, its increment if it is a for statement,
+ *		and those of any block among them.
+ */
+
+static void unconditional(Statement **slot, vector<Statement **> &slots)
+{
+    vector<Statement **> stmts;
+
+
+    if (dynamic_cast<Block *>(*slot) == nullptr) {
+	slots.push_back(slot);
+	return;
+    }
+
+    (*slot)->substatements(stmts);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	unconditional(stmts[i], slots);
+}
+
+
+/*
+ * Function:	induction
+ *
+ * Description:	Return the total step of a variable in an iteration of a
+ *		loop, and the slots of the statements that step it, if it
+ *		is an induction variable: a variable not addressed that
+ *		the loop assigns only by stepping it by a constant, in the
+ *		same direction, in statements evaluated in every
+ *		iteration.  Otherwise, return zero.  The initialization of
+ *		a for statement is not part of the loop.
+ */
+
+long induction(Statement *loop, const Symbol *symbol, vector<Statement **> &increments)
+{
+    vector<Statement **> stmts, slots;
+    unsigned writes, before;
+    long total, value;
+
+
+    if (addressed(symbol))
+	return 0;
+
+    writes = before = 0;
+    count(loop, symbol, writes);
+    loop->substatements(stmts);
+
+    if (dynamic_cast<For *>(loop) != nullptr) {
+	count(*stmts[0], symbol, before);
+	unconditional(stmts[1], slots);
+    }
+
+    unconditional(stmts.back(), slots);
+    increments.clear();
+    total = 0;
+
+    for (unsigned i = 0; i < slots.size(); i ++)
+	if ((value = step(*slots[i], symbol)) != 0) {
+	    if (total != 0 && (total > 0) != (value > 0))
+		return 0;
+
+	    total += value;
+	    increments.push_back(slots[i]);
+	}
+
+    return increments.size() == writes - before ? total : 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * File:	optimizer.h
+ *
+ * Description:	This file contains the public function declarations for
+ *		optimizing the tree of a function before it is compiled,
+ *		and for the analyses shared by the passes that do so.
+ */
+
+# ifndef OPTIMIZER_H
+# define OPTIMIZER_H
+# include <set>
+# include <string>
+# include <vector>
+# include "Tree.h"
+
+extern unsigned unrollFactor, tileSize, specializeBudget;
+
+struct Store {
+    Expression *expr, *pointer;
+    const Symbol *object;
+    Type type;
+
+    Store(Expression *expr);
+    Store(Expression *pointer, const Type &type);
+    Store(const Symbol *object, const Type &type);
+};
+
+struct Effects {
+    std::set<const Symbol *> assigned;
+    std::vector<Store> stores;
+    bool calls, clobbers, returns;
+
+    Effects() : calls(false), clobbers(false), returns(false) {}
+};
+
+bool optimization(const std::string &flag);
+bool optimizing(const std::string &name);
+std::string optimizations();
+void optimize(Function *function);
+void initOptimizer();
+Function *original(const Symbol *id);
+std::string summary(Function *function);
+bool restore(const Symbol *id, const std::string &summary, const Scope *scope);
+void initSummaries();
+bool summarized(const Symbol *id, const std::vector<Expression **> &args, Effects &effects);
+void saveSummary(const Symbol *id, std::ostream &out);
+bool loadSummary(const Symbol *id, std::istream &in, const Scope *scope);
+void initEvaluations();
+bool pure(const Symbol *id);
+void initSpecializations();
+std::vector<Function *> specializations();
+bool specializes(Function *function);
+
+Symbol *temporary(Scope *scope, const Type &type);
+Expression *number(long value);
+Expression **operand(Statement *stmt, unsigned n = 0);
+std::string key(Expression *expr);
+bool local(const Symbol *symbol);
+bool addressed(const Symbol *symbol);
+bool escaped(const Symbol *symbol);
+Expression *base(Expression *pointer);
+const Symbol *object(Expression *expr);
+bool mayAlias(const Type &left, const Type &right);
+bool mayAlias(Expression *left, Expression *right);
+bool mayAlias(const Store &store, Expression *expr);
+bool external(const Symbol *id);
+void effects(Statement *stmt, Effects &effects);
+bool invariant(Expression *expr, const Effects &loop);
+bool traps(Expression *expr);
+bool trivial(Expression *expr);
+bool names(Expression *expr, const Symbol *symbol);
+bool nested(Statement *stmt);
+long step(Statement *stmt, const Symbol *symbol);
+unsigned count(Statement *stmt, const Symbol *symbol, unsigned &writes);
+long induction(Statement *loop, const Symbol *symbol, std::vector<Statement **> &increments);
+
+void summarizeEffects(Function *function);
+void evaluateCalls(Function *function);
+void specializeCalls(Function *function);
+void promoteGlobals(Function *function);
+void interchangeLoops(Function *function);
+void tileLoops(Function *function);
+void hoistInvariants(Function *function);
+void vectorizeLoops(Function *function);
+void unrollLoops(Function *function);
+void reduceInductions(Function *function);
+void eliminateSubexpressions(Function *function);
+void propagateCopies(Function *function);
+void eliminateDeadStores(Function *function);
+
+# endif /* OPTIMIZER_H */
@@ -7,28 +7,57 @@
  */
 
 # include <cstdlib>
+# include <deque>
+# include <map>
+# include <set>
+# include <sstream>
 # include <iostream>
 # include "generator.h"
 # include "checker.h"
+# include "parser.h"
+# include "cache.h"
+# include "assembler.h"
+# include "elf.h"
+# include "bytecode.h"
+# include "translator.h"
+# include "inliner.h"
+# include "optimizer.h"
+# include "machine.h"
 # include "tokens.h"
 # include "lexer.h"
 
 using namespace std;
 
-static int lookahead;
-static string lexbuf;
+static thread_local int lookahead;
+static thread_local string lexbuf;
 
-static Type returnType;
+static thread_local Type returnType;
 static Expression *expression();
 static Statement *statement();
 
-static Symbols globals;
+static thread_local Symbols globals;
+
+struct SyntaxError {};
+
+struct Token {
+    int token;
+    string lexeme;
+    int line;
+};
+
+static thread_local deque<Token> pending;
+static thread_local Program *program;
+static thread_local bool source;
+static thread_local map<string, uint64_t> bodies;
 
 
 /*
  * Function:	error
  *
- * Description:	Report a syntax error to standard error.
+ * Description:	Report a syntax error.  Since we do no error recovery, the
+ *		rest of the translation unit is abandoned, but we unwind
+ *		back to compile() rather than exiting so that other units
+ *		being compiled in this process are unaffected.
  */
 
 static void error()
@@ -38,7 +67,30 @@ static void error()
     else
 	report("syntax error at '%s'", lexbuf);
 
-    exit(EXIT_FAILURE);
+    throw SyntaxError();
+}
+
+
+/*
+ * Function:	next
+ *
+ * Description:	Return the next token and its lexeme, using any tokens
+ *		that have been read ahead before calling the lexer again.
+ */
+
+static int next(string &buf)
+{
+    int token;
+
+
+    if (pending.empty())
+	return lexan(buf);
+
+    token = pending.front().token;
+    buf = pending.front().lexeme;
+    lineno = pending.front().line;
+    pending.pop_front();
+    return token;
 }
 
 
@@ -55,7 +107,7 @@ static void match(int t)
     if (lookahead != t)
 	error();
 
-    lookahead = lexan(lexbuf);
+    lookahead = next(lexbuf);
 }
 
 
@@ -256,6 +308,7 @@ static Expression *primaryExpression()
     string name;
     Expressions args;
     Expression *expr;
+    Symbol *symbol;
 
 
     if (lookahead == '(') {
@@ -285,7 +338,11 @@ static Expression *primaryExpression()
 	    }
 
 	    match(')');
-	    expr = checkCall(checkFunction(name), args);
+	    symbol = checkFunction(name);
+	    expr = checkCall(symbol, args);
+
+	    if (!source)
+		expr = inlineCall(symbol, args, expr);
 
 	} else
 	    expr = new Identifier(checkIdentifier(name));
@@ -890,10 +947,120 @@ static void remainingDeclarators(int typespec)
 }
 
 
+/*
+ * Function:	interprocedural
+ *
+ * Description:	Return whether how a function is compiled may depend on
+ *		the bodies of the functions it calls, which happens when
+ *		inlining, summarizing, evaluating, or specializing them.
+ */
+
+static bool interprocedural()
+{
+    if (inlineThreshold > 0 || optimizing("modref"))
+	return true;
+
+    return optimizing("evaluate") || optimizing("specialize");
+}
+
+
+/*
+ * Function:	readBody
+ *
+ * Description:	Read ahead the tokens of the body of the function being
+ *		defined, whose opening brace is the lookahead, and return
+ *		its fingerprint for the cache.  The fingerprint covers the
+ *		function's type and parameter names, the tokens of the
+ *		body, and the global declaration, if any, of every
+ *		identifier in the body.  If how the function is compiled
+ *		may depend on the functions it calls, the fingerprint of
+ *		any function already defined that the body calls is also
+ *		covered, since its code may be copied into ours, run to
+ *		fold a call, or decide how ours is optimized.  The tokens
+ *		are left pending so that the body can still be parsed.  If
+ *		the body is incomplete, zero is returned.
+ */
+
+static uint64_t readBody(const Symbol *symbol)
+{
+    stringstream tokens, refs;
+    Scope *params = currentScope();
+    const Symbols &symbols = params->symbols();
+    set<string> seen;
+    Symbol *global;
+    Token token;
+    int depth = 1;
+
+
+    tokens << symbol->name() << ": " << symbol->type();
+
+    for (unsigned i = 0; i < symbols.size(); i ++)
+	tokens << " " << symbols[i]->name();
+
+    tokens << endl;
+
+    while (depth > 0) {
+	token.token = lexan(token.lexeme);
+	token.line = lineno;
+	pending.push_back(token);
+
+	if (token.token == DONE)
+	    return 0;
+	else if (token.token == '{')
+	    depth ++;
+	else if (token.token == '}')
+	    depth --;
+
+	tokens << token.token << " " << token.lexeme << endl;
+
+	if (token.token == ID && seen.insert(token.lexeme).second) {
+	    global = params->enclosing()->find(token.lexeme);
+	    refs << token.lexeme << ": ";
+
+	    if (global != nullptr)
+		refs << global->type() << endl;
+	    else
+		refs << "undeclared" << endl;
+
+	    if (interprocedural() && bodies.count(token.lexeme) > 0)
+		refs << bodies[token.lexeme] << endl;
+	}
+    }
+
+    bodies[symbol->name()] = fingerprint(tokens.str() + refs.str());
+    return bodies[symbol->name()];
+}
+
+
+/*
+ * Function:	skipBody
+ *
+ * Description:	Skip the pending tokens of a function body whose code has
+ *		been found in the cache.  We never get here if the body had
+ *		errors, so the only effect of checking that we must mimic
+ *		is the implicit declaration of any functions it calls.
+ */
+
+static void skipBody()
+{
+    for (unsigned i = 0; i + 1 < pending.size(); i ++)
+	if (pending[i].token == ID && pending[i + 1].token == '(')
+	    checkFunction(pending[i].lexeme);
+
+    pending.clear();
+    lookahead = next(lexbuf);
+}
+
+
 /*
  * Function:	topLevelDeclaration
  *
- * Description:	Parse a global declaration or function definition.
+ * Description:	Parse a global declaration or function definition.  Any
+ *		copies of earlier functions that the optimizer specialized
+ *		for the calls in a function are compiled right after it.
+ *		A function whose code is found in the cache is skipped,
+ *		unless the functions after it may need its body, in which
+ *		case it is still parsed and optimized, but not generated.
  *
  * 		global-or-function:
  * 		  specifier pointers identifier remaining-decls
@@ -909,9 +1076,13 @@ static void topLevelDeclaration()
     Parameters *params;
     string name;
     Statements stmts;
+    vector<Function *> copies;
     Function *function;
+    Fragment fragment;
     Symbol *symbol;
     Scope *decls;
+    uint64_t key;
+    bool hit = false;
 
 
     typespec = specifier();
@@ -933,6 +1104,25 @@ static void topLevelDeclaration()
 	if (lookahead == '{') {
 	    returnType = Type(typespec, indirection);
 	    symbol = defineFunction(name, Type(typespec, indirection, params));
+	    key = 0;
+
+	    if (cacheEnabled() && numerrors == 0 && program == nullptr && !source)
+		key = readBody(symbol);
+
+	    if (key != 0 && numerrors == 0 && findFragment(key, fragment)) {
+		decls = currentScope()->enclosing();
+
+		if (!interprocedural() || restore(symbol, fragment.summary, decls)) {
+		    skipBody();
+		    closeScope();
+		    emitFragment(fragment);
+		    return;
+		}
+
+		hit = true;
+	    }
+
+	    enterFunction(symbol);
 	    match('{');
 	    declarations();
 	    stmts = statements();
@@ -940,9 +1130,37 @@ static void topLevelDeclaration()
 	    function = new Function(symbol, new Block(decls, stmts));
 	    match('}');
 
+	    if (numerrors == 0 && !source)
+		optimize(function);
+
 	    if (numerrors == 0)
+		leaveFunction(function);
+
+	    if (hit)
+		emitFragment(fragment);
+
+	    else if (numerrors == 0 && key != 0) {
+		generateFragment(function, fragment);
+		fragment.summary = summary(function);
+		storeFragment(key, fragment);
+
+	    } else if (numerrors == 0 && program != nullptr)
+		function->lower();
+
+	    else if (numerrors == 0 && source)
+		translateFunction(function);
+
+	    else if (numerrors == 0)
 		function->generate();
 
+	    copies = specializations();
+
+	    for (unsigned i = 0; numerrors == 0 && i < copies.size(); i ++)
+		if (program != nullptr)
+		    copies[i]->lower();
+		else
+		    copies[i]->generate();
+
 	} else {
 	    closeScope();
 	    declareFunction(name, Type(typespec, indirection, params));
@@ -958,22 +1176,113 @@ static void topLevelDeclaration()
 
 
 /*
- * Function:	main
+ * Function:	translationUnit
  *
- * Description:	Analyze the standard input stream.
+ * Description:	Parse the translation unit.  If a syntax error occurs, any
+ *		scopes left open are closed on the way out.
+ *
+ *		translation-unit:
+ *		  empty
+ *		  global-or-function translation-unit
  */
 
-int main()
+static void translationUnit()
 {
+    globals.clear();
+    pending.clear();
+    bodies.clear();
     openScope();
-    lookahead = lexan(lexbuf);
 
-    while (lookahead != DONE)
-	topLevelDeclaration();
+    try {
+	lookahead = lexan(lexbuf);
+
+	while (lookahead != DONE)
+	    topLevelDeclaration();
+
+	if (numerrors == 0 && source)
+	    translateGlobals(currentScope()->symbols());
+
+	else if (numerrors == 0 && program == nullptr)
+	    generateGlobals(globals);
+
+    } catch (const SyntaxError &) {
+    }
+
+    while (closeScope()->enclosing() != nullptr)
+	continue;
+}
+
+
+/*
+ * Function:	compile
+ *
+ * Description:	Compile the translation unit read from IN, writing the
+ *		assembly to OUT and any errors to ERR, and return the
+ *		number of errors reported.  If OBJECT is true, the
+ *		assembly is assembled in memory and an ELF relocatable
+ *		file is written to OUT instead.
+ */
+
+int compile(istream &in, ostream &out, ostream &err, bool object)
+{
+    stringstream text;
+    Object code(target->bits);
+
+
+    initLexer(in, err);
+    initInliner(err);
+    initOptimizer();
+    initGenerator(object ? text : out);
+    translationUnit();
+
+    if (object && numerrors == 0) {
+	if (assemble(text.str(), code, err))
+	    writeElf(code, out);
+	else
+	    numerrors ++;
+    }
+
+    return numerrors;
+}
+
 
-    if (numerrors == 0)
-	generateGlobals(globals);
+/*
+ * Function:	compile
+ *
+ * Description:	Compile the translation unit read from IN into bytecode,
+ *		adding its functions to PROGRAM, and return the number of
+ *		errors reported to ERR.
+ */
+
+int compile(istream &in, Program &p, ostream &err)
+{
+    initLexer(in, err);
+    initInliner(err);
+    initOptimizer();
+    initLowerer(p);
+    program = &p;
+    translationUnit();
+    program = nullptr;
+    return numerrors;
+}
 
-    closeScope();
-    exit(EXIT_SUCCESS);
+
+/*
+ * Function:	translate
+ *
+ * Description:	Translate the translation unit read from IN into C, writing
+ *		it to OUT and any errors to ERR, and return the number of
+ *		errors reported.
+ */
+
+int translate(istream &in, ostream &out, ostream &err)
+{
+    initLexer(in, err);
+    initInliner(err);
+    initOptimizer();
+    initTranslator(out);
+    source = true;
+    translationUnit();
+    source = false;
+    return numerrors;
 }
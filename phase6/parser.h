@@ -0,0 +1,18 @@
+/*
+ * File:	parser.h
+ *
+ * Description:	This file contains the public function declarations for the
+ *		recursive-descent parser for Simple C, which drives the
+ *		compilation of a single translation unit.
+ */
+
+# ifndef PARSER_H
+# define PARSER_H
+# include <iosfwd>
+
+int compile(std::istream &in, std::ostream &out, std::ostream &err,
+    bool object = false);
+int compile(std::istream &in, struct Program &program, std::ostream &err);
+int translate(std::istream &in, std::ostream &out, std::ostream &err);
+
+# endif /* PARSER_H */
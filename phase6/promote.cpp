@@ -0,0 +1,314 @@
+/*
+ * File:	promote.cpp
+ *
+ * Description:	This file contains the function definitions for
+ *		promoting globals to locals in loops.
+ *
+ *		A global scalar that a loop names is loaded into a
+ *		temporary just before the loop, which replaces it in the
+ *		loop.  If the loop assigns the global, the temporary is
+ *		stored back just after the loop and before any return in
+ *		it.  In the loop the global is then a local whose address
+ *		is never taken, so that a later pass may keep it in a
+ *		temporary or, if it is a counter, reduce its strength.
+ *
+ *		The global must be reached only by name in the loop.  Its
+ *		address may not be taken there, and nothing the loop
+ *		stores, other than by assigning it by name, may alias it,
+ *		including what the functions it calls store.  If the loop
+ *		assigns it, nothing may read it either: no load in the
+ *		loop may alias it, and the loop may call no function other
+ *		than one of the C library, since we do not know what any
+ *		other reads, and pass it no pointer that may alias the
+ *		global.  A string never does.
+ *
+ *		Loops are visited outermost first, so that a global is
+ *		loaded and stored once for a whole nest if it can be.
+ */
+
+# include <algorithm>
+# include "optimizer.h"
+# include "tokens.h"
+
+using namespace std;
+
+static thread_local Scope *decls;
+static thread_local vector<const Symbol *> named;
+static thread_local set<const Symbol *> taken;
+static thread_local vector<Expression *> loads, assigns;
+static thread_local vector<Call *> calls;
+static thread_local bool inlines;
+
+
+/*
+ * Function:	gather
+ *
+ * Description:	Gather the globals a statement names, those whose address
+ *		it takes, and the loads, calls, and targets of assignments
+ *		in it.
+ */
+
+static void gather(Statement *stmt)
+{
+    vector<Expression **> exprs;
+    vector<Statement **> stmts;
+    Identifier *id;
+    Call *call;
+
+
+    if ((id = dynamic_cast<Identifier *>(stmt)) != nullptr) {
+	const Symbol *symbol = id->symbol();
+
+	if (!local(symbol) && symbol->type().isScalar())
+	    if (find(named.begin(), named.end(), symbol) == named.end())
+		named.push_back(symbol);
+
+	return;
+    }
+
+    if (dynamic_cast<Address *>(stmt) != nullptr) {
+	stmt = *operand(stmt);
+
+	if ((id = dynamic_cast<Identifier *>(stmt)) != nullptr)
+	    taken.insert(id->symbol());
+	else if (dynamic_cast<Dereference *>(stmt) != nullptr)
+	    gather(*operand(stmt));
+
+	return;
+    }
+
+    if (dynamic_cast<Assignment *>(stmt) != nullptr)
+	assigns.push_back(*operand(stmt));
+
+    if (dynamic_cast<Dereference *>(stmt) != nullptr)
+	loads.push_back(static_cast<Expression *>(stmt));
+
+    if ((call = dynamic_cast<Call *>(stmt)) != nullptr)
+	calls.push_back(call);
+
+    if (dynamic_cast<Inline *>(stmt) || dynamic_cast<Vector *>(stmt))
+	inlines = true;
+
+    stmt->operands(exprs);
+    stmt->substatements(stmts);
+
+    for (unsigned i = 0; i < exprs.size(); i ++)
+	gather(*exprs[i]);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	gather(*stmts[i]);
+}
+
+
+/*
+ * Function:	reaches
+ *
+ * Description:	Return whether a call may be passed a pointer to the
+ *		memory accessed by the given expression.
+ */
+
+static bool reaches(Call *call, Expression *global)
+{
+    vector<Expression **> args;
+    Expression *arg, *load;
+
+
+    call->operands(args);
+
+    for (unsigned i = 0; i < args.size(); i ++) {
+	arg = *args[i];
+	const Type &type = arg->type();
+
+	if (!type.isPointer() || dynamic_cast<String *>(arg) != nullptr)
+	    continue;
+
+	if (type.deref().specifier() != VOID)
+	    load = new Dereference(arg, type.deref());
+	else
+	    load = new Dereference(arg, Type(CHAR));
+
+	if (mayAlias(load, global))
+	    return true;
+    }
+
+    return false;
+}
+
+
+/*
+ * Function:	promotable
+ *
+ * Description:	Return whether a global may be promoted in a loop with
+ *		the given effects.
+ */
+
+static bool promotable(const Symbol *symbol, const Effects &loop)
+{
+    Expression *global = new Identifier(symbol), *expr;
+
+
+    if (taken.count(symbol) > 0 || loop.clobbers)
+	return false;
+
+    for (unsigned i = 0; i < loop.stores.size(); i ++) {
+	expr = loop.stores[i].expr;
+
+	if (find(assigns.begin(), assigns.end(), expr) != assigns.end())
+	    if (names(expr, symbol))
+		continue;
+
+	if (mayAlias(loop.stores[i], global))
+	    return false;
+    }
+
+    if (loop.assigned.count(symbol) == 0)
+	return true;
+
+    if (inlines)
+	return false;
+
+    for (unsigned i = 0; i < loads.size(); i ++)
+	if (mayAlias(loads[i], global))
+	    return false;
+
+    for (unsigned i = 0; i < calls.size(); i ++)
+	if (!external(calls[i]->id()) || reaches(calls[i], global))
+	    return false;
+
+    return true;
+}
+
+
+/*
+ * Function:	rename
+ *
+ * Description:	Replace a global with a temporary throughout a statement.
+ */
+
+static void rename(Statement *stmt, const Symbol *symbol, Symbol *temp)
+{
+    vector<Expression **> exprs;
+    vector<Statement **> stmts;
+
+
+    stmt->operands(exprs);
+    stmt->substatements(stmts);
+
+    for (unsigned i = 0; i < exprs.size(); i ++)
+	if (names(*exprs[i], symbol))
+	    *exprs[i] = new Identifier(temp);
+	else
+	    rename(*exprs[i], symbol, temp);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	rename(*stmts[i], symbol, temp);
+}
+
+
+/*
+ * Function:	writeBack
+ *
+ * Description:	Store the temporary back into the global before each
+ *		return in a statement.
+ */
+
+static void writeBack(Statement **slot, const Symbol *symbol, Symbol *temp)
+{
+    vector<Statement **> stmts;
+    Statements block;
+
+
+    if (dynamic_cast<Return *>(*slot) != nullptr) {
+	block.push_back(new Assignment(new Identifier(symbol), new Identifier(temp)));
+	block.push_back(*slot);
+	*slot = new Block(new Scope(), block);
+	return;
+    }
+
+    (*slot)->substatements(stmts);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	writeBack(stmts[i], symbol, temp);
+}
+
+
+/*
+ * Function:	promote
+ *
+ * Description:	Promote a global in the loop in the given slot.
+ */
+
+static void promote(Statement **slot, const Symbol *symbol, bool assigned)
+{
+    Symbol *temp;
+    Statements block;
+
+
+    temp = temporary(decls, symbol->type());
+    rename(*slot, symbol, temp);
+
+    if (assigned)
+	writeBack(slot, symbol, temp);
+
+    block.push_back(new Assignment(new Identifier(temp), new Identifier(symbol)));
+    block.push_back(*slot);
+
+    if (assigned)
+	block.push_back(new Assignment(new Identifier(symbol), new Identifier(temp)));
+
+    *slot = new Block(new Scope(), block);
+}
+
+
+/*
+ * Function:	visit
+ *
+ * Description:	Promote the globals in the loops of a statement.
+ */
+
+static void visit(Statement **slot)
+{
+    Statement *stmt = *slot;
+    vector<Statement **> stmts;
+    Effects loop;
+
+
+    if (dynamic_cast<While *>(stmt) || dynamic_cast<For *>(stmt)) {
+	named.clear();
+	taken.clear();
+	loads.clear();
+	assigns.clear();
+	calls.clear();
+	inlines = false;
+	gather(stmt);
+	effects(stmt, loop);
+
+	for (unsigned i = 0; i < named.size(); i ++)
+	    if (promotable(named[i], loop))
+		promote(slot, named[i], loop.assigned.count(named[i]) > 0);
+    }
+
+    stmt->substatements(stmts);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	visit(stmts[i]);
+}
+
+
+/*
+ * Function:	promoteGlobals
+ *
+ * Description:	Promote the globals in the loops of a function.
+ */
+
+void promoteGlobals(Function *function)
+{
+    vector<Statement **> stmts;
+
+
+    decls = function->body()->declarations();
+    function->body()->substatements(stmts);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	visit(stmts[i]);
+}
@@ -0,0 +1,326 @@
+/*
+ * File:	server.cpp
+ *
+ * Description:	This file contains the public and private function
+ *		definitions for the compile server and its client.
+ *
+ *		The protocol is deliberately simple.  A client connects,
+ *		sends the source of one program, and shuts down its half of
+ *		the connection.  The server replies with the number of
+ *		errors, the assembly, and the diagnostics, each count or
+ *		length as four bytes in network order, and then closes the
+ *		connection.  Connections are handed to a work-stealing
+ *		scheduler, so requests are served concurrently.
+ *
+ *		Everything happens on the local machine; the socket is
+ *		just a file in the file system.
+ */
+
+# include <cerrno>
+# include <csignal>
+# include <cstdlib>
+# include <cstring>
+# include <sstream>
+# include <iostream>
+# include <unistd.h>
+# include <arpa/inet.h>
+# include <sys/socket.h>
+# include <sys/un.h>
+# include "Scheduler.h"
+# include "parser.h"
+# include "server.h"
+
+using namespace std;
+
+static volatile sig_atomic_t stopping;
+
+
+/*
+ * Function:	address
+ *
+ * Description:	Fill in the socket address for the given path, returning
+ *		false if the path is too long to fit.
+ */
+
+static bool address(const string &path, sockaddr_un &addr)
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof(addr.sun_path)) {
+	cerr << "scc: socket path too long: " << path << endl;
+	return false;
+    }
+
+    strcpy(addr.sun_path, path.c_str());
+    return true;
+}
+
+
+/*
+ * Function:	readAll
+ *
+ * Description:	Read exactly SIZE bytes from the descriptor, unless the
+ *		connection is closed first.
+ */
+
+static bool readAll(int fd, char *buf, size_t size)
+{
+    ssize_t n;
+
+
+    while (size > 0) {
+	n = read(fd, buf, size);
+
+	if (n < 0 && errno == EINTR)
+	    continue;
+
+	if (n <= 0)
+	    return false;
+
+	buf += n;
+	size -= n;
+    }
+
+    return true;
+}
+
+
+/*
+ * Function:	writeAll
+ *
+ * Description:	Write exactly SIZE bytes to the descriptor.  We never want
+ *		a client that hangs up early to take the server down with
+ *		a SIGPIPE, so we use send rather than write on sockets.
+ */
+
+static bool writeAll(int fd, const char *buf, size_t size, bool socket = true)
+{
+    ssize_t n;
+
+
+    while (size > 0) {
+	if (socket)
+	    n = send(fd, buf, size, MSG_NOSIGNAL);
+	else
+	    n = write(fd, buf, size);
+
+	if (n < 0 && errno == EINTR)
+	    continue;
+
+	if (n <= 0)
+	    return false;
+
+	buf += n;
+	size -= n;
+    }
+
+    return true;
+}
+
+
+/*
+ * Function:	writeCount
+ *
+ * Description:	Write a count or length in network byte order.
+ */
+
+static bool writeCount(int fd, uint32_t count)
+{
+    count = htonl(count);
+    return writeAll(fd, (const char *) &count, sizeof(count));
+}
+
+
+/*
+ * Function:	readCount
+ *
+ * Description:	Read a count or length in network byte order.
+ */
+
+static bool readCount(int fd, uint32_t &count)
+{
+    if (!readAll(fd, (char *) &count, sizeof(count)))
+	return false;
+
+    count = ntohl(count);
+    return true;
+}
+
+
+/*
+ * Function:	serve
+ *
+ * Description:	Serve a single request on the connection, which we close
+ *		when we are done.
+ */
+
+static void serve(int fd)
+{
+    stringstream source, out, err;
+    char buf[8192];
+    string text, diagnostics;
+    uint32_t errors;
+    ssize_t n;
+
+
+    while ((n = read(fd, buf, sizeof(buf))) != 0) {
+	if (n < 0 && errno == EINTR)
+	    continue;
+
+	if (n < 0) {
+	    close(fd);
+	    return;
+	}
+
+	source.write(buf, n);
+    }
+
+    errors = compile(source, out, err);
+    text = out.str();
+    diagnostics = err.str();
+
+    if (writeCount(fd, errors) && writeCount(fd, text.size()))
+	if (writeAll(fd, text.data(), text.size()))
+	    if (writeCount(fd, diagnostics.size()))
+		writeAll(fd, diagnostics.data(), diagnostics.size());
+
+    close(fd);
+}
+
+
+/*
+ * Function:	stop
+ *
+ * Description:	Signal handler that asks the server to stop accepting
+ *		connections.
+ */
+
+static void stop(int sig)
+{
+    stopping = 1;
+}
+
+
+/*
+ * Function:	runServer
+ *
+ * Description:	Listen on the socket at the given path and serve requests
+ *		until interrupted, using the given number of worker
+ *		threads.  Any existing socket at the path is replaced, and
+ *		the socket is removed when we stop.
+ */
+
+int runServer(const string &path, unsigned jobs)
+{
+    struct sigaction sa;
+    sigset_t signals;
+    sockaddr_un addr;
+    int sock, fd;
+
+
+    if (!address(path, addr))
+	return EXIT_FAILURE;
+
+    sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path.c_str());
+
+    if (sock < 0 || bind(sock, (sockaddr *) &addr, sizeof(addr)) < 0 ||
+	    listen(sock, SOMAXCONN) < 0) {
+	cerr << "scc: " << path << ": " << strerror(errno) << endl;
+	return EXIT_FAILURE;
+    }
+
+    /* The workers inherit our signal mask, so we block the signals
+       while starting them to make sure the signals interrupt us in
+       accept rather than some worker. */
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stop;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    Scheduler scheduler(jobs);
+    pthread_sigmask(SIG_UNBLOCK, &signals, nullptr);
+
+    cerr << "scc: serving on " << path << " with ";
+    cerr << scheduler.workers() << " threads" << endl;
+
+    while (!stopping) {
+	fd = accept(sock, nullptr, nullptr);
+
+	if (fd < 0) {
+	    if (errno != EINTR)
+		cerr << "scc: accept: " << strerror(errno) << endl;
+
+	    continue;
+	}
+
+	scheduler.submit([fd]() { serve(fd); });
+    }
+
+    close(sock);
+    unlink(path.c_str());
+    scheduler.wait();
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Function:	runClient
+ *
+ * Description:	Send the program on the standard input to the server at
+ *		the given path, and write the assembly and diagnostics it
+ *		returns to the standard output and standard error.
+ */
+
+int runClient(const string &path)
+{
+    sockaddr_un addr;
+    uint32_t errors, size;
+    string text, diagnostics;
+    stringstream source;
+    bool received;
+    int sock;
+
+
+    if (!address(path, addr))
+	return EXIT_FAILURE;
+
+    sock = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (sock < 0 || connect(sock, (sockaddr *) &addr, sizeof(addr)) < 0) {
+	cerr << "scc: " << path << ": " << strerror(errno) << endl;
+	return EXIT_FAILURE;
+    }
+
+    source << cin.rdbuf();
+    text = source.str();
+    received = false;
+
+    if (writeAll(sock, text.data(), text.size()) && !shutdown(sock, SHUT_WR))
+	if (readCount(sock, errors) && readCount(sock, size)) {
+	    text.resize(size);
+
+	    if (readAll(sock, &text[0], size) && readCount(sock, size)) {
+		diagnostics.resize(size);
+		received = readAll(sock, &diagnostics[0], size);
+	    }
+	}
+
+    close(sock);
+
+    if (!received) {
+	cerr << "scc: lost connection to " << path << endl;
+	return EXIT_FAILURE;
+    }
+
+    writeAll(1, text.data(), text.size(), false);
+    writeAll(2, diagnostics.data(), diagnostics.size(), false);
+    return errors > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
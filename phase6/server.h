@@ -0,0 +1,17 @@
+/*
+ * File:	server.h
+ *
+ * Description:	This file contains the public function declarations for
+ *		the compile server, which stays resident and compiles
+ *		programs sent to it over a Unix domain socket, and for the
+ *		thin client that talks to it.
+ */
+
+# ifndef SERVER_H
+# define SERVER_H
+# include <string>
+
+int runServer(const std::string &path, unsigned jobs);
+int runClient(const std::string &path);
+
+# endif /* SERVER_H */
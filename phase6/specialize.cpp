@@ -0,0 +1,554 @@
+/*
+ * File:	specialize.cpp
+ *
+ * Description:	This file contains the function definitions for
+ *		specializing functions for the constants they are called
+ *		with.
+ *
+ *		Since Simple C is compiled in a single pass, a function
+ *		has already been compiled by the time we see any call to
+ *		it, so we cannot fold into it a constant that every call
+ *		passes.  Instead, a copy of the body of each function is
+ *		kept before it is optimized, and a call that passes
+ *		constants for some of its int parameters, which the body
+ *		never assigns and whose address it never takes, calls a
+ *		copy of the function made just for those constants.  The
+ *		parameters are dropped from the copy and replaced by the
+ *		constants, which are folded wherever they meet other
+ *		constants, and any statement they make unreachable is
+ *		removed.  A copy is kept only if folding shrinks it.
+ *
+ *		A copy is named after the function and the constants, as
+ *		in f.1.4 for f with its second parameter 4, and is shared
+ *		by every call that passes the same constants.  It is
+ *		optimized as soon as it is made, so that its summary is
+ *		known at the calls to it, and compiled after the function
+ *		that first calls it, without being made global.  The
+ *		copies a function calls may together cost no more than
+ *		--specialize-budget nodes, whether or not another function
+ *		called them first, so that how a function is compiled
+ *		depends only on it and the functions it calls.  Since a
+ *		copy of a recursive function may call yet another copy, as
+ *		when it passes a constant less one, copies are made in the
+ *		optimization of other copies only so many levels deep.
+ *		The cache must keep the body of a function whose calls
+ *		may be specialized, or which calls copies that are compiled
+ *		after it.
+ */
+
+# include <map>
+# include <climits>
+# include "optimizer.h"
+# include "checker.h"
+# include "inliner.h"
+# include "tokens.h"
+
+using namespace std;
+
+# define MAXDEPTH 4
+
+unsigned specializeBudget = 200;
+
+static thread_local map<string, Function *> copies;
+static thread_local map<string, unsigned> costs;
+static thread_local vector<Function *> pending;
+static thread_local set<Function *> used;
+static thread_local unsigned spent, depth;
+
+
+/*
+ * Function:	initSpecializations
+ *
+ * Description:	Forget the functions of the previous translation unit.
+ */
+
+void initSpecializations()
+{
+    copies.clear();
+    costs.clear();
+    pending.clear();
+}
+
+
+/*
+ * Function:	specializations
+ *
+ * Description:	Return the copies made since last asked, in the order they
+ *		are to be compiled.
+ */
+
+vector<Function *> specializations()
+{
+    vector<Function *> functions;
+
+
+    functions.swap(pending);
+    return functions;
+}
+
+
+/*
+ * Function:	settled
+ *
+ * Description:	Return whether a statement leaves a parameter alone,
+ *		neither assigning it nor taking its address.
+ */
+
+static bool settled(Statement *stmt, const Symbol *param)
+{
+    vector<Expression **> exprs;
+    vector<Statement **> stmts;
+
+
+    if (dynamic_cast<Assignment *>(stmt) || dynamic_cast<Address *>(stmt))
+	if (names(*operand(stmt), param))
+	    return false;
+
+    stmt->operands(exprs);
+    stmt->substatements(stmts);
+
+    for (unsigned i = 0; i < exprs.size(); i ++)
+	if (!settled(*exprs[i], param))
+	    return false;
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	if (!settled(*stmts[i], param))
+	    return false;
+
+    return true;
+}
+
+
+/*
+ * Function:	calls
+ *
+ * Description:	Return whether a statement calls a copy of a function.
+ */
+
+static bool calls(Statement *stmt)
+{
+    vector<Expression **> exprs;
+    vector<Statement **> stmts;
+    Call *call;
+
+
+    if ((call = dynamic_cast<Call *>(stmt)) != nullptr)
+	if (call->id()->_attributes & SPECIALIZED)
+	    return true;
+
+    stmt->operands(exprs);
+    stmt->substatements(stmts);
+
+    for (unsigned i = 0; i < exprs.size(); i ++)
+	if (calls(*exprs[i]))
+	    return true;
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	if (calls(*stmts[i]))
+	    return true;
+
+    return false;
+}
+
+
+/*
+ * Function:	specializes
+ *
+ * Description:	Return whether calls to a function may be specialized,
+ *		since it has an int parameter that it leaves alone, or
+ *		whether it calls any copies.
+ */
+
+bool specializes(Function *function)
+{
+    Function *kept = original(function->id());
+    unsigned nparams = function->id()->type().parameters()->size();
+
+
+    if (kept != nullptr) {
+	const Symbols &params = kept->body()->declarations()->symbols();
+
+	for (unsigned i = 0; i < nparams && i < params.size(); i ++)
+	    if (params[i]->type() == Type(INT) && settled(kept->body(), params[i]))
+		return true;
+    }
+
+    return calls(function->body());
+}
+
+
+/*
+ * Function:	evaluate
+ *
+ * Description:	Compute an int expression whose operands are the given
+ *		constants, returning false if it is not one we fold or
+ *		its value is undefined.
+ */
+
+static bool evaluate(Expression *expr, long left, long right, long &value)
+{
+    if (dynamic_cast<Add *>(expr) != nullptr)
+	value = (int) (left + right);
+    else if (dynamic_cast<Subtract *>(expr) != nullptr)
+	value = (int) (left - right);
+    else if (dynamic_cast<Multiply *>(expr) != nullptr)
+	value = (int) (left * right);
+    else if (dynamic_cast<Divide *>(expr) || dynamic_cast<Remainder *>(expr)) {
+	if (right == 0 || (left == INT_MIN && right == -1))
+	    return false;
+
+	value = dynamic_cast<Divide *>(expr) ? left / right : left % right;
+
+    } else if (dynamic_cast<LessThan *>(expr) != nullptr)
+	value = left < right;
+    else if (dynamic_cast<GreaterThan *>(expr) != nullptr)
+	value = left > right;
+    else if (dynamic_cast<LessOrEqual *>(expr) != nullptr)
+	value = left <= right;
+    else if (dynamic_cast<GreaterOrEqual *>(expr) != nullptr)
+	value = left >= right;
+    else if (dynamic_cast<Equal *>(expr) != nullptr)
+	value = left == right;
+    else if (dynamic_cast<NotEqual *>(expr) != nullptr)
+	value = left != right;
+    else if (dynamic_cast<LogicalAnd *>(expr) != nullptr)
+	value = left && right;
+    else if (dynamic_cast<LogicalOr *>(expr) != nullptr)
+	value = left || right;
+    else
+	return false;
+
+    return true;
+}
+
+
+/*
+ * Function:	fold (expression)
+ *
+ * Description:	Fold the int operators of an expression whose operands are
+ *		constants.  A logical expression whose left operand alone
+ *		decides it is folded even if its right one is not constant,
+ *		since the right is then never evaluated, as is one whose
+ *		right operand decides it if its left calls nothing.
+ */
+
+static void fold(Expression **slot)
+{
+    Expression *expr = *slot;
+    vector<Expression **> exprs;
+    long left, right, value;
+    Effects calls;
+
+
+    expr->operands(exprs);
+
+    for (unsigned i = 0; i < exprs.size(); i ++)
+	fold(exprs[i]);
+
+    if (!(expr->type() == Type(INT)))
+	return;
+
+    if (exprs.size() == 1 && dynamic_cast<Not *>(expr) != nullptr)
+	if ((*exprs[0])->constant(value))
+	    *slot = number(!value);
+
+    if (exprs.size() != 2)
+	return;
+
+    if (!(*exprs[0])->constant(left)) {
+	if (!(*exprs[1])->constant(right))
+	    return;
+
+	effects(*exprs[0], calls);
+
+	if (calls.calls)
+	    return;
+
+	if (dynamic_cast<LogicalAnd *>(expr) && !right)
+	    *slot = number(0);
+
+	else if (dynamic_cast<LogicalOr *>(expr) && right)
+	    *slot = number(1);
+
+    } else if (dynamic_cast<LogicalAnd *>(expr) && !left)
+	*slot = number(0);
+
+    else if (dynamic_cast<LogicalOr *>(expr) && left)
+	*slot = number(1);
+
+    else if ((*exprs[1])->constant(right) && evaluate(expr, left, right, value))
+	*slot = number(value);
+}
+
+
+/*
+ * Function:	fold (statement)
+ *
+ * Description:	Fold the operands of a statement, and replace an if
+ *		statement with a constant test by the branch it takes and
+ *		a loop whose test is false by its initialization, if any.
+ *		The statements of a block after a return are dropped.
+ */
+
+static void fold(Statement **slot)
+{
+    Statement *stmt = *slot;
+    vector<Expression **> exprs;
+    vector<Statement **> stmts;
+    Statements reached;
+    Block *block;
+    long value;
+
+
+    stmt->operands(exprs);
+    stmt->substatements(stmts);
+
+    for (unsigned i = 0; i < exprs.size(); i ++)
+	fold(exprs[i]);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	fold(stmts[i]);
+
+    if ((block = dynamic_cast<Block *>(stmt)) != nullptr) {
+	for (unsigned i = 0; i < stmts.size(); i ++) {
+	    reached.push_back(*stmts[i]);
+
+	    if (dynamic_cast<Return *>(*stmts[i]) != nullptr)
+		break;
+	}
+
+	if (reached.size() < stmts.size())
+	    *slot = new Block(block->declarations(), reached);
+
+	return;
+    }
+
+    if (exprs.empty() || !(*exprs[0])->constant(value))
+	return;
+
+    if (dynamic_cast<If *>(stmt) != nullptr) {
+	if (value)
+	    *slot = *stmts[0];
+	else if (stmts.size() > 1)
+	    *slot = *stmts[1];
+	else
+	    *slot = new Block(new Scope(), Statements());
+
+    } else if (dynamic_cast<While *>(stmt) && !value)
+	*slot = new Block(new Scope(), Statements());
+
+    else if (dynamic_cast<For *>(stmt) && !value)
+	*slot = *stmts[0];
+}
+
+
+/*
+ * Function:	substitute
+ *
+ * Description:	Replace each read of a parameter with its constant.
+ */
+
+static void substitute(Statement *stmt, const map<const Symbol *, long> &constants)
+{
+    map<const Symbol *, long>::const_iterator it;
+    vector<Expression **> exprs;
+    vector<Statement **> stmts;
+    Identifier *id;
+
+
+    stmt->operands(exprs);
+    stmt->substatements(stmts);
+
+    for (unsigned i = 0; i < exprs.size(); i ++) {
+	id = dynamic_cast<Identifier *>(*exprs[i]);
+
+	if (id != nullptr && (it = constants.find(id->symbol())) != constants.end())
+	    *exprs[i] = number(it->second);
+	else
+	    substitute(*exprs[i], constants);
+    }
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	substitute(*stmts[i], constants);
+}
+
+
+/*
+ * Function:	specialize
+ *
+ * Description:	Return a copy of a function with the given parameters
+ *		replaced by their constants and folded, or null if that
+ *		does not make it any smaller.
+ */
+
+static Function *specialize(Function *original, const string &name, const map<unsigned, long> &values)
+{
+    const Symbol *id = original->id();
+    unsigned nparams = id->type().parameters()->size();
+    map<const Symbol *, long> constants;
+    Parameters *params = new Parameters();
+    Scope *decls = new Scope();
+    Renaming renaming;
+    Symbol *symbol;
+    Statement *body;
+    Block *block;
+
+
+    block = static_cast<Block *>(original->body()->clone(renaming));
+    const Symbols &symbols = block->declarations()->symbols();
+
+    for (unsigned i = 0; i < symbols.size(); i ++)
+	if (i < nparams && values.count(i) > 0)
+	    constants[symbols[i]] = values.find(i)->second;
+	else {
+	    decls->insert(symbols[i]);
+
+	    if (i < nparams)
+		params->push_back(symbols[i]->type());
+	}
+
+    body = new Block(decls, block->statements());
+    substitute(body, constants);
+    fold(&body);
+
+    if (body->cost() >= original->body()->cost())
+	return nullptr;
+
+    symbol = new Symbol(name, Type(id->type().specifier(), id->type().indirection(), params));
+    symbol->_attributes = FUNCDEFN | SPECIALIZED | (id->_attributes & FRAMEADDR);
+    return new Function(symbol, static_cast<Block *>(body));
+}
+
+
+/*
+ * Function:	specialized
+ *
+ * Description:	Return the copy of a function that a call should make
+ *		instead, if any, along with the parameters it drops, making
+ *		it if it is new.  The budget is charged the first time a
+ *		function calls each copy, with its size before it was
+ *		optimized.
+ */
+
+static Function *specialized(Call *call, map<unsigned, long> &values)
+{
+    vector<Expression **> args;
+    Function *callee, *copy;
+    set<Function *> users;
+    unsigned budget;
+    string name;
+    long value;
+
+
+    if ((callee = original(call->id())) == nullptr)
+	return nullptr;
+
+    const Symbols &params = callee->body()->declarations()->symbols();
+    name = call->id()->name();
+    call->operands(args);
+
+    if (args.size() != callee->id()->type().parameters()->size())
+	return nullptr;
+
+    for (unsigned i = 0; i < args.size(); i ++)
+	if (params[i]->type() == Type(INT) && (*args[i])->constant(value))
+	    if (settled(callee->body(), params[i])) {
+		values[i] = value;
+		name += "." + to_string(i) + "." + (value < 0 ? "m" + to_string(-value) : to_string(value));
+	    }
+
+    if (values.empty())
+	return nullptr;
+
+    if (copies.count(name) > 0)
+	copy = copies[name];
+    else if (depth >= MAXDEPTH)
+	return nullptr;
+    else if ((copy = specialize(callee, name, values)) == nullptr)
+	copies[name] = nullptr;
+    else
+	costs[name] = copy->body()->cost();
+
+    if (copy == nullptr || used.count(copy) > 0)
+	return copy;
+
+    if (spent + costs[name] > specializeBudget)
+	return nullptr;
+
+    if (copies.count(name) == 0) {
+	copies[name] = copy;
+	budget = spent;
+	users.swap(used);
+	depth ++;
+	optimize(copy);
+	depth --;
+	used.swap(users);
+	spent = budget;
+	pending.push_back(copy);
+    }
+
+    spent += costs[name];
+    used.insert(copy);
+    return copy;
+}
+
+
+/*
+ * Function:	visit
+ *
+ * Description:	Make each call in a statement that passes constants call a
+ *		copy specialized for them instead, without those arguments.
+ */
+
+static void visit(Statement *stmt)
+{
+    vector<Expression **> exprs, args;
+    vector<Statement **> stmts;
+    map<unsigned, long> values;
+    Expressions remaining;
+    Function *copy;
+    Call *call;
+
+
+    stmt->operands(exprs);
+    stmt->substatements(stmts);
+
+    for (unsigned i = 0; i < exprs.size(); i ++) {
+	visit(*exprs[i]);
+	values.clear();
+
+	if ((call = dynamic_cast<Call *>(*exprs[i])) == nullptr)
+	    continue;
+
+	if ((copy = specialized(call, values)) == nullptr)
+	    continue;
+
+	args.clear();
+	remaining.clear();
+	call->operands(args);
+
+	for (unsigned j = 0; j < args.size(); j ++)
+	    if (values.count(j) == 0)
+		remaining.push_back(*args[j]);
+
+	*exprs[i] = new Call(copy->id(), remaining, call->type());
+    }
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	visit(*stmts[i]);
+}
+
+
+/*
+ * Function:	specializeCalls
+ *
+ * Description:	Make the calls in a function that pass constants call
+ *		copies specialized for them.
+ */
+
+void specializeCalls(Function *function)
+{
+    spent = 0;
+    used.clear();
+    visit(function->body());
+}
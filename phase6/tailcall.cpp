@@ -0,0 +1,128 @@
+/*
+ * File:	tailcall.cpp
+ *
+ * Description:	This file contains the member function definitions for
+ *		finding the calls of a function that are in tail position.
+ *
+ *		A call is in tail position if its value is returned, or if
+ *		it is a call of the function itself after which the
+ *		function falls off its end.  A call to another function
+ *		that is simply followed by the end is not, since falling
+ *		off the end doesn't return its value.  The value of a
+ *		returned call must have the same type as the function, so
+ *		that the callee can return it to our caller directly.
+ *
+ *		Once a call in tail position is made, the frame of the
+ *		caller is no longer needed, unless the address of
+ *		something in it may have been taken.  In that case, no call
+ *		is marked, since the backends reuse or discard the frame
+ *		of a tail call.
+ */
+
+# include "Tree.h"
+# include "checker.h"
+
+static thread_local const Symbol *self;
+static thread_local Type result;
+static thread_local bool returned;
+
+
+/*
+ * Function:	Call::markTailCalls
+ *
+ * Description:	Mark this call as a tail call if it is in tail position.
+ */
+
+void Call::markTailCalls(bool last)
+{
+    _tail = last && (returned ? _type == result : _id == self);
+}
+
+
+/*
+ * Function:	Return::markTailCalls
+ *
+ * Description:	Mark the returned expression if it is a call.  Whatever
+ *		follows the return, the expression is in tail position.
+ */
+
+void Return::markTailCalls(bool last)
+{
+    returned = true;
+    _expr->markTailCalls(true);
+    returned = false;
+}
+
+
+/*
+ * Function:	Block::markTailCalls
+ *
+ * Description:	Mark the tail calls of a block, in which only the last
+ *		statement can be the last one executed.
+ */
+
+void Block::markTailCalls(bool last)
+{
+    for (unsigned i = 0; i < _stmts.size(); i ++)
+	_stmts[i]->markTailCalls(last && i + 1 == _stmts.size());
+}
+
+
+/*
+ * Function:	While::markTailCalls
+ *
+ * Description:	Mark the tail calls of a while statement, whose body is
+ *		never the last thing executed.
+ */
+
+void While::markTailCalls(bool last)
+{
+    _stmt->markTailCalls(false);
+}
+
+
+/*
+ * Function:	For::markTailCalls
+ *
+ * Description:	Mark the tail calls of a for statement, whose body is
+ *		never the last thing executed.
+ */
+
+void For::markTailCalls(bool last)
+{
+    _stmt->markTailCalls(false);
+}
+
+
+/*
+ * Function:	If::markTailCalls
+ *
+ * Description:	Mark the tail calls of an if statement, either of whose
+ *		branches may be the last thing executed.
+ */
+
+void If::markTailCalls(bool last)
+{
+    _thenStmt->markTailCalls(last);
+
+    if (_elseStmt != nullptr)
+	_elseStmt->markTailCalls(last);
+}
+
+
+/*
+ * Function:	Function::markTailCalls
+ *
+ * Description:	Mark the tail calls of this function, provided that its
+ *		frame can be given up when they are made.
+ */
+
+void Function::markTailCalls()
+{
+    if (_id->_attributes & FRAMEADDR)
+	return;
+
+    self = _id;
+    result = Type(_id->type().specifier(), _id->type().indirection());
+    _body->markTailCalls(true);
+}
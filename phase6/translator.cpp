@@ -0,0 +1,1173 @@
+/*
+ * File:	translator.cpp
+ *
+ * Description:	This file contains the member function definitions for
+ *		translating the checked abstract syntax tree back into ISO
+ *		C, suitable for compiling with the C compiler of the host.
+ *
+ *		The tree has already been through semantic checking, so
+ *		arrays have decayed into pointers, characters have been
+ *		promoted, and the index of each pointer addition has been
+ *		scaled by the size of the object pointed to.  Rather than
+ *		write out that scaling, we recognize it and write ordinary
+ *		pointer arithmetic and subscripts, so the C compiler sees
+ *		the same program the programmer wrote.  Where we can't, the
+ *		scaled index is added to a character pointer instead.
+ *
+ *		Expressions are written with only the parentheses needed,
+ *		using the precedence of the C operator for each node.
+ *		Statements are written without their leading indentation
+ *		or trailing newline, which are left to the enclosing
+ *		statement.
+ *
+ *		Functions of the C library are declared by including the
+ *		appropriate standard header rather than by the prototype
+ *		in the program, which the C compiler would complain about.
+ *		Everything else is declared before the first function, so
+ *		the functions may be written in the order they appear.
+ */
+
+# include <map>
+# include <set>
+# include <cstring>
+# include <sstream>
+# include "Tree.h"
+# include "tokens.h"
+# include "translator.h"
+
+using namespace std;
+
+enum {
+    LOGICAL_OR = 4, LOGICAL_AND, EQUALITY = 9, RELATIONAL, ADDITIVE = 12,
+    MULTIPLICATIVE, UNARY, POSTFIX
+};
+
+static thread_local ostream *out;
+static thread_local stringstream functions;
+static thread_local set<string> defined;
+
+static thread_local map<string, set<unsigned> > arguments;
+
+static const struct {
+    const char *name, *header;
+    int arity;
+} standard[] = {
+    {"printf", "stdio.h", -1}, {"scanf", "stdio.h", -1},
+    {"sprintf", "stdio.h", -1}, {"sscanf", "stdio.h", -1},
+    {"puts", "stdio.h", 1}, {"putchar", "stdio.h", 1},
+    {"getchar", "stdio.h", 0},
+    {"malloc", "stdlib.h", 1}, {"calloc", "stdlib.h", 2},
+    {"realloc", "stdlib.h", 2}, {"free", "stdlib.h", 1},
+    {"exit", "stdlib.h", 1}, {"abort", "stdlib.h", 0},
+    {"atoi", "stdlib.h", 1}, {"abs", "stdlib.h", 1},
+    {"rand", "stdlib.h", 0}, {"srand", "stdlib.h", 1},
+    {"strcpy", "string.h", 2}, {"strncpy", "string.h", 3},
+    {"strcat", "string.h", 2}, {"strcmp", "string.h", 2},
+    {"strncmp", "string.h", 3}, {"memcpy", "string.h", 3},
+    {"memset", "string.h", 3}, {"memcmp", "string.h", 3},
+    {"isalpha", "ctype.h", 1}, {"isdigit", "ctype.h", 1},
+    {"isalnum", "ctype.h", 1}, {"isspace", "ctype.h", 1},
+    {"isupper", "ctype.h", 1}, {"islower", "ctype.h", 1},
+    {"toupper", "ctype.h", 1}, {"tolower", "ctype.h", 1},
+    {nullptr, nullptr, 0}
+};
+
+
+/*
+ * Function:	lookup
+ *
+ * Description:	Return the index of the named function of the C library in
+ *		our table, or -1 if it isn't one we know about.
+ */
+
+static int lookup(const string &name)
+{
+    for (unsigned i = 0; standard[i].name != nullptr; i ++)
+	if (name == standard[i].name)
+	    return i;
+
+    return -1;
+}
+
+
+/*
+ * Function:	library
+ *
+ * Description:	Return the standard header declaring the function, if it is
+ *		one of the C library that the program didn't define.
+ */
+
+static const char *library(const Symbol *symbol)
+{
+    int i;
+
+    if (!symbol->type().isFunction() || defined.count(symbol->name()) > 0)
+	return nullptr;
+
+    i = lookup(symbol->name());
+    return i >= 0 ? standard[i].header : nullptr;
+}
+
+
+/*
+ * Function:	compatible
+ *
+ * Description:	Determine if the program uses a function of the C library
+ *		in the way its standard declaration expects: with the same
+ *		number of arguments, or with at least one if the function
+ *		is variadic.  A function the program never declared is
+ *		judged by the calls to it.
+ */
+
+static bool compatible(const Symbol *symbol)
+{
+    Parameters *params = symbol->type().parameters();
+    int arity = standard[lookup(symbol->name())].arity;
+    set<unsigned> counts;
+
+
+    if (params != nullptr)
+	counts.insert(params->size());
+    else
+	counts = arguments[symbol->name()];
+
+    for (set<unsigned>::iterator it = counts.begin(); it != counts.end(); it ++)
+	if (arity < 0 ? *it == 0 : (int) *it != arity)
+	    return false;
+
+    return true;
+}
+
+
+/*
+ * Function:	tabs
+ *
+ * Description:	Return the indentation for the given level of nesting,
+ *		using four columns per level and tabs where possible.
+ */
+
+static string tabs(unsigned indent)
+{
+    return string(indent / 2, '\t') + string(indent % 2 * 4, ' ');
+}
+
+
+/*
+ * Function:	declarator
+ *
+ * Description:	Return a declaration of NAME with the given type, or just
+ *		the type itself if NAME is empty.
+ */
+
+static string declarator(const Type &type, const string &name)
+{
+    stringstream ss;
+    Parameters *params;
+
+
+    if (type.specifier() == CHAR)
+	ss << "char";
+    else if (type.specifier() == LONG)
+	ss << "long";
+    else if (type.specifier() == VOID)
+	ss << "void";
+    else
+	ss << "int";
+
+    if (type.indirection() > 0 || !name.empty())
+	ss << " " << string(type.indirection(), '*') << name;
+
+    if (type.isArray())
+	ss << "[" << type.length() << "]";
+
+    else if (type.isFunction()) {
+	params = type.parameters();
+	ss << "(";
+
+	if (params != nullptr && params->empty())
+	    ss << "void";
+
+	else if (params != nullptr)
+	    for (unsigned i = 0; i < params->size(); i ++)
+		ss << (i > 0 ? ", " : "") << declarator((*params)[i], "");
+
+	ss << ")";
+    }
+
+    return ss.str();
+}
+
+
+/*
+ * Function:	operand
+ *
+ * Description:	Write an operand of an operator with the given precedence,
+ *		parenthesizing it if it binds less tightly.
+ */
+
+static void operand(ostream &ostr, const Expression *expr, int precedence)
+{
+    if (expr->precedence() < precedence) {
+	ostr << "(";
+	expr->write(ostr);
+	ostr << ")";
+    } else
+	expr->write(ostr);
+}
+
+
+/*
+ * Function:	binary
+ *
+ * Description:	Write a binary expression.  All of our binary operators are
+ *		left associative, so the right operand must bind more
+ *		tightly than the operator itself.
+ */
+
+static void binary(ostream &ostr, const Expression *left, const char *op,
+	const Expression *right, int precedence)
+{
+    operand(ostr, left, precedence);
+    ostr << " " << op << " ";
+    operand(ostr, right, precedence + 1);
+}
+
+
+/*
+ * Function:	arithmetic
+ *
+ * Description:	Write the addition or subtraction of an integer to or from
+ *		a pointer.  If the integer was scaled by the size of the
+ *		object pointed to, the scaling is left to the C compiler.
+ *		Otherwise, the bytes are added to a character pointer.
+ */
+
+static void arithmetic(ostream &ostr, const Type &type,
+	const Expression *pointer, const char *op, const Expression *offset)
+{
+    const Expression *index = offset->index(type.deref().size());
+
+    if (index != nullptr)
+	binary(ostr, pointer, op, index, ADDITIVE);
+
+    else {
+	ostr << "(" << declarator(type, "") << ") ((char *) ";
+	operand(ostr, pointer, UNARY);
+	ostr << " " << op << " ";
+	operand(ostr, offset, ADDITIVE + 1);
+	ostr << ")";
+    }
+}
+
+
+/*
+ * Function:	nested
+ *
+ * Description:	Write the body of a compound statement.  A block goes on
+ *		the same line, and anything else on a line by itself.
+ */
+
+static void nested(ostream &ostr, const Statement *stmt, unsigned indent)
+{
+    if (dynamic_cast<const Block *>(stmt) != nullptr) {
+	ostr << " ";
+	stmt->translate(ostr, indent);
+    } else {
+	ostr << endl << tabs(indent + 1);
+	stmt->translate(ostr, indent + 1);
+    }
+}
+
+
+/*
+ * Function:	body
+ *
+ * Description:	Write the declarations and statements of a block, starting
+ *		with the given declaration.
+ */
+
+static void body(ostream &ostr, const Symbols &symbols, unsigned first,
+	const Statements &stmts, unsigned indent)
+{
+    ostr << "{" << endl;
+
+    for (unsigned i = first; i < symbols.size(); i ++)
+	ostr << tabs(indent + 1) << declarator(symbols[i]->type(), symbols[i]->name()) << ";" << endl;
+
+    if (first < symbols.size() && !stmts.empty())
+	ostr << endl;
+
+    for (unsigned i = 0; i < stmts.size(); i ++) {
+	ostr << tabs(indent + 1);
+	stmts[i]->translate(ostr, indent + 1);
+	ostr << endl;
+    }
+
+    ostr << tabs(indent) << "}";
+}
+
+
+/*
+ * Function:	clause
+ *
+ * Description:	Write the initialization or increment of a for statement,
+ *		which is a statement without its semicolon.
+ */
+
+static void clause(ostream &ostr, const Statement *stmt)
+{
+    stringstream ss;
+    string s;
+
+
+    stmt->translate(ss, 0);
+    s = ss.str();
+    ostr << s.substr(0, s.size() - 1);
+}
+
+
+/*
+ * Function:	Expression::translate
+ *
+ * Description:	Write an expression statement.
+ */
+
+void Expression::translate(ostream &ostr, unsigned indent) const
+{
+    write(ostr);
+    ostr << ";";
+}
+
+
+/*
+ * Function:	Expression::write
+ *
+ * Description:	Write this expression.  Every expression we construct
+ *		overrides this function.
+ */
+
+void Expression::write(ostream &ostr) const
+{
+}
+
+
+/*
+ * Function:	Expression::precedence
+ *
+ * Description:	Return the precedence of the C operator for this
+ *		expression.  Identifiers, literals, calls, and subscripts
+ *		bind the most tightly.
+ */
+
+int Expression::precedence() const
+{
+    return POSTFIX;
+}
+
+
+/*
+ * Function:	Expression::index
+ *
+ * Description:	Return the expression which, multiplied by SIZE, gives this
+ *		expression, or null if there isn't one.
+ */
+
+const Expression *Expression::index(unsigned size) const
+{
+    return size == 1 ? this : nullptr;
+}
+
+
+/*
+ * Function:	Expression::subscript
+ *
+ * Description:	Determine if this expression, when dereferenced, can be
+ *		written as a subscript, and if so, of what and by what.
+ */
+
+bool Expression::subscript(const Expression *&base, const Expression *&index) const
+{
+    return false;
+}
+
+
+/*
+ * Function:	String::write
+ */
+
+void String::write(ostream &ostr) const
+{
+    ostr << _value;
+}
+
+
+/*
+ * Function:	Identifier::write
+ */
+
+void Identifier::write(ostream &ostr) const
+{
+    ostr << _symbol->name();
+}
+
+
+/*
+ * Function:	Number::write
+ */
+
+void Number::write(ostream &ostr) const
+{
+    ostr << _value;
+}
+
+
+/*
+ * Function:	Call::write
+ *
+ * Description:	Write a function call.  A function of the C library whose
+ *		result the program declared as a different pointer type
+ *		is cast, since the standard declaration returns void *.
+ */
+
+void Call::write(ostream &ostr) const
+{
+    if (precedence() == UNARY)
+	ostr << "(" << declarator(_type, "") << ") ";
+
+    arguments[_id->name()].insert(_args.size());
+    ostr << _id->name() << "(";
+
+    for (unsigned i = 0; i < _args.size(); i ++) {
+	ostr << (i > 0 ? ", " : "");
+	_args[i]->write(ostr);
+    }
+
+    ostr << ")";
+}
+
+
+/*
+ * Function:	Call::precedence
+ */
+
+int Call::precedence() const
+{
+    if (lookup(_id->name()) >= 0 && _type.isPointer() && _type != Type(VOID, 1))
+	return UNARY;
+
+    return POSTFIX;
+}
+
+
+/*
+ * Function:	Inline::write
+ *
+ * Description:	Write an inlined call as the call it replaced.
+ */
+
+void Inline::write(ostream &ostr) const
+{
+    ostr << _id->name() << "(";
+
+    for (unsigned i = 0; i < _args.size(); i ++) {
+	ostr << (i > 0 ? ", " : "");
+	_args[i]->write(ostr);
+    }
+
+    ostr << ")";
+}
+
+
+/*
+ * Function:	Not::write
+ */
+
+void Not::write(ostream &ostr) const
+{
+    ostr << "!";
+    operand(ostr, _expr, UNARY);
+}
+
+
+/*
+ * Function:	Not::precedence
+ */
+
+int Not::precedence() const
+{
+    return UNARY;
+}
+
+
+/*
+ * Function:	Negate::write
+ *
+ * Description:	Write an arithmetic negation, taking care that a nested
+ *		negation isn't written as a decrement.
+ */
+
+void Negate::write(ostream &ostr) const
+{
+    stringstream ss;
+
+    operand(ss, _expr, UNARY);
+    ostr << (ss.str()[0] == '-' ? "-(" + ss.str() + ")" : "-" + ss.str());
+}
+
+
+/*
+ * Function:	Negate::precedence
+ */
+
+int Negate::precedence() const
+{
+    return UNARY;
+}
+
+
+/*
+ * Function:	Dereference::write
+ */
+
+void Dereference::write(ostream &ostr) const
+{
+    const Expression *base, *index;
+
+    if (_expr->subscript(base, index)) {
+	operand(ostr, base, POSTFIX);
+	ostr << "[";
+	index->write(ostr);
+	ostr << "]";
+
+    } else {
+	ostr << "*";
+	operand(ostr, _expr, UNARY);
+    }
+}
+
+
+/*
+ * Function:	Dereference::precedence
+ */
+
+int Dereference::precedence() const
+{
+    const Expression *base, *index;
+
+    return _expr->subscript(base, index) ? POSTFIX : UNARY;
+}
+
+
+/*
+ * Function:	Address::write
+ *
+ * Description:	Write an address expression.  The address of an array is
+ *		simply the array itself, which C decays into a pointer.
+ */
+
+void Address::write(ostream &ostr) const
+{
+    if (_expr->type().isArray())
+	_expr->write(ostr);
+
+    else {
+	ostr << "&";
+	operand(ostr, _expr, UNARY);
+    }
+}
+
+
+/*
+ * Function:	Address::precedence
+ */
+
+int Address::precedence() const
+{
+    return _expr->type().isArray() ? _expr->precedence() : UNARY;
+}
+
+
+/*
+ * Function:	Promote::write
+ *
+ * Description:	Write an integer promotion.  C promotes characters on its
+ *		own, but widening to a long and narrowing back need a cast.
+ */
+
+void Promote::write(ostream &ostr) const
+{
+    if (_expr->type().specifier() == CHAR)
+	_expr->write(ostr);
+
+    else {
+	ostr << "(" << declarator(_type, "") << ") ";
+	operand(ostr, _expr, UNARY);
+    }
+}
+
+
+/*
+ * Function:	Promote::precedence
+ */
+
+int Promote::precedence() const
+{
+    return _expr->type().specifier() == CHAR ? _expr->precedence() : UNARY;
+}
+
+
+/*
+ * Function:	Promote::index
+ *
+ * Description:	An index is widened before it is scaled, which C will do
+ *		for us.
+ */
+
+const Expression *Promote::index(unsigned size) const
+{
+    if (_type.specifier() == LONG)
+	return _expr->index(size);
+
+    return Expression::index(size);
+}
+
+
+/*
+ * Function:	Multiply::write
+ */
+
+void Multiply::write(ostream &ostr) const
+{
+    binary(ostr, _left, "*", _right, MULTIPLICATIVE);
+}
+
+
+/*
+ * Function:	Multiply::precedence
+ */
+
+int Multiply::precedence() const
+{
+    return MULTIPLICATIVE;
+}
+
+
+/*
+ * Function:	Multiply::index
+ *
+ * Description:	A scaled index is the index multiplied by the size.
+ */
+
+const Expression *Multiply::index(unsigned size) const
+{
+    long value;
+
+    if (_right->constant(value) && value == (long) size)
+	return _left->index(1);
+
+    return Expression::index(size);
+}
+
+
+/*
+ * Function:	Divide::write
+ */
+
+void Divide::write(ostream &ostr) const
+{
+    binary(ostr, _left, "/", _right, MULTIPLICATIVE);
+}
+
+
+/*
+ * Function:	Divide::precedence
+ */
+
+int Divide::precedence() const
+{
+    return MULTIPLICATIVE;
+}
+
+
+/*
+ * Function:	Remainder::write
+ */
+
+void Remainder::write(ostream &ostr) const
+{
+    binary(ostr, _left, "%", _right, MULTIPLICATIVE);
+}
+
+
+/*
+ * Function:	Remainder::precedence
+ */
+
+int Remainder::precedence() const
+{
+    return MULTIPLICATIVE;
+}
+
+
+/*
+ * Function:	Add::write
+ *
+ * Description:	Write an addition.  The checker scales whichever operand
+ *		isn't the pointer, which we always write on the left.
+ */
+
+void Add::write(ostream &ostr) const
+{
+    if (!_type.isPointer())
+	binary(ostr, _left, "+", _right, ADDITIVE);
+    else if (_left->type().isPointer())
+	arithmetic(ostr, _type, _left, "+", _right);
+    else
+	arithmetic(ostr, _type, _right, "+", _left);
+}
+
+
+/*
+ * Function:	Add::precedence
+ */
+
+int Add::precedence() const
+{
+    const Expression *base, *index;
+
+    if (_type.isPointer() && !subscript(base, index))
+	return UNARY;
+
+    return ADDITIVE;
+}
+
+
+/*
+ * Function:	Add::subscript
+ *
+ * Description:	A pointer plus a scaled index can be written as a
+ *		subscript when dereferenced.
+ */
+
+bool Add::subscript(const Expression *&base, const Expression *&index) const
+{
+    if (!_type.isPointer())
+	return false;
+
+    base = _left->type().isPointer() ? _left : _right;
+    index = (base == _left ? _right : _left)->index(_type.deref().size());
+    return index != nullptr;
+}
+
+
+/*
+ * Function:	Subtract::write
+ *
+ * Description:	Write a subtraction.  The difference of two pointers is
+ *		computed in bytes, since the checker has already divided
+ *		it by the size of the object pointed to.
+ */
+
+void Subtract::write(ostream &ostr) const
+{
+    if (_left->type().isPointer() && _right->type().isPointer()) {
+	ostr << "(char *) ";
+	operand(ostr, _left, UNARY);
+	ostr << " - (char *) ";
+	operand(ostr, _right, UNARY);
+
+    } else if (_type.isPointer())
+	arithmetic(ostr, _type, _left, "-", _right);
+
+    else
+	binary(ostr, _left, "-", _right, ADDITIVE);
+}
+
+
+/*
+ * Function:	Subtract::precedence
+ */
+
+int Subtract::precedence() const
+{
+    if (_type.isPointer() && _right->index(_type.deref().size()) == nullptr)
+	return UNARY;
+
+    return ADDITIVE;
+}
+
+
+/*
+ * Function:	LessThan::write
+ */
+
+void LessThan::write(ostream &ostr) const
+{
+    binary(ostr, _left, "<", _right, RELATIONAL);
+}
+
+
+/*
+ * Function:	LessThan::precedence
+ */
+
+int LessThan::precedence() const
+{
+    return RELATIONAL;
+}
+
+
+/*
+ * Function:	GreaterThan::write
+ */
+
+void GreaterThan::write(ostream &ostr) const
+{
+    binary(ostr, _left, ">", _right, RELATIONAL);
+}
+
+
+/*
+ * Function:	GreaterThan::precedence
+ */
+
+int GreaterThan::precedence() const
+{
+    return RELATIONAL;
+}
+
+
+/*
+ * Function:	LessOrEqual::write
+ */
+
+void LessOrEqual::write(ostream &ostr) const
+{
+    binary(ostr, _left, "<=", _right, RELATIONAL);
+}
+
+
+/*
+ * Function:	LessOrEqual::precedence
+ */
+
+int LessOrEqual::precedence() const
+{
+    return RELATIONAL;
+}
+
+
+/*
+ * Function:	GreaterOrEqual::write
+ */
+
+void GreaterOrEqual::write(ostream &ostr) const
+{
+    binary(ostr, _left, ">=", _right, RELATIONAL);
+}
+
+
+/*
+ * Function:	GreaterOrEqual::precedence
+ */
+
+int GreaterOrEqual::precedence() const
+{
+    return RELATIONAL;
+}
+
+
+/*
+ * Function:	Equal::write
+ */
+
+void Equal::write(ostream &ostr) const
+{
+    binary(ostr, _left, "==", _right, EQUALITY);
+}
+
+
+/*
+ * Function:	Equal::precedence
+ */
+
+int Equal::precedence() const
+{
+    return EQUALITY;
+}
+
+
+/*
+ * Function:	NotEqual::write
+ */
+
+void NotEqual::write(ostream &ostr) const
+{
+    binary(ostr, _left, "!=", _right, EQUALITY);
+}
+
+
+/*
+ * Function:	NotEqual::precedence
+ */
+
+int NotEqual::precedence() const
+{
+    return EQUALITY;
+}
+
+
+/*
+ * Function:	LogicalAnd::write
+ */
+
+void LogicalAnd::write(ostream &ostr) const
+{
+    binary(ostr, _left, "&&", _right, LOGICAL_AND);
+}
+
+
+/*
+ * Function:	LogicalAnd::precedence
+ */
+
+int LogicalAnd::precedence() const
+{
+    return LOGICAL_AND;
+}
+
+
+/*
+ * Function:	LogicalOr::write
+ */
+
+void LogicalOr::write(ostream &ostr) const
+{
+    binary(ostr, _left, "||", _right, LOGICAL_OR);
+}
+
+
+/*
+ * Function:	LogicalOr::precedence
+ */
+
+int LogicalOr::precedence() const
+{
+    return LOGICAL_OR;
+}
+
+
+/*
+ * Function:	Assignment::translate
+ */
+
+void Assignment::translate(ostream &ostr, unsigned indent) const
+{
+    _left->write(ostr);
+    ostr << " = ";
+    _right->write(ostr);
+    ostr << ";";
+}
+
+
+/*
+ * Function:	Return::translate
+ */
+
+void Return::translate(ostream &ostr, unsigned indent) const
+{
+    ostr << "return ";
+    _expr->write(ostr);
+    ostr << ";";
+}
+
+
+/*
+ * Function:	Block::translate
+ */
+
+void Block::translate(ostream &ostr, unsigned indent) const
+{
+    body(ostr, _decls->symbols(), 0, _stmts, indent);
+}
+
+
+/*
+ * Function:	While::translate
+ */
+
+void While::translate(ostream &ostr, unsigned indent) const
+{
+    ostr << "while (";
+    _expr->write(ostr);
+    ostr << ")";
+    nested(ostr, _stmt, indent);
+}
+
+
+/*
+ * Function:	For::translate
+ */
+
+void For::translate(ostream &ostr, unsigned indent) const
+{
+    ostr << "for (";
+    clause(ostr, _init);
+    ostr << "; ";
+    _expr->write(ostr);
+    ostr << "; ";
+    clause(ostr, _incr);
+    ostr << ")";
+    nested(ostr, _stmt, indent);
+}
+
+
+/*
+ * Function:	If::translate
+ *
+ * Description:	Write an if statement, keeping else-if chains flat.
+ */
+
+void If::translate(ostream &ostr, unsigned indent) const
+{
+    ostr << "if (";
+    _expr->write(ostr);
+    ostr << ")";
+    nested(ostr, _thenStmt, indent);
+
+    if (_elseStmt != nullptr) {
+	if (dynamic_cast<const Block *>(_thenStmt) != nullptr)
+	    ostr << " else";
+	else
+	    ostr << endl << tabs(indent) << "else";
+
+	if (dynamic_cast<const If *>(_elseStmt) != nullptr) {
+	    ostr << " ";
+	    _elseStmt->translate(ostr, indent);
+	} else
+	    nested(ostr, _elseStmt, indent);
+    }
+}
+
+
+/*
+ * Function:	Vector::translate
+ *
+ * Description:	Write a vector assignment as the assignments of its
+ *		lanes, leaving the vectorizing to the C compiler.
+ */
+
+void Vector::translate(ostream &ostr, unsigned indent) const
+{
+    lanes()->translate(ostr, indent);
+}
+
+
+/*
+ * Function:	Function::translate
+ *
+ * Description:	Write a function definition.  The parameters are the first
+ *		symbols declared in the outermost block of the body.
+ */
+
+void Function::translate(ostream &ostr, unsigned indent) const
+{
+    Parameters *params = _id->type().parameters();
+    const Symbols &symbols = _body->declarations()->symbols();
+    stringstream ss;
+
+
+    ss << _id->name() << "(";
+
+    for (unsigned i = 0; i < params->size(); i ++)
+	ss << (i > 0 ? ", " : "") << declarator(symbols[i]->type(), symbols[i]->name());
+
+    ss << (params->empty() ? "void)" : ")");
+    ostr << declarator(Type(_id->type().specifier(), _id->type().indirection()), "");
+    ostr << (_id->type().indirection() > 0 ? "" : " ") << ss.str() << endl;
+    ::body(ostr, symbols, params->size(), _body->statements(), indent);
+    ostr << endl;
+}
+
+
+/*
+ * Function:	initTranslator
+ *
+ * Description:	Prepare to translate a translation unit, writing the C to
+ *		the given stream.
+ */
+
+void initTranslator(ostream &ostr)
+{
+    out = &ostr;
+    functions.str("");
+    defined.clear();
+    arguments.clear();
+}
+
+
+/*
+ * Function:	translateFunction
+ *
+ * Description:	Translate a function definition.  The definitions are held
+ *		back until everything in the translation unit has been
+ *		declared.
+ */
+
+void translateFunction(const Function *function)
+{
+    if (functions.tellp() > 0)
+	functions << endl;
+
+    function->translate(functions, 0);
+    defined.insert(function->id()->name());
+}
+
+
+/*
+ * Function:	translateGlobals
+ *
+ * Description:	Write the declarations of the translation unit, given the
+ *		symbols of its outermost scope, followed by its functions.
+ */
+
+void translateGlobals(const Symbols &symbols)
+{
+    set<string> headers, excluded;
+    stringstream groups[3];
+
+
+    /* A header is included only if the program uses every function it
+       declares in the expected way.  Otherwise, we leave the program to
+       declare the functions itself, which the C compiler will only warn
+       about. */
+
+    for (unsigned i = 0; i < symbols.size(); i ++)
+	if (library(symbols[i]))
+	    (compatible(symbols[i]) ? headers : excluded).insert(library(symbols[i]));
+
+    for (set<string>::iterator it = excluded.begin(); it != excluded.end(); it ++)
+	headers.erase(*it);
+
+    for (set<string>::iterator it = headers.begin(); it != headers.end(); it ++)
+	groups[0] << "#include <" << *it << ">" << endl;
+
+
+    /* Then come the functions and the variables, each separated from
+       what precedes them by a blank line. */
+
+    for (unsigned i = 0; i < symbols.size(); i ++) {
+	const Type &type = symbols[i]->type();
+
+	if (library(symbols[i]) && headers.count(library(symbols[i])) > 0)
+	    continue;
+
+	groups[type.isFunction() ? 1 : 2] << declarator(type, symbols[i]->name()) << ";" << endl;
+    }
+
+    for (unsigned i = 0; i < 3; i ++)
+	if (groups[i].tellp() > 0)
+	    *out << groups[i].str() << endl;
+
+    *out << functions.str();
+}
@@ -0,0 +1,19 @@
+/*
+ * File:	translator.h
+ *
+ * Description:	This file contains the function declarations for
+ *		translating Simple C into ISO C.  Most of the function
+ *		declarations are actually member functions provided as
+ *		part of Tree.h.
+ */
+
+# ifndef TRANSLATOR_H
+# define TRANSLATOR_H
+# include "Tree.h"
+# include <iosfwd>
+
+void initTranslator(std::ostream &ostr);
+void translateFunction(const Function *function);
+void translateGlobals(const Symbols &symbols);
+
+# endif /* TRANSLATOR_H */
@@ -0,0 +1,416 @@
+/*
+ * File:	unroll.cpp
+ *
+ * Description:	This file contains the function definitions for unrolling
+ *		loops.
+ *
+ *		A loop can be unrolled if its test compares an induction
+ *		variable, a local int that the loop steps by a constant in
+ *		statements evaluated in every iteration, with an invariant
+ *		bound in the direction of the step.  The number of
+ *		iterations left is then known on entry to each, and so
+ *		the loop
+ *
+ *			while (i < n) S
+ *
+ *		with S stepping i by c > 0 becomes
+ *
+ *			t = n; u = t - (k - 1) * c;
+ *			if (u <= t) while (i < u) { S S ... S }
+ *			while (i < t) S
+ *
+ *		with k copies of S, so that the test and its branches
+ *		are evaluated once for every k iterations.  The second
+ *		loop runs the remaining iterations, fewer than k, and
+ *		the guard keeps the first from running if computing u
+ *		overflows.  Simple C has no switch or goto with which to
+ *		jump into the middle of the unrolled body instead.  The
+ *		body of a for statement includes its increment, and its
+ *		initialization is done first.  Only innermost loops whose
+ *		bodies are small are unrolled, by the factor given with
+ *		--unroll-factor.
+ *
+ *		A for statement that sets the counter to a constant and
+ *		compares it with a constant runs a known number of times.
+ *		If that is at most twice the unroll factor, the loop is
+ *		replaced by that many copies of its body, with the
+ *		counter in each replaced by its value there, and then an
+ *		assignment of the counter's final value.
+ */
+
+# include "optimizer.h"
+# include "inliner.h"
+# include "tokens.h"
+
+# define MAXCOST 48
+
+using namespace std;
+
+unsigned unrollFactor = 4;
+
+static thread_local Effects loop;
+static thread_local const Symbol *counter;
+
+
+/*
+ * Function:	bound
+ *
+ * Description:	Return the slot of the bound if the test compares the
+ *		counter with an invariant in the direction of the step,
+ *		and whether the comparison includes the bound itself.
+ */
+
+static bool bound(Expression *test, long total, Expression **&limit, bool &inclusive)
+{
+    vector<Expression **> exprs;
+    bool ascending, descending;
+
+
+    test->operands(exprs);
+
+    if (exprs.size() != 2)
+	return false;
+
+    if (names(*exprs[0], counter)) {
+	limit = exprs[1];
+	ascending = dynamic_cast<LessThan *>(test) || dynamic_cast<LessOrEqual *>(test);
+	descending = dynamic_cast<GreaterThan *>(test) || dynamic_cast<GreaterOrEqual *>(test);
+
+    } else if (names(*exprs[1], counter)) {
+	limit = exprs[0];
+	ascending = dynamic_cast<GreaterThan *>(test) || dynamic_cast<GreaterOrEqual *>(test);
+	descending = dynamic_cast<LessThan *>(test) || dynamic_cast<LessOrEqual *>(test);
+
+    } else
+	return false;
+
+    inclusive = dynamic_cast<LessOrEqual *>(test) || dynamic_cast<GreaterOrEqual *>(test);
+
+    if (!invariant(*limit, loop) || (*limit)->type() != Type(INT))
+	return false;
+
+    return total > 0 ? ascending : descending;
+}
+
+
+/*
+ * Function:	offset
+ *
+ * Description:	Return an expression for the counter plus a constant.
+ */
+
+static Expression *offset(long value)
+{
+    Expression *expr = new Identifier(counter);
+
+
+    if (value > 0)
+	return new Add(expr, new Number(to_string(value)), Type(INT));
+
+    if (value < 0)
+	return new Subtract(expr, new Number(to_string(-value)), Type(INT));
+
+    return expr;
+}
+
+
+/*
+ * Function:	substitute
+ *
+ * Description:	Replace each read of the counter in a statement with its
+ *		value, or with the counter plus a constant if the value is
+ *		relative, folding the indices of any addresses that become
+ *		constant.
+ */
+
+static void substitute(Statement *stmt, long value, bool relative)
+{
+    vector<Expression **> exprs;
+    vector<Statement **> stmts;
+    long index;
+
+
+    stmt->operands(exprs);
+    stmt->substatements(stmts);
+
+    for (unsigned i = 0; i < exprs.size(); i ++)
+	if (names(*exprs[i], counter))
+	    *exprs[i] = relative ? offset(value) : number(value);
+	else
+	    substitute(*exprs[i], value, relative);
+
+    if (dynamic_cast<Add *>(stmt) && static_cast<Add *>(stmt)->type().isPointer())
+	for (unsigned i = 0; i < exprs.size(); i ++)
+	    if (dynamic_cast<Multiply *>(*exprs[i]) && (*exprs[i])->constant(index) && index >= 0)
+		*exprs[i] = new Number(to_string(index));
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	substitute(*stmts[i], value, relative);
+}
+
+
+/*
+ * Function:	expand
+ *
+ * Description:	Fully unroll a for statement that runs a small, known
+ *		number of times, returning whether it was done.
+ */
+
+static bool expand(Statement **slot, long total, vector<Statement **> &increments)
+{
+    Statement *stmt = *slot;
+    vector<Expression **> exprs;
+    vector<Statement **> stmts;
+    long start, finish, span, trip;
+    Expression **limit;
+    Statements copies;
+    bool inclusive;
+    Statement *copy;
+
+
+    stmt->substatements(stmts);
+
+    if (increments.size() != 1 || increments[0] != stmts[1])
+	return false;
+
+    if (dynamic_cast<Assignment *>(*stmts[0]) == nullptr)
+	return false;
+
+    (*stmts[0])->operands(exprs);
+
+    if (!names(*exprs[0], counter) || !(*exprs[1])->constant(start))
+	return false;
+
+    if (!bound(*operand(stmt), total, limit, inclusive) || !(*limit)->constant(finish))
+	return false;
+
+    span = total > 0 ? finish - start : start - finish;
+    span += inclusive ? 1 : 0;
+    trip = span > 0 ? (span + labs(total) - 1) / labs(total) : 0;
+
+    if (trip > 2 * (long) unrollFactor)
+	return false;
+
+    for (long i = 0; i < trip; i ++) {
+	Renaming renaming;
+
+	copy = (*stmts[2])->clone(renaming);
+	substitute(copy, start + i * total, false);
+	copies.push_back(copy);
+    }
+
+    copies.push_back(new Assignment(new Identifier(counter), number(start + trip * total)));
+    *slot = new Block(new Scope(), copies);
+    return true;
+}
+
+
+/*
+ * Function:	trailing
+ *
+ * Description:	Return whether a statement is the last evaluated in an
+ *		iteration of a loop: the increment of a for statement or
+ *		the last statement of the body of a while statement.
+ */
+
+static bool trailing(Statement *stmt, Statement **slot)
+{
+    vector<Statement **> stmts, body;
+
+
+    stmt->substatements(stmts);
+
+    if (dynamic_cast<For *>(stmt) != nullptr)
+	return slot == stmts[1];
+
+    if (dynamic_cast<Block *>(*stmts[0]) == nullptr)
+	return false;
+
+    (*stmts[0])->substatements(body);
+    return !body.empty() && slot == body.back();
+}
+
+
+/*
+ * Function:	unroll
+ *
+ * Description:	Unroll a while or for statement by the unroll factor,
+ *		replacing it with a block that computes the bounds of the
+ *		unrolled loop and then runs it and the original loop, which
+ *		runs whatever iterations remain.  If the counter is stepped
+ *		just once, at the end of an iteration, then each copy of
+ *		the body reads the counter plus the steps before it
+ *		instead, and the counter is stepped once for all of them.
+ */
+
+static void unroll(Statement **slot, long total, vector<Statement **> &increments)
+{
+    Statement *stmt = *slot;
+    vector<Statement **> stmts, body;
+    Statements outer, copies;
+    Expression **limit, *test;
+    Symbol *last, *first;
+    Expression *adjust;
+    Renaming renaming;
+    bool inclusive, single;
+    Statement *copy;
+    Scope *decls;
+
+
+    stmt->substatements(stmts);
+
+    if (!bound(*operand(stmt), total, limit, inclusive))
+	return;
+
+    decls = new Scope();
+    last = temporary(decls, Type(INT));
+    first = temporary(decls, Type(INT));
+
+    if (dynamic_cast<For *>(stmt) != nullptr) {
+	outer.push_back(*stmts[0]);
+	*stmts[0] = new Block(new Scope(), Statements());
+    }
+
+    outer.push_back(new Assignment(new Identifier(last), *limit));
+    adjust = new Number(to_string((unrollFactor - 1) * labs(total)));
+
+    if (total > 0) {
+	adjust = new Subtract(new Identifier(last), adjust, Type(INT));
+	test = new LessOrEqual(new Identifier(first), new Identifier(last), Type(INT));
+    } else {
+	adjust = new Add(new Identifier(last), adjust, Type(INT));
+	test = new GreaterOrEqual(new Identifier(first), new Identifier(last), Type(INT));
+    }
+
+    outer.push_back(new Assignment(new Identifier(first), adjust));
+
+    single = increments.size() == 1 && trailing(stmt, increments[0]);
+
+    for (unsigned i = 0; i < unrollFactor; i ++) {
+	copy = (*stmts.back())->clone(renaming);
+
+	if (single) {
+	    if (dynamic_cast<While *>(stmt) != nullptr) {
+		body.clear();
+		copy->substatements(body);
+		*body.back() = new Block(new Scope(), Statements());
+	    }
+
+	    substitute(copy, i * total, true);
+	    copies.push_back(copy);
+
+	} else {
+	    copies.push_back(copy);
+
+	    if (dynamic_cast<For *>(stmt) != nullptr)
+		copies.push_back((*stmts[1])->clone(renaming));
+	}
+    }
+
+    if (single)
+	copies.push_back(new Assignment(new Identifier(counter), offset(unrollFactor * total)));
+
+    *limit = new Identifier(first);
+    outer.push_back(new If(test, new While((*operand(stmt))->clone(renaming),
+	new Block(new Scope(), copies)), nullptr));
+
+    *limit = new Identifier(last);
+    outer.push_back(stmt);
+    *slot = new Block(decls, outer);
+}
+
+
+/*
+ * Function:	optimize
+ *
+ * Description:	Unroll an innermost loop with a small body whose test
+ *		compares an induction variable, either fully or by the
+ *		unroll factor.
+ */
+
+static void optimize(Statement **slot)
+{
+    Statement *stmt = *slot;
+    vector<Statement **> stmts, increments;
+    vector<Expression **> exprs;
+    Identifier *id;
+    long total;
+
+
+    stmt->substatements(stmts);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	if (nested(*stmts[i]))
+	    return;
+
+    if (stmt->cost() > MAXCOST)
+	return;
+
+    loop = Effects();
+    effects(stmt, loop);
+    (*operand(stmt))->operands(exprs);
+
+    for (unsigned i = 0; i < exprs.size(); i ++) {
+	if ((id = dynamic_cast<Identifier *>(*exprs[i])) == nullptr)
+	    continue;
+
+	counter = id->symbol();
+
+	if (counter->type() != Type(INT))
+	    continue;
+
+	if ((total = induction(stmt, counter, increments)) == 0)
+	    continue;
+
+	if (dynamic_cast<For *>(stmt) && expand(slot, total, increments))
+	    return;
+
+	unroll(slot, total, increments);
+	return;
+    }
+}
+
+
+/*
+ * Function:	visit
+ *
+ * Description:	Unroll the loops in a statement, innermost loops first,
+ *		so that a loop whose inner loops were fully unrolled may
+ *		itself be unrolled.
+ */
+
+static void visit(Statement **slot)
+{
+    vector<Statement **> stmts;
+
+
+    (*slot)->substatements(stmts);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	visit(stmts[i]);
+
+    if (dynamic_cast<While *>(*slot) || dynamic_cast<For *>(*slot))
+	optimize(slot);
+}
+
+
+/*
+ * Function:	unrollLoops
+ *
+ * Description:	Unroll the loops of a function, unless the unroll factor
+ *		is one.
+ */
+
+void unrollLoops(Function *function)
+{
+    vector<Statement **> stmts;
+
+
+    if (unrollFactor < 2)
+	return;
+
+    function->body()->substatements(stmts);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	visit(stmts[i]);
+}
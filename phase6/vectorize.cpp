@@ -0,0 +1,401 @@
+/*
+ * File:	vectorize.cpp
+ *
+ * Description:	This file contains the function definitions for
+ *		vectorizing loops with SSE2.
+ *
+ *		A loop is vectorized if its body is a single assignment
+ *		a[i] = e to an array of ints, with i a counter stepped by
+ *		one and compared with an invariant bound, and a invariant.
+ *		The expression e may add, subtract, and negate ints that
+ *		are either invariant, the counter itself, or elements b[i]
+ *		of other arrays of ints with b invariant.  Four iterations
+ *		are then done at once, by a single vector assignment that
+ *		loads four elements of each b, computes e in each lane,
+ *		and stores four elements of a.  The loop
+ *
+ *			while (i < n) { a[i] = e; i = i + 1; }
+ *
+ *		becomes
+ *
+ *			t = n; u = t - 3;
+ *			if (u <= t && i < u && checks)
+ *			    while (i < u) { a[i..i+3] = e; i = i + 4; }
+ *			while (i < t) { a[i] = e; i = i + 1; }
+ *
+ *		where the second loop does whatever iterations remain.
+ *		Since each b[i] is loaded before a[i] is stored, the
+ *		vector assignment differs from the iterations it replaces
+ *		only if an element of b is read after an earlier lane has
+ *		stored it, which is if b lies less than four ints below a.
+ *		Unless b is known to be a itself, the checks test at run
+ *		time that it doesn't.
+ */
+
+# include "optimizer.h"
+# include "inliner.h"
+# include "tokens.h"
+
+# define LANES 4
+# define MAXDEPTH 6
+
+using namespace std;
+
+static thread_local Effects loop;
+static thread_local const Symbol *counter;
+static thread_local vector<Vector::Operation> ops;
+static thread_local Expressions args, bases;
+static thread_local unsigned depth, highest;
+
+
+/*
+ * Function:	element
+ *
+ * Description:	Return whether an expression is the address of the
+ *		counter'th int of an array at an invariant address, and
+ *		that address.
+ */
+
+static bool element(Expression *expr, Expression *&base)
+{
+    vector<Expression **> exprs, factors;
+    Expression *factor;
+    long size;
+
+
+    if (dynamic_cast<Add *>(expr) == nullptr || !expr->type().isPointer())
+	return false;
+
+    if (expr->type().deref() != Type(INT))
+	return false;
+
+    expr->operands(exprs);
+
+    for (unsigned i = 0; i < 2; i ++) {
+	if (dynamic_cast<Multiply *>(*exprs[i]) == nullptr)
+	    continue;
+
+	factors.clear();
+	(*exprs[i])->operands(factors);
+	factor = *factors[0];
+	base = *exprs[1 - i];
+
+	if (dynamic_cast<Promote *>(factor) != nullptr)
+	    factor = *operand(factor);
+
+	if (!names(factor, counter) || !(*factors[1])->constant(size))
+	    continue;
+
+	if (size == (long) Type(INT).size() && invariant(base, loop))
+	    return true;
+    }
+
+    return false;
+}
+
+
+/*
+ * Function:	push
+ *
+ * Description:	Append an operation to the vector expression, keeping
+ *		track of how deep the stack of vectors gets.
+ */
+
+static void push(Vector::Operation op, Expression *arg)
+{
+    if (op == Vector::ADD || op == Vector::SUBTRACT)
+	depth --;
+    else if (op != Vector::NEGATE)
+	depth ++;
+
+    if (depth > highest)
+	highest = depth;
+
+    ops.push_back(op);
+    args.push_back(arg);
+}
+
+
+/*
+ * Function:	lanes
+ *
+ * Description:	Translate an int expression into the operations of a
+ *		vector expression, returning whether it can be.
+ */
+
+static bool lanes(Expression *expr)
+{
+    vector<Expression **> exprs;
+    Expression *base;
+
+
+    if (expr->type() != Type(INT))
+	return false;
+
+    expr->operands(exprs);
+
+    if (dynamic_cast<Dereference *>(expr) && element(*exprs[0], base)) {
+	push(Vector::LOAD, *exprs[0]);
+	bases.push_back(base);
+	return true;
+    }
+
+    if (names(expr, counter)) {
+	push(Vector::STEP, expr);
+	return true;
+    }
+
+    if (dynamic_cast<Add *>(expr) || dynamic_cast<Subtract *>(expr)) {
+	if (!lanes(*exprs[0]) || !lanes(*exprs[1]))
+	    return false;
+
+	push(dynamic_cast<Add *>(expr) ? Vector::ADD : Vector::SUBTRACT, nullptr);
+	return true;
+    }
+
+    if (dynamic_cast<Negate *>(expr) != nullptr) {
+	if (!lanes(*exprs[0]))
+	    return false;
+
+	push(Vector::NEGATE, nullptr);
+	return true;
+    }
+
+    if (invariant(expr, loop)) {
+	push(Vector::SPLAT, expr);
+	return true;
+    }
+
+    return false;
+}
+
+
+/*
+ * Function:	bound
+ *
+ * Description:	Return the slot of the bound if the test compares the
+ *		counter with an invariant, running while it is below.
+ */
+
+static bool bound(Expression *test, Expression **&limit)
+{
+    vector<Expression **> exprs;
+
+
+    test->operands(exprs);
+
+    if (exprs.size() != 2)
+	return false;
+
+    if (names(*exprs[0], counter)) {
+	if (!dynamic_cast<LessThan *>(test) && !dynamic_cast<LessOrEqual *>(test))
+	    return false;
+
+	limit = exprs[1];
+
+    } else if (names(*exprs[1], counter)) {
+	if (!dynamic_cast<GreaterThan *>(test) && !dynamic_cast<GreaterOrEqual *>(test))
+	    return false;
+
+	limit = exprs[0];
+
+    } else
+	return false;
+
+    return invariant(*limit, loop) && (*limit)->type() == Type(INT);
+}
+
+
+/*
+ * Function:	assignment
+ *
+ * Description:	Return the slot of the assignment that is the body of a
+ *		loop, apart from the single increment of the counter.
+ */
+
+static Statement **assignment(Statement *stmt, Statement **increment)
+{
+    vector<Statement **> stmts, slots;
+    Block *block;
+
+
+    stmt->substatements(stmts);
+
+    if ((block = dynamic_cast<Block *>(*stmts.back())) != nullptr) {
+	if (!block->declarations()->symbols().empty())
+	    return nullptr;
+
+	block->substatements(slots);
+    } else
+	slots.push_back(stmts.back());
+
+    if (dynamic_cast<For *>(stmt) != nullptr) {
+	if (increment != stmts[1] || slots.size() != 1)
+	    return nullptr;
+
+    } else if (slots.size() != 2 || increment != slots[1])
+	return nullptr;
+
+    if (dynamic_cast<Assignment *>(*slots[0]) == nullptr)
+	return nullptr;
+
+    return slots[0];
+}
+
+
+/*
+ * Function:	checks
+ *
+ * Description:	Return the test that no array loaded from lies less than
+ *		four ints below the array stored to, or null if none is
+ *		needed.
+ */
+
+static Expression *checks(Expression *dst)
+{
+    Expression *test, *check, *below;
+    Renaming renaming;
+    set<string> keys;
+
+
+    test = nullptr;
+    keys.insert(key(dst));
+
+    for (unsigned i = 0; i < bases.size(); i ++) {
+	if (!keys.insert(key(bases[i])).second)
+	    continue;
+
+	below = new Subtract(dst->clone(renaming), new Number(to_string(LANES * Type(INT).size())), dst->type());
+	check = new LogicalOr(new GreaterOrEqual(bases[i]->clone(renaming), dst->clone(renaming), Type(INT)),
+	    new LessOrEqual(bases[i]->clone(renaming), below, Type(INT)), Type(INT));
+	test = test != nullptr ? new LogicalAnd(test, check, Type(INT)) : check;
+    }
+
+    return test;
+}
+
+
+/*
+ * Function:	optimize
+ *
+ * Description:	Vectorize a loop if it has the right shape, replacing it
+ *		with a block that computes the bound of the vectorized loop
+ *		and then runs it, if the checks pass, and the original loop,
+ *		which runs whatever iterations remain.
+ */
+
+static void optimize(Statement **slot)
+{
+    Statement *stmt = *slot;
+    vector<Statement **> stmts, increments;
+    vector<Expression **> exprs, sides;
+    Expression **limit, *dst, *base, *test, *guard, *safe;
+    Statement **assign, *copy;
+    Statements outer, body;
+    Symbol *last, *first;
+    Renaming renaming;
+    Identifier *id;
+    Scope *decls;
+
+
+    loop = Effects();
+    effects(stmt, loop);
+    (*operand(stmt))->operands(exprs);
+    counter = nullptr;
+
+    for (unsigned i = 0; i < exprs.size() && counter == nullptr; i ++)
+	if ((id = dynamic_cast<Identifier *>(*exprs[i])) != nullptr)
+	    if (id->type() == Type(INT) && induction(stmt, id->symbol(), increments) == 1)
+		counter = id->symbol();
+
+    if (counter == nullptr || increments.size() != 1 || !bound(*operand(stmt), limit))
+	return;
+
+    if ((assign = assignment(stmt, increments[0])) == nullptr)
+	return;
+
+    copy = (*assign)->clone(renaming);
+    copy->operands(sides);
+
+    if (dynamic_cast<Dereference *>(*sides[0]) == nullptr)
+	return;
+
+    dst = *operand(*sides[0]);
+    ops.clear();
+    args.clear();
+    bases.clear();
+    depth = highest = 0;
+
+    if (!element(dst, base) || !lanes(*sides[1]) || highest > MAXDEPTH)
+	return;
+
+    stmt->substatements(stmts);
+    decls = new Scope();
+    last = temporary(decls, Type(INT));
+    first = temporary(decls, Type(INT));
+
+    if (dynamic_cast<For *>(stmt) != nullptr) {
+	outer.push_back(*stmts[0]);
+	*stmts[0] = new Block(new Scope(), Statements());
+    }
+
+    outer.push_back(new Assignment(new Identifier(last), *limit));
+    outer.push_back(new Assignment(new Identifier(first), new Subtract(new Identifier(last),
+	new Number(to_string(LANES - 1)), Type(INT))));
+
+    *limit = new Identifier(first);
+    test = (*operand(stmt))->clone(renaming);
+    guard = new LessOrEqual(new Identifier(first), new Identifier(last), Type(INT));
+    guard = new LogicalAnd(guard, test->clone(renaming), Type(INT));
+
+    if ((safe = checks(base)) != nullptr)
+	guard = new LogicalAnd(guard, safe, Type(INT));
+
+    body.push_back(new Vector(dst, ops, args));
+    body.push_back(new Assignment(new Identifier(counter), new Add(new Identifier(counter),
+	new Number(to_string(LANES)), Type(INT))));
+
+    outer.push_back(new If(guard, new While(test, new Block(new Scope(), body)), nullptr));
+    *limit = new Identifier(last);
+    outer.push_back(stmt);
+    *slot = new Block(decls, outer);
+}
+
+
+/*
+ * Function:	visit
+ *
+ * Description:	Vectorize the loops in a statement.
+ */
+
+static void visit(Statement **slot)
+{
+    vector<Statement **> stmts;
+
+
+    (*slot)->substatements(stmts);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	visit(stmts[i]);
+
+    if (dynamic_cast<While *>(*slot) || dynamic_cast<For *>(*slot))
+	optimize(slot);
+}
+
+
+/*
+ * Function:	vectorizeLoops
+ *
+ * Description:	Vectorize the loops of a function.
+ */
+
+void vectorizeLoops(Function *function)
+{
+    vector<Statement **> stmts;
+
+
+    function->body()->substatements(stmts);
+
+    for (unsigned i = 0; i < stmts.size(); i ++)
+	visit(stmts[i]);
+}
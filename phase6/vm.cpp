@@ -0,0 +1,368 @@
+/*
+ * File:	vm.cpp
+ *
+ * Description:	This file contains the public and private function
+ *		definitions for the bytecode interpreter.  The program is
+ *		lowered into bytecode, the functions it calls are resolved
+ *		to either its own routines or those of the C library we
+ *		were linked with, and main is run.
+ *
+ *		The interpreter is direct-threaded: before running, each
+ *		instruction is rewritten with the address of its handler,
+ *		and each handler ends by jumping straight to the handler
+ *		of the next instruction, using the computed goto of GCC.
+ *
+ *		Calls between routines don't recurse in the interpreter.
+ *		Instead, the registers and memory of each call are carved
+ *		from two stacks, and the caller is saved on a third.  A
+ *		tail call reuses the registers and memory of its caller
+ *		and saves nothing, so it returns to the caller's caller.  A
+ *		call to the C library passes the arguments as 64-bit
+ *		integers, which is how the System V ABI passes both ints
+ *		and pointers, through a variadic function pointer so that
+ *		%al is zero for functions such as printf.
+ */
+
+# include <cstdio>
+# include <memory>
+# include <ostream>
+# include <map>
+# include <dlfcn.h>
+# include "bytecode.h"
+# include "machine.h"
+# include "parser.h"
+# include "vm.h"
+
+using namespace std;
+
+# define MAX_REGISTERS	(1 << 22)
+# define MAX_MEMORY	(1 << 24)
+# define MAX_FRAMES	(1 << 20)
+# define MAX_NATIVE_ARGS 12
+
+typedef intptr_t (*Native)(...);
+
+struct Threaded {
+    const void *handler;
+    int a, b, c;
+    intptr_t imm;
+};
+
+struct Frame {
+    const Threaded *ip, *code;
+    int64_t *regs;
+    uint8_t *memory;
+    unsigned registers, size;
+};
+
+
+/*
+ * Function:	link
+ *
+ * Description:	Resolve each function called by the program to one of its
+ *		routines, or failing that, to a function of the C library.
+ */
+
+static bool link(Program &program, ostream &err)
+{
+    map<string, int> routines;
+    bool ok = true;
+
+
+    for (unsigned i = 0; i < program.routines.size(); i ++)
+	routines[program.routines[i].name] = i;
+
+    for (unsigned i = 0; i < program.callees.size(); i ++) {
+	Callee &callee = program.callees[i];
+
+	if (routines.count(callee.name) > 0)
+	    callee.routine = routines[callee.name];
+
+	else if ((callee.native = dlsym(RTLD_DEFAULT, callee.name.c_str())) == nullptr) {
+	    err << "undefined symbol " << callee.name << endl;
+	    ok = false;
+	}
+    }
+
+    for (unsigned i = 0; i < program.routines.size(); i ++) {
+	const Instructions &code = program.routines[i].code;
+
+	for (unsigned j = 0; j < code.size(); j ++)
+	    if ((code[j].op == OP_CALL || code[j].op == OP_TAIL) && program.callees[code[j].b].routine < 0)
+		if (program.arguments[code[j].c] > MAX_NATIVE_ARGS) {
+		    err << "too many arguments to " << program.callees[code[j].b].name << endl;
+		    ok = false;
+		}
+    }
+
+    return ok;
+}
+
+
+/*
+ * Function:	execute
+ *
+ * Description:	Run the given routine of a linked program, leaving the
+ *		value it returns in STATUS.
+ */
+
+static bool execute(const Program &program, unsigned entry, int &status, ostream &err)
+{
+# define OPCODE(name) &&L_##name,
+    static const void *const handlers[] = { OPCODES };
+# undef OPCODE
+
+    vector<vector<Threaded> > routines(program.routines.size());
+    unique_ptr<int64_t[]> stack(new int64_t[MAX_REGISTERS]);
+    unique_ptr<uint8_t[]> heap(new uint8_t[MAX_MEMORY]);
+    unique_ptr<Frame[]> frames(new Frame[MAX_FRAMES]);
+    const Threaded *ip, *code;
+    const int *args;
+    int64_t *regs, *callee, value;
+    uint8_t *memory;
+    unsigned registers, size, bytes, depth = 0;
+    intptr_t v[MAX_NATIVE_ARGS];
+    bool tail;
+
+
+    /* Thread the code, replacing each opcode with its handler.  A call
+       to the C library gets its own handler, as does a tail call. */
+
+    for (unsigned i = 0; i < program.routines.size(); i ++) {
+	const Instructions &code = program.routines[i].code;
+
+	for (unsigned j = 0; j < code.size(); j ++) {
+	    Threaded t = {handlers[code[j].op], code[j].a, code[j].b, code[j].c, code[j].imm};
+
+	    if (code[j].op == OP_CALL || code[j].op == OP_TAIL) {
+		const Callee &callee = program.callees[code[j].b];
+
+		if (callee.routine >= 0)
+		    t.b = callee.routine;
+		else
+		    t.handler = handlers[code[j].op == OP_CALL ? OP_CALLN : OP_TAILN];
+	    }
+
+	    routines[i].push_back(t);
+	}
+    }
+
+
+    /* Start running at the entry routine. */
+
+# define R(x)		regs[ip->x]
+# define INT(x)		((int64_t) (int32_t) (x))
+# define NEXT()		goto *(++ ip)->handler
+# define JUMP()		do { ip = code + ip->c; goto *ip->handler; } while (0)
+# define BRANCH(cond)	do { if (cond) JUMP(); NEXT(); } while (0)
+
+    regs = stack.get();
+    memory = heap.get();
+    regs[0] = (int64_t) memory;
+    code = ip = &routines[entry][0];
+    registers = program.routines[entry].registers;
+    size = program.routines[entry].memory;
+    goto *ip->handler;
+
+L_MOV:	R(a) = R(b); NEXT();
+L_LI:	R(a) = ip->imm; NEXT();
+
+L_ADD:	R(a) = INT((uint64_t) R(b) + R(c)); NEXT();
+L_SUB:	R(a) = INT((uint64_t) R(b) - R(c)); NEXT();
+L_MUL:	R(a) = INT((uint64_t) R(b) * R(c)); NEXT();
+L_DIV:	R(a) = INT((int32_t) R(b) / (int32_t) R(c)); NEXT();
+L_REM:	R(a) = INT((int32_t) R(b) % (int32_t) R(c)); NEXT();
+
+L_ADDQ:	R(a) = (int64_t) ((uint64_t) R(b) + R(c)); NEXT();
+L_SUBQ:	R(a) = (int64_t) ((uint64_t) R(b) - R(c)); NEXT();
+L_MULQ:	R(a) = (int64_t) ((uint64_t) R(b) * R(c)); NEXT();
+L_DIVQ:	R(a) = R(b) / R(c); NEXT();
+L_REMQ:	R(a) = R(b) % R(c); NEXT();
+
+L_ADDI:	R(a) = INT((uint64_t) R(b) + ip->imm); NEXT();
+L_MULI:	R(a) = INT((uint64_t) R(b) * ip->imm); NEXT();
+L_ADDQI: R(a) = (int64_t) ((uint64_t) R(b) + ip->imm); NEXT();
+L_MULQI: R(a) = (int64_t) ((uint64_t) R(b) * ip->imm); NEXT();
+
+L_NEG:	R(a) = INT(- (uint64_t) R(b)); NEXT();
+L_NEGQ:	R(a) = (int64_t) (- (uint64_t) R(b)); NEXT();
+L_NOT:	R(a) = R(b) == 0; NEXT();
+L_SEXTB: R(a) = (int8_t) R(b); NEXT();
+L_SEXTW: R(a) = (int32_t) R(b); NEXT();
+
+L_LT:	R(a) = R(b) < R(c); NEXT();
+L_GT:	R(a) = R(b) > R(c); NEXT();
+L_LE:	R(a) = R(b) <= R(c); NEXT();
+L_GE:	R(a) = R(b) >= R(c); NEXT();
+L_EQ:	R(a) = R(b) == R(c); NEXT();
+L_NE:	R(a) = R(b) != R(c); NEXT();
+
+L_LB:	R(a) = *(int8_t *) (R(b) + ip->imm); NEXT();
+L_LW:	R(a) = *(int32_t *) (R(b) + ip->imm); NEXT();
+L_LQ:	R(a) = *(int64_t *) (R(b) + ip->imm); NEXT();
+L_LBX:	R(a) = *(int8_t *) (R(b) + R(c) * ip->imm); NEXT();
+L_LWX:	R(a) = *(int32_t *) (R(b) + R(c) * ip->imm); NEXT();
+L_LQX:	R(a) = *(int64_t *) (R(b) + R(c) * ip->imm); NEXT();
+
+L_SB:	*(int8_t *) (R(b) + ip->imm) = R(a); NEXT();
+L_SW:	*(int32_t *) (R(b) + ip->imm) = R(a); NEXT();
+L_SQ:	*(int64_t *) (R(b) + ip->imm) = R(a); NEXT();
+L_SBX:	*(int8_t *) (R(b) + R(c) * ip->imm) = R(a); NEXT();
+L_SWX:	*(int32_t *) (R(b) + R(c) * ip->imm) = R(a); NEXT();
+L_SQX:	*(int64_t *) (R(b) + R(c) * ip->imm) = R(a); NEXT();
+
+L_LEA:	R(a) = R(b) + R(c) * ip->imm; NEXT();
+
+L_JMP:	JUMP();
+L_BZ:	BRANCH(R(a) == 0);
+L_BNZ:	BRANCH(R(a) != 0);
+
+L_BLT:	BRANCH(R(a) < R(b));
+L_BGT:	BRANCH(R(a) > R(b));
+L_BLE:	BRANCH(R(a) <= R(b));
+L_BGE:	BRANCH(R(a) >= R(b));
+L_BEQ:	BRANCH(R(a) == R(b));
+L_BNE:	BRANCH(R(a) != R(b));
+
+L_BLTI:	BRANCH(R(a) < ip->imm);
+L_BGTI:	BRANCH(R(a) > ip->imm);
+L_BLEI:	BRANCH(R(a) <= ip->imm);
+L_BGEI:	BRANCH(R(a) >= ip->imm);
+L_BEQI:	BRANCH(R(a) == ip->imm);
+L_BNEI:	BRANCH(R(a) != ip->imm);
+
+L_CALL:
+    callee = regs + registers;
+    args = &program.arguments[ip->c];
+
+    if (callee + program.routines[ip->b].registers > stack.get() + MAX_REGISTERS ||
+	    memory + size + program.routines[ip->b].memory > heap.get() + MAX_MEMORY ||
+	    depth == MAX_FRAMES) {
+	err << "stack overflow in " << program.routines[ip->b].name << endl;
+	return false;
+    }
+
+    for (int i = 1; i <= args[0]; i ++)
+	callee[i] = regs[args[i]];
+
+    frames[depth ++] = {ip, code, regs, memory, registers, size};
+    regs = callee;
+    memory += size;
+    regs[0] = (int64_t) memory;
+    registers = program.routines[ip->b].registers;
+    size = program.routines[ip->b].memory;
+    code = ip = &routines[ip->b][0];
+    goto *ip->handler;
+
+L_TAIL:
+    args = &program.arguments[ip->c];
+    callee = regs + registers;
+
+    if (callee + args[0] + 1 > stack.get() + MAX_REGISTERS ||
+	    regs + program.routines[ip->b].registers > stack.get() + MAX_REGISTERS ||
+	    memory + program.routines[ip->b].memory > heap.get() + MAX_MEMORY) {
+	err << "stack overflow in " << program.routines[ip->b].name << endl;
+	return false;
+    }
+
+    for (int i = 1; i <= args[0]; i ++)
+	callee[i] = regs[args[i]];
+
+    for (int i = 1; i <= args[0]; i ++)
+	regs[i] = callee[i];
+
+    registers = program.routines[ip->b].registers;
+    size = program.routines[ip->b].memory;
+    code = ip = &routines[ip->b][0];
+    goto *ip->handler;
+
+L_CALLN:
+    tail = false;
+    goto native;
+
+L_TAILN:
+    tail = true;
+
+native:
+    args = &program.arguments[ip->c];
+
+    for (int i = 0; i < MAX_NATIVE_ARGS; i ++)
+	v[i] = i < args[0] ? regs[args[i + 1]] : 0;
+
+    if (args[0] <= 6)
+	value = ((Native) program.callees[ip->b].native)(v[0], v[1], v[2], v[3], v[4], v[5]);
+    else
+	value = ((Native) program.callees[ip->b].native)(v[0], v[1], v[2], v[3], v[4], v[5],
+	    v[6], v[7], v[8], v[9], v[10], v[11]);
+
+    bytes = program.callees[ip->b].size;
+    R(a) = bytes == 1 ? (int8_t) value : bytes == 4 ? (int32_t) value : value;
+
+    if (!tail)
+	NEXT();
+
+L_RET:
+    value = R(a);
+
+    if (depth == 0) {
+	status = (int) value;
+	return true;
+    }
+
+    depth --;
+    ip = frames[depth].ip;
+    code = frames[depth].code;
+    regs = frames[depth].regs;
+    memory = frames[depth].memory;
+    registers = frames[depth].registers;
+    size = frames[depth].size;
+    R(a) = value;
+    NEXT();
+
+# undef R
+# undef INT
+# undef NEXT
+# undef JUMP
+# undef BRANCH
+}
+
+
+/*
+ * Function:	interpret
+ *
+ * Description:	Compile the program read from IN into bytecode and run it,
+ *		leaving the value returned by its main function in STATUS.
+ *		The program reads the standard input and writes the
+ *		standard output of this process.  Return the number of
+ *		errors reported, in which case the program isn't run.
+ */
+
+int interpret(istream &in, ostream &err, int &status)
+{
+    Program program;
+    int errors;
+
+
+    errors = compile(in, program, err);
+
+    if (errors > 0)
+	return errors;
+
+    if (target->bits != 8 * sizeof(uintptr_t)) {
+	err << "cannot interpret " << target->name << " code on this host" << endl;
+	return 1;
+    }
+
+    if (!link(program, err))
+	return 1;
+
+    for (unsigned i = 0; i < program.routines.size(); i ++)
+	if (program.routines[i].name == "main") {
+	    errors = execute(program, i, status, err) ? 0 : 1;
+	    fflush(stdout);
+	    return errors;
+	}
+
+    err << "no main function" << endl;
+    return 1;
+}
@@ -0,0 +1,15 @@
+/*
+ * File:	vm.h
+ *
+ * Description:	This file contains the public function declarations for
+ *		running a Simple C program in the bytecode interpreter,
+ *		which needs no assembler and no particular instruction set.
+ */
+
+# ifndef VM_H
+# define VM_H
+# include <iosfwd>
+
+int interpret(std::istream &in, std::ostream &err, int &status);
+
+# endif /* VM_H */